@@ -0,0 +1,172 @@
+#include "aes_cmac.h"
+#include <string.h>
+
+// S-блок AES (FIPS-197, рис. 7)
+static const uint8_t SBOX[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+// Умножение на x в GF(2^8)
+static inline uint8_t xtime(uint8_t b) {
+    return (uint8_t)((b << 1) ^ ((b & 0x80) ? 0x1b : 0x00));
+}
+
+// Расписание ключей AES-128: 11 раундовых ключей по 16 байт
+static void expandKey(const uint8_t key[AES_KEY_SIZE], uint8_t roundKeys[176]) {
+    memcpy(roundKeys, key, AES_KEY_SIZE);
+    uint8_t rcon = 0x01;
+    for (uint8_t i = 16; i < 176; i += 4) {
+        uint8_t t[4] = {roundKeys[i - 4], roundKeys[i - 3], roundKeys[i - 2], roundKeys[i - 1]};
+        if (i % 16 == 0) {
+            uint8_t first = t[0];
+            t[0] = SBOX[t[1]] ^ rcon;
+            t[1] = SBOX[t[2]];
+            t[2] = SBOX[t[3]];
+            t[3] = SBOX[first];
+            rcon = xtime(rcon);
+        }
+        for (uint8_t j = 0; j < 4; j++) roundKeys[i + j] = roundKeys[i - 16 + j] ^ t[j];
+    }
+}
+
+// Программное зашифрование блока (состояние хранится по столбцам, как в FIPS-197)
+static void encryptSoftware(const uint8_t roundKeys[176], const uint8_t in[AES_BLOCK_SIZE], uint8_t out[AES_BLOCK_SIZE]) {
+    uint8_t s[AES_BLOCK_SIZE];
+    for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++) s[i] = in[i] ^ roundKeys[i];
+
+    for (uint8_t round = 1; round <= 10; round++) {
+        // SubBytes + ShiftRows за один проход
+        uint8_t t[AES_BLOCK_SIZE];
+        for (uint8_t c = 0; c < 4; c++) {
+            for (uint8_t r = 0; r < 4; r++) t[c * 4 + r] = SBOX[s[((c + r) % 4) * 4 + r]];
+        }
+
+        // MixColumns (кроме последнего раунда)
+        if (round < 10) {
+            for (uint8_t c = 0; c < 4; c++) {
+                uint8_t* col = t + c * 4;
+                uint8_t all = col[0] ^ col[1] ^ col[2] ^ col[3];
+                uint8_t first = col[0];
+                col[0] ^= all ^ xtime(col[0] ^ col[1]);
+                col[1] ^= all ^ xtime(col[1] ^ col[2]);
+                col[2] ^= all ^ xtime(col[2] ^ col[3]);
+                col[3] ^= all ^ xtime(col[3] ^ first);
+            }
+        }
+
+        const uint8_t* rk = roundKeys + round * 16;
+        for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++) s[i] = t[i] ^ rk[i];
+    }
+    memcpy(out, s, AES_BLOCK_SIZE);
+}
+
+// Сдвиг блока на 1 бит влево с условным XOR 0x87 (генерация подключей CMAC)
+static void doubleBlock(const uint8_t in[AES_BLOCK_SIZE], uint8_t out[AES_BLOCK_SIZE]) {
+    uint8_t carry = in[0] >> 7;
+    for (uint8_t i = 0; i < AES_BLOCK_SIZE - 1; i++) out[i] = (uint8_t)((in[i] << 1) | (in[i + 1] >> 7));
+    out[AES_BLOCK_SIZE - 1] = (uint8_t)((in[AES_BLOCK_SIZE - 1] << 1) ^ (carry ? 0x87 : 0x00));
+}
+
+
+
+/**
+ * @brief Установка ключа: расписание ключей (или загрузка ключа в аппаратный блок) и подключи K1/K2
+ *
+ * @param key - ключ AES-128
+ * @param backend - желаемое исполнение AES
+ */
+void AesCmac::setKey(const uint8_t key[AES_KEY_SIZE], AesBackend backend) {
+    #if defined(ARDUINO_ARCH_ESP32)
+    _backend = backend;
+    if (_backend == AesBackend::HARDWARE) {
+        esp_aes_init(&_hw);
+        esp_aes_setkey(&_hw, key, 128);
+    }
+    #else
+    (void)backend;
+    _backend = AesBackend::SOFTWARE; // Аппаратного AES нет
+    #endif
+    expandKey(key, _roundKeys);
+
+    uint8_t zero[AES_BLOCK_SIZE] = {0};
+    uint8_t l[AES_BLOCK_SIZE];
+    encryptBlock(zero, l);
+    doubleBlock(l, _k1);
+    doubleBlock(_k1, _k2);
+    begin();
+}
+
+
+
+void AesCmac::encryptBlock(const uint8_t in[AES_BLOCK_SIZE], uint8_t out[AES_BLOCK_SIZE]) {
+    #if defined(ARDUINO_ARCH_ESP32)
+    if (_backend == AesBackend::HARDWARE) {
+        esp_aes_crypt_ecb(&_hw, ESP_AES_ENCRYPT, in, out);
+        return;
+    }
+    #endif
+    encryptSoftware(_roundKeys, in, out);
+}
+
+
+
+void AesCmac::begin() {
+    memset(_state, 0, sizeof(_state));
+    _bufferLength = 0;
+}
+
+
+
+/**
+ * @brief Добавление данных. Полный блок шифруется только когда за ним пришли ещё данные:
+ * последний блок обрабатывается в finish() особым образом
+ */
+void AesCmac::update(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        if (_bufferLength == AES_BLOCK_SIZE) {
+            for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++) _state[i] ^= _buffer[i];
+            encryptBlock(_state, _state);
+            _bufferLength = 0;
+        }
+        size_t chunk = AES_BLOCK_SIZE - _bufferLength;
+        if (chunk > length) chunk = length;
+        memcpy(_buffer + _bufferLength, data, chunk);
+        _bufferLength += (uint8_t)chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+
+
+/**
+ * @brief Завершение: последний блок складывается с K1 (полный) или дополняется 10..0 и складывается с K2
+ *
+ * @param mac - полный 16-байтный код; в кадр обычно идёт только его начало
+ */
+void AesCmac::finish(uint8_t mac[AES_BLOCK_SIZE]) {
+    const uint8_t* subkey = _k1;
+    if (_bufferLength < AES_BLOCK_SIZE) {
+        _buffer[_bufferLength] = 0x80;
+        memset(_buffer + _bufferLength + 1, 0, AES_BLOCK_SIZE - _bufferLength - 1);
+        subkey = _k2;
+    }
+    for (uint8_t i = 0; i < AES_BLOCK_SIZE; i++) _state[i] ^= _buffer[i] ^ subkey[i];
+    encryptBlock(_state, mac);
+    begin();
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include "aes/esp_aes.h" // Аппаратный блок AES (ESP32, ESP32-S3)
+#endif
+
+/**
+ * AES-128-CMAC (RFC 4493) — код аутентичности сообщения
+ *
+ * Блочный шифр — два исполнения:
+ *  HARDWARE — аппаратный ускоритель AES на ESP32/ESP32-S3 (esp_aes_*);
+ *  SOFTWARE — переносимая реализация AES-128 (только зашифрование, оно всё, что нужно CMAC).
+ * На ESP8266 и на хосте HARDWARE недоступен и молча заменяется на SOFTWARE.
+ * Оба исполнения дают одинаковый результат, поэтому узлы с разными платами понимают друг друга.
+ *
+ * Не зависит от Arduino: проверяется тестовыми векторами и замеряется на хосте (tools/auth_bench).
+ */
+
+#define AES_BLOCK_SIZE 16
+#define AES_KEY_SIZE 16
+
+enum class AesBackend : uint8_t {
+    SOFTWARE = 0,
+    HARDWARE = 1,
+};
+
+class AesCmac {
+public:
+    /**
+     * @brief Установка ключа и вычисление подключей K1/K2 (один раз на ключ)
+     *
+     * @param key - ключ AES-128
+     * @param backend - аппаратный или программный AES
+     */
+    void setKey(const uint8_t key[AES_KEY_SIZE], AesBackend backend = AesBackend::HARDWARE);
+
+    AesBackend backend() { return _backend; }
+
+    // Потоковое вычисление: begin(), любое число update(), finish()
+    void begin();
+    void update(const uint8_t* data, size_t length);
+    void finish(uint8_t mac[AES_BLOCK_SIZE]);
+
+    /**
+     * @brief Зашифрование одного блока текущим ключом (AES-128 ECB)
+     */
+    void encryptBlock(const uint8_t in[AES_BLOCK_SIZE], uint8_t out[AES_BLOCK_SIZE]);
+
+private:
+    AesBackend _backend = AesBackend::SOFTWARE;
+    uint8_t _roundKeys[176];        // Расписание ключей программного AES
+    uint8_t _k1[AES_BLOCK_SIZE];    // Подключи CMAC
+    uint8_t _k2[AES_BLOCK_SIZE];
+    uint8_t _state[AES_BLOCK_SIZE]; // Цепочка CBC-MAC
+    uint8_t _buffer[AES_BLOCK_SIZE];
+    uint8_t _bufferLength = 0;      // Последний блок держим до finish(): его надо сложить с K1 или K2
+
+    #if defined(ARDUINO_ARCH_ESP32)
+    esp_aes_context _hw;
+    #endif
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+/**
+ * ОБРАЗЕЦ src/auth_keys.h — ключей подписи кадров (AES-128, см. frame_auth.h)
+ *
+ * Настоящий файл создаётся для каждой сети и в git не попадает (.gitignore):
+ *     python3 tools/auth_keygen.py > src/auth_keys.h
+ * Один и тот же файл — на все узлы сети. Ключи из этого образца нулевые и известны всем: прошивка
+ * с ними не собирается (AUTH_KEYS_PLACEHOLDER), их берут только хостовые инструменты из tools/,
+ * которым нужны размеры кадра, а не ключи.
+ */
+
+#define AUTH_KEYS_PLACEHOLDER
+
+// Ключ пары пульт <-> приёмник
+#define AUTH_KEY_REMOTE_1 {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+
+// Ключ группы, общий для всех узлов сети: им подписаны кадры для всех сразу (маяки TDMA, команды группе).
+// Узел, знающий только ключ пары, такие кадры не примет
+#define AUTH_KEY_GROUP {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
@@ -0,0 +1,198 @@
+#include "battery.h"
+
+#ifdef BATTERY_USED
+
+#include "site_config.h"
+#include "logger.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(BATTERY_PIN)
+  #if ESP_ARDUINO_VERSION_MAJOR >= 3
+    #define BATTERY_DMA // Непрерывный режим АЦП (analogContinuous) — с ядра Arduino 3.0
+  #else
+    #include <esp_timer.h>
+    #include <freertos/FreeRTOS.h>
+    #define BATTERY_TIMER_SAMPLES 16 // Ядро 2.x: выборок на одно среднее, по одной на срабатывание esp_timer
+    static esp_timer_handle_t sampleTimer = nullptr;
+    static uint32_t sampleSum = 0;
+    static uint8_t sampleCount = 0;
+    static volatile uint32_t frameMv = 0;
+    // Выборки идут в задаче esp_timer, разбор — в loop(): готовое среднее передаём под замком
+    static portMUX_TYPE frameMux = portMUX_INITIALIZER_UNLOCKED;
+  #endif
+  static volatile bool frameReady = false;
+#endif
+
+BatteryMonitor MyBattery;
+
+
+
+#if defined(BATTERY_DMA)
+// Прерывание АЦП: кадр из BATTERY_OVERSAMPLE выборок готов, усреднение уже сделал драйвер
+static void IRAM_ATTR onConversionDone() {
+    frameReady = true;
+}
+#elif defined(ARDUINO_ARCH_ESP32) && defined(BATTERY_PIN)
+static void onSample(void* arg) {
+    (void)arg;
+    sampleSum += analogReadMilliVolts(BATTERY_PIN);
+    if (++sampleCount < BATTERY_TIMER_SAMPLES) return;
+    portENTER_CRITICAL(&frameMux);
+    frameMv = sampleSum / sampleCount;
+    frameReady = true;
+    portEXIT_CRITICAL(&frameMux);
+    sampleSum = 0;
+    sampleCount = 0;
+}
+#endif
+
+
+
+void BatteryMonitor::begin() {
+    #if defined(BATTERY_DMA)
+        const uint8_t pins[] = {BATTERY_PIN};
+        analogContinuousSetAtten(ADC_11db); // До ~3.1 В на пине
+        if (!analogContinuous(pins, 1, BATTERY_OVERSAMPLE, BATTERY_SAMPLE_HZ, onConversionDone) || !analogContinuousStart()) {
+            print_log("[BATTERY]", "ADC continuous mode failed");
+        }
+    #elif defined(ARDUINO_ARCH_ESP32) && defined(BATTERY_PIN)
+        analogSetPinAttenuation(BATTERY_PIN, ADC_11db);
+        esp_timer_create_args_t args = {};
+        args.callback = onSample;
+        args.name = "battery";
+        esp_timer_create(&args, &sampleTimer);
+        esp_timer_start_periodic(sampleTimer, (uint64_t)BATTERY_OVERSAMPLE * 1000000ULL / BATTERY_SAMPLE_HZ / BATTERY_TIMER_SAMPLES);
+    #endif
+}
+
+
+
+/**
+ * @brief Забрать готовое среднее. Сам АЦП loop() не трогает
+ */
+void BatteryMonitor::service() {
+    #if defined(BATTERY_DMA)
+        if (!frameReady) return;
+        frameReady = false;
+        adc_continuous_data_t* result = nullptr;
+        if (analogContinuousRead(&result, 0)) addFrame(result[0].avg_read_mvolts);
+    #elif defined(ARDUINO_ARCH_ESP32) && defined(BATTERY_PIN)
+        if (!frameReady) return;
+        portENTER_CRITICAL(&frameMux);
+        uint32_t mv = frameMv;
+        frameReady = false;
+        portEXIT_CRITICAL(&frameMux);
+        addFrame(mv);
+    #endif
+}
+
+
+
+void BatteryMonitor::addFrame(uint32_t pinMv) {
+    _lastPinMv = pinMv;
+    uint32_t packMv = (uint32_t)(pinMv * BATTERY_DIVIDER_RATIO);
+    if (frames++ == 0) _filteredQ = packMv << BATTERY_FILTER_SHIFT; // Первое значение — сразу, без разгона фильтра
+    else _filteredQ = _filteredQ - (_filteredQ >> BATTERY_FILTER_SHIFT) + packMv;
+
+    bool low = isLow(millivolts(), _low);
+    if (low != _low) print_log("[BATTERY]", String(low ? "Low: " : "Recovered: ") + String(millivolts() / 1000.0f, 2) + " V");
+    _low = low;
+}
+
+
+
+uint16_t BatteryMonitor::millivolts() const {
+    if (frames == 0) return 0;
+    uint32_t mv = (uint32_t)((_filteredQ >> BATTERY_FILTER_SHIFT) * MyConfig.data.batteryScale);
+    if (mv < BATTERY_CELLS * BATTERY_CELL_ABSENT_MV) return 0; // Пин висит в воздухе или делителя нет
+    return mv > 0xFFFF ? 0xFFFF : (uint16_t)mv;
+}
+
+
+
+// Порог с гистерезисом: из "низкого" выходим только заметно выше порога (просадка под нагрузкой не дёргает флаг)
+bool BatteryMonitor::isLow(uint16_t mv, bool wasLow) const {
+    if (mv == 0) return false;
+    return mv < BATTERY_CELLS * (BATTERY_CELL_LOW_MV + (wasLow ? BATTERY_CELL_HYSTERESIS_MV : 0));
+}
+
+
+
+void BatteryMonitor::onPeerReport(uint16_t mv) {
+    _peerMv = mv;
+    _peerAtMs = millis();
+    _peerLow = isLow(mv, _peerLow);
+}
+
+
+
+uint16_t BatteryMonitor::peerMillivolts() const {
+    if (_peerMv == 0 || millis() - _peerAtMs > BATTERY_PEER_MAX_AGE) return 0;
+    return _peerMv;
+}
+
+
+
+static String volts(uint16_t mv) {
+    return String(mv / 1000.0f, 2) + "V";
+}
+
+
+
+String BatteryMonitor::summary() const {
+    String line;
+    if (peerMillivolts() != 0) line = "RX " + volts(peerMillivolts()) + (peerLow() ? "!" : "");
+    if (millivolts() != 0) line += (line.length() > 0 ? " " : "") + RADIO_NAME + " " + volts(millivolts()) + (_low ? "!" : "");
+    return line;
+}
+
+
+
+// Команды "battery" и "battery cal <В>"
+bool BatteryMonitor::handleCommand(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd != "battery" && !cmd.startsWith("battery ")) return false;
+
+    if (cmd.startsWith("battery cal ")) {
+        float measured = cmd.substring(12).toFloat();
+        uint32_t rawMv = _filteredQ >> BATTERY_FILTER_SHIFT; // По номиналу делителя, без поправки
+        if (frames == 0 || rawMv < BATTERY_CELLS * BATTERY_CELL_ABSENT_MV) {
+            reply("BATTERY nothing measured to calibrate");
+            return true;
+        }
+        float scale = measured * 1000.0f / rawMv;
+        if (scale < 0.8f || scale > 1.25f) {
+            reply("BATTERY scale " + String(scale, 4) + " out of 0.8..1.25: check the divider or the meter");
+            return true;
+        }
+        MyConfig.data.batteryScale = scale;
+        bool ok = MyConfig.save();
+        reply("BATTERY scale " + String(scale, 4) + (ok ? " saved" : " save FAILED") + ", now " + volts(millivolts()));
+        return true;
+    }
+    if (cmd != "battery") {
+        reply("Usage: battery [cal <volts>]");
+        return true;
+    }
+
+    #if defined(BATTERY_PIN)
+        #if defined(BATTERY_DMA)
+            const char* source = "ADC DMA";
+        #else
+            const char* source = "esp_timer";
+        #endif
+        uint16_t mv = millivolts();
+        reply("BATTERY " + RADIO_NAME + " " + (mv != 0 ? volts(mv) + " (" + String(mv / 1000.0f / BATTERY_CELLS, 2) + " V/cell)" : String("none")) +
+              (_low ? " LOW" : "") + ", pin " + String(_lastPinMv) + " mV x" + String(BATTERY_DIVIDER_RATIO, 1) + " x" +
+              String(MyConfig.data.batteryScale, 4) + ", " + String(frames) + " frames (" + source + ")");
+    #else
+        reply("BATTERY " + RADIO_NAME + " not measured (no BATTERY_PIN)");
+    #endif
+    #ifdef TRANSMITTER
+        uint16_t peer = peerMillivolts();
+        if (peer == 0) reply("RX no report");
+        else reply("RX " + volts(peer) + " (" + String(peer / 1000.0f / BATTERY_CELLS, 2) + " V/cell)" + (peerLow() ? " LOW" : "") +
+                   ", " + String((millis() - _peerAtMs) / 1000) + " s ago");
+    #endif
+    return true;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * НАПРЯЖЕНИЕ БАТАРЕИ 6S (фоновое измерение, отчёт в ответах приёмника)
+ *
+ * АЦП работает сам: в непрерывном режиме контроллер DMA складывает BATTERY_OVERSAMPLE выборок
+ * с BATTERY_PIN в буфер и по готовности отдаёт их среднее, уже пересчитанное в мВ по калибровке из eFuse.
+ * loop() в АЦП не ходит — service() только забирает готовое среднее: пересчёт через делитель и поправку
+ * "battery cal", фильтр (скользящее среднее с весом 1/2^BATTERY_FILTER_SHIFT) и порог низкого заряда
+ * с гистерезисом. В ядре Arduino 2.x непрерывного режима нет — там выборки снимает периодический esp_timer
+ * в своей задаче, но тоже не loop().
+ *
+ * Приёмник дописывает напряжение к метрикам линка в каждом ответе: "ACK_OK|-87,9,23150" (мВ), в неявном
+ * профиле — два байта к ответу. Отдельных кадров нет. Пульт показывает напряжение приёмника на экране,
+ * отдаёт по BLE и при низком заряде (своём или приёмника) реже сверяет состояние (Reconciler::setLowBattery).
+ * 0 мВ — "нет данных": узел без BATTERY_PIN, без делителя или ещё не успевший измерить.
+ *
+ * Команды: "battery" — своё напряжение и приёмника, "battery cal <В>" — поправка делителя по вольтметру
+ * (сохраняется в настройках узла, см. site_config.h).
+ */
+
+#ifdef BATTERY_USED
+
+class BatteryMonitor {
+public:
+    /**
+     * @brief Запуск фоновых выборок (только узлы с BATTERY_PIN)
+     */
+    void begin();
+
+    /**
+     * @brief Вызывать из loop(): забрать готовое среднее, отфильтровать, обновить порог
+     */
+    void service();
+
+    uint16_t millivolts() const; // Своё напряжение сборки, мВ (0 — нет данных)
+    bool low() const { return _low; }
+
+    /**
+     * @brief Пульт: напряжение приёмника из ответа
+     *
+     * @param mv - мВ (0 — приёмник не измеряет)
+     */
+    void onPeerReport(uint16_t mv);
+
+    uint16_t peerMillivolts() const; // Пульт: напряжение приёмника, мВ (0 — нет данных или они старше BATTERY_PEER_MAX_AGE)
+    bool peerLow() const { return _peerLow && peerMillivolts() != 0; }
+
+    /**
+     * @brief Короткая строка для экрана: "RX 23.15V TX 24.02V" (пустая, если показывать нечего)
+     */
+    String summary() const;
+
+    /**
+     * @brief Команды "battery", "battery cal <В>"
+     */
+    bool handleCommand(const String& cmd, void (*reply)(const String& line));
+
+    uint32_t frames = 0; // Усреднённых значений с включения
+
+private:
+    void addFrame(uint32_t pinMv);
+    bool isLow(uint16_t mv, bool wasLow) const;
+
+    uint32_t _filteredQ = 0;   // Напряжение сборки без поправки, мВ * 2^BATTERY_FILTER_SHIFT
+    uint32_t _lastPinMv = 0;   // Последнее среднее на пине АЦП, мВ
+    bool _low = false;
+    uint16_t _peerMv = 0;
+    bool _peerLow = false;
+    unsigned long _peerAtMs = 0;
+};
+
+extern BatteryMonitor MyBattery;
+
+#endif
@@ -10,35 +10,64 @@ BleManager MyBLE;
 // Класс, который слушает события от телефона
 class MyCallbacks: public BLECharacteristicCallbacks {
     void onWrite(BLECharacteristic *pCharacteristic) {
-        std::string rxValue = pCharacteristic->getValue();
-
-        if (rxValue.length() > 0 && rxValue.length() < 64) { // Ограничим длину команды
-            String cmd = "";
-            for (int i = 0; i < rxValue.length(); i++) {
-                cmd += rxValue[i];
-            }
-            MyBLE._receivedCommand = cmd;
+        // Данные читаем прямо из буфера характеристики, без промежуточных строк
+        const uint8_t* data = pCharacteristic->getData();
+        size_t length = pCharacteristic->getLength();
+
+        // Ограничим длину команды. Пока main не забрал предыдущую команду, новые отбрасываются
+        if (length > 0 && length < BLE_COMMAND_MAX_LEN && MyBLE._receivedLength == 0) {
+            memcpy(MyBLE._receivedCommand, data, length);
+            MyBLE._receivedCommand[length] = '\0';
+            MyBLE._receivedLength = (uint8_t)length; // Последним шагом: ящик заполнен
         }
     }
 };
 
 class MyServerCallbacks: public BLEServerCallbacks {
     void onConnect(BLEServer* pServer) {
-        // Можно добавить флаг подключения
+        MyBLE.deviceConnected = true;
     };
 
     void onDisconnect(BLEServer* pServer) {
-        // При потере связи запускаем рекламу снова, чтобы можно было переподключиться
-        pServer->getAdvertising()->start();
+        MyBLE.deviceConnected = false;
+        // При потере связи запускаем рекламу снова, чтобы можно было переподключиться (но не в режиме ожидания)
+        if (MyBLE._state == BleState::ACTIVE) pServer->getAdvertising()->start();
     }
 };
 
+// Колбэки и дескриптор живут всё время работы: GATT-база создаётся один раз и больше не пересоздаётся
+static MyServerCallbacks serverCallbacks;
+static MyCallbacks rxCallbacks;
+static BLE2902 txNotifyDescriptor;
+
+
+
+/**
+ * @brief Включение BLE. Первый раз — полная инициализация стека и GATT-базы,
+ * из режима ожидания — только реклама и мощность передатчика
+ * 
+ * @param deviceName - имя устройства (используется только при первой инициализации)
+ */
 void BleManager::begin(String deviceName) {
-    if (_isActive) return;
+    if (_state == BleState::ACTIVE) return;
+
+    uint32_t heapBefore = ESP.getFreeHeap();
+    uint32_t t0 = micros();
+
+    if (_state == BleState::STANDBY) {
+        // Быстрый путь: всё уже создано, ничего не выделяем
+        BLEDevice::setPower(ESP_PWR_LVL_P9, ESP_BLE_PWR_TYPE_DEFAULT);
+        pServer->getAdvertising()->start();
+        _state = BleState::ACTIVE;
+        _resumeTimeUs = micros() - t0;
+        _resumeHeapCost = (int32_t)(heapBefore - ESP.getFreeHeap());
+        _resumeCount++;
+        return;
+    }
 
     BLEDevice::init(deviceName.c_str());
     pServer = BLEDevice::createServer();
-    pServer->setCallbacks(new MyServerCallbacks());
+    pServer->setCallbacks(&serverCallbacks);
 
     BLEService *pService = pServer->createService(SERVICE_UUID);
 
@@ -46,38 +75,45 @@ void BleManager::begin(String deviceName) {
                                 CHARACTERISTIC_UUID_TX,
                                 BLECharacteristic::PROPERTY_NOTIFY
                             );
-    pTxCharacteristic->addDescriptor(new BLE2902());
+    pTxCharacteristic->addDescriptor(&txNotifyDescriptor);
 
     pRxCharacteristic = pService->createCharacteristic(
                                 CHARACTERISTIC_UUID_RX,
                                 BLECharacteristic::PROPERTY_WRITE
                             );
-    pRxCharacteristic->setCallbacks(new MyCallbacks());
+    pRxCharacteristic->setCallbacks(&rxCallbacks);
 
     pService->start();
     pServer->getAdvertising()->start();
     
-    _isActive = true;
+    _state = BleState::ACTIVE;
+    _initTimeUs = micros() - t0;
+    _initHeapCost = (int32_t)(heapBefore - ESP.getFreeHeap());
 }
 
 
+/**
+ * @brief Перевод BLE в режим ожидания. Стек и GATT-база остаются в памяти
+ */
 void BleManager::stop() {
-    if (!_isActive) return;
+    if (_state != BleState::ACTIVE) return;
 
-    // 1. Останавливаем рекламу (Advertising)
-    BLEDevice::getAdvertising()->stop();
+    uint32_t heapBefore = ESP.getFreeHeap();
+    uint32_t t0 = micros();
 
-    // 2. Деинициализируем устройство и освобождаем память
-    // Параметр 'true' заставляет Bluetooth стек полностью выгрузиться из памяти
-    BLEDevice::deinit(true);
+    // 1. Останавливаем рекламу (Advertising) — до отключения клиента, иначе onDisconnect запустит её снова
+    _state = BleState::STANDBY;
+    pServer->getAdvertising()->stop();
 
-    // 3. Сбрасываем указатели, так как объекты сервера и характеристик удалены внутри deinit
-    pServer = nullptr;
-    pTxCharacteristic = nullptr;
-    pRxCharacteristic = nullptr;
+    // 2. Отключаем телефон, если он подключён
+    if (deviceConnected) pServer->disconnect(pServer->getConnId());
 
-    _isActive = false;
-    _receivedCommand = ""; // Чистим буфер на всякий случай
+    // 3. Снижаем мощность радио BLE до минимума — в ожидании эфир нам не нужен
+    BLEDevice::setPower(ESP_PWR_LVL_N12, ESP_BLE_PWR_TYPE_DEFAULT);
+
+    _receivedLength = 0; // Чистим буфер на всякий случай
+    _standbyTimeUs = micros() - t0;
+    _standbyHeapCost = (int32_t)(heapBefore - ESP.getFreeHeap());
 }
 
 
@@ -86,12 +122,16 @@ void BleManager::loop() {
 }
 
 bool BleManager::isActive() {
-    return _isActive;
+    return _state == BleState::ACTIVE;
 }
 
 void BleManager::send(String text) {
-    if (_isActive && pTxCharacteristic) {
-        pTxCharacteristic->setValue((uint8_t*)text.c_str(), text.length());
+    send(text.c_str());
+}
+
+void BleManager::send(const char* text) {
+    if (_state == BleState::ACTIVE && pTxCharacteristic) {
+        pTxCharacteristic->setValue((uint8_t*)text, strlen(text));
         pTxCharacteristic->notify();
     }
 }
@@ -100,12 +140,38 @@ void BleManager::send(String text) {
 
 // Есть ли команда в буфере?
 bool BleManager::hasCommand() {
-    return _receivedCommand.length() > 0;
+    return _receivedLength > 0;
 }
 
 // Отдать команду и очистить буфер
-String BleManager::getCommand() {
-    String temp = _receivedCommand;
-    _receivedCommand = ""; // Очищаем ящик
-    return temp;
-}
\ No newline at end of file
+bool BleManager::takeCommand(char* out, size_t size) {
+    uint8_t length = _receivedLength;
+    if (length == 0 || size == 0) return false;
+    if (length >= size) length = size - 1;
+
+    memcpy(out, _receivedCommand, length);
+    out[length] = '\0';
+    _receivedLength = 0; // Очищаем ящик — колбэк снова может писать
+    return true;
+}
+
+
+
+// Команда "ble": состояние и замеры переходов
+bool BleManager::handleCommand(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd != "ble") return false;
+
+    static const char* const STATE_NAMES[] = {"OFF", "ACTIVE", "STANDBY"};
+    reply("BLE " + String(STATE_NAMES[(uint8_t)_state]) + (deviceConnected ? ", connected" : "") +
+          ", heap free " + String(ESP.getFreeHeap()));
+    if (_initTimeUs == 0) return true;
+    reply("init: " + String(_initTimeUs / 1000) + " ms, heap " + String(_initHeapCost) + " B");
+    if (_standbyTimeUs > 0) {
+        reply("standby: " + String(_standbyTimeUs) + " us, heap " + String(_standbyHeapCost) + " B");
+    }
+    if (_resumeCount > 0) {
+        reply("resume x" + String(_resumeCount) + ": last " + String(_resumeTimeUs) + " us, heap " +
+              String(_resumeHeapCost) + " B");
+    }
+    return true;
+}
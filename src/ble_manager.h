@@ -7,17 +7,54 @@
 #include <BLEServer.h>
 #include <BLE2902.h> // Нужен для уведомлений (notify)
 
+#define BLE_COMMAND_MAX_LEN 64 // Длина команды с телефона вместе с '\0'; длиннее — отбрасываются
+
+/**
+ * Жизненный цикл BLE:
+ *  OFF     — стек ни разу не запускался, память контроллера свободна;
+ *  ACTIVE  — идёт реклама (advertising) или телефон подключён;
+ *  STANDBY — GATT-база (сервер, сервис, характеристики, колбэки) остаётся в памяти, реклама остановлена,
+ *            клиенты отключены, мощность передатчика снижена до минимума.
+ * Первый begin() создаёт всё с нуля (долго и с выделением памяти), последующие begin() из STANDBY
+ * просто снова запускают рекламу — быстро и без выделений. Полностью выгрузить стек нельзя:
+ * BLEDevice::deinit(true) освобождает память контроллера навсегда, и повторный init после этого ненадёжен.
+ */
+enum class BleState : uint8_t {
+    OFF,
+    ACTIVE,
+    STANDBY,
+};
+
 class BleManager {
 public:
-    void begin(String deviceName);
-    void stop();      // <--- ДОБАВЛЕНО: Правильное выключение BLE
+    void begin(String deviceName); // OFF -> ACTIVE (полная инициализация) или STANDBY -> ACTIVE (быстро)
+    void stop();      // ACTIVE -> STANDBY: без выгрузки стека, чтобы повторное включение было быстрым
     void loop(); // Обработчик в главном цикле
     bool isActive(); // Включен ли блютуз вообще
+    BleState state() { return _state; }
     void send(String text); // Отправка ответа на телефон
+    void send(const char* text); // То же без String — для постоянных ответов
 
     // НОВЫЕ ФУНКЦИИ ДЛЯ "ПОЧТОВОГО ЯЩИКА"
     bool hasCommand();        // Проверка: пришла ли новая команда?
-    String getCommand();      // Забрать команду и очистить ящик
+
+    /**
+     * @brief Забрать команду и очистить ящик
+     *
+     * @param out - буфер не меньше BLE_COMMAND_MAX_LEN
+     * @param size - размер буфера
+     * @return true - команда была и скопирована (с завершающим '\0')
+     */
+    bool takeCommand(char* out, size_t size);
+
+    /**
+     * @brief Команда "ble": состояние, цена по памяти и времени каждого перехода
+     *
+     * @param cmd - команда
+     * @param reply - куда писать ответ
+     * @return true - команда обработана
+     */
+    bool handleCommand(const String& cmd, void (*reply)(const String& line));
 
 private:
     BLEServer* pServer = nullptr;
@@ -25,19 +62,27 @@ private:
     BLECharacteristic* pRxCharacteristic = nullptr;
     bool deviceConnected = false;
     bool oldDeviceConnected = false;
-    bool _isActive = false;
+    BleState _state = BleState::OFF;
 
-    // Переменная для хранения команды, пока main её не заберет
-    String _receivedCommand = ""; 
+    // Ящик для команды, пока main её не заберет. Колбэк BLE пишет только в пустой ящик,
+    // main освобождает его, обнулив длину, — одна запись и одно чтение, без блокировок и String
+    char _receivedCommand[BLE_COMMAND_MAX_LEN];
+    volatile uint8_t _receivedLength = 0;
 
-    // Дружим с классом-колбэком, чтобы он мог писать в _receivedCommand
+    // Дружим с классами-колбэками, чтобы они могли писать в _receivedCommand и знать состояние
     friend class MyCallbacks; 
+    friend class MyServerCallbacks;
 
     unsigned long _startTime = 0;
     bool _isAuthorized = false;
     String _currentPassword = "";
+
+    // Замеры переходов: время (мкс) и изменение свободной кучи (байт, + = съели память)
+    uint32_t _initTimeUs = 0, _resumeTimeUs = 0, _standbyTimeUs = 0;
+    int32_t _initHeapCost = 0, _resumeHeapCost = 0, _standbyHeapCost = 0;
+    uint32_t _resumeCount = 0;
 };
 
 extern BleManager MyBLE;
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,280 @@
+#include "channel_plan.h"
+
+#ifdef CHANNEL_PLAN_USED
+
+#include "radiomodem.h"
+#include "protocol.h"
+#include "logger.h"
+#ifdef TRANSMITTER
+  #include "command_engine.h"
+#endif
+
+#define CHANNEL_EWMA 0.2f        // Вес нового отсчёта в доле подтверждённых обменов
+#define CHANNEL_RX_SAMPLES 4     // Замеров RSSI на одну проверку своего канала приёмником
+
+ChannelPlan MyChannels;
+
+static constexpr float PLAN[] = CHANNEL_PLAN;
+#define CHANNEL_COUNT (sizeof(PLAN) / sizeof(PLAN[0]))
+static_assert(CHANNEL_COUNT >= 2 && CHANNEL_COUNT <= 16, "CHANNEL_PLAN must have 2..16 channels");
+static_assert(CHANNEL_HOME < CHANNEL_COUNT, "CHANNEL_HOME is outside CHANNEL_PLAN");
+
+static ChannelScore board[CHANNEL_COUNT];
+static uint32_t lastScanUs = 0; // Сколько длился последний скан
+
+
+
+uint8_t ChannelPlan::count() {
+    return CHANNEL_COUNT;
+}
+
+
+
+float ChannelPlan::frequency(uint8_t channel) {
+    return PLAN[channel < CHANNEL_COUNT ? channel : CHANNEL_HOME];
+}
+
+
+
+/**
+ * @brief Первый скан: табло шума заполнено до первого обмена, приёмнику есть с чем сравнивать свой канал
+ */
+void ChannelPlan::begin() {
+    _current = CHANNEL_HOME;
+    scan();
+    _lastHeard = millis();
+    print_log("[CHANNEL]", "Plan of " + String(CHANNEL_COUNT) + " channels scanned in " + String(lastScanUs / 1000) +
+                           " ms, home " + String(PLAN[CHANNEL_HOME], 3) + " MHz, quietest " + String(quietest(), 1) + " dBm");
+}
+
+
+
+/**
+ * @brief Скан всех каналов плана. Пакет, пришедший в эти десятки миллисекунд, будет потерян
+ */
+void ChannelPlan::scan() {
+    uint32_t t0 = micros();
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+        MyRadio.tune(PLAN[i]);
+        MyRadio.startListening(); // RSSI эфира чип меряет только в режиме приёма
+        delayMicroseconds(CHANNEL_SAMPLE_SPACING_US);
+
+        float peak;
+        float noise = MyRadio.sampleNoise(CHANNEL_SCAN_SAMPLES, CHANNEL_SAMPLE_SPACING_US, &peak);
+        ChannelScore& s = board[i];
+        s.noise = s.scans == 0 ? noise : (s.noise + noise) / 2;
+        s.peak = peak;
+        s.scans++;
+    }
+    MyRadio.tune(PLAN[_current]);
+    MyRadio.startListening();
+    lastScanUs = micros() - t0;
+    _lastScan = millis();
+}
+
+
+
+float ChannelPlan::score(uint8_t channel) {
+    const ChannelScore& s = board[channel];
+    return s.noise + CHANNEL_LOSS_PENALTY * (1.0f - s.delivery);
+}
+
+
+
+uint8_t ChannelPlan::best() {
+    uint8_t result = _current;
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+        if (score(i) < score(result)) result = i;
+    }
+    return result;
+}
+
+
+
+float ChannelPlan::quietest() {
+    float result = board[0].noise;
+    for (uint8_t i = 1; i < CHANNEL_COUNT; i++) {
+        if (board[i].noise < result) result = board[i].noise;
+    }
+    return result;
+}
+
+
+
+/**
+ * @brief Переход на канал. Обе стороны вызывают его уже после обмена командой перехода
+ */
+void ChannelPlan::switchTo(uint8_t channel) {
+    if (channel >= CHANNEL_COUNT) return;
+    _current = channel;
+    _fails = 0;
+    _jamSamples = 0;
+    _lastHeard = millis();
+    MyRadio.tune(PLAN[channel]);
+    MyRadio.startListening();
+    print_log("[CHANNEL]", "Channel " + String(channel) + " (" + String(PLAN[channel], 3) + " MHz)");
+}
+
+
+
+void ChannelPlan::follow(const uint8_t* frame, size_t length) {
+    size_t payload = length > protocol_trailer() ? length - protocol_trailer() : 0;
+    char token[8];
+    size_t n = 0;
+    while (n < payload && n < sizeof(token) - 1 && frame[n] != LINK_METRICS_SEPARATOR) {
+        token[n] = (char)frame[n];
+        n++;
+    }
+    token[n] = '\0';
+
+    uint8_t channel;
+    if (_followPending >= 0 && strcmp(token, ACK_CHANNEL) == 0) {
+        switchTo((uint8_t)_followPending);
+        _followPending = -1;
+    } else if (parseSwitch(String(token), channel)) {
+        _followPending = channel;
+        _followDeadline = millis() + MyRadio.ackTimeout();
+    }
+}
+
+
+
+void ChannelPlan::followTimeout() {
+    if (_followPending < 0 || (long)(millis() - _followDeadline) < 0) return;
+    switchTo((uint8_t)_followPending);
+    _followPending = -1;
+}
+
+
+
+/**
+ * @brief Аварийный переход на следующий канал плана. Пульт сначала объявляет его на текущем канале:
+ * если помеха глушит только ответы, приёмник всё равно услышит и перейдёт вместе с нами
+ */
+void ChannelPlan::escape(const char* reason) {
+    uint8_t next = (_current + 1) % CHANNEL_COUNT;
+    print_log("[CHANNEL]", String("Leaving channel ") + String(_current) + ": " + reason);
+    #ifdef TRANSMITTER
+        _switching = true;
+        MyRadio.sendCommandAndWaitAck(CMD_CHANNEL + String(next), _onTick);
+        _switching = false;
+    #endif
+    escapes++;
+    switchTo(next);
+}
+
+
+
+void ChannelPlan::service(void (*onTick)()) {
+    unsigned long now = millis();
+
+    #ifdef TRANSMITTER
+        // Эфир занят или вот-вот уйдёт команда пользователя — переходы подождут
+        if (MyRadio.isProcessing || MyCommands.hasPending()) return;
+        _onTick = onTick;
+
+        if (_escapePending) {
+            _escapePending = false;
+            escape("no answer");
+            return;
+        }
+
+        if (now - _lastScan < CHANNEL_SCAN_INTERVAL) return;
+        scan();
+        uint8_t target = best();
+        if (target == _current || score(_current) - score(target) < CHANNEL_SWITCH_MARGIN) return;
+
+        // Согласованный переход: только если приёмник подтвердил, иначе оба остаются на месте
+        _switching = true;
+        bool ok = MyRadio.sendCommandAndWaitAck(CMD_CHANNEL + String(target), onTick);
+        _switching = false;
+        if (ok) {
+            switches++;
+            switchTo(target);
+        }
+    #else
+        (void)onTick;
+        // Свой канал меряем не выходя из приёма; идущий пакет — не помеха, поэтому нужны несколько замеров подряд
+        if (now - _lastSample >= CHANNEL_RX_SAMPLE_INTERVAL && !MyRadio.isDataReady()) {
+            _lastSample = now;
+            float noise = MyRadio.sampleNoise(CHANNEL_RX_SAMPLES, CHANNEL_SAMPLE_SPACING_US);
+            board[_current].peak = noise;
+            if (noise > quietest() + CHANNEL_JAM_MARGIN) {
+                if (++_jamSamples >= CHANNEL_RX_JAM_SAMPLES) {
+                    escape("jammed");
+                    return;
+                }
+            } else {
+                _jamSamples = 0;
+            }
+        }
+
+        if (now - _lastHeard >= CHANNEL_RX_LOST) {
+            escape("no frames from remote");
+            _lastHeard = now - (CHANNEL_RX_LOST - CHANNEL_RX_DWELL); // Следующий канал обхода — через CHANNEL_RX_DWELL
+        }
+    #endif
+}
+
+
+
+void ChannelPlan::recordExchange(bool acked) {
+    if (_switching) return; // Обмен командой перехода — не показатель канала
+
+    ChannelScore& s = board[_current];
+    s.exchanges++;
+    s.delivery += CHANNEL_EWMA * ((acked ? 1.0f : 0.0f) - s.delivery);
+
+    if (acked) {
+        _fails = 0;
+    } else if (++_fails >= CHANNEL_TX_FAILS) {
+        _fails = 0;
+        _escapePending = true; // Переход — из service(): мы сейчас внутри sendCommandAndWaitAck
+    }
+}
+
+
+
+void ChannelPlan::recordRx() {
+    _lastHeard = millis();
+    _jamSamples = 0; // Правильные кадры проходят — канал рабочий
+}
+
+
+
+bool ChannelPlan::parseSwitch(const String& token, uint8_t& channel) {
+    size_t prefix = strlen(CMD_CHANNEL);
+    if (token.length() <= prefix || token.length() > prefix + 2 || !token.startsWith(CMD_CHANNEL)) return false;
+    for (size_t i = prefix; i < token.length(); i++) {
+        if (!isDigit(token[i])) return false;
+    }
+    long value = token.substring(prefix).toInt();
+    if (value >= (long)CHANNEL_COUNT) return false;
+    channel = (uint8_t)value;
+    return true;
+}
+
+
+
+// Команды "channels" и "channels scan"
+bool ChannelPlan::handleCommand(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd == "channels scan") {
+        scan();
+        reply("CHANNELS scanned in " + String(lastScanUs / 1000.0f, 1) + " ms");
+    } else if (cmd != "channels") {
+        return false;
+    }
+
+    reply("CHANNELS current " + String(_current) + " (" + String(PLAN[_current], 3) + " MHz), switches " +
+          String(switches) + ", escapes " + String(escapes) + ", last scan " + String((millis() - _lastScan) / 1000) +
+          " s ago (" + String(lastScanUs / 1000.0f, 1) + " ms)");
+    for (uint8_t i = 0; i < CHANNEL_COUNT; i++) {
+        const ChannelScore& s = board[i];
+        reply(String(i == _current ? "*" : " ") + String(i) + " " + String(PLAN[i], 3) + " MHz  noise " +
+              String(s.noise, 1) + " peak " + String(s.peak, 1) + " dBm  delivery " + String(100.0f * s.delivery, 0) +
+              "% of " + String(s.exchanges) + "  score " + String(score(i), 1));
+    }
+    return true;
+}
+
+#endif
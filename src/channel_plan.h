@@ -0,0 +1,129 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * ЧАСТОТНАЯ АГИЛЬНОСТЬ: ПЛАН КАНАЛОВ, ТАБЛО КАЧЕСТВА И СОГЛАСОВАННЫЙ ПЕРЕХОД
+ *
+ * Вместо одной FREQUENCY_RADIO узлы работают на одном из каналов CHANNEL_PLAN. После включения оба
+ * на канале CHANNEL_HOME. Для каждого канала ведётся табло: шум эфира (средний RSSI без пакета),
+ * пиковый шум и доля подтверждённых обменов на нём (только пульт).
+ *
+ * Оценка канала = шум + CHANNEL_LOSS_PENALTY * доля потерь (дБ, меньше — лучше).
+ *
+ * Пульт ведёт, приёмник следует:
+ *  - при включении и раз в CHANNEL_SCAN_INTERVAL пульт сканирует план (десятки мс, пульт в это время
+ *    всё равно не слушает). Если лучший канал лучше текущего на CHANNEL_SWITCH_MARGIN — шлёт на текущем
+ *    "CH_<n>"; приёмник отвечает ACK_CHANNEL и переходит, пульт переходит, получив ответ. Нет ответа —
+ *    оба остаются на месте;
+ *  - CHANNEL_TX_FAILS неудачных обменов подряд — пульт объявляет переход на следующий канал плана
+ *    и переходит в любом случае (помеха может глушить только ответы);
+ *  - приёмник сканирует план только при включении (во время сканирования он глух), дальше раз в
+ *    CHANNEL_RX_SAMPLE_INTERVAL меряет шум своего канала не выходя из приёма. Шум выше самого тихого
+ *    канала на CHANNEL_JAM_MARGIN CHANNEL_RX_JAM_SAMPLES раз подряд — уходит на следующий канал.
+ *    Пульт, потеряв ответы, придёт туда же;
+ *  - последняя страховка: CHANNEL_RX_LOST без единого правильного кадра — приёмник обходит каналы,
+ *    стоя на каждом CHANNEL_RX_DWELL. Это дольше полного круга пульта, так что встреча гарантирована.
+ *
+ * Команда "channels" показывает табло, "channels scan" — пересканировать (на приёмнике — глух на время скана).
+ */
+
+#ifdef CHANNEL_PLAN_USED
+
+struct ChannelScore {
+    float noise = 0;         // Средний шум по сканам (EWMA), дБм
+    float peak = 0;          // Максимальный замер последнего скана (приёмник: последний замер своего канала), дБм
+    float delivery = 1;      // Доля подтверждённых обменов на канале (EWMA), пока не пробовали — 1
+    uint32_t exchanges = 0;  // Обменов на канале
+    uint32_t scans = 0;      // Сколько раз канал сканировали
+};
+
+class ChannelPlan {
+public:
+    /**
+     * @brief Первое сканирование плана и настройка на CHANNEL_HOME. Вызывать после beginRadio()
+     */
+    void begin();
+
+    /**
+     * @brief Вызывать из loop(). Пульт: периодический скан, согласованный и аварийный переходы
+     * (блокирует на время обмена). Приёмник: замер шума своего канала и обход при потере связи
+     *
+     * @param onTick - фоновая задача на время ожидания ответа
+     */
+    void service(void (*onTick)() = nullptr);
+
+    /**
+     * @brief Пульт: учёт завершённого обмена на текущем канале (вызывает RadioManager)
+     */
+    void recordExchange(bool acked);
+
+    /**
+     * @brief Приёмник: принят правильный кадр (связь с пультом есть)
+     */
+    void recordRx();
+
+    /**
+     * @brief Приёмник: разбор команды "CH_<n>"
+     *
+     * @param token - принятый токен
+     * @param channel - номер канала из команды
+     * @return true - это команда перехода на существующий канал
+     */
+    bool parseSwitch(const String& token, uint8_t& channel);
+
+    /**
+     * @brief Перейти на канал плана: перестроить частоту и снова слушать эфир
+     */
+    void switchTo(uint8_t channel);
+
+    /**
+     * @brief Ретранслятор и сниффер: кадр пары (услышанный или пересланный). "CH_<n>" запоминаем,
+     * ответ ACK_CHANNEL на него — переходим вместе с парой
+     *
+     * @param frame - кадр целиком, с подписью и TTL
+     * @param length - длина кадра
+     */
+    void follow(const uint8_t* frame, size_t length);
+
+    /**
+     * @brief Ответа на "CH_<n>" не услышали — переходим по истечении времени ожидания ответа:
+     * приёмник, получивший команду, уже там. Вызывать из loop()
+     */
+    void followTimeout();
+
+    uint8_t current() { return _current; }
+    uint8_t count();
+    float frequency(uint8_t channel);
+
+    /**
+     * @brief Команды "channels" (табло) и "channels scan"
+     */
+    bool handleCommand(const String& cmd, void (*reply)(const String& line));
+
+    uint32_t switches = 0; // Согласованных переходов
+    uint32_t escapes = 0;  // Аварийных переходов (помеха или потеря связи)
+
+private:
+    void scan();                   // Скан всех каналов плана; после него радио снова слушает текущий канал
+    uint8_t best();                // Канал с лучшей оценкой
+    float score(uint8_t channel);  // Оценка канала (дБ, меньше — лучше)
+    float quietest();              // Шум самого тихого канала — опорный уровень для обнаружения помехи
+    void escape(const char* reason);
+
+    uint8_t _current = CHANNEL_HOME;
+    uint8_t _fails = 0;              // Неудачных обменов подряд на текущем канале
+    uint8_t _jamSamples = 0;         // Замеров подряд над порогом помехи
+    bool _escapePending = false;     // Пульт: пора объявить переход на следующий канал
+    bool _switching = false;         // Идёт обмен командой перехода — в табло его не считаем
+    unsigned long _lastScan = 0;
+    unsigned long _lastSample = 0;
+    unsigned long _lastHeard = 0;    // Приёмник: последний правильный кадр или переход
+    int16_t _followPending = -1;     // Ретранслятор и сниффер: услышали "CH_<n>" — ждём ответ
+    unsigned long _followDeadline = 0;
+    void (*_onTick)() = nullptr;     // Фоновая задача для обмена командой аварийного перехода
+};
+
+extern ChannelPlan MyChannels;
+
+#endif
@@ -0,0 +1,66 @@
+#include "command_engine.h"
+#include "radiomodem.h"
+#include "logger.h"
+
+CommandEngine MyCommands;
+
+
+
+/**
+ * @brief Запрос желаемого состояния реле
+ *
+ * @param on - желаемое состояние
+ * @param src - источник запроса
+ */
+void CommandEngine::requestRelay(bool on, CommandSource src) {
+    // Предыдущая цель ещё не ушла в эфир и отличается от новой — она больше никому не нужна
+    if (_pending && _targetOn != on) supersededCount++;
+
+    _targetOn = on;
+    desiredOn = on;
+    hasDesired = true;
+    _sources |= (uint8_t)(1 << (uint8_t)src); // Все, кто ждал старую цель, получат ответ по новой
+    _pending = true;
+}
+
+
+
+/**
+ * @brief Отработка цели: одна команда в эфир (или ни одной), затем вызов обработчика результата
+ *
+ * @param onTick - фоновая задача на время ожидания ACK
+ */
+void CommandEngine::service(void (*onTick)()) {
+    if (!_pending || MyRadio.isProcessing) return; // Нечего делать, либо уже идёт обмен
+
+    // Забираем цель целиком. Всё, что придёт через onTick во время обмена, станет новой целью
+    CommandResult result;
+    result.targetOn = _targetOn;
+    result.sources = _sources;
+    _pending = false;
+    _sources = 0;
+
+    if (MyRadio.rxOnline && MyRadio.relayIsOn == result.targetOn) {
+        // Реле уже в нужном состоянии и связь подтверждена — эфир не тратим
+        result.alreadyInState = true;
+        result.delivered = true;
+    } else {
+        print_log("[ACTION]", result.targetOn ? "Sending ON command..." : "Sending OFF command...");
+        sentCount++;
+        result.delivered = MyRadio.sendCommandAndWaitAck(result.targetOn ? CMD_RELAY_ON : CMD_RELAY_OFF, onTick);
+    }
+
+    if (_onResult != nullptr) _onResult(result);
+}
+
+
+
+bool CommandEngine::hasPending() {
+    return _pending;
+}
+
+
+
+void CommandEngine::setResultHandler(void (*handler)(const CommandResult&)) {
+    _onResult = handler;
+}
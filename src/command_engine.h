@@ -0,0 +1,73 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * КОАЛЕСЦЕР КОМАНД (желаемое состояние вместо очереди команд)
+ *
+ * Кнопка и BLE больше не шлют команды в эфир сами. Они только сообщают, в каком состоянии
+ * должно оказаться реле ("цель"). Движок в loop() отправляет в эфир только последнюю цель,
+ * и только когда текущий обмен с приёмником завершён. Если пока шёл обмен пользователь успел
+ * нажать ВКЛ-ВЫКЛ-ВКЛ, то промежуточные команды в эфир не уйдут никогда — уйдёт одна последняя
+ * (или вообще ничего, если реле уже в нужном состоянии).
+ */
+
+// Кто запросил изменение состояния — нужно, чтобы знать, кому отвечать по завершении обмена
+enum class CommandSource : uint8_t {
+    BUTTON = 0,
+    BLE    = 1,
+    SYSTEM = 2,
+    HOST   = 3, // Стенд по USB (host_link.h)
+};
+
+// Итог обработки цели: передаётся в обработчик результата (см. setResultHandler)
+struct CommandResult {
+    bool targetOn = false;       // какое состояние реле мы хотели получить
+    bool delivered = false;      // приёмник подтвердил команду (ACK получен)
+    bool alreadyInState = false; // в эфир ничего не уходило: реле уже в нужном состоянии
+    uint8_t sources = 0;         // битовая маска источников (1 << CommandSource), ожидающих ответа
+};
+
+class CommandEngine {
+public:
+    /**
+     * @brief Запрос желаемого состояния реле. Ничего не передаёт в эфир и не блокирует.
+     * Можно вызывать откуда угодно, в том числе из onTick во время ожидания ACK.
+     *
+     * @param on - true: реле должно быть включено, false: выключено
+     * @param src - источник запроса
+     */
+    void requestRelay(bool on, CommandSource src);
+
+    /**
+     * @brief Обработка цели. Вызывать из loop(). Если цель есть и обмен не идёт —
+     * отправляет одну команду и ждёт ACK через MyRadio.sendCommandAndWaitAck().
+     *
+     * @param onTick - фоновая задача на время ожидания ACK (опрос кнопки, BLE)
+     */
+    void service(void (*onTick)() = nullptr);
+
+    bool hasPending();        // Есть ли цель, ещё не отправленная в эфир
+
+    /**
+     * @brief Установка обработчика результата (экран, светодиод, NVS, ответ в BLE)
+     */
+    void setResultHandler(void (*handler)(const CommandResult&));
+
+    // Последняя цель пользователя в этой сессии — с ней фоновая сверка сравнивает фактическое состояние.
+    // После перезагрузки пульта цели нет: сами по себе мы реле не переключаем.
+    bool hasDesired = false;
+    bool desiredOn = false;
+
+    uint32_t supersededCount = 0; // Сколько команд было заменено более новыми и не ушло в эфир
+    uint32_t sentCount = 0;       // Сколько команд реально ушло в эфир
+
+private:
+    bool _pending = false;  // Есть цель, которую ещё не отрабатывали
+    bool _targetOn = false; // Последняя запрошенная цель
+    uint8_t _sources = 0;   // Кто ждёт ответа по этой цели
+
+    void (*_onResult)(const CommandResult&) = nullptr;
+};
+
+extern CommandEngine MyCommands;
@@ -0,0 +1,66 @@
+#include "command_table.h"
+
+static bool isSeparator(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
+
+/**
+ * @brief Разбиение строки на слова на месте
+ *
+ * @param line - строка команды
+ * @param args - результат разбора
+ * @return общее число слов
+ */
+uint8_t cmd_tokenize(char* line, CommandArgs& args) {
+    uint8_t total = 0;
+    args.count = 0;
+
+    char* p = line;
+    while (*p != '\0') {
+        while (isSeparator(*p)) *p++ = '\0'; // Разделители сразу становятся концами слов
+        if (*p == '\0') break;
+
+        if (args.count < CMD_MAX_TOKENS) args.argv[args.count++] = p;
+        if (total < 255) total++;
+        while (*p != '\0' && !isSeparator(*p)) p++;
+    }
+    return total;
+}
+
+
+
+/**
+ * @brief Поиск команды в отсортированной таблице (двоичный поиск) и вызов обработчика
+ */
+DispatchResult cmd_dispatch(char* line, const CommandSpec* table, size_t count, bool authorized,
+                            const CommandSpec** matched) {
+    if (matched != nullptr) *matched = nullptr;
+
+    CommandArgs args;
+    uint8_t total = cmd_tokenize(line, args);
+    if (total == 0) return DispatchResult::EMPTY;
+
+    size_t lo = 0, hi = count;
+    const CommandSpec* spec = nullptr;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int cmp = cmd_name_compare(args.argv[0], table[mid].name);
+        if (cmp == 0) { spec = &table[mid]; break; }
+        if (cmp < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    if (spec == nullptr) return DispatchResult::UNKNOWN;
+    if (matched != nullptr) *matched = spec;
+
+    // Имя — к написанию таблицы: обработчики, которым строка пересылается целиком, сравнивают с учётом регистра
+    for (char* p = line + (args.argv[0] - line); *p != '\0'; p++) *p = cmd_lower(*p);
+
+    if (spec->needsAuth && !authorized) return DispatchResult::NOT_AUTHORIZED;
+    uint8_t argCount = total - 1;
+    if (argCount < spec->minArgs || argCount > spec->maxArgs || total > CMD_MAX_TOKENS) return DispatchResult::BAD_ARGS;
+
+    spec->handler(args);
+    return DispatchResult::OK;
+}
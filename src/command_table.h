@@ -0,0 +1,82 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * ТАБЛИЧНЫЙ РАЗБОР ТЕКСТОВЫХ КОМАНД (BLE, в будущем — и другие текстовые каналы)
+ *
+ * Строка команды разбирается прямо в своём буфере: разделители заменяются на '\0',
+ * в argv сохраняются указатели на слова. Никаких String, substring и выделений памяти.
+ * Команды описываются таблицей CommandSpec: имя, сколько аргументов допустимо,
+ * нужна ли авторизация и обработчик. Таблица должна быть отсортирована по имени
+ * (без учёта регистра) — поиск идёт двоичный, а порядок проверяется static_assert
+ * через cmd_table_sorted(). Имя найденной команды приводится к нижнему регистру на месте
+ * ("SOAK" -> "soak"), аргументы не трогаются.
+ *
+ * Не зависит от Arduino: собирается и на хосте (tools/cmd_bench).
+ */
+
+#define CMD_MAX_TOKENS 6 // Имя команды + до пяти аргументов
+
+// Разобранная команда: argv[0] — имя, argv[1..count-1] — аргументы
+struct CommandArgs {
+    uint8_t count = 0;
+    const char* argv[CMD_MAX_TOKENS] = {};
+};
+
+typedef void (*CommandHandler)(const CommandArgs& args);
+
+struct CommandSpec {
+    const char* name;     // имя команды (сравнивается без учёта регистра)
+    const char* usage;    // подсказка при неверном числе аргументов (nullptr — молча игнорировать)
+    uint8_t minArgs;      // аргументов, не считая имени
+    uint8_t maxArgs;
+    bool needsAuth;       // только после успешного входа
+    CommandHandler handler;
+};
+
+enum class DispatchResult : uint8_t {
+    OK,             // обработчик вызван
+    EMPTY,          // пустая строка
+    UNKNOWN,        // такой команды нет в таблице
+    BAD_ARGS,       // число аргументов вне [minArgs, maxArgs] (см. matched->usage)
+    NOT_AUTHORIZED, // команда требует входа
+};
+
+// Сравнение ASCII-строк без учёта регистра (как strcasecmp), пригодное для constexpr
+constexpr char cmd_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+constexpr int cmd_name_compare(const char* a, const char* b) {
+    return (cmd_lower(*a) != cmd_lower(*b) || *a == '\0')
+               ? (int)(unsigned char)cmd_lower(*a) - (int)(unsigned char)cmd_lower(*b)
+               : cmd_name_compare(a + 1, b + 1);
+}
+
+// Проверка порядка таблицы на этапе компиляции: static_assert(cmd_table_sorted(TABLE, N), "...")
+constexpr bool cmd_table_sorted(const CommandSpec* table, size_t count) {
+    return count < 2 || (cmd_name_compare(table[0].name, table[1].name) < 0 && cmd_table_sorted(table + 1, count - 1));
+}
+
+/**
+ * @brief Разбиение строки на слова на месте (пробелы, табуляция, \r, \n)
+ *
+ * @param line - строка с завершающим '\0'; разделители будут заменены на '\0'
+ * @param args - куда сложить указатели на слова (не больше CMD_MAX_TOKENS)
+ * @return сколько слов в строке всего (может быть больше CMD_MAX_TOKENS — лишние не сохраняются)
+ */
+uint8_t cmd_tokenize(char* line, CommandArgs& args);
+
+/**
+ * @brief Разбор строки и вызов обработчика из таблицы
+ *
+ * @param line - строка команды (будет изменена разбором)
+ * @param table - отсортированная таблица команд
+ * @param count - размер таблицы
+ * @param authorized - выполнен ли вход
+ * @param matched - (необязательно) найденная запись таблицы, в том числе при BAD_ARGS / NOT_AUTHORIZED
+ * @return результат разбора
+ */
+DispatchResult cmd_dispatch(char* line, const CommandSpec* table, size_t count, bool authorized,
+                            const CommandSpec** matched = nullptr);
@@ -0,0 +1,133 @@
+#include "fast_boot.h"
+
+#ifdef RECEIVER
+
+#include "radiomodem.h"
+#include "protocol.h"
+#include "logger.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include <Preferences.h>
+  #include <esp_system.h>
+  static Preferences relayStore; // Отдельное пространство NVS "relay"
+  // Не обнуляется при сбросе (кроме включения питания): метка + бит реле. Мусор после включения отсеет метка
+  static RTC_NOINIT_ATTR uint32_t rtcRelay;
+#elif defined(ARDUINO_ARCH_ESP8266)
+  #include <EEPROM.h>
+#endif
+
+#define FAST_BOOT_RTC_MAGIC 0x52454C00UL // "REL" + 0, младший бит — реле
+
+FastBoot MyFastBoot;
+
+
+
+void FastBoot::restoreRelay() {
+    bool on = false;
+    #if defined(ARDUINO_ARCH_ESP32)
+        if (esp_reset_reason() != ESP_RST_POWERON && (rtcRelay & ~1UL) == FAST_BOOT_RTC_MAGIC) {
+            on = rtcRelay & 1;
+            source = RelaySource::RTC;
+        } else {
+            _storeOpen = relayStore.begin("relay", false);
+            if (relayStore.isKey("on")) {
+                on = relayStore.getUChar("on", 0) == 1;
+                source = RelaySource::FLASH;
+            }
+        }
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        EEPROM.begin(EEPROM_SIZE); // Готовим память (разметка — в settings.h)
+        uint8_t stored = EEPROM.read(EEPROM_ADDR_RELAY);
+        if (stored <= 1) { // Чистая flash — 0xFF
+            on = stored == 1;
+            source = RelaySource::FLASH;
+        }
+    #endif
+
+    // Сначала уровень, потом выход: пин сразу становится выходом с нужным уровнем (на ядре, где запись
+    // до pinMode не действует, — импульс в микросекунды до writeRelay(), реле на него не успевает)
+    digitalWrite(RELAY_PIN, on ? LOW : HIGH);
+    pinMode(RELAY_PIN, OUTPUT);
+    writeRelay(on);
+    MyRadio.relayIsOn = on;
+    restoredOn = on;
+    relayUs = micros();
+}
+
+
+
+void FastBoot::writeRelay(bool on) {
+    digitalWrite(RELAY_PIN, on ? LOW : HIGH);
+    #if defined(ARDUINO_ARCH_ESP32)
+        rtcRelay = FAST_BOOT_RTC_MAGIC | (on ? 1 : 0);
+    #endif
+}
+
+
+
+void FastBoot::saveRelay(bool on) {
+    writeRelay(on);
+    #if defined(ARDUINO_ARCH_ESP32)
+        if (!_storeOpen) _storeOpen = relayStore.begin("relay", false); // После старта по копии из RTC ещё не открыто
+        relayStore.putUChar("on", on ? 1 : 0);
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        EEPROM.write(EEPROM_ADDR_RELAY, on ? 1 : 0);
+        EEPROM.commit(); // Запомнили в память (и счётчик подписи — одной записью)
+    #endif
+}
+
+
+
+void FastBoot::announce() {
+    String frame = protocol_encode(MsgId::RX_BOOT, MyRadio.relayIsOn ? "1" : "0");
+    MyRadio.send(frame); // Пульт после включения или после неудачного обмена слушает явно
+    #ifdef FRAME_IMPLICIT_USED
+      MyRadio.sendInMode(frame, FrameMode::IMPLICIT); // Пульт в установившемся обмене ждёт неявный ответ; сами остаёмся в явном
+    #endif
+    MyRadio.startListening();
+    announceUs = micros();
+}
+
+
+
+void FastBoot::report() {
+    print_log("[BOOT]", resetReason() + ", relay " + (restoredOn ? "ON" : "OFF") + " from " +
+                        (source == RelaySource::RTC ? "RTC" : source == RelaySource::FLASH ? "flash" : "default") +
+                        " at " + String(relayUs) + " us, radio up and announced at " + String(announceUs / 1000) + " ms");
+}
+
+
+
+bool FastBoot::handleCommand(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd != "boot") return false;
+    reply("BOOT reset: " + resetReason() + ", relay restored " + (restoredOn ? "ON" : "OFF") + " from " +
+          (source == RelaySource::RTC ? "RTC" : source == RelaySource::FLASH ? "flash" : "default (no record)"));
+    reply("relay set at " + String(relayUs) + " us, announced to TX at " + String(announceUs / 1000.0f, 1) +
+          " ms after firmware start (bootloader time not included)");
+    return true;
+}
+
+
+
+String FastBoot::resetReason() {
+    #if defined(ARDUINO_ARCH_ESP32)
+        switch (esp_reset_reason()) {
+            case ESP_RST_POWERON: return "power on";
+            case ESP_RST_BROWNOUT: return "brownout";
+            case ESP_RST_SW: return "software";
+            case ESP_RST_PANIC: return "panic";
+            case ESP_RST_INT_WDT:
+            case ESP_RST_TASK_WDT:
+            case ESP_RST_WDT: return "watchdog";
+            case ESP_RST_EXT: return "reset pin";
+            case ESP_RST_DEEPSLEEP: return "deep sleep";
+            default: return "unknown";
+        }
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        return ESP.getResetReason();
+    #else
+        return "unknown";
+    #endif
+}
+
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * БЫСТРЫЙ СТАРТ ПРИЁМНИКА: РЕЛЕ — ПЕРВЫМ ДЕЛОМ
+ *
+ * После сбоя питания реле должно вернуться в прежнее состояние раньше всего остального, а не когда
+ * поднимутся экран, лог и радио и придёт команда. Поэтому restoreRelay() — первая строка setup() приёмника.
+ * Откуда берётся состояние:
+ *  1. ESP32: копия в RTC-памяти (RTC_NOINIT) — переживает программный сброс, сторожевой таймер и просадку
+ *     питания без полного отключения; читается за доли микросекунды, flash не трогаем.
+ *  2. Иначе — запись во flash: NVS "relay" на ESP32, EEPROM_ADDR_RELAY на ESP8266.
+ *  3. Записи нет — реле выключено.
+ * Уровень пишется на пин до того, как пин становится выходом, — без короткого "вкл" при старте.
+ *
+ * Дальше setup() приёмника читает настройки, продолжает расписание реле, поднимает радио и объявляет
+ * пульту о включении кадром ACK_RX_BOOT с состоянием реле (пульт сверяет его с целью сразу, не дожидаясь
+ * опроса). В каком профиле кадров слушает пульт, приёмник после сброса не знает, поэтому с FRAME_IMPLICIT_USED
+ * объявление уходит дважды: явным и неявным кадром. Serial, экран, АЦП батареи и светодиод запускаются только после этого.
+ *
+ * Время от старта прошивки до верного уровня на реле, до готовности радио и до объявления — команда "boot".
+ * Загрузчик и ПЗУ до старта прошивки сюда не входят: полное время от сброса — осциллографом по EN и RELAY_PIN.
+ */
+
+enum class RelaySource : uint8_t {
+    DEFAULT_OFF = 0, // Записи нет
+    RTC = 1,         // Копия в RTC-памяти с прошлого запуска
+    FLASH = 2,       // NVS / EEPROM
+};
+
+class FastBoot {
+public:
+    /**
+     * @brief Реле — как было до сброса. Первая строка setup()
+     */
+    void restoreRelay();
+
+    /**
+     * @brief Уровень на реле и копия в RTC. Можно вызывать из таймера (во flash не пишет)
+     */
+    void writeRelay(bool on);
+
+    /**
+     * @brief writeRelay() и запись во flash (на ESP8266 — одной записью со счётчиком подписи). Только из loop()
+     */
+    void saveRelay(bool on);
+
+    /**
+     * @brief Радио готово: кадр ACK_RX_BOOT пульту и отметка времени
+     */
+    void announce();
+
+    /**
+     * @brief Замеры старта в лог (когда Serial уже запущен)
+     */
+    void report();
+
+    /**
+     * @brief Команда "boot": причина сброса, источник состояния реле и замеры старта
+     */
+    bool handleCommand(const String& cmd, void (*reply)(const String& line));
+
+    RelaySource source = RelaySource::DEFAULT_OFF;
+    bool restoredOn = false;
+    uint32_t relayUs = 0;    // От старта прошивки до верного уровня на реле (мкс)
+    uint32_t announceUs = 0; // До объявления пульту (мкс): радио готово
+
+private:
+    String resetReason();
+
+    bool _storeOpen = false; // ESP32: пространство NVS открыто
+};
+
+extern FastBoot MyFastBoot;
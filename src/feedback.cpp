@@ -0,0 +1,195 @@
+#include "feedback.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include <esp_timer.h>
+  #include <freertos/FreeRTOS.h>
+  static esp_timer_handle_t timerHandle = nullptr;
+  // Выходы переключает задача esp_timer, узоры задаёт loop(): слои меняем под замком
+  static portMUX_TYPE feedbackMux = portMUX_INITIALIZER_UNLOCKED;
+  #define FEEDBACK_LOCK() portENTER_CRITICAL(&feedbackMux)
+  #define FEEDBACK_UNLOCK() portEXIT_CRITICAL(&feedbackMux)
+#elif defined(ARDUINO_ARCH_ESP8266)
+  extern "C" {
+    #include <osapi.h>
+  }
+  static os_timer_t timerHandle;
+  // os_timer вызывается между итерациями loop(), а не посреди них — замок не нужен
+  #define FEEDBACK_LOCK()
+  #define FEEDBACK_UNLOCK()
+#else
+  #define FEEDBACK_LOCK()
+  #define FEEDBACK_UNLOCK()
+#endif
+
+// На ESP8266 приёмника светодиод сидит на пине реле — мигать им нельзя
+#if defined(ARDUINO_ARCH_ESP32) || !defined(RECEIVER)
+  #define FEEDBACK_LED
+#endif
+
+#define FEEDBACK_IDLE UINT32_MAX // Уровень не изменится, пока не зададут новый
+
+Feedback MyFeedback;
+
+static const FeedbackStep BOOT_STEPS[] = {{255, 100, false}};
+static const FeedbackStep BLE_ON_STEPS[] = {{255, 200, false}};
+static const FeedbackStep BREATHE_STEPS[] = {{40, 800, true}, {255, 800, true}};
+static const FeedbackStep BLINK_STEPS[] = {{255, 500, false}, {0, 500, false}};
+
+const FeedbackPattern FEEDBACK_BOOT = {FeedbackOutput::VIBRO, COLORS_RGB_LED::black, false, BOOT_STEPS, 1, 1};
+const FeedbackPattern FEEDBACK_BLE_ON = {FeedbackOutput::VIBRO, COLORS_RGB_LED::black, false, BLE_ON_STEPS, 1, 1};
+const FeedbackPattern FEEDBACK_BLE_ACTIVE = {FeedbackOutput::LED, COLORS_RGB_LED::black, true, BREATHE_STEPS, 2, 0};
+const FeedbackPattern FEEDBACK_RADIO_FAIL = {FeedbackOutput::LED, COLORS_RGB_LED::red, false, BLINK_STEPS, 2, 0};
+
+
+
+static void onTimer(void* arg) {
+    (void)arg;
+    MyFeedback.update();
+}
+
+
+
+/**
+ * @brief Взвод таймера. Без replace уже взведённый не трогаем: это kick() из loop() успел раньше
+ * (на ESP32 update() идёт в задаче esp_timer параллельно с loop()), и его срок ближе
+ */
+static void arm(uint32_t ms, bool replace) {
+    if (ms == 0) ms = 1;
+    #if defined(ARDUINO_ARCH_ESP32)
+        if (replace) esp_timer_stop(timerHandle); // Не взведён — вернёт ошибку, это нормально
+        esp_timer_start_once(timerHandle, (uint64_t)ms * 1000); // Уже взведён — вернёт ошибку и останется как был
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        os_timer_disarm(&timerHandle);
+        os_timer_arm(&timerHandle, ms, false);
+        (void)replace;
+    #endif
+}
+
+
+
+void Feedback::begin() {
+    #if defined(VIBRO_USED)
+        pinMode(VIBRO_PIN, OUTPUT);
+        digitalWrite(VIBRO_PIN, LOW);
+    #endif
+    #if defined(ARDUINO_ARCH_ESP8266) && defined(FEEDBACK_LED)
+        pinMode(LED_PIN, OUTPUT);
+    #endif
+    #if defined(ARDUINO_ARCH_ESP32)
+        esp_timer_create_args_t args = {};
+        args.callback = onTimer;
+        args.name = "feedback";
+        esp_timer_create(&args, &timerHandle);
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        os_timer_setfn(&timerHandle, onTimer, nullptr);
+    #endif
+}
+
+
+
+void Feedback::kick() {
+    arm(0, true);
+}
+
+
+
+void Feedback::setColor(COLORS_RGB_LED color) {
+    FEEDBACK_LOCK();
+    bool changed = _baseColor != color;
+    _baseColor = color;
+    FEEDBACK_UNLOCK();
+    if (changed) kick();
+}
+
+
+
+void Feedback::play(const FeedbackPattern& pattern, FeedbackPriority priority) {
+    FEEDBACK_LOCK();
+    Layer& layer = _layers[(uint8_t)pattern.output][(uint8_t)priority];
+    layer.pattern = &pattern;
+    layer.startMs = millis();
+    FEEDBACK_UNLOCK();
+    kick();
+}
+
+
+
+void Feedback::stop(FeedbackOutput output, FeedbackPriority priority) {
+    FEEDBACK_LOCK();
+    _layers[(uint8_t)output][(uint8_t)priority].pattern = nullptr;
+    FEEDBACK_UNLOCK();
+    kick();
+}
+
+
+
+bool Feedback::levelAt(const Layer& layer, unsigned long now, uint8_t& level, uint32_t& untilMs) {
+    const FeedbackPattern& p = *layer.pattern;
+    uint32_t cycle = 0;
+    for (uint8_t i = 0; i < p.count; i++) cycle += p.steps[i].ms;
+    uint32_t elapsed = now - layer.startMs;
+    if (cycle == 0 || (p.repeats != 0 && elapsed >= cycle * p.repeats)) return false;
+
+    uint32_t offset = elapsed % cycle;
+    uint8_t i = 0;
+    while (offset >= p.steps[i].ms) offset -= p.steps[i++].ms;
+    const FeedbackStep& step = p.steps[i];
+    untilMs = step.ms - offset;
+    if (!step.fade) {
+        level = step.level;
+        return true;
+    }
+    // Первый шаг первого прохода плавно выходит из темноты, дальше — из уровня предыдущего шага
+    uint8_t from = i > 0 ? p.steps[i - 1].level : (elapsed >= cycle ? p.steps[p.count - 1].level : 0);
+    level = (uint8_t)(from + ((int32_t)step.level - from) * (int32_t)offset / (int32_t)step.ms);
+    if (untilMs > FEEDBACK_FADE_STEP_MS) untilMs = FEEDBACK_FADE_STEP_MS;
+    return true;
+}
+
+
+
+/**
+ * @brief Верхний живой слой каждого выхода -> уровень. Закончившиеся узоры снимаются
+ */
+void Feedback::update() {
+    unsigned long now = millis();
+    uint32_t next = FEEDBACK_IDLE;
+    uint8_t levels[2] = {255, 0};
+    COLORS_RGB_LED color;
+
+    FEEDBACK_LOCK();
+    color = _baseColor;
+    for (uint8_t output = 0; output < 2; output++) {
+        for (int8_t priority = 1; priority >= 0; priority--) {
+            Layer& layer = _layers[output][priority];
+            if (layer.pattern == nullptr) continue;
+            uint32_t untilMs;
+            if (!levelAt(layer, now, levels[output], untilMs)) {
+                layer.pattern = nullptr;
+                continue;
+            }
+            if (output == (uint8_t)FeedbackOutput::LED && !layer.pattern->baseColor) color = layer.pattern->color;
+            if (untilMs < next) next = untilMs;
+            break; // Нижние слои под этим не видны
+        }
+    }
+    FEEDBACK_UNLOCK();
+
+    #ifdef FEEDBACK_LED
+        uint8_t led = levels[(uint8_t)FeedbackOutput::LED];
+        if (color != _ledColor || led != _ledLevel) {
+            WriteColorPixel(color, led);
+            _ledColor = color;
+            _ledLevel = led;
+        }
+    #endif
+    #ifdef VIBRO_USED
+        uint8_t vibro = levels[(uint8_t)FeedbackOutput::VIBRO] > 0 ? 1 : 0;
+        if (vibro != _vibroLevel) {
+            digitalWrite(VIBRO_PIN, vibro ? HIGH : LOW);
+            _vibroLevel = vibro;
+        }
+    #endif
+
+    if (next != FEEDBACK_IDLE) arm(next, false);
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+#include "rgb_led.h"
+
+/**
+ * СВЕТОДИОД И ВИБРОМОТОР БЕЗ delay() (узоры по аппаратному таймеру)
+ *
+ * loop() только говорит, что показать: цвет состояния (setColor) или узор (play) — и сразу идёт дальше.
+ * Выходы переключает одноразовый таймер (esp_timer на ESP32, os_timer на ESP8266): он взводится ровно
+ * до следующего изменения, а на плавном шаге — каждые FEEDBACK_FADE_STEP_MS. Пока ничего не меняется,
+ * таймер не тикает. Кнопка, радио и BLE узоров не ждут: время отклика на команду с ними то же, что без них.
+ *
+ * Узор — таблица шагов {уровень, длительность, плавно} для одного выхода и число повторов (0 — пока не
+ * остановят). Уровень светодиода — яркость 0..255 (255 = RGB_BRIGHTNESS), вибромотора — вкл/выкл.
+ * "Плавно" — уровень идёт от предыдущего шага к этому за время шага. На каждом выходе по узору на
+ * приоритет: ALERT перекрывает EVENT, оба перекрывают цвет состояния; кончился узор — виден тот, что ниже.
+ * Узор светодиода может мигать цветом состояния (baseColor), а не своим: "BLE включён" не прячет связь и реле.
+ *
+ * На ESP8266 приёмника LED_PIN — это пин реле: там светодиодом модуль не управляет вовсе.
+ */
+
+enum class FeedbackOutput : uint8_t {
+    LED = 0,
+    VIBRO = 1,
+};
+
+enum class FeedbackPriority : uint8_t {
+    EVENT = 0, // Отклик на действие пользователя
+    ALERT = 1, // Неисправность: перекрывает всё
+};
+
+struct FeedbackStep {
+    uint8_t level;  // 0..255; у вибромотора > 0 — включён
+    uint16_t ms;
+    bool fade;      // Плавно от уровня предыдущего шага
+};
+
+struct FeedbackPattern {
+    FeedbackOutput output;
+    COLORS_RGB_LED color; // Светодиод: цвет узора
+    bool baseColor;       // Светодиод: вместо color — текущий цвет состояния
+    const FeedbackStep* steps;
+    uint8_t count;
+    uint8_t repeats;      // 0 — пока не остановят stop()
+};
+
+// Узоры прошивки
+extern const FeedbackPattern FEEDBACK_BOOT;       // Вибро 100 мс при включении
+extern const FeedbackPattern FEEDBACK_BLE_ON;     // Вибро 200 мс: BLE включён
+extern const FeedbackPattern FEEDBACK_BLE_ACTIVE; // Цвет состояния "дышит", пока BLE включён
+extern const FeedbackPattern FEEDBACK_RADIO_FAIL; // Красный мигает 500/500 мс: радиомодуль не отвечает
+
+class Feedback {
+public:
+    /**
+     * @brief Пины и таймер. Вызывать в setup() до первого setColor/play
+     */
+    void begin();
+
+    /**
+     * @brief Цвет состояния светодиода (виден, когда нет узоров)
+     */
+    void setColor(COLORS_RGB_LED color);
+
+    /**
+     * @brief Запуск узора с начала. Тот же приоритет на том же выходе заменяется
+     */
+    void play(const FeedbackPattern& pattern, FeedbackPriority priority = FeedbackPriority::EVENT);
+
+    /**
+     * @brief Остановка узора приоритета на выходе (если он ещё идёт)
+     */
+    void stop(FeedbackOutput output, FeedbackPriority priority = FeedbackPriority::EVENT);
+
+    /**
+     * @brief Вызывает таймер: вывести текущие уровни и взвести таймер до следующего изменения
+     */
+    void update();
+
+private:
+    struct Layer {
+        const FeedbackPattern* pattern = nullptr;
+        unsigned long startMs = 0;
+    };
+    // Уровень слоя на момент now; в untilMs — сколько он ещё не изменится. false — узор кончился
+    static bool levelAt(const Layer& layer, unsigned long now, uint8_t& level, uint32_t& untilMs);
+    void kick(); // Применить изменения сразу (из loop() — только взвод таймера)
+
+    Layer _layers[2][2]; // [выход][приоритет]
+    COLORS_RGB_LED _baseColor = COLORS_RGB_LED::black;
+    COLORS_RGB_LED _ledColor = COLORS_RGB_LED::black; // Что сейчас на светодиоде
+    int16_t _ledLevel = -1;                            // -1 — ещё ничего не выводили
+    int16_t _vibroLevel = -1;
+};
+
+extern Feedback MyFeedback;
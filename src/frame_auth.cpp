@@ -0,0 +1,266 @@
+#include "frame_auth.h"
+
+#ifdef AUTH_USED
+
+#include "lora_airtime.h"
+#include "site_config.h"
+#include "protocol.h"
+
+#if defined(TDMA_USED) || defined(GROUP_USED)
+  #define AUTH_GROUP_RX // Есть сообщения для всех узлов: на приёме пробуем и ключ группы
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include <Preferences.h>
+  static Preferences authStore; // Отдельное пространство NVS "auth"
+#elif defined(ARDUINO_ARCH_ESP8266)
+  #include <EEPROM.h>
+#endif
+
+FrameAuth MyAuth;
+
+static const AuthPeer PEERS[] = AUTH_PEERS;
+#define AUTH_PEER_COUNT (sizeof(PEERS) / sizeof(PEERS[0]))
+
+#if defined(ARDUINO_ARCH_ESP8266)
+static_assert(EEPROM_ADDR_AUTH + 4 * (1 + AUTH_PEER_COUNT) <= EEPROM_SIZE, "EEPROM_SIZE is too small for AUTH_PEERS");
+#endif
+
+static const uint8_t GROUP_KEY[AES_KEY_SIZE] = AUTH_KEY_GROUP;
+static AesCmac peerCmac[AUTH_PEER_COUNT];      // Ключ пары уже развёрнут: подпись — только шифрование блоков
+static AesCmac groupCmac;
+static uint32_t peerCounter[AUTH_PEER_COUNT];  // Последний принятый счётчик собеседника
+static uint32_t peerPersisted[AUTH_PEER_COUNT]; // Последний сохранённый во flash
+
+
+
+static uint32_t loadCounter(uint8_t slot) {
+    #if defined(ARDUINO_ARCH_ESP32)
+        char key[4] = {'c', (char)('0' + slot), '\0'};
+        return authStore.getUInt(key, 0);
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        uint32_t value = 0;
+        EEPROM.get(EEPROM_ADDR_AUTH + 4 * slot, value);
+        return value == 0xFFFFFFFF ? 0 : value; // Чистая flash читается как 0xFF
+    #else
+        (void)slot;
+        return 0;
+    #endif
+}
+
+
+
+void FrameAuth::storeCounter(uint8_t slot, uint32_t value, bool commit) {
+    #if defined(ARDUINO_ARCH_ESP32)
+        (void)commit; // NVS пишет сразу
+        char key[4] = {'c', (char)('0' + slot), '\0'};
+        authStore.putUInt(key, value);
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        EEPROM.put(EEPROM_ADDR_AUTH + 4 * slot, value);
+        if (commit) EEPROM.commit();
+    #else
+        (void)slot; (void)value; (void)commit;
+    #endif
+}
+
+
+
+/**
+ * @brief Развёртывание ключей и восстановление счётчиков
+ */
+void FrameAuth::begin() {
+    #if defined(ARDUINO_ARCH_ESP32)
+        authStore.begin("auth", false);
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        EEPROM.begin(EEPROM_SIZE); // Радио поднимается раньше, чем main читает состояние реле; размер тот же
+    #endif
+
+    _nodeId = MyConfig.data.nodeId; // Смена id командой "config" — только после перезагрузки
+    groupCmac.setKey(GROUP_KEY);
+    for (uint8_t i = 0; i < AUTH_PEER_COUNT; i++) {
+        peerCmac[i].setKey(PEERS[i].key);
+        peerCounter[i] = peerPersisted[i] = loadCounter(i + 1);
+    }
+
+    // Продолжаем с сохранённой границы: номера до неё могли уйти в эфир до перезагрузки. 0 не выдаём никогда
+    _txCounter = _txReserved = loadCounter(0);
+    if (_txCounter == 0) _txCounter = 1;
+}
+
+
+
+void FrameAuth::computeTag(AesCmac& cmac, uint32_t counter, const uint8_t* frame, size_t length,
+                           uint8_t tag[AES_BLOCK_SIZE]) {
+    uint8_t counterBytes[4] = {(uint8_t)counter, (uint8_t)(counter >> 8), (uint8_t)(counter >> 16), (uint8_t)(counter >> 24)};
+    cmac.begin();
+    cmac.update(counterBytes, sizeof(counterBytes));
+    cmac.update(frame, length);
+    cmac.finish(tag);
+}
+
+
+
+/**
+ * @brief Подпись исходящего кадра ключом собеседника. Адресации пока нет — подписываем ключом первого
+ * собеседника из AUTH_PEERS (для пульта это его приёмник), а в ответах — ключом того, кто спрашивал.
+ * Кадр для всех — ключом группы; счётчик общий, номера не повторяются ни для одного из ключей
+ */
+size_t FrameAuth::seal(uint8_t* frame, size_t length, size_t capacity, bool group) {
+    if (length + AUTH_OVERHEAD > capacity) return 0;
+
+    // Выдаём номер из сохранённого блока; блок кончился — сохраняем следующую границу (одна запись на блок)
+    if (_txCounter >= _txReserved) {
+        _txReserved = _txCounter + AUTH_COUNTER_BLOCK;
+        storeCounter(0, _txReserved, true);
+    }
+    uint32_t counter = _txCounter++;
+
+    frame[length++] = _nodeId;
+    frame[length++] = (uint8_t)counter;
+    frame[length++] = (uint8_t)(counter >> 8);
+
+    uint8_t tag[AES_BLOCK_SIZE];
+    computeTag(group ? groupCmac : peerCmac[_lastPeer], counter, frame, length, tag);
+    memcpy(frame + length, tag, AUTH_TAG_LEN);
+    return length + AUTH_TAG_LEN;
+}
+
+
+
+/**
+ * @brief Проверка входящего кадра
+ */
+int FrameAuth::open(uint8_t* frame, size_t& length) {
+    if (length < AUTH_OVERHEAD) { rejectedShort++; return AUTH_ERR_TOO_SHORT; }
+
+    size_t header = length - AUTH_OVERHEAD; // Начало заголовка подписи = длина полезной нагрузки
+    uint8_t senderId = frame[header];
+    uint8_t peer = 0;
+    while (peer < AUTH_PEER_COUNT && PEERS[peer].id != senderId) peer++;
+    if (peer == AUTH_PEER_COUNT) { rejectedPeer++; return AUTH_ERR_UNKNOWN_PEER; }
+
+    // Восстанавливаем полный счётчик по двум младшим байтам: ближайший номер после последнего принятого
+    uint16_t low = (uint16_t)(frame[header + 1] | (frame[header + 2] << 8));
+    uint32_t last = peerCounter[peer];
+    if (last != 0 && low == (uint16_t)last) { duplicates++; return AUTH_ERR_DUPLICATE; }
+    uint32_t counter = (last & 0xFFFF0000UL) | low;
+    if (counter <= last) counter += 0x10000UL;
+    if (counter - last > AUTH_MAX_GAP) { rejectedReplay++; return AUTH_ERR_REPLAY; }
+
+    // Сначала ключ пары, потом ключ группы. Сравнение за постоянное время: не подсказываем, сколько байт совпало
+    uint8_t tag[AES_BLOCK_SIZE];
+    uint8_t diff = 0;
+    bool group = false;
+    computeTag(peerCmac[peer], counter, frame, header + 3, tag);
+    for (uint8_t i = 0; i < AUTH_TAG_LEN; i++) diff |= tag[i] ^ frame[header + 3 + i];
+    #ifdef AUTH_GROUP_RX
+    if (diff != 0) {
+        group = true;
+        diff = 0;
+        computeTag(groupCmac, counter, frame, header + 3, tag);
+        for (uint8_t i = 0; i < AUTH_TAG_LEN; i++) diff |= tag[i] ^ frame[header + 3 + i];
+    }
+    #endif
+    if (diff != 0) { rejectedTag++; return AUTH_ERR_BAD_TAG; }
+
+    #ifdef AUTH_GROUP_RX
+    // Ключ группы знает вся сеть: им можно подписать только маяк или команду группе. Счётчик пока не трогали
+    if (group) {
+        const char* text = (const char*)frame;
+        MsgId id = protocol_decode(text, header, MsgDir::TO_RX);
+        if (id == MsgId::NONE) id = protocol_decode(text, header, MsgDir::TO_TX);
+        if (!protocol_group_signed(id)) { rejectedGroup++; return AUTH_ERR_GROUP_ONLY; }
+    }
+    #endif
+
+    peerCounter[peer] = counter;
+    _lastPeer = peer;
+    _lastGroup = group;
+    if (counter - peerPersisted[peer] >= AUTH_COUNTER_BLOCK) {
+        storeCounter(peer + 1, counter, true);
+        peerPersisted[peer] = counter;
+    }
+
+    length = header;
+    return 0;
+}
+
+
+
+uint8_t FrameAuth::lastSenderId() {
+    return PEERS[_lastPeer].id;
+}
+
+
+
+void FrameAuth::commitReplayWindow(bool commit) {
+    if (peerPersisted[_lastPeer] == peerCounter[_lastPeer]) return;
+    storeCounter(_lastPeer + 1, peerCounter[_lastPeer], commit);
+    peerPersisted[_lastPeer] = peerCounter[_lastPeer];
+}
+
+
+
+// Команды "auth", "auth bench", "auth reset"
+bool FrameAuth::handleCommand(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd == "auth") {
+        reply("AUTH node 0x" + String(_nodeId, HEX) + ", tx counter " + String(_txCounter) +
+              " (saved " + String(_txReserved) + ")");
+        for (uint8_t i = 0; i < AUTH_PEER_COUNT; i++) {
+            reply("peer 0x" + String(PEERS[i].id, HEX) + ": rx counter " + String(peerCounter[i]) +
+                  " (saved " + String(peerPersisted[i]) + ")");
+        }
+        reply("rejected: short " + String(rejectedShort) + ", unknown peer " + String(rejectedPeer) +
+              ", bad tag " + String(rejectedTag) + ", replay " + String(rejectedReplay) + ", group key misuse " + String(rejectedGroup) +
+              ", duplicates " + String(duplicates));
+        return true;
+    }
+
+    if (cmd == "auth reset") {
+        // После перепрошивки собеседника "с нуля" его счётчик начинается заново — забываем старый
+        for (uint8_t i = 0; i < AUTH_PEER_COUNT; i++) {
+            peerCounter[i] = peerPersisted[i] = 0;
+            storeCounter(i + 1, 0, true);
+        }
+        reply("AUTH peer counters reset");
+        return true;
+    }
+
+    if (cmd == "auth bench") {
+        // Типичный кадр: "RELAY_ON|-87,9" + заголовок подписи, как его видит computeTag
+        uint8_t frame[24] = "RELAY_ON|-87,9";
+        uint8_t tag[AES_BLOCK_SIZE];
+        const uint16_t rounds = 200;
+        static const AesBackend BACKENDS[] = {AesBackend::HARDWARE, AesBackend::SOFTWARE};
+        static const char* const NAMES[] = {"hw", "sw"};
+
+        for (uint8_t b = 0; b < 2; b++) {
+            AesCmac cmac;
+            cmac.setKey(PEERS[0].key, BACKENDS[b]);
+            if (cmac.backend() != BACKENDS[b]) {
+                reply(String(NAMES[b]) + ": not available");
+                continue;
+            }
+            uint32_t t0 = micros();
+            for (uint16_t i = 0; i < rounds; i++) {
+                frame[16] = (uint8_t)i;
+                cmac.update(frame, 21);
+                cmac.finish(tag);
+            }
+            uint32_t elapsed = micros() - t0;
+            reply(String(NAMES[b]) + ": " + String(elapsed / (float)rounds, 1) + " us per 21-byte frame");
+        }
+
+        size_t payload = strlen(CMD_RELAY_ON) + 7; // команда + "|RSSI,SNR"
+        uint32_t plain = lora_time_on_air_us(payload, RADIO_SPREAD_FACTOR, RADIO_BANDWIDTH, RADIO_CODING_RATE,
+                                             RADIO_PREAMBLE_LENGTH);
+        uint32_t signed_ = lora_time_on_air_us(payload + AUTH_OVERHEAD, RADIO_SPREAD_FACTOR, RADIO_BANDWIDTH,
+                                               RADIO_CODING_RATE, RADIO_PREAMBLE_LENGTH);
+        reply("airtime RELAY_ON: " + String(plain / 1000.0f, 1) + " -> " + String(signed_ / 1000.0f, 1) + " ms (+" +
+              String(AUTH_OVERHEAD) + " bytes)");
+        return true;
+    }
+    return false;
+}
+
+#endif
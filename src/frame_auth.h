@@ -0,0 +1,115 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+#include "aes_cmac.h"
+
+/**
+ * ПОДПИСЬ РАДИОКАДРОВ (AES-128-CMAC) И ЗАЩИТА ОТ ПОВТОРОВ
+ *
+ * К каждому кадру в конец дописывается AUTH_OVERHEAD байт:
+ *
+ *   [ полезная нагрузка (как раньше) ][ id отправителя ][ счётчик, 2 младших байта LE ][ CMAC, AUTH_TAG_LEN байт ]
+ *
+ * CMAC считается ключом пары узлов по полному 32-битному счётчику и всему кадру до подписи.
+ * Кадры для всех узлов сразу (маяк TDMA, команда группе) подписываются ключом группы AUTH_KEY_GROUP; при приёме
+ * ключ группы пробуется, только если не сошёлся ключ пары, и только с TDMA_USED или GROUP_USED. Ключ группы
+ * есть у каждого узла сети, поэтому подписанный им кадр принимается, только если это маяк или команда группе
+ * (protocol_group_signed): иначе любой узел сети мог бы включить чужое реле от имени пульта. Отвергнутый
+ * кадр счётчик собеседника не сдвигает.
+ * У каждого узла свой монотонный счётчик исходящих кадров; для каждого собеседника помним
+ * последний принятый счётчик. Старшие байты счётчика в эфир не идут: приёмник восстанавливает их
+ * как ближайшее значение больше последнего принятого (как FCnt в LoRaWAN).
+ *
+ * Сохранение счётчиков без износа flash:
+ *  - свой счётчик записывается раз в AUTH_COUNTER_BLOCK кадров, с запасом вперёд. После перезагрузки
+ *    счёт продолжается с сохранённой границы — номера не повторяются, пропадает максимум блок;
+ *  - счётчик собеседника записывается после каждой команды, меняющей состояние (commitReplayWindow),
+ *    и раз в AUTH_COUNTER_BLOCK кадров в остальное время. Повтор старого GET_ST после перезагрузки
+ *    безвреден, а повтор RELAY_ON/RELAY_OFF, расписания, группы или перехода на канал отсекается всегда.
+ *
+ * На ESP32 CMAC считается аппаратным AES, на ESP8266 — программным (см. aes_cmac.h).
+ */
+
+// Коды ошибок проверки (в стиле кодов RadioLib: отрицательные, не пересекаются с ними)
+#define AUTH_ERR_TOO_SHORT    (-1101) // Кадр короче заголовка подписи (старая прошивка без подписи?)
+#define AUTH_ERR_UNKNOWN_PEER (-1102) // Id отправителя нет в таблице AUTH_PEERS
+#define AUTH_ERR_BAD_TAG      (-1103) // Подпись не сошлась: чужой ключ или подделка
+#define AUTH_ERR_REPLAY       (-1104) // Счётчик не новее последнего принятого: повтор
+#define AUTH_ERR_DUPLICATE    (-1105) // Тот же кадр ещё раз (например, напрямую и через ретранслятор)
+#define AUTH_ERR_GROUP_ONLY   (-1106) // Ключом группы подписано сообщение, которое не для всех узлов
+
+#ifdef AUTH_USED
+
+struct AuthPeer {
+    uint8_t id;
+    uint8_t key[AES_KEY_SIZE];
+};
+
+class FrameAuth {
+public:
+    /**
+     * @brief Загрузка ключей и восстановление счётчиков из NVS/EEPROM. Вызывать до первого кадра
+     */
+    void begin();
+
+    /**
+     * @brief Подпись кадра на месте
+     *
+     * @param frame - буфер с полезной нагрузкой
+     * @param length - длина полезной нагрузки
+     * @param capacity - размер буфера (нужно length + AUTH_OVERHEAD)
+     * @param group - подписать ключом группы (кадр для всех узлов сети)
+     * @return size_t - длина подписанного кадра, 0 — не влезает
+     */
+    size_t seal(uint8_t* frame, size_t length, size_t capacity, bool group = false);
+
+    /**
+     * @brief Проверка подписи и счётчика; при успехе заголовок подписи отрезается
+     *
+     * @param frame - принятый кадр
+     * @param length - длина кадра; после успешной проверки — длина полезной нагрузки
+     * @return int - RADIOLIB_ERR_NONE (0) или AUTH_ERR_*
+     */
+    int open(uint8_t* frame, size_t& length);
+
+    /**
+     * @brief Немедленно сохранить счётчик последнего проверенного собеседника.
+     * Вызывать после ответа на любую команду, меняющую состояние. На ESP8266 без commit значение только
+     * кладётся в буфер EEPROM и уходит во flash ближайшим EEPROM.commit() (вместе с состоянием реле)
+     *
+     * @param commit - ESP8266: сразу EEPROM.commit() (команда, после которой реле не сохраняется)
+     */
+    void commitReplayWindow(bool commit = false);
+
+    uint8_t lastPeer() { return _lastPeer; } // Индекс в AUTH_PEERS отправителя последнего принятого кадра
+    uint8_t lastSenderId();                  // Id отправителя последнего принятого кадра
+    bool lastWasGroup() { return _lastGroup; } // Последний принятый кадр подписан ключом группы
+    uint8_t nodeId() { return _nodeId; }       // Свой id (из настроек узла, читается в begin())
+
+    /**
+     * @brief Команды "auth" (счётчики и отказы) и "auth bench" (время подписи: аппаратный и программный AES, эфир)
+     */
+    bool handleCommand(const String& cmd, void (*reply)(const String& line));
+
+    // Отказы по причинам
+    uint32_t rejectedShort = 0;
+    uint32_t rejectedPeer = 0;
+    uint32_t rejectedTag = 0;
+    uint32_t rejectedReplay = 0;
+    uint32_t rejectedGroup = 0; // Ключ группы на сообщении не для всех
+    uint32_t duplicates = 0; // Не атака: копия последнего кадра, пришедшая другим путём
+
+private:
+    void computeTag(AesCmac& cmac, uint32_t counter, const uint8_t* frame, size_t length, uint8_t tag[AES_BLOCK_SIZE]);
+    void storeCounter(uint8_t slot, uint32_t value, bool commit); // slot 0 — свой счётчик, 1.. — собеседники
+
+    uint32_t _txCounter = 0;  // Номер следующего исходящего кадра
+    uint32_t _txReserved = 0; // Граница, сохранённая во flash: до неё номера можно выдавать без записи
+    uint8_t _lastPeer = 0;
+    bool _lastGroup = false;
+    uint8_t _nodeId = AUTH_NODE_ID;
+};
+
+extern FrameAuth MyAuth;
+
+#endif
@@ -0,0 +1,159 @@
+#include "frame_profile.h"
+#include "radiomodem.h"
+#include "lora_airtime.h"
+#include "protocol.h"
+
+#ifdef AUTH_USED
+  #define FRAME_TRAILER_LEN AUTH_OVERHEAD
+#else
+  #define FRAME_TRAILER_LEN 0
+#endif
+
+#define FRAME_METRICS_FLAG PROTOCOL_CODE_METRICS // Старший бит кода: за токеном шли метрики линка
+
+// Коды сообщений неявного профиля — столбец code таблицы PROTOCOL (protocol.h). Менять только одновременно на всех узлах.
+// Код сообщения с полями ("CH_<n>") несёт число 0..15 в младших 4 битах
+
+
+
+// Код сообщения по токену
+static bool frame_code_of(const char* token, size_t length, uint8_t& code) {
+    for (const MsgSpec& m : PROTOCOL) {
+        if (m.code == 0) continue;
+        size_t prefix = strlen(m.token);
+        if (m.fieldsMax == 0) {
+            if (length != prefix || strncmp(token, m.token, length) != 0) continue;
+            code = m.code;
+            return true;
+        }
+        if (length <= prefix || length > prefix + 2 || strncmp(token, m.token, prefix) != 0) continue;
+        uint8_t number = 0;
+        bool digits = true; // "CH_OK" тоже начинается с "CH_" — это другое сообщение
+        for (size_t i = prefix; i < length; i++) {
+            digits = digits && isDigit(token[i]);
+            number = number * 10 + (token[i] - '0');
+        }
+        if (!digits || number > 0x0F) continue;
+        code = m.code | number;
+        return true;
+    }
+    return false;
+}
+
+
+
+static bool frame_token_of(uint8_t code, String& token) {
+    for (const MsgSpec& m : PROTOCOL) {
+        if (m.code == 0) continue;
+        if (m.fieldsMax == 0 ? code == m.code : (code & 0xF0) == m.code) {
+            token = m.token;
+            if (m.fieldsMax > 0) token += String(code & 0x0F);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+size_t frame_payload_length(FrameClass cls) {
+    return FRAME_COMPACT_LEN + (cls == FrameClass::REPLY ? FRAME_BATTERY_LEN : 0);
+}
+
+
+
+size_t frame_class_length(FrameClass cls) {
+    return frame_payload_length(cls) + FRAME_TRAILER_LEN;
+}
+
+
+
+/**
+ * @brief Кодирование текстового кадра
+ */
+bool frame_encode_compact(const String& text, FrameClass cls, uint8_t* out) {
+    int sep = text.indexOf(LINK_METRICS_SEPARATOR);
+    size_t tokenLength = sep < 0 ? text.length() : (size_t)sep;
+
+    uint8_t code;
+    if (!frame_code_of(text.c_str(), tokenLength, code)) return false;
+
+    memset(out, 0, frame_payload_length(cls));
+    out[0] = code;
+    if (sep >= 0) {
+        int comma = text.indexOf(',', sep + 1);
+        if (comma > sep) {
+            out[0] |= FRAME_METRICS_FLAG;
+            out[1] = (uint8_t)(int8_t)constrain((int)text.substring(sep + 1, comma).toInt(), -128, 127);
+            out[2] = (uint8_t)(int8_t)constrain((int)text.substring(comma + 1).toInt(), -128, 127);
+            #ifdef BATTERY_USED
+                int second = text.indexOf(',', comma + 1);
+                if (cls == FrameClass::REPLY && second > comma) {
+                    uint16_t mv = (uint16_t)constrain(text.substring(second + 1).toInt(), 0L, 0xFFFFL);
+                    out[3] = mv >> 8;
+                    out[4] = mv & 0xFF;
+                }
+            #endif
+        }
+    }
+    return true;
+}
+
+
+
+/**
+ * @brief Декодирование компактного кадра в текст
+ */
+bool frame_decode_compact(const uint8_t* in, FrameClass cls, String& text) {
+    if (!frame_token_of(in[0] & ~FRAME_METRICS_FLAG, text)) return false;
+
+    if (in[0] & FRAME_METRICS_FLAG) {
+        text += LINK_METRICS_SEPARATOR;
+        text += String((int)(int8_t)in[1]) + "," + String((int)(int8_t)in[2]);
+        #ifdef BATTERY_USED
+            if (cls == FrameClass::REPLY) text += "," + String(((uint16_t)in[3] << 8) | in[4]);
+        #endif
+    }
+    #ifndef BATTERY_USED
+        (void)cls;
+    #endif
+    return true;
+}
+
+
+
+// Команда "frames": выигрыш по эфиру для всех SF при текущих BW/CR/преамбуле
+bool frame_handle_command(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd != "frames") return false;
+
+    const LORA_CONFIGURATION& cfg = MyRadio.config;
+    #ifdef FRAME_IMPLICIT_USED
+      const char* profile = "on";
+    #else
+      const char* profile = "off";
+    #endif
+    reply("FRAMES mode " + String(MyRadio.frameMode == FrameMode::IMPLICIT ? "IMPLICIT" : "EXPLICIT") +
+          " (implicit profile " + profile + "), BW" + String(cfg.bandwidth, 0) + " CR4/" + String(cfg.codingRate) +
+          " preamble " + String(cfg.preambleLength));
+
+    // Типичный обмен: команда без метрик и ответ с метриками ("ACK_OK|-87,9", с батареей — "ACK_OK|-87,9,23150")
+    size_t cmdExplicit = strlen(CMD_RELAY_ON) + FRAME_TRAILER_LEN;
+    size_t ackExplicit = strlen(ACK_FROM_RECEIVER_IF_ON) + 6 + FRAME_TRAILER_LEN;
+    #ifdef BATTERY_USED
+        ackExplicit += 6;
+    #endif
+    size_t cmdImplicit = frame_class_length(FrameClass::COMMAND);
+    size_t ackImplicit = frame_class_length(FrameClass::REPLY);
+    reply("SF  cmd " + String(cmdExplicit) + "B->" + String(cmdImplicit) + "B  ack " + String(ackExplicit) + "B->" +
+          String(ackImplicit) + "B  exchange ms  saved");
+
+    for (uint8_t sf = 7; sf <= 12; sf++) {
+        uint32_t expl = lora_time_on_air_us(cmdExplicit, sf, cfg.bandwidth, cfg.codingRate, cfg.preambleLength) +
+                        lora_time_on_air_us(ackExplicit, sf, cfg.bandwidth, cfg.codingRate, cfg.preambleLength);
+        uint32_t impl = lora_time_on_air_us(cmdImplicit, sf, cfg.bandwidth, cfg.codingRate, cfg.preambleLength, false) +
+                        lora_time_on_air_us(ackImplicit, sf, cfg.bandwidth, cfg.codingRate, cfg.preambleLength, false);
+        reply(String(sf == cfg.spreadingFactor ? "*" : " ") + String(sf) + "  " + String(expl / 1000.0f, 1) + " -> " +
+              String(impl / 1000.0f, 1) + "  " + String(100.0f * (expl - impl) / expl, 0) + "%");
+    }
+    return true;
+}
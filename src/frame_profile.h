@@ -0,0 +1,78 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * ПРОФИЛЬ КАДРОВ: ЯВНЫЙ ИЛИ НЕЯВНЫЙ ЗАГОЛОВОК LoRa
+ *
+ * EXPLICIT — как раньше: текстовый токен ("RELAY_ON|-87,9") переменной длины, LoRa-заголовок
+ *            с длиной кадра передаётся в эфир (20 бит + выравнивание до блока символов).
+ * IMPLICIT — заголовка нет, длина кадра заранее известна обеим сторонам по классу сообщения:
+ *            COMMAND (пульт -> приёмник) и REPLY (приёмник -> пульт). Токен кодируется одним байтом,
+ *            метрики линка — ещё двумя (RSSI и SNR в дБ, int8), итого FRAME_COMPACT_LEN байт;
+ *            в ответе с BATTERY_USED — ещё два байта напряжения батареи приёмника (мВ, uint16)
+ *            (+ подпись кадра, если включена). Остальной код этого не видит: RadioManager отдаёт
+ *            и принимает те же текстовые токены.
+ *
+ * Обнаружение и откат: после включения обе стороны работают в EXPLICIT. Приёмник, ответив на
+ * правильный явный кадр, переходит в IMPLICIT; пульт переходит, получив этот ответ. Любая неудача
+ * (пульт: нет ответа; приёмник: кадр с ошибкой CRC, подписи или кода) возвращает сторону в EXPLICIT,
+ * и следующий обмен заново договаривается явным кадром. Цена рассинхронизации — один неудачный обмен.
+ */
+
+#define FRAME_COMPACT_LEN 3 // код сообщения + RSSI + SNR
+#ifdef BATTERY_USED
+  #define FRAME_BATTERY_LEN 2 // Ответ приёмника: + напряжение батареи, мВ (старший байт первым)
+#else
+  #define FRAME_BATTERY_LEN 0
+#endif
+#define FRAME_COMPACT_MAX (FRAME_COMPACT_LEN + FRAME_BATTERY_LEN) // Буфер под компактный кадр любого класса
+
+#define FRAME_ERR_UNKNOWN_CODE (-1201) // Неявный кадр с неизвестным кодом сообщения (код ошибки в стиле RadioLib)
+
+enum class FrameMode : uint8_t {
+    EXPLICIT = 0,
+    IMPLICIT = 1,
+};
+
+// Класс сообщения определяет длину кадра в неявном режиме
+enum class FrameClass : uint8_t {
+    COMMAND = 0, // пульт -> приёмник: RELAY_ON, RELAY_OFF, GET_ST, CH_<n>
+    REPLY   = 1, // приёмник -> пульт: ACK_OK, ACK_OFF, RELAY_IS_ON, RELAY_IS_OFF, CH_OK
+};
+
+/**
+ * @brief Длина полезной нагрузки компактного кадра класса (без подписи)
+ */
+size_t frame_payload_length(FrameClass cls);
+
+/**
+ * @brief Длина кадра класса в неявном режиме (вместе с подписью, если она включена)
+ */
+size_t frame_class_length(FrameClass cls);
+
+/**
+ * @brief Кодирование текстового кадра "ТОКЕН", "ТОКЕН|RSSI,SNR" или "ТОКЕН|RSSI,SNR,мВ" в компактный вид
+ *
+ * @param text - текстовый кадр
+ * @param cls - класс кадра: сколько байт писать
+ * @param out - буфер не меньше FRAME_COMPACT_MAX (записывается frame_payload_length(cls) байт)
+ * @return true - токен известен и закодирован
+ */
+bool frame_encode_compact(const String& text, FrameClass cls, uint8_t* out);
+
+/**
+ * @brief Обратное преобразование: компактный кадр -> тот же текст, что был до кодирования
+ *
+ * @param in - frame_payload_length(cls) байт
+ * @param cls - класс кадра
+ * @param text - результат
+ * @return true - код известен
+ */
+bool frame_decode_compact(const uint8_t* in, FrameClass cls, String& text);
+
+/**
+ * @brief Команда "frames": текущий режим и выигрыш по эфиру неявного профиля для SF7..SF12
+ * при текущих BW, CR и преамбуле
+ */
+bool frame_handle_command(const String& cmd, void (*reply)(const String& line));
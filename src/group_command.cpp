@@ -0,0 +1,185 @@
+#include "group_command.h"
+
+#ifdef GROUP_USED
+
+#include "radiomodem.h"
+#include "frame_auth.h"
+#include "protocol.h"
+#include "logger.h"
+#include "site_config.h"
+
+GroupCommander MyGroups;
+
+#ifdef TRANSMITTER
+static const GroupSpec GROUPS[] = GROUP_TABLE;
+#else
+static_assert(AUTH_NODE_ID >= GROUP_FIRST_ID && AUTH_NODE_ID < GROUP_FIRST_ID + GROUP_MAX_MEMBERS,
+              "AUTH_NODE_ID of a group member must have a bit in the group mask");
+#endif
+
+
+
+uint32_t GroupCommander::slotMs() {
+    return protocol_time_on_air(protocol_spec(MsgId::GROUP_ACK), strlen(ACK_GROUP)) / 1000 + 1 + GROUP_ACK_GUARD_MS;
+}
+
+
+
+#ifdef TRANSMITTER
+/**
+ * @brief Команда группе и сбор подтверждений по окнам. Повтор — только для тех, кто не ответил
+ */
+uint32_t GroupCommander::send(uint8_t group, bool on, void (*onTick)()) {
+    uint32_t members = 0;
+    for (const GroupSpec& spec : GROUPS) {
+        if (spec.group == group) members = spec.members;
+    }
+    lastGroup = group;
+    lastMembers = members;
+    lastConfirmed = 0;
+    lastRounds = 0;
+    if (members == 0) return 0;
+
+    MyRadio.isProcessing = true;
+    unsigned long t0 = millis();
+    uint32_t missing = members;
+    for (uint8_t round = 0; round <= GROUP_RETRIES && missing != 0; round++) {
+        char mask[9];
+        snprintf(mask, sizeof(mask), "%lX", (unsigned long)missing);
+        MyRadio.send(String(CMD_GROUP) + String(group) + (on ? "_ON_" : "_OFF_") + mask, true);
+        MyRadio.startListening();
+        lastRounds++;
+
+        // Окна всех, кого ждём, и ещё одно — запас на разброс задержек приёмников
+        uint32_t window = MyConfig.data.waitTxMs + (__builtin_popcount(missing) + 1) * slotMs();
+        unsigned long start = millis();
+        while (millis() - start < window && missing != 0) {
+            if (onTick != nullptr) onTick();
+            if (MyRadio.isDataReady()) {
+                String response;
+                if (MyRadio.receive(response) == RADIOLIB_ERR_NONE && protocol_decode(response, MsgDir::TO_TX) == MsgId::GROUP_ACK) {
+                    uint8_t id = MyAuth.lastSenderId();
+                    if (id >= GROUP_FIRST_ID && id < GROUP_FIRST_ID + GROUP_MAX_MEMBERS) {
+                        uint32_t bit = 1UL << (id - GROUP_FIRST_ID);
+                        lastConfirmed |= bit & members;
+                        missing &= ~bit;
+                    }
+                }
+                MyRadio.startListening();
+            }
+            yield();
+        }
+    }
+
+    lastElapsedMs = millis() - t0;
+    commands++;
+    MyRadio.isProcessing = false;
+    return lastConfirmed;
+}
+
+
+
+void GroupCommander::service(void (*onTick)()) {
+    if (!_pending || MyRadio.isProcessing) return;
+    _pending = false;
+    send(_group, _on, onTick);
+
+    if (_reply == nullptr) return;
+    uint32_t missing = lastMembers & ~lastConfirmed;
+    _reply("GROUP " + String(lastGroup) + (_on ? " ON: " : " OFF: ") + String(__builtin_popcount(lastConfirmed)) + "/" +
+           String(__builtin_popcount(lastMembers)) + " confirmed in " + String(lastElapsedMs) + " ms, " +
+           String(lastRounds) + " frames" + (missing != 0 ? ", missing mask 0x" + String(missing, HEX) : String()));
+}
+#else
+uint32_t GroupCommander::send(uint8_t group, bool on, void (*onTick)()) {
+    (void)group; (void)on; (void)onTick;
+    return 0;
+}
+
+void GroupCommander::service(void (*onTick)()) {
+    (void)onTick;
+}
+#endif
+
+
+
+/**
+ * @brief Приёмник: наша ли это группа, ждут ли нас и когда начинается наше окно
+ */
+bool GroupCommander::accept(const String& message, bool& on, uint32_t& replyDelayMs) {
+    #ifdef GROUP_MEMBERSHIP
+        if (!message.startsWith(CMD_GROUP) || !MyAuth.lastWasGroup()) return false;
+        int first = strlen(CMD_GROUP);
+        int second = message.indexOf('_', first);
+        int third = second < 0 ? -1 : message.indexOf('_', second + 1);
+        if (third < 0) return false;
+
+        long group = message.substring(first, second).toInt();
+        String action = message.substring(second + 1, third);
+        uint32_t mask = strtoul(message.substring(third + 1).c_str(), nullptr, 16);
+        if (group < 1 || group > 32 || !(GROUP_MEMBERSHIP & (1UL << (group - 1)))) return false;
+
+        uint8_t id = MyAuth.nodeId();
+        if (id < GROUP_FIRST_ID || id >= GROUP_FIRST_ID + GROUP_MAX_MEMBERS) return false; // Id сменили командой "config"
+        uint32_t own = 1UL << (id - GROUP_FIRST_ID);
+        if (!(mask & own)) return false; // Наш ответ уже получен
+        if (action == "ON") on = true;
+        else if (action == "OFF") on = false;
+        else return false;
+
+        // Окно — по числу отмеченных приёмников с меньшим id
+        replyDelayMs = MyConfig.data.waitTxMs + __builtin_popcount(mask & (own - 1)) * slotMs();
+        commands++;
+        return true;
+    #else
+        (void)message; (void)on; (void)replyDelayMs;
+        return false;
+    #endif
+}
+
+
+
+// Команды "group <g> on|off" и "groups"
+bool GroupCommander::handleCommand(const String& cmd, void (*reply)(const String& line)) {
+    #ifdef TRANSMITTER
+        if (cmd == "groups") {
+            for (const GroupSpec& spec : GROUPS) {
+                reply("group " + String(spec.group) + ": mask 0x" + String(spec.members, HEX) + " (" +
+                      String(__builtin_popcount(spec.members)) + " receivers)");
+            }
+            // Для сравнения: те же приёмники по одному — команда, TIMEOUT_WAITING_TX и ответ на каждого
+            uint32_t single = (protocol_time_on_air(protocol_spec(MsgId::RELAY_OFF), strlen(CMD_RELAY_OFF)) +
+                              protocol_reply_time_us(MsgId::RELAY_OFF)) / 1000 + MyConfig.data.waitTxMs;
+            reply("reply window " + String(slotMs()) + " ms; last: group " + String(lastGroup) + ", " +
+                  String(__builtin_popcount(lastConfirmed)) + "/" + String(__builtin_popcount(lastMembers)) + " in " +
+                  String(lastElapsedMs) + " ms (one by one ~" + String(single * __builtin_popcount(lastMembers)) + " ms)");
+            return true;
+        }
+        if (!cmd.startsWith("group ")) return false;
+
+        int space = cmd.indexOf(' ', 6);
+        long group = space < 0 ? 0 : cmd.substring(6, space).toInt();
+        String action = space < 0 ? String() : cmd.substring(space + 1);
+        bool known = false;
+        for (const GroupSpec& spec : GROUPS) {
+            if (spec.group == group) known = true;
+        }
+        if (!known || (action != "on" && action != "off")) {
+            reply("Usage: group <n> on|off (groups — list)");
+            return true;
+        }
+        _group = (uint8_t)group;
+        _on = (action == "on");
+        _reply = reply;
+        _pending = true; // Уйдёт из service(), когда эфир свободен
+        return true;
+    #else
+        if (cmd != "groups") return false;
+        reply("GROUPS membership 0x" + String((uint32_t)GROUP_MEMBERSHIP, HEX) + ", id 0x" + String(MyAuth.nodeId(), HEX) +
+              " (bit " + String(MyAuth.nodeId() - GROUP_FIRST_ID) + "), reply window " + String(slotMs()) + " ms, executed " +
+              String(commands));
+        return true;
+    #endif
+}
+
+#endif
@@ -0,0 +1,92 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * ГРУППОВЫЕ КОМАНДЫ С ОТВЕТАМИ ПО ОКНАМ
+ *
+ * Переключить одну нагрузку на 20 приёмниках по одному — 20 обменов, каждый со своим ожиданием ответа.
+ * С GROUP_USED пульт шлёт один кадр на всю группу:
+ *
+ *   "GRP_<группа>_ON_<маска>"   маска (hex) — каких приёмников ждём: бит i — id GROUP_FIRST_ID + i
+ *
+ * Кадр подписан ключом группы (его проверяет каждый приёмник). Приёмник, состоящий в группе
+ * (GROUP_MEMBERSHIP) и отмеченный в маске, исполняет команду и отвечает ACK_GROUP в своём окне:
+ *
+ *   конец команды | TIMEOUT_WAITING_TX | окно 0 | окно 1 | ... | окно n-1 |
+ *
+ * Номер окна — сколько отмеченных в маске битов младше своего, ширина окна — время ответа в эфире
+ * + GROUP_ACK_GUARD_MS. Обе стороны считают её по одним настройкам радио, ответы не пересекаются.
+ * Кто ответил, пульт узнаёт по id отправителя в подписи и собирает битовую карту подтверждений.
+ * Не ответившие получают ту же команду ещё раз (до GROUP_RETRIES раз) — уже с маской только из них,
+ * поэтому окон в повторе меньше. Команда идемпотентна: исполнивший, но не услышанный приёмник просто
+ * подтвердит ещё раз.
+ *
+ * Пульт: команды "group <группа> on|off" (исполняется из loop(), итог — туда же, откуда пришла команда)
+ * и "groups" (таблица групп и итог последней команды). Приёмник: "groups" — членство и счётчики.
+ */
+
+#ifdef GROUP_USED
+
+static_assert(GROUP_MAX_MEMBERS <= 32, "Group mask is 32 bits");
+
+struct GroupSpec {
+    uint8_t group;    // Номер группы 1..32
+    uint32_t members; // Маска приёмников (бит i — id GROUP_FIRST_ID + i)
+};
+
+class GroupCommander {
+public:
+    /**
+     * @brief Пульт: "group <g> on|off" — запомнить команду (уйдёт из service()), "groups" — отчёт.
+     * Приёмник: "groups"
+     */
+    bool handleCommand(const String& cmd, void (*reply)(const String& line));
+
+    /**
+     * @brief Пульт: вызывать из loop(). Если есть команда — отправка и сбор подтверждений
+     * (блокирует на время окон ответов, onTick крутится)
+     */
+    void service(void (*onTick)() = nullptr);
+
+    /**
+     * @brief Пульт: групповая команда с повторами для не ответивших
+     *
+     * @param group - номер группы из GROUP_TABLE
+     * @param on - включить или выключить
+     * @param onTick - фоновая задача на время ожидания
+     * @return uint32_t - маска подтвердивших приёмников
+     */
+    uint32_t send(uint8_t group, bool on, void (*onTick)() = nullptr);
+
+    /**
+     * @brief Приёмник: разбор групповой команды
+     *
+     * @param message - принятый токен
+     * @param on - включить или выключить
+     * @param replyDelayMs - через сколько мс после приёма отвечать (начало своего окна)
+     * @return true - команда нашей группе и нас в ней ждут
+     */
+    bool accept(const String& message, bool& on, uint32_t& replyDelayMs);
+
+    uint32_t slotMs(); // Ширина окна ответа (мс)
+
+    // Пульт: итог последней команды
+    uint8_t lastGroup = 0;
+    uint32_t lastMembers = 0;   // Кого ждали
+    uint32_t lastConfirmed = 0; // Кто подтвердил
+    uint8_t lastRounds = 0;     // Кадров команды (1 + повторы)
+    uint32_t lastElapsedMs = 0;
+
+    uint32_t commands = 0; // Пульт: отправлено групповых команд. Приёмник: исполнено
+
+private:
+    bool _pending = false;
+    uint8_t _group = 0;
+    bool _on = false;
+    void (*_reply)(const String& line) = nullptr;
+};
+
+extern GroupCommander MyGroups;
+
+#endif
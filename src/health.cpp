@@ -0,0 +1,192 @@
+#include "health.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include <freertos/FreeRTOS.h>
+  #include <freertos/task.h>
+#elif !defined(ARDUINO)
+  // Хостовая сборка (native): время из std::chrono, куча из glibc
+  #include <chrono>
+  #include <malloc.h>
+  static uint32_t micros() {
+      using namespace std::chrono;
+      return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+  }
+  static uint32_t millis() { return micros() / 1000; }
+#endif
+
+#include <stdio.h>
+
+HealthMonitor MyHealth;
+
+// Биты предупреждений в _activeWarnings
+#define WARN_HEAP  0
+#define WARN_BLOCK 1
+#define WARN_STACK 2
+#define WARN_LOOP  3
+
+#if defined(ARDUINO_ARCH_ESP32)
+// Задачи, за стеком которых следим. Отсутствующие (например, BLE выключен) пропускаются
+static const char* const WATCHED_TASKS[] = {"loopTask", "esp_timer", "BTC_TASK", "BTU_TASK", "btController", "nimble_host"};
+#endif
+
+
+
+/**
+ * @brief Учёт длительности итерации loop() и периодический снимок кучи/стеков
+ */
+void HealthMonitor::loopTick() {
+    uint32_t now = micros();
+    if (loopCount > 0) {
+        uint32_t dt = now - _lastLoopUs;
+        uint8_t bucket = 0;
+        while (bucket < HEALTH_LOOP_BUCKETS - 1 && (dt >> (bucket + 1)) != 0) bucket++;
+        _loopBuckets[bucket]++;
+        if (dt > loopMaxUs) loopMaxUs = dt;
+        if (dt / 1000 > HEALTH_WARN_LOOP_MS) {
+            char text[32];
+            snprintf(text, sizeof(text), "loop() took %lu ms", (unsigned long)(dt / 1000));
+            warn(WARN_LOOP, true, text);
+        }
+    }
+    _lastLoopUs = now;
+    loopCount++;
+
+    uint32_t nowMs = millis();
+    if (nowMs - _lastSampleMs >= HEALTH_SAMPLE_INTERVAL) {
+        _lastSampleMs = nowMs;
+        check(sample());
+    }
+}
+
+
+
+/**
+ * @brief Снимок кучи и стеков
+ *
+ * @return HealthSnapshot - показания
+ */
+HealthSnapshot HealthMonitor::sample() {
+    HealthSnapshot s;
+
+    #if defined(ARDUINO_ARCH_ESP32)
+        s.freeHeap = ESP.getFreeHeap();
+        s.minFreeHeap = ESP.getMinFreeHeap();
+        s.maxBlock = ESP.getMaxAllocHeap();
+        for (const char* name : WATCHED_TASKS) {
+            TaskHandle_t task = xTaskGetHandle(name);
+            if (task == nullptr || s.taskCount >= HEALTH_MAX_TASKS) continue;
+            s.taskNames[s.taskCount] = name;
+            s.taskStackFree[s.taskCount] = uxTaskGetStackHighWaterMark(task); // В ESP-IDF — в байтах
+            s.taskCount++;
+        }
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        s.freeHeap = ESP.getFreeHeap();
+        s.maxBlock = ESP.getMaxFreeBlockSize();
+        s.taskNames[0] = "cont";
+        s.taskStackFree[0] = ESP.getFreeContStack();
+        s.taskCount = 1;
+    #elif defined(__GLIBC__)
+        struct mallinfo2 info = mallinfo2();
+        s.freeHeap = (uint32_t)info.fordblks;
+        s.maxBlock = (uint32_t)info.fordblks;
+    #endif
+
+    // Минимум считаем сами там, где ядро его не ведёт
+    if (s.freeHeap < _minFreeHeap) _minFreeHeap = s.freeHeap;
+    if (s.minFreeHeap == 0 || s.minFreeHeap > _minFreeHeap) s.minFreeHeap = _minFreeHeap;
+    return s;
+}
+
+
+
+/**
+ * @brief Проверка порогов
+ */
+void HealthMonitor::check(const HealthSnapshot& s) {
+    char text[48];
+    snprintf(text, sizeof(text), "free heap %lu B", (unsigned long)s.freeHeap);
+    warn(WARN_HEAP, s.freeHeap < HEALTH_WARN_FREE_HEAP, text);
+    snprintf(text, sizeof(text), "largest free block %lu B", (unsigned long)s.maxBlock);
+    warn(WARN_BLOCK, s.maxBlock < HEALTH_WARN_MAX_BLOCK, text);
+
+    uint8_t worst = 0;
+    for (uint8_t i = 1; i < s.taskCount; i++) {
+        if (s.taskStackFree[i] < s.taskStackFree[worst]) worst = i;
+    }
+    bool lowStack = s.taskCount > 0 && s.taskStackFree[worst] < HEALTH_WARN_STACK;
+    if (lowStack) snprintf(text, sizeof(text), "%s stack free %lu B", s.taskNames[worst], (unsigned long)s.taskStackFree[worst]);
+    warn(WARN_STACK, lowStack, text);
+
+    // Предупреждение о долгом loop() — событие, а не состояние: снимаем его на каждом снимке
+    warn(WARN_LOOP, false, "");
+}
+
+
+
+/**
+ * @brief Предупреждение по фронту: сообщаем при входе в состояние, молчим, пока оно держится
+ */
+void HealthMonitor::warn(uint8_t bit, bool active, const char* text) {
+    uint8_t mask = (uint8_t)(1 << bit);
+    if (!active) {
+        _activeWarnings &= ~mask;
+        return;
+    }
+    if (_activeWarnings & mask) return;
+    _activeWarnings |= mask;
+
+    if (_onWarning != nullptr) _onWarning(String(text));
+}
+
+
+
+uint32_t HealthMonitor::loopPercentileUs(uint8_t p) const {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < HEALTH_LOOP_BUCKETS; i++) total += _loopBuckets[i];
+    if (total == 0) return 0;
+    uint32_t rank = (uint32_t)(((uint64_t)total * p + 99) / 100), seen = 0;
+    for (uint8_t i = 0; i < HEALTH_LOOP_BUCKETS; i++) {
+        seen += _loopBuckets[i];
+        if (seen >= rank) return (2UL << i) - 1; // Верхняя граница корзины [2^i, 2^(i+1))
+    }
+    return loopMaxUs;
+}
+
+
+
+/**
+ * @brief Отчёт построчно
+ */
+void HealthMonitor::report(void (*reply)(const String& line)) {
+    HealthSnapshot s = sample();
+    char line[96];
+
+    uint32_t frag = s.freeHeap ? 100 - (uint32_t)((uint64_t)s.maxBlock * 100 / s.freeHeap) : 0;
+    snprintf(line, sizeof(line), "HEAP free %lu min %lu maxblk %lu frag %lu%%", (unsigned long)s.freeHeap,
+             (unsigned long)s.minFreeHeap, (unsigned long)s.maxBlock, (unsigned long)frag);
+    reply(String(line));
+
+    for (uint8_t i = 0; i < s.taskCount; i++) {
+        snprintf(line, sizeof(line), "STACK %s free %lu B", s.taskNames[i], (unsigned long)s.taskStackFree[i]);
+        reply(String(line));
+    }
+
+    snprintf(line, sizeof(line), "LOOP n %lu p50<%lu p95<%lu p99<%lu max %lu us", (unsigned long)loopCount,
+             (unsigned long)loopPercentileUs(50), (unsigned long)loopPercentileUs(95),
+             (unsigned long)loopPercentileUs(99), (unsigned long)loopMaxUs);
+    reply(String(line));
+}
+
+
+
+void HealthMonitor::setWarningHandler(void (*handler)(const String& warning)) {
+    _onWarning = handler;
+}
+
+
+
+bool health_handle_command(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd != "health") return false;
+    MyHealth.report(reply);
+    return true;
+}
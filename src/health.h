@@ -0,0 +1,81 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * КОНТРОЛЬ ЗДОРОВЬЯ СИСТЕМЫ
+ *
+ * Главный риск долгой работы — фрагментация кучи (String повсюду, включение/выключение BLE),
+ * поэтому раз в HEALTH_SAMPLE_INTERVAL снимаем:
+ *  - свободную кучу, самый большой свободный блок и минимум свободной кучи за всё время;
+ *  - запас стека (high-water mark) у известных задач FreeRTOS (на ESP8266 — у стека loop);
+ * а на каждой итерации loop() — её длительность в логарифмическую гистограмму (степени двойки, мкс).
+ * Накладные расходы на итерацию — один micros() и пара инструкций.
+ *
+ * При пересечении порогов HEALTH_WARN_* вызывается обработчик предупреждений (один раз на пересечение).
+ * Команда "health" (консоль Serial или BLE) выводит отчёт.
+ *
+ * Модуль не зависит от радио и периферии и собирается на хосте (native) — там куча берётся из mallinfo2(),
+ * так что те же счётчики можно использовать в тестах на утечки.
+ */
+
+#define HEALTH_LOOP_BUCKETS 24 // Корзины 2^i мкс: от 1 мкс до ~16 с
+#define HEALTH_MAX_TASKS 6     // Сколько задач отслеживаем
+
+struct HealthSnapshot {
+    uint32_t freeHeap = 0;    // Свободно сейчас
+    uint32_t minFreeHeap = 0; // Минимум свободной кучи за всё время работы
+    uint32_t maxBlock = 0;    // Самый большой блок, который можно выделить
+    uint8_t taskCount = 0;
+    const char* taskNames[HEALTH_MAX_TASKS] = {};
+    uint32_t taskStackFree[HEALTH_MAX_TASKS] = {}; // Минимальный запас стека задачи за всё время (байт)
+};
+
+class HealthMonitor {
+public:
+    /**
+     * @brief Вызывать первой строкой loop(): учитывает длительность предыдущей итерации
+     * и раз в HEALTH_SAMPLE_INTERVAL снимает показания кучи и стеков
+     */
+    void loopTick();
+
+    HealthSnapshot sample(); // Снять показания прямо сейчас
+
+    /**
+     * @brief Отчёт построчно
+     *
+     * @param reply - куда писать строки
+     */
+    void report(void (*reply)(const String& line));
+
+    /**
+     * @brief Обработчик предупреждений (порог пересечён)
+     */
+    void setWarningHandler(void (*handler)(const String& warning));
+
+    uint32_t loopPercentileUs(uint8_t p) const; // Перцентиль длительности итерации (верхняя граница корзины)
+    uint32_t loopCount = 0;
+    uint32_t loopMaxUs = 0;
+
+private:
+    void check(const HealthSnapshot& s);
+    void warn(uint8_t bit, bool active, const char* text);
+
+    uint32_t _loopBuckets[HEALTH_LOOP_BUCKETS] = {};
+    uint32_t _lastLoopUs = 0;
+    uint32_t _lastSampleMs = 0;
+    uint32_t _minFreeHeap = UINT32_MAX; // Для платформ, где ядро само минимум не считает
+    uint8_t _activeWarnings = 0;        // Биты активных предупреждений — чтобы не спамить
+    void (*_onWarning)(const String& warning) = nullptr;
+};
+
+/**
+ * @brief Разбор команды "health"
+ *
+ * @param cmd - команда
+ * @param reply - куда писать ответ
+ * @return true - команда обработана
+ */
+bool health_handle_command(const String& cmd, void (*reply)(const String& line));
+
+extern HealthMonitor MyHealth;
@@ -0,0 +1,59 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * Гистограмма с фиксированными корзинами: постоянная память, добавление за O(1), без выделения памяти.
+ * Значения ниже lo попадают в первую корзину, выше последней — в последнюю.
+ *
+ * @tparam BINS - количество корзин
+ */
+template <uint16_t BINS>
+struct Histogram {
+    int32_t lo;   // Нижняя граница первой корзины
+    int32_t step; // Ширина корзины
+    uint32_t bins[BINS] = {};
+    uint32_t count = 0;
+    int32_t min = 0;
+    int32_t max = 0;
+    int64_t sum = 0;
+
+    Histogram(int32_t lo, int32_t step) : lo(lo), step(step) {}
+
+    void add(int32_t value) {
+        int32_t index = (value - lo) / step;
+        if (value < lo) index = 0;
+        if (index >= (int32_t)BINS) index = BINS - 1;
+        bins[index]++;
+        if (count == 0 || value < min) min = value;
+        if (count == 0 || value > max) max = value;
+        sum += value;
+        count++;
+    }
+
+    void reset() {
+        for (uint16_t i = 0; i < BINS; i++) bins[i] = 0;
+        count = 0;
+        min = max = 0;
+        sum = 0;
+    }
+
+    int32_t mean() const { return count ? (int32_t)(sum / (int64_t)count) : 0; }
+
+    // Перцентиль (0..100) с точностью до корзины: возвращает середину корзины, ограниченную min/max
+    int32_t percentile(uint8_t p) const {
+        if (count == 0) return 0;
+        uint32_t rank = (uint32_t)(((uint64_t)count * p + 99) / 100);
+        if (rank == 0) rank = 1;
+        uint32_t seen = 0;
+        for (uint16_t i = 0; i < BINS; i++) {
+            seen += bins[i];
+            if (seen >= rank) {
+                int32_t value = lo + (int32_t)i * step + step / 2;
+                return value < min ? min : (value > max ? max : value);
+            }
+        }
+        return max;
+    }
+
+    int32_t binStart(uint16_t i) const { return lo + (int32_t)i * step; }
+};
@@ -0,0 +1,349 @@
+#include "host_link.h"
+
+#ifdef HOST_LINK_USED
+
+#include "radiomodem.h"
+#include "frame_auth.h"
+#include "battery.h"
+#include "logger.h"
+
+// Типы кадров (см. host_link.h)
+#define HOST_HELLO 0x01
+#define HOST_RELAY 0x02
+#define HOST_STATUS 0x03
+#define HOST_COMMAND 0x04
+#define HOST_BYE 0x05
+#define HOST_ACK 0x80 // Ответ = тип запроса | HOST_ACK
+#define HOST_TEXT 0x84
+#define HOST_END 0x85
+#define HOST_LOG 0xC0
+#define HOST_CAPTURE 0xC1
+#define HOST_ERROR 0xEE
+
+// Коды END и ERROR
+#define HOST_OK 0
+#define HOST_ERR_UNKNOWN_COMMAND 1
+#define HOST_ERR_BAD_TYPE 2
+#define HOST_ERR_BAD_LENGTH 3
+#define HOST_ERR_UNSUPPORTED 4 // Не для этой роли (RELAY на приёмнике)
+#define HOST_ERR_BUSY 5        // Очередь RELAY заполнена
+
+#define HOST_HEADER_LEN 3 // тип + id
+#define HOST_CRC_LEN 2
+#define HOST_HELLO_MAX 16 // Текстовый режим: кадр HELLO в линии короче (длиннее — это не хост)
+
+HostLink MyHost;
+
+
+
+static uint16_t crc16(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    while (length--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+
+
+// COBS: нулей в выходе нет, длина растёт на 1 байт на каждые 254
+static size_t cobs_encode(const uint8_t* in, size_t length, uint8_t* out) {
+    size_t code = 0, pos = 1;
+    uint8_t run = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (in[i] != 0) {
+            out[pos++] = in[i];
+            run++;
+        }
+        if (in[i] == 0 || run == 0xFF) {
+            out[code] = run;
+            code = pos++;
+            run = 1;
+        }
+    }
+    out[code] = run;
+    return pos;
+}
+
+
+
+// Декодирование на месте. 0 — битый кадр
+static size_t cobs_decode(uint8_t* buf, size_t length) {
+    size_t in = 0, out = 0;
+    while (in < length) {
+        uint8_t run = buf[in++];
+        if (run == 0 || in + run - 1 > length) return 0;
+        for (uint8_t i = 1; i < run; i++) buf[out++] = buf[in++];
+        if (run != 0xFF && in < length) buf[out++] = 0;
+    }
+    return out;
+}
+
+
+
+void HostLink::setCommandHandler(bool (*handler)(const String& line, void (*reply)(const String& line))) {
+    _handler = handler;
+}
+
+
+
+/**
+ * @brief Текстовый режим: 0x00 открывает возможный кадр HELLO, следующий 0x00 — закрывает
+ */
+bool HostLink::feed(uint8_t c) {
+    if (c == 0) {
+        if (_collecting && _rxLength > 0) handleFrame(_rx, _rxLength, false);
+        _collecting = !_active;
+        _rxLength = 0;
+        return true;
+    }
+    if (!_collecting) return false;
+    if (_rxLength >= HOST_HELLO_MAX) {
+        _collecting = false; // Не кадр хоста — дальше снова текст
+        return false;
+    }
+    _rx[_rxLength++] = c;
+    return true;
+}
+
+
+
+void HostLink::poll(bool inExchange) {
+    if (!_active) return;
+
+    if (!inExchange) {
+        // Обмена нет: отложенная команда консоли и запросы RELAY, пришедшие во время чужого обмена, — к следующей цели
+        for (uint8_t i = 0; i < _pendingCount; i++) _pending[i].duringExchange = false;
+        if (_deferred) {
+            _deferred = false;
+            dispatch(HOST_COMMAND, _deferredId, (const uint8_t*)_deferredLine, strlen(_deferredLine), false);
+        }
+    }
+
+    while (!_deferred && Serial.available() > 0) {
+        uint8_t c = (uint8_t)Serial.read();
+        if (c != 0) {
+            if (_rxLength < sizeof(_rx)) _rx[_rxLength++] = c;
+            else _rxOverflow = true;
+            continue;
+        }
+        if (_rxOverflow) {
+            badFrames++;
+            sendError(0, HOST_ERR_BAD_LENGTH);
+        } else if (_rxLength > 0) {
+            handleFrame(_rx, _rxLength, inExchange);
+        }
+        _rxLength = 0;
+        _rxOverflow = false;
+    }
+
+    if (_active && millis() - _lastFrameMs > HOST_LINK_IDLE_MS) {
+        _active = false;
+        _deferred = false;
+        print_log("[HOST]", "Host link idle, back to text console");
+    }
+}
+
+
+
+/**
+ * @brief Снятие COBS и проверка CRC
+ */
+void HostLink::handleFrame(uint8_t* frame, size_t length, bool inExchange) {
+    size_t decoded = cobs_decode(frame, length);
+    if (decoded < HOST_HEADER_LEN + HOST_CRC_LEN ||
+        crc16(frame, decoded - HOST_CRC_LEN) != (frame[decoded - 2] | (frame[decoded - 1] << 8))) {
+        badFrames++;
+        if (_active) sendError(0, HOST_ERR_BAD_LENGTH);
+        return;
+    }
+    if (!_active && frame[0] != HOST_HELLO) return; // В текстовом режиме понимаем только HELLO
+    framesIn++;
+    _lastFrameMs = millis();
+    dispatch(frame[0], frame[1] | (frame[2] << 8), frame + HOST_HEADER_LEN, decoded - HOST_HEADER_LEN - HOST_CRC_LEN, inExchange);
+}
+
+
+
+void HostLink::dispatch(uint8_t type, uint16_t id, const uint8_t* data, size_t length, bool inExchange) {
+    switch (type) {
+        case HOST_HELLO: {
+            _active = true;
+            _collecting = false;
+            uint8_t hello[5] = {HOST_LINK_VERSION, (uint8_t)RADIO_NAME[0], 0,
+                                (uint8_t)(HOST_LINK_FRAME_MAX & 0xFF), (uint8_t)(HOST_LINK_FRAME_MAX >> 8)};
+            #ifdef AUTH_USED
+                hello[2] = MyAuth.nodeId();
+            #endif
+            sendFrame(HOST_HELLO | HOST_ACK, id, hello, sizeof(hello));
+            break;
+        }
+        case HOST_BYE: {
+            uint8_t code = HOST_OK;
+            sendFrame(HOST_END, id, &code, 1);
+            _active = false;
+            break;
+        }
+        case HOST_STATUS:
+            sendStatus(id);
+            break;
+        case HOST_RELAY:
+            #ifdef TRANSMITTER
+                if (length != 1) {
+                    sendError(id, HOST_ERR_BAD_LENGTH);
+                } else if (_pendingCount >= HOST_LINK_PENDING) {
+                    sendError(id, HOST_ERR_BUSY);
+                } else {
+                    _pending[_pendingCount++] = {id, data[0] != 0, inExchange, millis()};
+                    MyCommands.requestRelay(data[0] != 0, CommandSource::HOST); // Итог — в onCommandResult()
+                }
+            #else
+                sendError(id, HOST_ERR_UNSUPPORTED);
+            #endif
+            break;
+        case HOST_COMMAND: {
+            if (length > HOST_LINK_FRAME_MAX) {
+                sendError(id, HOST_ERR_BAD_LENGTH);
+                break;
+            }
+            char* line = _deferredLine;
+            memmove(line, data, length);
+            line[length] = '\0';
+            if (inExchange) {
+                // Команды консоли могут трогать радио — только после обмена. Пока ждём, вход не читаем: порядок сохраняется
+                _deferredId = id;
+                _deferred = true;
+                break;
+            }
+            _replyId = id;
+            uint8_t code = (_handler != nullptr && _handler(String(line), commandReply)) ? HOST_OK : HOST_ERR_UNKNOWN_COMMAND;
+            sendFrame(HOST_END, id, &code, 1);
+            break;
+        }
+        default:
+            sendError(id, HOST_ERR_BAD_TYPE);
+            break;
+    }
+}
+
+
+
+void HostLink::sendFrame(uint8_t type, uint16_t id, const uint8_t* data, size_t length) {
+    if (length > HOST_LINK_FRAME_MAX) length = HOST_LINK_FRAME_MAX;
+    uint8_t raw[HOST_HEADER_LEN + HOST_LINK_FRAME_MAX + HOST_CRC_LEN];
+    raw[0] = type;
+    raw[1] = id & 0xFF;
+    raw[2] = id >> 8;
+    memcpy(raw + HOST_HEADER_LEN, data, length);
+    size_t rawLength = HOST_HEADER_LEN + length;
+    uint16_t crc = crc16(raw, rawLength);
+    raw[rawLength++] = crc & 0xFF;
+    raw[rawLength++] = crc >> 8;
+
+    uint8_t wire[sizeof(raw) + sizeof(raw) / 254 + 2];
+    size_t wireLength = cobs_encode(raw, rawLength, wire);
+    wire[wireLength++] = 0;
+    Serial.write(wire, wireLength);
+    framesOut++;
+}
+
+
+
+void HostLink::sendError(uint16_t id, uint8_t code) {
+    sendFrame(HOST_ERROR, id, &code, 1);
+}
+
+
+
+// Длинная строка — несколькими кадрами подряд: хост склеивает их до следующего типа или END
+void HostLink::sendText(uint8_t type, uint16_t id, const String& text) {
+    size_t offset = 0;
+    do {
+        size_t part = min((size_t)HOST_LINK_FRAME_MAX, text.length() - offset);
+        sendFrame(type, id, (const uint8_t*)text.c_str() + offset, part);
+        offset += part;
+    } while (offset < text.length());
+}
+
+
+
+void HostLink::commandReply(const String& line) {
+    MyHost.sendText(HOST_TEXT, MyHost._replyId, line);
+}
+
+
+
+void HostLink::log(const String& line) {
+    sendText(HOST_LOG, 0, line);
+}
+
+
+
+bool HostLink::capture(const uint8_t* record, size_t length) {
+    if (!_active || length > HOST_LINK_FRAME_MAX) return false;
+    size_t raw = HOST_HEADER_LEN + length + HOST_CRC_LEN;
+    if ((size_t)Serial.availableForWrite() < raw + raw / 254 + 2) return false; // COBS + разделитель
+    sendFrame(HOST_CAPTURE, 0, record, length);
+    return true;
+}
+
+
+
+/**
+ * @brief STATUS, все числа LE: [реле][связь][неявный профиль][мс с последнего ACK, 4 (0xFFFFFFFF — не было)]
+ * [RSSI][SNR][RSSI у собеседника][SNR у собеседника] (int8) [своя батарея, мВ, 2][батарея приёмника, мВ, 2]
+ * [обменов, 4][подтверждено, 4][команд в эфир, 4][слито коалесцером, 4]
+ */
+void HostLink::sendStatus(uint16_t id) {
+    uint8_t status[32];
+    size_t n = 0;
+    auto put = [&](uint32_t value, uint8_t bytes) {
+        for (uint8_t i = 0; i < bytes; i++) status[n++] = (value >> (8 * i)) & 0xFF;
+    };
+    put(MyRadio.relayIsOn, 1);
+    put(MyRadio.rxOnline, 1);
+    put(MyRadio.frameMode == FrameMode::IMPLICIT, 1);
+    put(MyRadio.lastAckTime == 0 ? 0xFFFFFFFF : millis() - MyRadio.lastAckTime, 4);
+    put((uint8_t)(int8_t)MyRadio.lastRssi, 1);
+    put((uint8_t)(int8_t)MyRadio.lastSnr, 1);
+    put((uint8_t)(int8_t)MyRadio.peerRssi, 1);
+    put((uint8_t)(int8_t)MyRadio.peerSnr, 1);
+    #ifdef BATTERY_USED
+        put(MyBattery.millivolts(), 2);
+        put(MyBattery.peerMillivolts(), 2);
+    #else
+        put(0, 4);
+    #endif
+    LinkTelemetry& link = MyRadio.telemetry[MyRadio.currentPeer];
+    put(link.exchanges, 4);
+    put(link.acked, 4);
+    put(MyCommands.sentCount, 4);
+    put(MyCommands.supersededCount, 4);
+    sendFrame(HOST_STATUS | HOST_ACK, id, status, n);
+}
+
+
+
+/**
+ * @brief Один итог коалесцера закрывает все ждущие RELAY: совпавшие с целью — её итогом, остальные — "заменён"
+ */
+void HostLink::onCommandResult(const CommandResult& result) {
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < _pendingCount; i++) {
+        const PendingRelay& request = _pending[i];
+        if (request.duringExchange) {
+            _pending[kept++] = request; // Этот запрос уже в новой цели коалесцера
+            continue;
+        }
+        uint8_t reply[5];
+        reply[0] = (request.on == result.targetOn) ? ((result.delivered ? 0x01 : 0) | (result.alreadyInState ? 0x02 : 0)) : 0x04;
+        if (MyRadio.relayIsOn) reply[0] |= 0x08;
+        uint32_t elapsed = millis() - request.atMs;
+        for (uint8_t b = 0; b < 4; b++) reply[1 + b] = (elapsed >> (8 * b)) & 0xFF;
+        if (_active) sendFrame(HOST_RELAY | HOST_ACK, request.id, reply, sizeof(reply));
+    }
+    _pendingCount = kept;
+}
+
+#endif
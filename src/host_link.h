@@ -0,0 +1,118 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+#include "command_engine.h"
+
+/**
+ * ДВОИЧНЫЙ ПРОТОКОЛ ХОСТА ПО USB CDC (стенды и автоматизация)
+ *
+ * Тот же Serial, что и у монитора порта, но вместо текста — кадры с id запроса, которые не надо выискивать
+ * в логе. Кадр в линии: COBS(тип | id запроса, 2 байта LE | данные | CRC-16/CCITT, 2 байта LE) и 0x00.
+ * Нулевой байт бывает только разделителем кадров, поэтому после сбоя приём сам находит начало следующего.
+ *
+ * Вход в режим: хост шлёт 0x00 и кадр HELLO. До этого Serial остаётся текстовой консолью. В двоичном режиме
+ * print_log и ответы консоли уходят кадрами LOG (id 0) — лог не смешивается с ответами. Выход: кадр BYE
+ * или HOST_LINK_IDLE_MS без кадров от хоста (стенд упал — монитор порта снова показывает текст).
+ *
+ *   хост -> узел                            узел -> хост
+ *   0x01 HELLO                              0x81 HELLO [версия][роль T|R|P][id узла][HOST_LINK_FRAME_MAX, 2 байта]
+ *   0x02 RELAY [0|1]        (только пульт)  0x82 RESULT [флаги][мс от запроса до итога, 4 байта]
+ *   0x03 STATUS                             0x83 STATUS (см. sendStatus)
+ *   0x04 COMMAND "<текст>"                  0x84 TEXT "<строка ответа>" ... и 0x85 END [код]
+ *   0x05 BYE                                0x85 END [0]
+ *                                           0xC0 LOG "<строка лога>" (id 0)
+ *                                           0xC1 CAPTURE — кадр из эфира (id 0, роль SNIFFER, см. sniffer.h)
+ *                                           0xEE ERROR [код] — битый или неизвестный запрос
+ *
+ * RELAY идёт через тот же коалесцер, что кнопка и BLE: запросы, пришедшие во время обмена, сливаются, и
+ * на каждый приходит свой RESULT. Флаги: бит 0 — подтверждено, бит 1 — реле уже было в этом состоянии,
+ * бит 2 — запрос заменён более новым (в эфир не уходил), бит 3 — реле сейчас включено.
+ * COMMAND — любая команда консоли (config, stats, trace, radio ...), ответ построчно кадрами TEXT.
+ * Во время обмена с приёмником HELLO, RELAY и STATUS отрабатываются сразу, COMMAND — после обмена.
+ */
+
+#ifdef HOST_LINK_USED
+
+#define HOST_LINK_VERSION 1
+
+class HostLink {
+public:
+    /**
+     * @brief Обработчик COMMAND — тот же разбор, что у текстовой консоли
+     *
+     * @param handler - возвращает false, если команда неизвестна
+     */
+    void setCommandHandler(bool (*handler)(const String& line, void (*reply)(const String& line)));
+
+    /**
+     * @brief Текстовый режим: байт из Serial, прочитанный консолью
+     *
+     * @return true - байт относится к кадру хоста (в строку консоли не идёт)
+     */
+    bool feed(uint8_t c);
+
+    /**
+     * @brief Двоичный режим: чтение кадров из Serial. Вызывать из loop() и из onTick на время обмена
+     *
+     * @param inExchange - идёт обмен с приёмником: COMMAND откладывается до его конца
+     */
+    void poll(bool inExchange = false);
+
+    bool active() const { return _active; }
+
+    /**
+     * @brief Строка лога в канал LOG (вызывает print_log в двоичном режиме)
+     */
+    void log(const String& line);
+
+    /**
+     * @brief Итог отработки цели коалесцером: RESULT на каждый ждущий запрос RELAY
+     */
+    void onCommandResult(const CommandResult& result);
+
+    /**
+     * @brief Запись сниффера кадром CAPTURE. Не ждёт USB: если буфер передачи не вмещает кадр, не шлёт ничего
+     *
+     * @return true - отправлено; false - хоста нет или USB занят (запись остаётся у вызывающего)
+     */
+    bool capture(const uint8_t* record, size_t length);
+
+    uint32_t framesIn = 0;   // Принятые кадры
+    uint32_t framesOut = 0;  // Отправленные кадры
+    uint32_t badFrames = 0;  // Отброшенные: COBS, CRC, длина
+
+private:
+    void handleFrame(uint8_t* frame, size_t length, bool inExchange); // COBS, CRC -> dispatch()
+    void dispatch(uint8_t type, uint16_t id, const uint8_t* data, size_t length, bool inExchange);
+    void sendFrame(uint8_t type, uint16_t id, const uint8_t* data, size_t length);
+    void sendError(uint16_t id, uint8_t code);
+    void sendText(uint8_t type, uint16_t id, const String& text);
+    void sendStatus(uint16_t id);
+    static void commandReply(const String& line);
+
+    bool (*_handler)(const String& line, void (*reply)(const String& line)) = nullptr;
+    bool _active = false;
+    bool _collecting = false;    // Текстовый режим: после 0x00 собираем возможный HELLO
+    uint8_t _rx[HOST_LINK_FRAME_MAX + 8]; // Кадр в линии (COBS) до разделителя
+    size_t _rxLength = 0;
+    bool _rxOverflow = false;
+    bool _deferred = false;                    // COMMAND ждёт конца обмена
+    uint16_t _deferredId = 0;
+    char _deferredLine[HOST_LINK_FRAME_MAX + 1];
+    unsigned long _lastFrameMs = 0;
+    uint16_t _replyId = 0;       // id запроса, на который сейчас отвечает COMMAND
+
+    // Запросы RELAY, ждущие итога обмена
+    struct PendingRelay {
+        uint16_t id;
+        bool on;
+        bool duringExchange; // Пришёл во время обмена — итог будет у следующей цели коалесцера
+        unsigned long atMs;
+    };
+    PendingRelay _pending[HOST_LINK_PENDING];
+    uint8_t _pendingCount = 0;
+};
+
+extern HostLink MyHost;
+
+#endif
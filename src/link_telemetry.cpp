@@ -0,0 +1,144 @@
+#include "link_telemetry.h"
+#include "radiomodem.h"
+
+
+
+/**
+ * @brief Учёт принятого кадра
+ */
+void LinkTelemetry::recordRx(float rssi, float snr, float freqError) {
+    rxFrames++;
+
+    RxSample& s = _rx[_rxHead];
+    s.rssi = (int16_t)rssi;
+    s.snrQ4 = (int16_t)(snr * 4);
+    s.freqError = (int32_t)freqError;
+    _rxHead = (_rxHead + 1) % TELEMETRY_WINDOW;
+    if (_rxFill < TELEMETRY_WINDOW) _rxFill++;
+
+    _rssiQ.add(rssi);
+    _snrQ.add(snr);
+    _freqQ.add(fabsf(freqError));
+}
+
+
+
+/**
+ * @brief Учёт завершённого обмена
+ */
+void LinkTelemetry::recordExchange(bool isAcked, uint32_t rttMs, bool retry) {
+    exchanges++;
+    if (retry) retries++;
+
+    _lossHistory = (_lossHistory << 1) | (isAcked ? 0 : 1);
+    if (_lossFill < 32) _lossFill++;
+
+    if (!isAcked) return;
+    acked++;
+    _rtt[_rttHead] = (uint16_t)min(rttMs, (uint32_t)UINT16_MAX);
+    _rttHead = (_rttHead + 1) % TELEMETRY_WINDOW;
+    if (_rttFill < TELEMETRY_WINDOW) _rttFill++;
+    _rttQ.add((float)rttMs);
+}
+
+
+
+void LinkTelemetry::reset() {
+    rxFrames = exchanges = acked = retries = 0;
+    _rxHead = _rxFill = _rttHead = _rttFill = _lossFill = 0;
+    _lossHistory = 0;
+    _rssiQ.reset();
+    _snrQ.reset();
+    _freqQ.reset();
+    _rttQ.reset();
+}
+
+
+
+float LinkTelemetry::recentLossPercent() const {
+    if (_lossFill == 0) return 0;
+    uint32_t mask = (_lossFill >= 32) ? 0xFFFFFFFFUL : ((1UL << _lossFill) - 1);
+    uint8_t lost = 0;
+    for (uint32_t bits = _lossHistory & mask; bits; bits &= bits - 1) lost++;
+    return 100.0f * lost / _lossFill;
+}
+
+
+
+/**
+ * @brief Подробный отчёт построчно
+ */
+void LinkTelemetry::report(const String& name, void (*reply)(const String& line)) {
+    String head = name + ": rx " + String(rxFrames) + ", exch " + String(exchanges) + ", ack " + String(acked);
+    if (exchanges > 0) head += " (" + String(100.0f * acked / exchanges, 1) + "%)";
+    head += ", retry " + String(retries) + ", loss32 " + String(recentLossPercent(), 1) + "%";
+    reply(head);
+
+    if (_rxFill > 0) {
+        int32_t rMin = INT16_MAX, rMax = INT16_MIN, rSum = 0, sMin = INT16_MAX, sMax = INT16_MIN, sSum = 0, fSum = 0;
+        for (uint8_t i = 0; i < _rxFill; i++) {
+            rMin = min(rMin, (int32_t)_rx[i].rssi); rMax = max(rMax, (int32_t)_rx[i].rssi); rSum += _rx[i].rssi;
+            sMin = min(sMin, (int32_t)_rx[i].snrQ4); sMax = max(sMax, (int32_t)_rx[i].snrQ4); sSum += _rx[i].snrQ4;
+            fSum += _rx[i].freqError;
+        }
+        reply("RSSI dBm win " + String(rMin) + "/" + String(rSum / _rxFill) + "/" + String(rMax) +
+              " P1/P5/P50 " + String(_rssiQ.low.value(), 0) + "/" + String(_rssiQ.mid.value(), 0) + "/" +
+              String(_rssiQ.high.value(), 0));
+        reply("SNR dB win " + String(sMin / 4.0f, 1) + "/" + String(sSum / 4.0f / _rxFill, 1) + "/" + String(sMax / 4.0f, 1) +
+              " P1/P5/P50 " + String(_snrQ.low.value(), 1) + "/" + String(_snrQ.mid.value(), 1) + "/" +
+              String(_snrQ.high.value(), 1));
+        reply("FERR Hz win avg " + String(fSum / _rxFill) + " |P50/P95/P99| " + String(_freqQ.low.value(), 0) + "/" +
+              String(_freqQ.mid.value(), 0) + "/" + String(_freqQ.high.value(), 0));
+    }
+
+    if (_rttFill > 0) {
+        uint32_t tMin = UINT16_MAX, tMax = 0, tSum = 0;
+        for (uint8_t i = 0; i < _rttFill; i++) {
+            tMin = min(tMin, (uint32_t)_rtt[i]); tMax = max(tMax, (uint32_t)_rtt[i]); tSum += _rtt[i];
+        }
+        reply("RTT ms win " + String(tMin) + "/" + String(tSum / _rttFill) + "/" + String(tMax) +
+              " P50/P95/P99 " + String(_rttQ.low.value(), 0) + "/" + String(_rttQ.mid.value(), 0) + "/" +
+              String(_rttQ.high.value(), 0));
+    }
+}
+
+
+
+/**
+ * @brief Короткая строка для экрана: средние RSSI/SNR по окну и последний RTT
+ */
+String LinkTelemetry::summary() {
+    if (_rxFill == 0) return "no link data";
+    int32_t rSum = 0, sSum = 0;
+    for (uint8_t i = 0; i < _rxFill; i++) {
+        rSum += _rx[i].rssi;
+        sSum += _rx[i].snrQ4;
+    }
+    String line = String(rSum / _rxFill) + "dBm " + String(sSum / 4.0f / _rxFill, 1) + "dB";
+    if (_rttFill > 0) line += " " + String(_rtt[(_rttHead + TELEMETRY_WINDOW - 1) % TELEMETRY_WINDOW]) + "ms";
+    return line;
+}
+
+
+
+/**
+ * @brief Команды "stats" / "stats reset"
+ */
+bool telemetry_handle_command(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd.equalsIgnoreCase("stats")) {
+        bool any = false;
+        for (uint8_t peer = 0; peer < TELEMETRY_MAX_PEERS; peer++) {
+            if (!MyRadio.telemetry[peer].hasData()) continue;
+            MyRadio.telemetry[peer].report("PEER " + String(peer), reply);
+            any = true;
+        }
+        if (!any) reply("STATS: no link data");
+        return true;
+    }
+    if (cmd.equalsIgnoreCase("stats reset")) {
+        for (uint8_t peer = 0; peer < TELEMETRY_MAX_PEERS; peer++) MyRadio.telemetry[peer].reset();
+        reply("STATS RESET");
+        return true;
+    }
+    return false;
+}
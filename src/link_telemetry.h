@@ -0,0 +1,94 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+#include "quantile.h"
+
+/**
+ * ТЕЛЕМЕТРИЯ КАЧЕСТВА ЛИНКА (фиксированная память, без выделений)
+ *
+ * На каждого собеседника храним:
+ *  - счётчики за всё время: принятые кадры, обмены, подтверждения, повторы;
+ *  - скользящее окно последних TELEMETRY_WINDOW отсчётов RSSI/SNR/ошибки частоты и RTT (мин/средн/макс);
+ *  - историю потерь последних 32 обменов (битовая маска);
+ *  - потоковые квантили P² за всё время: для RSSI и SNR — нижние (P1/P5/P50, "насколько плохо бывает"),
+ *    для ошибки частоты и RTT — верхние (P50/P95/P99).
+ *
+ * Запрос: команда "stats" (консоль Serial или BLE), "stats reset" — сброс.
+ */
+
+// Три квантиля одной метрики
+struct QuantileSet {
+    P2Quantile low, mid, high;
+    QuantileSet(float pLow, float pMid, float pHigh) : low(pLow), mid(pMid), high(pHigh) {}
+    void add(float x) { low.add(x); mid.add(x); high.add(x); }
+    void reset() { low.reset(); mid.reset(); high.reset(); }
+};
+
+class LinkTelemetry {
+public:
+    /**
+     * @brief Учёт принятого кадра
+     *
+     * @param rssi - RSSI, дБм
+     * @param snr - SNR, дБ
+     * @param freqError - ошибка частоты, Гц
+     */
+    void recordRx(float rssi, float snr, float freqError);
+
+    /**
+     * @brief Учёт завершённого обмена команда -> ACK
+     *
+     * @param acked - подтверждение получено
+     * @param rttMs - время от начала передачи команды до приёма ACK (если acked)
+     * @param retry - это повтор команды, на которую в прошлый раз не ответили
+     */
+    void recordExchange(bool acked, uint32_t rttMs, bool retry);
+
+    void reset();
+    bool hasData() const { return rxFrames > 0 || exchanges > 0; }
+    float recentLossPercent() const; // Доля потерь среди последних 32 обменов
+
+    /**
+     * @brief Подробный отчёт построчно
+     *
+     * @param name - подпись собеседника
+     * @param reply - куда писать строки
+     */
+    void report(const String& name, void (*reply)(const String& line));
+
+    String summary(); // Короткая строка для экрана: средние по окну
+
+    uint32_t rxFrames = 0;  // Принятые кадры
+    uint32_t exchanges = 0; // Обмены команда -> ACK
+    uint32_t acked = 0;     // Из них подтверждённые
+    uint32_t retries = 0;   // Повторы после неудачи
+
+private:
+    // Отсчёт окна. SNR хранится с шагом 0.25 дБ
+    struct RxSample {
+        int16_t rssi;
+        int16_t snrQ4;
+        int32_t freqError;
+    };
+
+    RxSample _rx[TELEMETRY_WINDOW] = {};
+    uint8_t _rxHead = 0, _rxFill = 0;
+    uint16_t _rtt[TELEMETRY_WINDOW] = {};
+    uint8_t _rttHead = 0, _rttFill = 0;
+    uint32_t _lossHistory = 0; // 1 = обмен потерян, младший бит — самый свежий
+    uint8_t _lossFill = 0;
+
+    QuantileSet _rssiQ{0.01f, 0.05f, 0.50f};
+    QuantileSet _snrQ{0.01f, 0.05f, 0.50f};
+    QuantileSet _freqQ{0.50f, 0.95f, 0.99f}; // |ошибка частоты|
+    QuantileSet _rttQ{0.50f, 0.95f, 0.99f};
+};
+
+/**
+ * @brief Разбор команд "stats" / "stats reset" по телеметрии всех собеседников MyRadio
+ *
+ * @param cmd - команда
+ * @param reply - куда писать ответ
+ * @return true - команда обработана
+ */
+bool telemetry_handle_command(const String& cmd, void (*reply)(const String& line));
@@ -0,0 +1,63 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * ВРЕМЯ В ЭФИРЕ LoRa-ПАКЕТА (формула Semtech AN1200.13 / даташит SX127x, SX126x)
+ *
+ * Не зависит от Arduino и RadioLib: используется и в прошивке, и в хостовых инструментах
+ * (симулятор tools/lora_sim). Все функции constexpr — ими можно считать эфирное время
+ * на этапе компиляции прямо из макросов settings.h.
+ *
+ *   Tsym     = 2^SF / BW
+ *   Npayload = 8 + max(ceil((8*PL - 4*SF + 28 + 16*CRC - 20*IH) / (4*(SF - 2*DE))) * CR, 0)
+ *   T        = (Npreamble + 4.25 + Npayload) * Tsym
+ *
+ * PL — длина полезной нагрузки (байт), IH — неявный заголовок (implicit header),
+ * DE — оптимизация для низкой скорости (включается RadioLib автоматически при Tsym >= 16 мс),
+ * CR — знаменатель coding rate 4/CR (5..8, как RADIO_CODING_RATE).
+ */
+
+// Длительность одного символа, мкс
+constexpr float lora_symbol_time_us(uint8_t spreadingFactor, float bandwidthKhz) {
+    return (float)(1UL << spreadingFactor) * 1000.0f / bandwidthKhz;
+}
+
+// Включается ли Low Data Rate Optimization (DE) при данных SF и BW
+constexpr bool lora_low_data_rate_optimize(uint8_t spreadingFactor, float bandwidthKhz) {
+    return lora_symbol_time_us(spreadingFactor, bandwidthKhz) >= 16000.0f;
+}
+
+// Числитель формулы Npayload (может быть отрицательным для коротких пакетов)
+constexpr int32_t lora_payload_bits(size_t length, uint8_t spreadingFactor, bool explicitHeader, bool crc) {
+    return 8 * (int32_t)length - 4 * (int32_t)spreadingFactor + 28 + (crc ? 16 : 0) - (explicitHeader ? 0 : 20);
+}
+
+// Знаменатель формулы Npayload: бит на блок кодирования
+constexpr int32_t lora_bits_per_block(uint8_t spreadingFactor, float bandwidthKhz) {
+    return 4 * ((int32_t)spreadingFactor - (lora_low_data_rate_optimize(spreadingFactor, bandwidthKhz) ? 2 : 0));
+}
+
+// Количество символов после преамбулы (заголовок + данные + CRC)
+constexpr uint32_t lora_payload_symbols(size_t length, uint8_t spreadingFactor, float bandwidthKhz,
+                                        uint8_t codingRate, bool explicitHeader = true, bool crc = true) {
+    return 8 + (lora_payload_bits(length, spreadingFactor, explicitHeader, crc) > 0
+                    ? (uint32_t)((lora_payload_bits(length, spreadingFactor, explicitHeader, crc) +
+                                  lora_bits_per_block(spreadingFactor, bandwidthKhz) - 1) /
+                                 lora_bits_per_block(spreadingFactor, bandwidthKhz)) * codingRate
+                    : 0);
+}
+
+// Полное время в эфире, мкс
+constexpr uint32_t lora_time_on_air_us(size_t length, uint8_t spreadingFactor, float bandwidthKhz,
+                                       uint8_t codingRate, uint16_t preambleLength,
+                                       bool explicitHeader = true, bool crc = true) {
+    return (uint32_t)(((float)preambleLength + 4.25f +
+                       (float)lora_payload_symbols(length, spreadingFactor, bandwidthKhz, codingRate, explicitHeader, crc)) *
+                      lora_symbol_time_us(spreadingFactor, bandwidthKhz));
+}
+
+// Порог демодуляции LoRa по SNR, дБ (SF7: -7.5, каждый следующий SF ещё -2.5)
+constexpr float lora_snr_floor_db(uint8_t spreadingFactor) {
+    return -2.5f * ((float)spreadingFactor - 4.0f);
+}
@@ -5,7 +5,27 @@
 #include "output_display.h" // Функции для рисования текста на маленьком экране
 #include "logger.h"         // Помогает выводить красивые сообщения в монитор порта на компьютере
 #include "rgb_led.h"        // Управляет цветом маленького светодиода на самой плате
+#include "feedback.h"       // Узоры светодиода и вибромотора по таймеру, без delay()
 #include "ble_manager.h" // <--- ДОБАВЛЕНО BLE: Подключаем наш менеджер BLE
+#include "command_engine.h" // Коалесцер команд: кнопка и BLE задают цель, в эфир уходит только последняя
+#include "command_table.h"  // Табличный разбор команд BLE без выделения памяти
+#include "frame_auth.h"     // Подпись радиокадров и защита от повторов
+#include "channel_plan.h"   // План каналов, табло шума и согласованный переход на лучший канал
+#include "repeater.h"       // Роль ретранслятора: пересылка кадров с TTL и отсевом дублей
+#include "sniffer.h"        // Роль сниффера: все кадры эфира с меткой времени — на ПК
+#include "tdma.h"           // Слоты по маяку приёмника для нескольких пультов
+#include "group_command.h"  // Команда группе приёмников одним кадром, ответы по окнам
+#include "relay_timer.h"    // Расписания реле: приёмник сам отсчитывает время по аппаратному таймеру
+#include "fast_boot.h"      // Быстрый старт приёмника: реле — как было, раньше экрана, лога и радио
+#include "site_config.h"    // Настройки узла во flash: одна запись с версией и CRC, читается при включении
+#include "battery.h"        // Напряжение батареи: АЦП с DMA в фоне, приёмник сообщает его в каждом ответе
+#include "reconciler.h"     // Фоновая сверка состояния реле и живости приёмника
+#include "trace.h"          // Трассировка задержек: от нажатия кнопки до щелчка реле
+#include "serial_console.h" // Текстовые команды из монитора порта
+#include "host_link.h"      // Двоичный протокол для стендов по USB: запросы с id, лог отдельным каналом
+#include "soak_test.h"      // Нагрузочный тест линка прямо с пульта
+#include "health.h"         // Куча, стеки задач и длительность итераций loop()
+#include "protocol.h"         // Таблица сообщений TX <-> RX: разбор кадров и проверки при сборке
 
 /** * РАЗБОР РАБОТЫ С ЭНЕРГОНЕЗАВИСИМОЙ ПАМЯТЬЮ (NVS и EEPROM):
  * * Нам нужно, чтобы после выключения батарейки пульт помнил, включен свет или нет.
@@ -23,11 +43,11 @@
  * 3. EEPROM.write(0, значение) — Мы записываем данные в ячейку. Но внимание: данные еще НЕ сохранились в чип!
  * 4. EEPROM.commit() — САМЫЙ ВАЖНЫЙ ШАГ. Только после этой команды данные физически переносятся из 
  * оперативной памяти в постоянную. Если забыть commit, после перезагрузки всё пропадет.
+ * * Состояние реле пульта, пароль BLE и параметры узла теперь хранятся одной записью с CRC
+ * (см. site_config.h): её читают один раз при включении, а ключи "relay-app" переносятся в неё сами.
  */
 
-#if defined(ARDUINO_ARCH_ESP32)
-  #include <Preferences.h>  // Библиотека для работы с NVS-памятью ESP32
-#elif defined(ARDUINO_ARCH_ESP8266)
+#if defined(ARDUINO_ARCH_ESP8266)
   #include <EEPROM.h>       // Стандартный способ сохранения данных для старых плат
 #endif
 
@@ -39,15 +59,10 @@
   // чтобы он не "болтался в воздухе", true — кнопка замыкается на землю.
   Button2 btn(BUTTON_PIN, INPUT_PULLUP, true);
   
-  #if defined(ARDUINO_ARCH_ESP32)
-    Preferences pref; // Создаем инструмент для работы с памятью
-  #endif
-
   // Переменные для безопасности и таймера
   unsigned long bleEnableTime = 0;           // Время включения BLE
   const unsigned long BLE_TIMEOUT = 600000; // 10 минут в миллисекундах
   bool isBleAuthenticated = false;          // Флаг успешного входа
-  String currentBlePass = "";               // Текущий пароль в ОЗУ
 
 
   // Прототипы функций (просто оглавление для компилятора)
@@ -55,13 +70,57 @@
   void handleDoubleClick(Button2& b); 
   void handleLongPress(Button2& b); // <--- ДОБАВЛЕНО BLE: прототип длинного нажатия
   // Прототип новой функции обработки команд (обычная функция, не внутри класса!)
-  void processBleCommand(String cmd);
+  void processBleCommand(char* line);
+  void onCommandResult(const CommandResult& result); // Итог отработки цели коалесцером
+  void radioTick();                                   // Фоновая задача на время ожидания ACK
+  void onReconcileStatusChange();                     // Фоновая сверка заметила изменение связи или реле
   
   bool sendCommandAndWaitAck(String cmd);
   void updateDisplayStatus(String status, String msg); 
-#else
+  String displayedStatus, displayedMsg; // Что сейчас на экране — для перерисовки с новым напряжением батареи
+#elif defined(RECEIVER)
   // --- НАСТРОЙКИ ДЛЯ ПРИЕМНИКА (ИСПОЛНИТЕЛЯ) ---
   String RADIO_NAME = "RX";
+#elif defined(REPEATER)
+  // --- НАСТРОЙКИ ДЛЯ РЕТРАНСЛЯТОРА ---
+  String RADIO_NAME = "RP";
+#else
+  // --- НАСТРОЙКИ ДЛЯ СНИФФЕРА ---
+  String RADIO_NAME = "SN";
+#endif
+
+void processConsoleCommand(const String& line); // Команды из монитора порта (все роли)
+bool runTextCommand(const String& line, void (*reply)(const String& line)); // Те же команды для консоли и хоста
+
+
+
+#ifdef RECEIVER
+/**
+ * Переключение реле приёмника. Общее для одиночной и групповой команды. Во flash ничего не пишет:
+ * копия в RTC-памяти (writeRelay) уже переживает сброс, а запись NVS длится до сотен мс — её делает
+ * saveRelay() после ответа, чтобы не съедать ожидание пульта
+ */
+void setRelay(bool on) {
+    #ifdef RELAY_TIMER_USED
+      MyRelayTimer.cancel(); // Ручная команда главнее расписания
+    #endif
+    MyFastBoot.writeRelay(on);
+    TRACE(RELAY_WRITE, on ? 1 : 0);
+    MyRadio.relayIsOn = on;
+}
+
+/**
+ * Сохранение состояния после ответа пульту на команду реле, группы или расписания
+ */
+void saveRelay(bool on) {
+    #ifdef AUTH_USED
+      MyAuth.commitReplayWindow(); // Повтор этой команды после перезагрузки не пройдёт
+    #endif
+    #ifdef RELAY_TIMER_USED
+      if (MyRelayTimer.save()) return; // Команда отменила расписание — оно уходит во flash вместе с реле
+    #endif
+    MyFastBoot.saveRelay(on); // Во flash: после сбоя питания реле вернётся таким (на ESP8266 — и счётчик подписи, одной записью)
+}
 #endif
 
 
@@ -74,12 +133,20 @@
 void updateDisplayStatus(String status, String msg) {
     // Формируем строчку связи: [OK] если связь есть, или [LOST] если нет
     String conn = MyRadio.rxOnline ? " [RELAY ONLINE]" : " [RELAY NOT ONLINE]";
-    display_print_status(status + conn, msg);
+    // Ниже — качество линка: средние RSSI/SNR по окну и последний RTT, и напряжение батарей
+    String lines = msg + "\n" + MyRadio.telemetry[MyRadio.currentPeer].summary();
+    #ifdef BATTERY_USED
+      String battery = MyBattery.summary();
+      if (battery.length() > 0) lines += "\n" + battery;
+    #endif
+    display_print_status(status + conn, lines);
+    displayedStatus = status;
+    displayedMsg = msg;
     
     // Меняем цвет встроенного RGB светодиода:
-    if (!MyRadio.rxOnline) WriteColorPixel(COLORS_RGB_LED::blue);       // СИНИЙ — нет связи (или еще не проверяли)
-    else if (MyRadio.relayIsOn) WriteColorPixel(COLORS_RGB_LED::green); // ЗЕЛЕНЫЙ — всё включено, связь есть
-    else WriteColorPixel(COLORS_RGB_LED::red);                 // КРАСНЫЙ — всё выключено, связь есть
+    if (!MyRadio.rxOnline) MyFeedback.setColor(COLORS_RGB_LED::blue);       // СИНИЙ — нет связи (или еще не проверяли)
+    else if (MyRadio.relayIsOn) MyFeedback.setColor(COLORS_RGB_LED::green); // ЗЕЛЕНЫЙ — всё включено, связь есть
+    else MyFeedback.setColor(COLORS_RGB_LED::red);                 // КРАСНЫЙ — всё выключено, связь есть
 }
 #endif
 
@@ -92,53 +159,77 @@ void updateDisplayStatus(String status, String msg) {
 
 
 
-void setup()
-{
-  // Включаем передачу данных в компьютер для отладки
-  #ifdef DEBUG_PRINT
-    Serial.begin(115200);
+/**
+ * Периферия, которой приёмник может подождать: АЦП батареи, светодиод с вибромотором, экран.
+ * Остальные роли запускают её до радио, приёмник — после радио и объявления пульту (см. fast_boot.h)
+ */
+void startPeripherals() {
+  #if defined(RECEIVER) && defined(DEBUG_PRINT)
+    Serial.begin(115200); // Лог приёмника — тоже после радио: остальные роли включают Serial первым делом
+  #endif
+  #ifdef BATTERY_USED
+    MyBattery.begin(); // Выборки АЦП идут в фоне с этого момента (поправка делителя — из настроек)
   #endif
 
-  // 1. Делаем короткий "вжжжух" вибромоторчиком при включении (если он есть в схеме)
+  // 1. Делаем короткий "вжжжух" вибромоторчиком при включении (если он есть в схеме) — выключит его таймер, setup() идёт дальше
+  MyFeedback.begin();
   #if defined(TRANSMITTER) && defined(VIBRO_USED)
-    pinMode(VIBRO_PIN, OUTPUT);
-    digitalWrite(VIBRO_PIN, HIGH); delay(100); digitalWrite(VIBRO_PIN, LOW);
+    MyFeedback.play(FEEDBACK_BOOT);
   #endif
 
-  // 2. Настраиваем ножку (пин), которая дергает реле
-  #if defined(RECEIVER) && defined(RELAY_USED)
-    pinMode(RELAY_PIN, OUTPUT);
-    #if defined(ARDUINO_ARCH_ESP32)
-      digitalWrite(RELAY_PIN, LOW); // Для ESP32 по умолчанию ставим 0
-    #elif defined(ARDUINO_ARCH_ESP8266)
-      digitalWrite(RELAY_PIN, HIGH); // Для ESP8266 обычно реле выключено при 1 (HIGH)
-    #endif
-  #endif
-  
   // 3. Запускаем экран и красим светодиод в синий (значит "Гружусь...")
   #if defined(ARDUINO_ARCH_ESP32)
-    WriteColorPixel(COLORS_RGB_LED::blue); 
+    MyFeedback.setColor(COLORS_RGB_LED::blue);
     #ifdef USE_DISPLAY
       display_init(); // Запуск экрана
     #endif
   #endif
+}
+
+
+
+void setup()
+{
+  #ifdef RECEIVER
+    // 0. Реле — как было до сброса, раньше всего остального: лог, экран и радио подождут (см. fast_boot.h)
+    MyFastBoot.restoreRelay();
+  #elif defined(DEBUG_PRINT)
+    // Включаем передачу данных в компьютер для отладки
+    Serial.begin(115200);
+  #endif
+  MyHealth.setWarningHandler([](const String& warning) { print_log("[HEALTH]", warning); });
+  #ifdef HOST_LINK_USED
+    MyHost.setCommandHandler(runTextCommand); // COMMAND хоста разбирается так же, как строка консоли
+  #endif
+  MyConfig.begin(); // Настройки узла (радио, таймауты, id, пароль BLE) — одним чтением flash, до радио
+  #ifdef RECEIVER
+    #ifdef RELAY_TIMER_USED
+      MyRelayTimer.begin(); // Расписание, прерванное перезагрузкой, продолжается с сохранённой точки — тоже до радио
+    #endif
+  #else
+    startPeripherals(); // 1.–3. Батарея, вибромотор и светодиод, экран
+  #endif
 
   // 4. Проверяем радиомодуль. Если он не подключен — мигаем КРАСНЫМ и дальше не идем
   if (!MyRadio.beginRadio()) {
-    while (1) {
-      WriteColorPixel(COLORS_RGB_LED::red);
-      display_print_status("ERROR", "Radio Fail");
-      delay(500);
-    }
+    #ifdef RECEIVER
+      startPeripherals(); // Экран и светодиод приёмника ещё не запущены — ошибку показать нечем
+    #endif
+    MyFeedback.play(FEEDBACK_RADIO_FAIL, FeedbackPriority::ALERT); // Мигает таймер
+    display_print_status("ERROR", "Radio Fail");
+    while (1) delay(1000);
   }
+  #ifdef CHANNEL_PLAN_USED
+    MyChannels.begin(); // Шум на всех каналах плана и настройка на CHANNEL_HOME
+  #endif
+  #ifdef TDMA_USED
+    MyTdma.begin(); // Приёмник: первый маяк; пульт: ждём маяк (до него передаём без слотов)
+  #endif
 
   // 5. Особые действия для ПУЛЬТА при включении
   #ifdef TRANSMITTER
-    #if defined(ARDUINO_ARCH_ESP32)
-      // Вспоминаем, что было до выключения питания
-      pref.begin("relay-app", false); 
-      MyRadio.relayIsOn = pref.getBool("state", false); 
-    #endif
+    // Вспоминаем, что было до выключения питания (настройки уже в ОЗУ, пароль BLE сверяется с ними же)
+    MyRadio.relayIsOn = MyConfig.data.relayOn;
 
     // Если в настройках включен опрос статуса — спрашиваем у приемника, как он там
     #ifdef RELAY_GET_STATUS
@@ -146,6 +237,9 @@ void setup()
       MyRadio.rxOnline = MyRadio.sendCommandAndWaitAck(CMD_GET_STATUS, [](){ btn.loop(); }); // Функция сама вернет true или false
     #endif
     
+    MyCommands.setResultHandler(onCommandResult);
+    MyReconciler.setStatusChangeHandler(onReconcileStatusChange);
+
     // --- НАСТРОЙКИ КНОПКИ ---
     btn.setClickHandler(handleClick);         
     btn.setDoubleClickHandler(handleDoubleClick);
@@ -161,13 +255,26 @@ void setup()
 
   // 6. Особые действия для ПРИЕМНИКА при включении
   #ifdef RECEIVER
-    #if defined(ARDUINO_ARCH_ESP8266)
-      EEPROM.begin(4); // Готовим память
-      MyRadio.relayIsOn = (EEPROM.read(0) == 1); // Читаем состояние
-      digitalWrite(RELAY_PIN, MyRadio.relayIsOn ? LOW : HIGH); // Сразу ставим реле как было
-    #endif
+    MyFastBoot.announce(); // Радио готово: пульт узнаёт о включении и о реле сразу, без опроса
+    startPeripherals();    // Теперь можно и лог, и экран
+    MyFastBoot.report();
     print_log("[SYSTEM] ", "RX Ready...");
   #endif
+
+  // 7. Ретранслятору готовить нечего: ни реле, ни кнопки — сразу слушаем эфир
+  #ifdef REPEATER
+    display_print_status("REPEATER", "TTL " + String(REPEATER_HOP_LIMIT));
+    print_log("[SYSTEM] ", "Repeater Ready...");
+  #endif
+
+  // 8. Сниффер тоже только слушает: радио уже в приёме, кадры пойдут на ПК
+  #ifdef SNIFFER
+    display_print_status("SNIFFER", String(MyRadio.config.frequency, 3) + " MHz SF" + String(MyRadio.config.spreadingFactor));
+    print_log("[SYSTEM] ", "Sniffer Ready...");
+    #ifdef FRAME_IMPLICIT_USED
+      print_log("[SNIFF]", "WARNING: FRAME_IMPLICIT_USED - implicit frames are not heard, capture stops after the first acknowledged exchange");
+    #endif
+  #endif
 }
 
 
@@ -177,6 +284,12 @@ void setup()
 
 void loop()
 {
+  MyHealth.loopTick();                 // Длительность итерации, периодический снимок кучи и стеков
+  console_poll(processConsoleCommand); // Команды из монитора порта (trace, soak ...)
+  #ifdef BATTERY_USED
+    MyBattery.service(); // Готовое среднее АЦП -> фильтр и порог низкого заряда (сам АЦП loop() не опрашивает)
+  #endif
+
   #ifdef TRANSMITTER
     btn.loop();   // 1. Слушаем кнопку
     
@@ -187,15 +300,58 @@ void loop()
         if (millis() - bleEnableTime > BLE_TIMEOUT) {
             // Тут нужна функция деактивации BLE (могу помочь написать)
             print_log("[SYSTEM]", "BLE Автовыключение (тайм-аут)");
-            MyBLE.stop(); // <--- Теперь вызываем правильный стоп
+            MyBLE.stop(); // Режим ожидания: стек остаётся в памяти, повторное включение — без переинициализации
+            MyFeedback.stop(FeedbackOutput::LED); // Светодиод больше не "дышит"
             // Опционально: можно вывести инфо на экран, что BLE выключен
             updateDisplayStatus(RADIO_NAME, "BLE OFF (Idle)");
         }
 
-        if (MyBLE.hasCommand()) {
-            processBleCommand(MyBLE.getCommand());
+        char line[BLE_COMMAND_MAX_LEN];
+        if (MyBLE.takeCommand(line, sizeof(line))) {
+            processBleCommand(line);
         }
     }
+
+    #ifdef TDMA_USED
+      MyTdma.service(); // Маяки между обменами: часы и карта слотов (и объявления приёмника)
+    #else
+      // Кадры между обменами: приёмник объявил о включении — сверяем реле с целью сразу, не дожидаясь опроса
+      if (!MyRadio.isProcessing && MyRadio.isDataReady()) {
+          String frame;
+          if (MyRadio.receive(frame) == RADIOLIB_ERR_NONE) MyReconciler.onFrame(frame); // Остальное — запоздавшие ответы
+          MyRadio.startListening();
+      }
+    #endif
+
+    // 2. Отрабатываем последнюю цель (если есть). Пока ждём ACK, кнопка и BLE продолжают опрашиваться
+    MyCommands.service(radioTick);
+
+    #ifdef CHANNEL_PLAN_USED
+      MyChannels.service(radioTick); // Пересканирование плана и переходы (только когда эфир свободен)
+    #endif
+
+    #ifdef GROUP_USED
+      MyGroups.service(radioTick); // Команда группе приёмников ("group <n> on|off")
+    #endif
+    #ifdef RELAY_TIMER_USED
+      MyRelayTimer.service(radioTick); // Расписание для приёмника ("timer ...")
+    #endif
+
+    #ifdef BATTERY_USED
+      // Экран перерисовываем, только когда напряжение (своё или из ответа приёмника) заметно изменилось
+      static uint16_t shownOwnMv = 0, shownPeerMv = 0;
+      if (abs((int)MyBattery.millivolts() - shownOwnMv) >= 100 || abs((int)MyBattery.peerMillivolts() - shownPeerMv) >= 100) {
+          shownOwnMv = MyBattery.millivolts();
+          shownPeerMv = MyBattery.peerMillivolts();
+          updateDisplayStatus(displayedStatus, displayedMsg);
+      }
+      MyReconciler.setLowBattery(MyBattery.low() || MyBattery.peerLow()); // Севшую батарею (любую) бережём: опросы реже
+    #endif
+
+    // 3. Если в эфире давно тихо — сверяем состояние приёмника (интервал адаптивный, см. reconciler.h).
+    // Во время нагрузочного теста эфир и так занят подтверждаемыми обменами
+    if (MySoak.isActive()) MySoak.service(radioTick);
+    else MyReconciler.service(radioTick);
   #endif
 
   #ifdef RECEIVER
@@ -204,39 +360,115 @@ void loop()
       String rxMessage;
       // Если данные получены без помех:
       if (MyRadio.receive(rxMessage) == RADIOLIB_ERR_NONE) { 
+        MyRadio.stripLinkMetrics(rxMessage); // Отрезаем "|RSSI,SNR", если пульт их прислал
+        #ifdef CHANNEL_PLAN_USED
+          uint8_t channel;
+          MyChannels.recordRx();
+        #endif
+        #ifdef TDMA_USED
+          MyTdma.recordRx(MyAuth.lastSenderId()); // Пульт слышен — закрепляем за ним слот
+        #endif
         
-        if (rxMessage == CMD_RELAY_ON) {
-          digitalWrite(RELAY_PIN, LOW); 
-          MyRadio.relayIsOn = true; // Добавил MyRadio.
-          
-          #if defined(ARDUINO_ARCH_ESP8266)
-            EEPROM.write(0, 1); 
-            EEPROM.commit(); // Запомнили в память
-          #endif
-          
-          delay(TIMEOUT_WAITING_TX); // Ждем чуть-чуть, пока пульт перейдет в режим приема подтверждения
-          MyRadio.send(ACK_FROM_RECEIVER_IF_ON); // Отвечаем "Я всё сделал!"
-          display_print_status("RELAY", "STATUS: ON");
-          
-        } else if (rxMessage == CMD_RELAY_OFF) {
-            digitalWrite(RELAY_PIN, HIGH);
-            MyRadio.relayIsOn = false; // ВЫКЛ
-          #if defined(ARDUINO_ARCH_ESP8266)
-            EEPROM.write(0, 0); EEPROM.commit();
-          #endif
-          delay(TIMEOUT_WAITING_TX);
-          MyRadio.send(ACK_FROM_RECEIVER_IF_OFF); // Отвечаем "Я всё сделал!"
-          display_print_status("RELAY", "STATUS: OFF");
-          
-        } else if (rxMessage == CMD_GET_STATUS) {
+        #ifdef GROUP_USED
+          bool groupOn;
+          uint32_t groupDelayMs;
+        #endif
+        
+        switch (protocol_decode(rxMessage, MsgDir::TO_RX)) {
+        case MsgId::RELAY_ON:
+          setRelay(true);
+          delay(MyConfig.data.waitTxMs); // Ждем чуть-чуть, пока пульт перейдет в режим приема подтверждения
+          TRACE(ACK_TX, 1);
+          MyRadio.send(MyRadio.withLinkMetrics(ACK_FROM_RECEIVER_IF_ON)); // Отвечаем "Я всё сделал!" и как мы слышим пульт
+          saveRelay(true); // Пульт уже слушает ответ — теперь можно и во flash
+          display_print_status("RELAY", "STATUS: ON\n" + MyRadio.telemetry[MyRadio.currentPeer].summary());
+          break;
+
+        case MsgId::RELAY_OFF:
+          setRelay(false);
+          delay(MyConfig.data.waitTxMs);
+          TRACE(ACK_TX, 0);
+          MyRadio.send(MyRadio.withLinkMetrics(ACK_FROM_RECEIVER_IF_OFF)); // Отвечаем "Я всё сделал!"
+          saveRelay(false);
+          display_print_status("RELAY", "STATUS: OFF\n" + MyRadio.telemetry[MyRadio.currentPeer].summary());
+          break;
+
+        #ifdef RELAY_GET_STATUS
+        case MsgId::GET_STATUS:
           // Если нас просто спросили "Ты как?", отвечаем текущим состоянием ножки реле
           delay(50);
-          MyRadio.send((digitalRead(RELAY_PIN) == LOW) ? ACK_RELAY_IS_ON : ACK_RELAY_IS_OFF);
+          TRACE(ACK_TX, 2);
+          MyRadio.send(MyRadio.withLinkMetrics((digitalRead(RELAY_PIN) == LOW) ? ACK_RELAY_IS_ON : ACK_RELAY_IS_OFF));
+          break;
+        #endif
+
+        #ifdef CHANNEL_PLAN_USED
+        case MsgId::CHANNEL:
+          if (!MyChannels.parseSwitch(rxMessage, channel)) break;
+          // Отвечаем на старом канале и только потом переходим — пульт перейдёт, получив ответ
+          delay(50);
+          MyRadio.send(MyRadio.withLinkMetrics(ACK_CHANNEL));
+          MyChannels.switchTo(channel);
+          #ifdef AUTH_USED
+            MyAuth.commitReplayWindow(true); // Записанный "CH_<n>" после перезагрузки не уведёт приёмник с канала
+          #endif
+          break;
+        #endif
+
+        #ifdef RELAY_TIMER_USED
+        case MsgId::TIMER:
+          if (!MyRelayTimer.accept(rxMessage)) break;
+          delay(MyConfig.data.waitTxMs);
+          MyRadio.send(MyRadio.withLinkMetrics(MyRelayTimer.ackToken())); // Расписание принято: реле сейчас и сколько осталось
+          saveRelay(MyRadio.relayIsOn); // Во flash — только после ответа: счётчик подписи, расписание и реле
+          display_print_status("RELAY", String(MyRelayTimer.active() ? "TIMER RUNNING" : "TIMER OFF") + "\n" +
+                                        MyRadio.telemetry[MyRadio.currentPeer].summary());
+          break;
+        #endif
+
+        #ifdef GROUP_USED
+        case MsgId::GROUP: {
+          if (!MyGroups.accept(rxMessage, groupOn, groupDelayMs)) break;
+          // Окно считается от приёма: переключение не должно сдвигать ответ в окно соседа
+          unsigned long replyAt = millis() + groupDelayMs;
+          setRelay(groupOn);
+          while ((long)(millis() - replyAt) < 0) delay(1);
+          TRACE(ACK_TX, groupOn ? 1 : 0);
+          MyRadio.send(ACK_GROUP);
+          saveRelay(groupOn);
+          display_print_status("RELAY", String(groupOn ? "STATUS: ON" : "STATUS: OFF") + "\nGROUP CMD " + String(MyGroups.commands));
+          break;
+        }
+        #endif
+
+        default:
+          break; // Не команда приёмнику (ответ другого приёмника, чужой кадр) — молчим
         }
         
         MyRadio.startListening(); // Снова переходим в режим ожидания команд
       }
     }
+
+    #ifdef CHANNEL_PLAN_USED
+      MyChannels.service(); // Шум своего канала: помеха — уходим на следующий; долгая тишина — ищем пульт
+    #endif
+    #ifdef TDMA_USED
+      MyTdma.service(); // Маяк в начале суперкадра
+    #endif
+    #ifdef RELAY_TIMER_USED
+      MyRelayTimer.service(); // Ход расписания во flash (само реле переключает таймер)
+    #endif
+  #endif
+
+  #ifdef REPEATER
+    MyRepeater.service(); // Приём, отсев дублей и пересылка по очереди со случайной паузой
+    #ifdef CHANNEL_PLAN_USED
+      MyChannels.service(); // Как приёмник: помеха на канале и обход при долгой тишине
+    #endif
+  #endif
+
+  #ifdef SNIFFER
+    MySniffer.service(); // Кадр из чипа — в очередь, очередь — в USB, сколько примет буфер
   #endif
 }
 
@@ -260,35 +492,34 @@ void loop()
 
 
 #ifdef TRANSMITTER
+/**
+ * Фоновая задача на время ожидания ACK: кнопка и BLE не должны "засыпать" на 400 мс.
+ * Обработчики лишь обновляют цель в коалесцере, в эфир из них ничего не уходит.
+ */
+void radioTick() {
+    btn.loop();
+    #ifdef HOST_LINK_USED
+      MyHost.poll(true); // RELAY и STATUS стенда — сразу, команды консоли — после обмена
+    #endif
+    char line[BLE_COMMAND_MAX_LEN];
+    if (MyBLE.isActive() && MyBLE.takeCommand(line, sizeof(line))) {
+        processBleCommand(line);
+    }
+}
+
+
+
+
+
 /**
  * Обработка одного клика:
- * Мы хотим включить реле.
+ * Мы хотим включить реле. Команда не отправляется сразу — мы только задаём цель,
+ * даже если сейчас идёт обмен. Коалесцер отправит её, когда эфир освободится.
  */
 void handleClick(Button2& b) {
-    if (MyRadio.isProcessing) return; // Если уже идет какой-то обмен данными — игнорируем лишние нажатия
-
-    
-    
-    // Условие: если мы ДУМАЕМ, что реле выключено, ИЛИ если у нас нет связи (надо проверить)
-    if (!MyRadio.relayIsOn || !MyRadio.rxOnline) {
-        print_log("[ACTION]", "Sending ON command...");
-        // Пытаемся отправить команду и ждем ответ
-        if (MyRadio.sendCommandAndWaitAck(CMD_RELAY_ON, [](){ btn.loop(); })) {
-            MyRadio.relayIsOn = true; // Если ответ пришел (true) — значит реле точно ВКЛ
-            #if defined(ARDUINO_ARCH_ESP32)
-              pref.putBool("state", true); // Сохраняем успех в память
-            #endif
-            updateDisplayStatus(RADIO_NAME, "RX ON");
-            print_log("[handleTap] :", "RX is ON");
-        } else {
-            // Если за 2 секунды никто не ответил
-            updateDisplayStatus("[ERR]", "RX NOT ANSWER");
-            print_log("[handleTap] :", "No answer from RX");
-        }
-    } else {
-      updateDisplayStatus("[INFO]", "RX ALREADY ON");
-      print_log("[handleTap] :", "RX already ON");
-    }
+    TRACE(BUTTON_EVENT, 1);
+    print_log("[handleTap] :", "Target ON");
+    MyCommands.requestRelay(true, CommandSource::BUTTON);
 }
 
 
@@ -300,25 +531,55 @@ void handleClick(Button2& b) {
  * Мы хотим выключить реле.
  */
 void handleDoubleClick(Button2& b) {
-    if (MyRadio.isProcessing) return;
-
-    if (MyRadio.relayIsOn || !MyRadio.rxOnline) {
-        print_log("[ACTION]", "Sending OFF command...");
-        if (MyRadio.sendCommandAndWaitAck(CMD_RELAY_OFF, [](){ btn.loop(); })) {
-            MyRadio.relayIsOn = false; // Успешно выключили
-            #if defined(ARDUINO_ARCH_ESP32)
-              pref.putBool("state", false); // Сохранили в память
-            #endif
-            updateDisplayStatus(RADIO_NAME, "RX OFF");
-            print_log("[handleDoubleClick] :", "RX is OFF");
-        } else {
-            updateDisplayStatus("[ERR]", "RX NOT ANSWER");
-            print_log("[handleDoubleClick] :", "No answer from RX");
-        }
+    TRACE(BUTTON_EVENT, 0);
+    print_log("[handleDoubleClick] :", "Target OFF");
+    MyCommands.requestRelay(false, CommandSource::BUTTON);
+}
+
+
+
+
+
+/**
+ * Фоновая сверка заметила, что связь пропала/появилась или реле переключили не мы
+ */
+void onReconcileStatusChange() {
+    if (!MyRadio.rxOnline) updateDisplayStatus("[ERR]", "RX NOT ANSWER");
+    else updateDisplayStatus(RADIO_NAME, MyRadio.relayIsOn ? "RX ON" : "RX OFF");
+}
+
+
+
+
+
+/**
+ * Итог отработки цели коалесцером: экран, светодиод, память и ответ на телефон.
+ * Вызывается один раз на цель, сколько бы раз её ни перезапрашивали во время обмена.
+ */
+void onCommandResult(const CommandResult& result) {
+    if (result.alreadyInState) {
+        updateDisplayStatus("[INFO]", result.targetOn ? "RX ALREADY ON" : "RX ALREADY OFF");
+        print_log("[COMMAND] :", result.targetOn ? "RX already ON" : "RX already OFF");
+    } else if (result.delivered) {
+        MyRadio.relayIsOn = result.targetOn; // Ответ пришёл — значит реле точно в нужном состоянии
+        MyConfig.data.relayOn = result.targetOn;
+        MyConfig.save(); // Сохраняем успех в память
+        updateDisplayStatus(RADIO_NAME, result.targetOn ? "RX ON" : "RX OFF");
+        print_log("[COMMAND] :", result.targetOn ? "RX is ON" : "RX is OFF");
     } else {
-        updateDisplayStatus("[INFO]", "RX ALREADY OFF");
-        print_log("[handleDoubleClick] :", "RX already OFF");
+        // Если за TIMEOUT_WAITING_RX никто не ответил
+        updateDisplayStatus("[ERR]", "RX NOT ANSWER");
+        print_log("[COMMAND] :", "No answer from RX");
+    }
+
+    // Телефон ждёт ответ, только если команда пришла от него (исправление расхождения — SYSTEM — молча)
+    if (result.sources & (1 << (uint8_t)CommandSource::BLE)) {
+        if (result.delivered) MyBLE.send(result.targetOn ? "RELAY ON OK\n" : "RELAY OFF OK\n");
+        else MyBLE.send("RADIO ERR\n");
     }
+    #ifdef HOST_LINK_USED
+      if (result.sources & (1 << (uint8_t)CommandSource::HOST)) MyHost.onCommandResult(result); // RESULT на каждый запрос стенда
+    #endif
 }
 
 
@@ -342,8 +603,9 @@ void handleLongPress(Button2& b) {
         print_log("[SYSTEM]", "Bluetooth ON");
         
         #ifdef VIBRO_USED
-        digitalWrite(VIBRO_PIN, HIGH); delay(200); digitalWrite(VIBRO_PIN, LOW);
+        MyFeedback.play(FEEDBACK_BLE_ON);
         #endif
+        MyFeedback.play(FEEDBACK_BLE_ACTIVE); // Пока BLE включён, цвет состояния "дышит"
     }
 }
 
@@ -354,76 +616,193 @@ void handleLongPress(Button2& b) {
 
 
 
+// Ответ на телефон построчно — для модулей, которые пишут отчёты через writeLine (trace, soak)
+void bleReply(const String& line) {
+    MyBLE.send(line + "\n");
+}
+
+
+
+
+
 // 2. Обработка команд С ТЕЛЕФОНА (вызывается из loop)
 /**
- * ОБРАБОТКА КОМАНД BLE
- * Реализует: авторизацию, смену пароля, запрос статуса и управление реле.
+ * Обработчики команд BLE. Аргументы уже разобраны в CommandArgs (argv[0] — имя команды),
+ * их количество проверено по таблице BLE_COMMANDS.
  */
-void processBleCommand(String cmd) {
-    cmd.trim();
-    if (cmd.length() == 0) return;
-
-    // 1. Загружаем пароль из памяти
-    String savedPass = pref.getString("ble_pass", "123456");
-
-    // 2. БЛОК АВТОРИЗАЦИИ
-    if (!isBleAuthenticated) {
-        if (cmd.startsWith("pass ") && cmd.length() > 5) {
-            String inputPass = cmd.substring(5);
-            inputPass.trim();
-            if (inputPass == savedPass) {
-                isBleAuthenticated = true;
-                MyBLE.send("AUTH OK\n");
-            } else {
-                MyBLE.send("WRONG PASS\n");
-            }
-        } else {
-            MyBLE.send("Login: pass [password]\n");
-        }
-        return; 
+void bleCmdPass(const CommandArgs& args) {
+    if (strcmp(args.argv[1], MyConfig.data.blePass) == 0) {
+        isBleAuthenticated = true;
+        MyBLE.send("AUTH OK\n");
+    } else {
+        MyBLE.send("WRONG PASS\n");
     }
+}
 
-    // 3. БЛОК КОМАНД
-    if (cmd.startsWith("setpass ")) {
-        int firstSpace = cmd.indexOf(' ');
-        int secondSpace = cmd.indexOf(' ', firstSpace + 1);
-
-        // Проверяем, что есть оба пробела и после второго что-то есть
-        if (firstSpace != -1 && secondSpace != -1 && cmd.length() > secondSpace + 1) {
-            String oldP = cmd.substring(firstSpace + 1, secondSpace);
-            String newP = cmd.substring(secondSpace + 1);
-            oldP.trim(); newP.trim();
-
-            if (oldP == savedPass && newP.length() >= 4) {
-                pref.putString("ble_pass", newP);
-                MyBLE.send("PASS CHANGED\n");
-            } else {
-                MyBLE.send("SET ERROR\n");
-            }
-        } else {
-            MyBLE.send("Usage: setpass [old] [new]\n");
-        }
-    }
-    // ... остальное (on/off/status) у тебя в коде написано верно
-    else if (cmd.equalsIgnoreCase("on")) {
-        if (MyRadio.sendCommandAndWaitAck(CMD_RELAY_ON, [](){ btn.loop(); })) {
-            MyRadio.relayIsOn = true;
-            pref.putBool("state", true);
-            MyBLE.send("RELAY ON OK\n");
-        } else { MyBLE.send("RADIO ERR\n"); }
+void bleCmdSetPass(const CommandArgs& args) {
+    const char* newPass = args.argv[2];
+    size_t newLength = strlen(newPass);
+
+    if (strcmp(args.argv[1], MyConfig.data.blePass) == 0 && newLength >= 4 && newLength <= BLE_PASS_MAX_LEN) {
+        memcpy(MyConfig.data.blePass, newPass, newLength + 1);
+        MyConfig.save();
+        MyBLE.send("PASS CHANGED\n");
+    } else {
+        MyBLE.send("SET ERROR\n");
     }
-    else if (cmd.equalsIgnoreCase("off")) {
-        if (MyRadio.sendCommandAndWaitAck(CMD_RELAY_OFF, [](){ btn.loop(); })) {
-            MyRadio.relayIsOn = false;
-            pref.putBool("state", false);
-            MyBLE.send("RELAY OFF OK\n");
-        } else { MyBLE.send("RADIO ERR\n"); }
+}
+
+// on/off только задают цель, ответ придёт из onCommandResult() после обмена
+void bleCmdOn(const CommandArgs& args) {
+    MyCommands.requestRelay(true, CommandSource::BLE);
+}
+
+void bleCmdOff(const CommandArgs& args) {
+    MyCommands.requestRelay(false, CommandSource::BLE);
+}
+
+void bleCmdStatus(const CommandArgs& args) {
+    MyBLE.send(MyRadio.relayIsOn ? "ST: ON\n" : "ST: OFF\n");
+}
+
+// Диагностика (trace, stats, health, frames, display, soak, auth, channels, tdma, group, timer, radio, config, battery, ble) разбирает аргументы сама — ей отдаём строку целиком.
+// Эти команды редкие и всё равно строят отчёты через String, поэтому склейка здесь не мешает
+void bleCmdDiagnostics(const CommandArgs& args) {
+    char buffer[BLE_COMMAND_MAX_LEN];
+    size_t length = 0;
+    for (uint8_t i = 0; i < args.count; i++) {
+        size_t part = strlen(args.argv[i]);
+        if (length + part + 1 >= sizeof(buffer)) break;
+        if (i > 0) buffer[length++] = ' ';
+        memcpy(buffer + length, args.argv[i], part);
+        length += part;
     }
-    else if (cmd.equalsIgnoreCase("status") || cmd == "?") {
-        MyBLE.send("ST: " + String(MyRadio.relayIsOn ? "ON" : "OFF") + "\n");
+    buffer[length] = '\0';
+
+    runTextCommand(String(buffer), bleReply); // Та же цепочка, что у консоли и хоста: новый модуль подключается в одном месте
+}
+
+/**
+ * ТАБЛИЦА КОМАНД BLE. Строго по алфавиту (без учёта регистра) — поиск двоичный, порядок проверяет static_assert.
+ * Новая команда — новая строка таблицы; стоимость разбора от числа команд почти не зависит.
+ */
+constexpr CommandSpec BLE_COMMANDS[] = {
+    // имя       подсказка                          мин макс  вход   обработчик
+    {"?",       nullptr,                            0,  0,    true,  bleCmdStatus},
+    {"auth",    nullptr,                            0,  1,    true,  bleCmdDiagnostics},
+    {"battery", nullptr,                            0,  2,    true,  bleCmdDiagnostics},
+    {"ble",     nullptr,                            0,  0,    true,  bleCmdDiagnostics},
+    {"channels", nullptr,                           0,  1,    true,  bleCmdDiagnostics},
+    {"config",  nullptr,                            0,  3,    true,  bleCmdDiagnostics},
+    {"display", nullptr,                            0,  1,    true,  bleCmdDiagnostics},
+    {"frames",  nullptr,                            0,  0,    true,  bleCmdDiagnostics},
+    {"group",   nullptr,                            0,  2,    true,  bleCmdDiagnostics},
+    {"groups",  nullptr,                            0,  0,    true,  bleCmdDiagnostics},
+    {"health",  nullptr,                            0,  0,    true,  bleCmdDiagnostics},
+    {"off",     nullptr,                            0,  0,    true,  bleCmdOff},
+    {"on",      nullptr,                            0,  0,    true,  bleCmdOn},
+    {"pass",    "Login: pass [password]\n",         1,  1,    false, bleCmdPass},
+    {"protocol", nullptr,                           0,  0,    true,  bleCmdDiagnostics},
+    {"radio",   nullptr,                            0,  4,    true,  bleCmdDiagnostics},
+    {"setpass", "Usage: setpass [old] [new]\n",     2,  2,    true,  bleCmdSetPass},
+    {"soak",    nullptr,                            0,  4,    true,  bleCmdDiagnostics},
+    {"stats",   nullptr,                            0,  1,    true,  bleCmdDiagnostics},
+    {"status",  nullptr,                            0,  0,    true,  bleCmdStatus},
+    {"tdma",    nullptr,                            0,  0,    true,  bleCmdDiagnostics},
+    {"timer",   nullptr,                            0,  5,    true,  bleCmdDiagnostics},
+    {"trace",   nullptr,                            0,  1,    true,  bleCmdDiagnostics},
+};
+static_assert(cmd_table_sorted(BLE_COMMANDS, sizeof(BLE_COMMANDS) / sizeof(BLE_COMMANDS[0])),
+              "BLE_COMMANDS must be sorted by name");
+
+/**
+ * ОБРАБОТКА КОМАНД BLE
+ * Реализует: авторизацию, смену пароля, запрос статуса и управление реле.
+ * Строка разбирается на месте, без выделения памяти; пароль сверяется с копией в ОЗУ.
+ */
+void processBleCommand(char* line) {
+    TRACE(BLE_COMMAND, 0);
+
+    const CommandSpec* spec = nullptr;
+    DispatchResult result = cmd_dispatch(line, BLE_COMMANDS, sizeof(BLE_COMMANDS) / sizeof(BLE_COMMANDS[0]),
+                                         isBleAuthenticated, &spec);
+
+    switch (result) {
+        case DispatchResult::OK:
+        case DispatchResult::EMPTY:
+            break;
+        case DispatchResult::BAD_ARGS:
+            if (spec->usage != nullptr) MyBLE.send(spec->usage);
+            break;
+        case DispatchResult::UNKNOWN:
+        case DispatchResult::NOT_AUTHORIZED:
+            // До входа на всё, кроме pass, отвечаем подсказкой; после входа неизвестные команды молча игнорируем
+            if (!isBleAuthenticated) MyBLE.send("Login: pass [password]\n");
+            break;
     }
 }
 
 
 
-#endif
\ No newline at end of file
+#endif
+
+
+
+
+
+/**
+ * Команды из монитора порта. Авторизации нет: доступ к USB и так означает физический доступ к плате.
+ */
+void processConsoleCommand(const String& line) {
+    if (!runTextCommand(line, console_reply)) console_reply("Unknown command: " + line);
+}
+
+
+
+/**
+ * Разбор текстовой команды по модулям. Общий для консоли и кадров COMMAND хоста (host_link.h)
+ *
+ * @return false - команда неизвестна
+ */
+bool runTextCommand(const String& line, void (*reply)(const String& line)) {
+    if (trace_handle_command(line, reply)) return true;
+    if (telemetry_handle_command(line, reply)) return true;
+    if (health_handle_command(line, reply)) return true;
+    if (frame_handle_command(line, reply)) return true;
+    if (protocol_handle_command(line, reply)) return true;
+    if (display_handle_command(line, reply)) return true;
+    if (MyRadio.handleCommand(line, reply)) return true;
+    if (MyConfig.handleCommand(line, reply)) return true;
+    #ifdef AUTH_USED
+      if (MyAuth.handleCommand(line, reply)) return true;
+    #endif
+    #ifdef CHANNEL_PLAN_USED
+      if (MyChannels.handleCommand(line, reply)) return true;
+    #endif
+    #ifdef TDMA_USED
+      if (MyTdma.handleCommand(line, reply)) return true;
+    #endif
+    #ifdef GROUP_USED
+      if (MyGroups.handleCommand(line, reply)) return true;
+    #endif
+    #ifdef RELAY_TIMER_USED
+      if (MyRelayTimer.handleCommand(line, reply)) return true;
+    #endif
+    #ifdef BATTERY_USED
+      if (MyBattery.handleCommand(line, reply)) return true;
+    #endif
+    #ifdef TRANSMITTER
+      if (MySoak.handleCommand(line, reply)) return true;
+      if (MyBLE.handleCommand(line, reply)) return true;
+    #endif
+    #ifdef RECEIVER
+      if (MyFastBoot.handleCommand(line, reply)) return true;
+    #endif
+    #ifdef REPEATER
+      if (MyRepeater.handleCommand(line, reply)) return true;
+    #endif
+    #ifdef SNIFFER
+      if (MySniffer.handleCommand(line, reply)) return true;
+    #endif
+    return false;
+}
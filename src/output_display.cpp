@@ -3,14 +3,91 @@
 
 // --- Секция для OLED SSD1306 ---
 #ifdef USE_OLED_SSD1306
-  #include <Adafruit_GFX.h>
-  #include <Adafruit_SSD1306.h>
   #include <Wire.h>
+  #include "status_renderer.h"
 
-  Adafruit_SSD1306 display(128, 64, &Wire, -1);
+  #define SSD1306_ADDRESS 0x3C
+  #define SSD1306_CHUNK 31 // Байт данных за одну передачу I2C: буфер Wire на 32 байта минус байт управления
+
+  static StatusRenderer renderer; // Одна страница 128 байт вместо кадра 1 КБ
 
   bool isDisplayReady = false; // Глобальный флаг правильности инициализации дисплея
 
+  // Статистика отрисовки (команда "display")
+  static uint32_t frames = 0;
+  static uint32_t pagesSent = 0;
+  static uint32_t pagesSkipped = 0;
+  static uint32_t lastFrameUs = 0;
+  static uint32_t maxFrameUs = 0;
+  static String lastText; // Что на экране: "display bench" вернёт его на место
+
+  // Инициализация контроллера: внутренний преобразователь, горизонтальная адресация, развёртка как у Adafruit_SSD1306
+  static const uint8_t INIT_SEQUENCE[] = {
+      0xAE,       // Экран выключен
+      0xD5, 0x80, // Частота тактирования
+      0xA8, 0x3F, // 64 строки
+      0xD3, 0x00, // Без смещения
+      0x40,       // Начальная строка 0
+      0x8D, 0x14, // Преобразователь напряжения включён
+      0x20, 0x00, // Горизонтальная адресация
+      0xA1,       // Зеркально по X
+      0xC8,       // Зеркально по Y
+      0xDA, 0x12, // Раскладка выводов COM
+      0x81, 0xCF, // Контраст
+      0xD9, 0xF1, // Предзаряд
+      0xDB, 0x40, // Уровень VCOMH
+      0xA4,       // Изображение из памяти
+      0xA6,       // Без инверсии
+      0x2E,       // Прокрутка выключена
+      0xAF,       // Экран включён
+  };
+
+
+
+  static void sendCommands(const uint8_t* commands, uint8_t count)
+  {
+    Wire.beginTransmission(SSD1306_ADDRESS);
+    Wire.write((uint8_t)0x00); // Дальше — команды
+    Wire.write(commands, count);
+    Wire.endTransmission();
+  }
+
+
+
+  /**
+   * @brief Отправка одной страницы (128x8) в память дисплея
+   */
+  static void sendPage(uint8_t page, const uint8_t* data)
+  {
+    const uint8_t window[] = {0x21, 0, STATUS_WIDTH - 1, 0x22, page, page};
+    sendCommands(window, sizeof(window));
+    for (uint8_t offset = 0; offset < STATUS_WIDTH; offset += SSD1306_CHUNK) {
+      uint8_t length = min(SSD1306_CHUNK, STATUS_WIDTH - offset);
+      Wire.beginTransmission(SSD1306_ADDRESS);
+      Wire.write((uint8_t)0x40); // Дальше — данные
+      Wire.write(data + offset, length);
+      Wire.endTransmission();
+    }
+  }
+
+
+
+  /**
+   * @brief Отрисовка текста: в I2C уходят только изменившиеся страницы
+   */
+  static void drawText(int x, int y, const String& text)
+  {
+    unsigned long started = micros();
+    uint8_t sent = renderer.render(x, y, text.c_str(), sendPage);
+    lastFrameUs = micros() - started;
+    if (lastFrameUs > maxFrameUs) maxFrameUs = lastFrameUs;
+    frames++;
+    pagesSent += sent;
+    pagesSkipped += STATUS_PAGES - sent;
+  }
+
+
+
   /**
    * @brief Инициализация дисплея OLED
    * 
@@ -18,7 +95,9 @@
   void display_init()
   {
     Wire.begin(OLED_SDA, OLED_SCL);
-    if(!display.begin(SSD1306_SWITCHCAPVCC, 0x3C))
+    Wire.setClock(400000); // SSD1306 держит fast mode: кадр в 2.5 раза быстрее, чем на 100 кГц
+    Wire.beginTransmission(SSD1306_ADDRESS);
+    if(Wire.endTransmission() != 0)
     {
       isDisplayReady = false; // Экран не найден
       #ifdef DEBUG_PRINT
@@ -35,39 +114,57 @@
         Serial.println(OLED_SCL);
       #endif
     }
-    display.clearDisplay();
-    display.setTextSize(1);
-    display.setTextColor(SSD1306_WHITE);
-    display.display();
+    sendCommands(INIT_SEQUENCE, sizeof(INIT_SEQUENCE));
+    renderer.invalidate(); // Память дисплея после включения не определена — первый кадр целиком
+    display_clear();
   }
 
   void display_print_status(String status, String message)
   {
-    if (!isDisplayReady) return; // Если экрана нет, ничего не делаем и не тратим время
-    display.clearDisplay();
-    display.setCursor(0,5);
-    display.println(status);
-    display.println("---------");
-    display.println(message);
-    display.display();
+    display_print_status(0, 5, status, message);
   }
 
   void display_print_status(int x, int y, String status, String message)
   {
     if (!isDisplayReady) return; // Если экрана нет, ничего не делаем и не тратим время
-    display.clearDisplay();
-    display.setCursor(x, y);
-    display.println(status);
-    display.println("---------");
-    display.println(message);
-    display.display();
+    lastText = status + "\n---------\n" + message;
+    drawText(x, y, lastText);
   }
 
   void display_clear()
   {
     if (!isDisplayReady) return; // Если экрана нет, ничего не делаем и не тратим время
-    display.clearDisplay();
-    display.display();
+    lastText = "";
+    drawText(0, 0, lastText);
+  }
+
+  bool display_handle_command(const String& cmd, void (*reply)(const String& line))
+  {
+    if (cmd != "display" && cmd != "display bench") return false;
+    if (!isDisplayReady) {
+      reply("DISPLAY not found");
+      return true;
+    }
+    if (cmd == "display bench") {
+      // Типичная смена экрана: меняется одна строка (счётчик), остальное то же
+      const uint8_t runs = 50;
+      String saved = lastText;
+      uint32_t sentBefore = pagesSent;
+      unsigned long started = micros();
+      for (uint8_t i = 0; i < runs; i++) drawText(0, 5, "BENCH\n---------\nframe " + String(i));
+      unsigned long elapsed = micros() - started;
+      uint32_t sent = pagesSent - sentBefore;
+      lastText = saved;
+      drawText(0, 5, lastText);
+      reply("DISPLAY bench " + String(runs) + " frames: " + String(elapsed / runs) + " us/frame, " +
+            String((float)sent / runs, 2) + " pages/frame (full frame " + String(STATUS_PAGES) + ")");
+      return true;
+    }
+    reply("DISPLAY frames " + String(frames) + ", pages sent " + String(pagesSent) + ", unchanged skipped " +
+          String(pagesSkipped) + ", last frame " + String(lastFrameUs) + " us, worst " + String(maxFrameUs) + " us");
+    reply("glyph cache hits " + String(renderer.glyphHits) + ", misses " + String(renderer.glyphMisses) +
+          ", renderer RAM " + String(sizeof(StatusRenderer)) + " bytes");
+    return true;
   }
 
 // --- Секция для TFT (пример на будущее) ---
@@ -77,10 +174,12 @@
   void display_init() { /* код для TFT */ }
   void display_print_status(String s, String m) { /* код для TFT */ }
   void display_clear() { /* код для TFT */ }
+  bool display_handle_command(const String& cmd, void (*reply)(const String& line)) { return false; }
 
 // --- Если дисплей не выбран ---
 #else
   void display_init() {}
   void display_print_status(String s, String m) {}
   void display_clear() {}
-#endif
\ No newline at end of file
+  bool display_handle_command(const String& cmd, void (*reply)(const String& line)) { return false; }
+#endif
@@ -31,3 +31,12 @@ void display_print_status(int x, int y, String status, String message);
  * 
  */
 void display_clear();
+
+/**
+ * @brief Разбор команд "display" (статистика отрисовки) и "display bench" (замер смены экрана)
+ *
+ * @param cmd - команда
+ * @param reply - куда писать ответ
+ * @return true - команда обработана
+ */
+bool display_handle_command(const String& cmd, void (*reply)(const String& line));
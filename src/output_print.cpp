@@ -1,4 +1,5 @@
 #include <output_print.h>
+#include "host_link.h"
 
 
 /**
@@ -8,6 +9,12 @@
  * @param message - строка сообщения
  */
 void print_log(String status, String message) {
+    #ifdef HOST_LINK_USED
+        if (MyHost.active()) {
+            MyHost.log("[" + RADIO_NAME + "] " + status + " : " + message); // Лог — своим каналом, не вперемешку с ответами
+            return;
+        }
+    #endif
     #ifdef DEBUG_PRINT
         // Формат: [TX] SUCCESS : Сообщение
         Serial.print("[");
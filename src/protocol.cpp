@@ -0,0 +1,162 @@
+#include "protocol.h"
+#include "radiomodem.h"
+#include "site_config.h"
+
+
+
+// --- Проверки таблицы при сборке ---
+
+constexpr bool protocol_ids_ordered(size_t i = 0) {
+    return i >= PROTOCOL_COUNT || (PROTOCOL[i].id == (MsgId)i && protocol_ids_ordered(i + 1));
+}
+
+constexpr bool protocol_streq(const char* a, const char* b) {
+    return *a == *b && (*a == 0 || protocol_streq(a + 1, b + 1));
+}
+
+// Кадр строки j можно принять за сообщение строки i
+constexpr bool protocol_clash(size_t i, size_t j) {
+    return i != j && PROTOCOL[i].dir == PROTOCOL[j].dir &&
+           (protocol_streq(PROTOCOL[i].token, PROTOCOL[j].token) ||
+            (PROTOCOL[i].fieldsMax > 0 && protocol_starts_with(PROTOCOL[j].token, PROTOCOL[i].token)));
+}
+
+constexpr bool protocol_row_unambiguous(size_t i, size_t j = 0) {
+    return j >= PROTOCOL_COUNT || (!protocol_clash(i, j) && protocol_row_unambiguous(i, j + 1));
+}
+
+constexpr bool protocol_tokens_unambiguous(size_t i = 0) {
+    return i >= PROTOCOL_COUNT || (protocol_row_unambiguous(i) && protocol_tokens_unambiguous(i + 1));
+}
+
+// Ответы команды i, начиная со строки j, идут от приёмника к пульту
+constexpr bool protocol_replies_to_tx(size_t i, size_t j = 0) {
+    return j >= PROTOCOL_COUNT ||
+           (((PROTOCOL[i].replies & (1UL << j)) == 0 || PROTOCOL[j].dir == MsgDir::TO_TX) && protocol_replies_to_tx(i, j + 1));
+}
+
+constexpr bool protocol_replies_valid(size_t i = 0) {
+    return i >= PROTOCOL_COUNT ||
+           ((PROTOCOL[i].replies >> PROTOCOL_COUNT) == 0 && (PROTOCOL[i].replies == 0 || PROTOCOL[i].dir == MsgDir::TO_RX) &&
+            protocol_replies_to_tx(i) && protocol_replies_valid(i + 1));
+}
+
+constexpr bool protocol_code_unique(size_t i, size_t j = 0) {
+    return j >= PROTOCOL_COUNT || ((i == j || PROTOCOL[j].code != PROTOCOL[i].code) && protocol_code_unique(i, j + 1));
+}
+
+// Код с полями (номер в младших 4 битах) — только 0x20 или 0x30, коды без полей диапазон 0x2_..0x3_ не занимают
+constexpr bool protocol_code_with_fields(uint8_t code) {
+    return (code & 0xE0) == PROTOCOL_CODE_CHANNEL;
+}
+
+constexpr bool protocol_codes_valid(size_t i = 0) {
+    return i >= PROTOCOL_COUNT ||
+           ((PROTOCOL[i].code == 0 ||
+             (PROTOCOL[i].code < PROTOCOL_CODE_METRICS && protocol_code_unique(i) &&
+              protocol_code_with_fields(PROTOCOL[i].code) == (PROTOCOL[i].fieldsMax > 0) &&
+              (PROTOCOL[i].fieldsMax == 0 || (PROTOCOL[i].code & 0x0F) == 0))) &&
+            protocol_codes_valid(i + 1));
+}
+
+constexpr bool protocol_frames_fit(size_t i = 0) {
+    return i >= PROTOCOL_COUNT || (protocol_frame_max(PROTOCOL[i]) <= PROTOCOL_FRAME_MAX && protocol_frames_fit(i + 1));
+}
+
+constexpr bool protocol_replies_in_time(size_t i = 0) {
+    return i >= PROTOCOL_COUNT ||
+           ((PROTOCOL[i].replies == 0 || protocol_reply_ms(i) < TIMEOUT_WAITING_RX) && protocol_replies_in_time(i + 1));
+}
+
+static_assert(PROTOCOL_COUNT == (size_t)MsgId::COUNT, "PROTOCOL must have one row per MsgId");
+static_assert(protocol_ids_ordered(), "PROTOCOL rows must follow MsgId order");
+static_assert(PROTOCOL_COUNT <= 32, "MsgSpec::replies mask is 32 bits");
+static_assert(protocol_tokens_unambiguous(), "Two messages of one direction share a token or a token with fields is a prefix of another");
+static_assert(protocol_replies_valid(), "Only TX->RX commands may expect replies, and only RX->TX messages may be replies");
+static_assert(protocol_codes_valid(), "Implicit profile codes must be unique, below the metrics flag, 0x20/0x30 only and always for messages with fields");
+static_assert(protocol_frames_fit(), "The longest frame of a message does not fit into a LoRa frame");
+static_assert(protocol_replies_in_time(), "TIMEOUT_WAITING_RX is too short for TIMEOUT_WAITING_TX and the longest reply at default radio settings");
+
+#ifdef TDMA_USED
+// Слот рассчитан на обмен включения/выключения: защитный интервал, команда, пауза приёмника и ответ.
+// Запрос статуса с метриками и расписание длиннее — их хвост заходит в защитный интервал следующего слота
+constexpr uint32_t protocol_slot_ms(MsgId id) {
+    return TDMA_GUARD_MS + protocol_airtime_us(protocol_frame_max(protocol_spec(id))) / 1000 + protocol_reply_ms((size_t)id);
+}
+
+static_assert(protocol_slot_ms(MsgId::RELAY_ON) <= TDMA_SLOT_MS && protocol_slot_ms(MsgId::RELAY_OFF) <= TDMA_SLOT_MS,
+              "TDMA_SLOT_MS is too short for a relay command and its reply at default radio settings");
+#endif
+
+
+
+MsgId protocol_decode(const String& frame, MsgDir dir) {
+    return protocol_decode(frame.c_str(), frame.length(), dir);
+}
+
+
+
+MsgId protocol_decode(const char* text, size_t length, MsgDir dir) {
+    const char* sep = (const char*)memchr(text, LINK_METRICS_SEPARATOR, length);
+    if (sep != nullptr) length = sep - text;
+
+    for (const MsgSpec& m : PROTOCOL) {
+        if (m.dir != dir) continue;
+        size_t tokenLength = strlen(m.token);
+        bool fits = m.fieldsMax == 0 ? length == tokenLength : length > tokenLength && length <= tokenLength + m.fieldsMax;
+        if (fits && memcmp(text, m.token, tokenLength) == 0) return m.id; // Токены однозначны — совпадение одно
+    }
+    return MsgId::NONE;
+}
+
+
+
+String protocol_encode(MsgId id, const String& fields) {
+    const MsgSpec& m = protocol_spec(id);
+    return String(m.token) + (fields.length() > m.fieldsMax ? fields.substring(0, m.fieldsMax) : fields);
+}
+
+
+
+uint32_t protocol_time_on_air(const MsgSpec& m, size_t length) {
+    return MyRadio.getTimeOnAir(length, m.dir == MsgDir::TO_RX ? FrameClass::COMMAND : FrameClass::REPLY, m.code != 0);
+}
+
+
+
+uint32_t protocol_reply_time_us(MsgId command) {
+    uint32_t longest = 0;
+    for (const MsgSpec& m : PROTOCOL) {
+        if (!protocol_expects(command, m.id)) continue;
+        uint32_t us = protocol_time_on_air(m, protocol_text_max(m));
+        if (us > longest) longest = us;
+    }
+    return longest;
+}
+
+
+
+// Команда "protocol": сообщения, самые длинные кадры и время в эфире при текущих настройках радио
+bool protocol_handle_command(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd != "protocol") return false;
+
+    reply("PROTOCOL " + String((unsigned)PROTOCOL_COUNT) + " messages, trailer " + String((unsigned)protocol_trailer()) +
+          " B, SF" + String(MyRadio.config.spreadingFactor) + " BW" + String(MyRadio.config.bandwidth, 0));
+    for (const MsgSpec& m : PROTOCOL) {
+        size_t length = protocol_frame_max(m);
+        String line = String(m.dir == MsgDir::TO_RX ? "> " : "< ") + m.token + (m.fieldsMax ? "<" + String(m.fieldsMax) + ">" : "") +
+                      " max " + String((unsigned)length) + " B " + String(protocol_time_on_air(m, protocol_text_max(m)) / 1000.0f, 1) + " ms";
+        if (m.code) line += " code 0x" + String(m.code, HEX);
+        if (m.replies) {
+            // Ответ приёмника позже ожидания пульта — обмен не состоится при любом качестве линка
+            uint32_t replyMs = MyConfig.data.waitTxMs + protocol_reply_time_us(m.id) / 1000 + 1;
+            line += ", reply in " + String(replyMs) + " ms" + (replyMs >= MyConfig.data.waitRxMs ? " > waitrx!" : "");
+            #ifdef TDMA_USED
+                uint32_t slotMs = TDMA_GUARD_MS + protocol_time_on_air(m, protocol_text_max(m)) / 1000 + replyMs;
+                if (slotMs > TDMA_SLOT_MS) line += " > slot by " + String(slotMs - TDMA_SLOT_MS) + " ms";
+            #endif
+        }
+        reply(line);
+    }
+    return true;
+}
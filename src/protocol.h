@@ -0,0 +1,244 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+#include "lora_airtime.h"
+
+/**
+ * ОПИСАНИЕ ПРОТОКОЛА TX <-> RX В ОДНОМ МЕСТЕ (проверяется при сборке)
+ *
+ * Токены по-прежнему задаются в settings.h, но что они значат, знает только таблица PROTOCOL: кто шлёт
+ * сообщение, сколько байт полей идёт за токеном, может ли оно нести метрики линка, что ответ говорит о реле,
+ * какой однобайтовый код у него в неявном профиле (frame_profile.h) и какие ответы ждёт команда.
+ * Порядок строк таблицы совпадает с MsgId: поиск по id — индекс, без сравнения строк.
+ *
+ * Разбор принятого кадра — один проход protocol_decode() по таблице, дальше switch по MsgId (приёмник в loop(),
+ * пульт в sendCommandAndWaitAck(): ответ, которого эта команда не ждёт, не засчитывается).
+ *
+ * При сборке проверяются (static_assert):
+ *  - строки таблицы идут в порядке MsgId и покрывают все id;
+ *  - токены одного направления однозначны: ни один не совпадает с другим и не начинает другой, если за ним идут поля;
+ *  - ответы, которых ждёт команда, идут от приёмника к пульту, а команды — от пульта к приёмнику;
+ *  - коды неявного профиля не повторяются и не задевают флаг метрик и диапазон кодов перехода на канал;
+ *  - самый длинный кадр каждого сообщения (поля, метрики, подпись, TTL) влезает в LoRa-кадр;
+ *  - самый длинный ответ успевает за TIMEOUT_WAITING_RX с параметрами радио по умолчанию, с TDMA обмен
+ *    включения/выключения влезает в слот (остальные показывает команда "protocol").
+ * Рассогласование протокола (новый токен, длинное поле, медленный SF) — ошибка сборки, а не тихий тайм-аут в эфире.
+ */
+
+#define PROTOCOL_FRAME_MAX 255         // Самый длинный LoRa-кадр (RADIO_MAX_FRAME_LENGTH)
+#define PROTOCOL_METRICS_MAX 10        // "|-128,-128" — как нас слышали
+#ifdef BATTERY_USED
+  #define PROTOCOL_BATTERY_MAX 6       // ",65535" — напряжение в ответе приёмника
+#else
+  #define PROTOCOL_BATTERY_MAX 0
+#endif
+#define PROTOCOL_CODE_CHANNEL 0x20     // Код неявного профиля для "CH_<n>": номер канала в младших 4 битах
+#define PROTOCOL_CODE_BOOT 0x30        // Код неявного профиля для "RX_UP_<реле>": реле в младших 4 битах
+#define PROTOCOL_CODE_METRICS 0x80     // Старший бит кода неявного профиля: за токеном шли метрики
+
+// Сообщения протокола. Порядок — как строки PROTOCOL
+enum class MsgId : uint8_t {
+    RELAY_ON,
+    RELAY_OFF,
+    ACK_ON,
+    ACK_OFF,
+#ifdef RELAY_GET_STATUS
+    GET_STATUS,
+    IS_ON,
+    IS_OFF,
+#endif
+    RX_BOOT,
+#ifdef CHANNEL_PLAN_USED
+    CHANNEL,
+    CHANNEL_ACK,
+#endif
+#ifdef RELAY_TIMER_USED
+    TIMER,
+    TIMER_ACK,
+#endif
+#ifdef GROUP_USED
+    GROUP,
+    GROUP_ACK,
+#endif
+#ifdef TDMA_USED
+    BEACON,
+#endif
+    COUNT,
+    NONE = COUNT, // Кадр не из протокола
+};
+
+enum class MsgDir : uint8_t {
+    TO_RX = 0, // Пульт -> приёмник
+    TO_TX = 1, // Приёмник -> пульт (и маяк — всем пультам)
+};
+
+struct MsgSpec {
+    MsgId id;
+    const char* token;
+    MsgDir dir;
+    uint8_t fieldsMax; // Байт полей за токеном ("CH_<n>", "TMR_OK_<реле>_<мс>"); 0 — токен целиком
+    bool metrics;      // Несёт "|RSSI,SNR" (ответ приёмника — и ",мВ"): от пульта — только запрос статуса
+    int8_t relay;      // Ответ: реле включено (1), выключено (0), из полей или не о реле (-1)
+    uint8_t code;      // Код неявного профиля; 0 — только явные кадры
+    uint32_t replies;  // Команда: маска MsgId ответов, которые её подтверждают
+};
+
+#define MSG_BIT(id) (1UL << (uint8_t)MsgId::id)
+
+constexpr MsgSpec PROTOCOL[] = {
+    {MsgId::RELAY_ON,    CMD_RELAY_ON,             MsgDir::TO_RX, 0,  false, -1, 0x01, MSG_BIT(ACK_ON)},
+    {MsgId::RELAY_OFF,   CMD_RELAY_OFF,            MsgDir::TO_RX, 0,  false, -1, 0x02, MSG_BIT(ACK_OFF)},
+    {MsgId::ACK_ON,      ACK_FROM_RECEIVER_IF_ON,  MsgDir::TO_TX, 0,  true,  1,  0x11, 0},
+    {MsgId::ACK_OFF,     ACK_FROM_RECEIVER_IF_OFF, MsgDir::TO_TX, 0,  true,  0,  0x12, 0},
+#ifdef RELAY_GET_STATUS
+    {MsgId::GET_STATUS,  CMD_GET_STATUS,           MsgDir::TO_RX, 0,  true,  -1, 0x03, MSG_BIT(IS_ON) | MSG_BIT(IS_OFF)},
+    {MsgId::IS_ON,       ACK_RELAY_IS_ON,          MsgDir::TO_TX, 0,  true,  1,  0x13, 0},
+    {MsgId::IS_OFF,      ACK_RELAY_IS_OFF,         MsgDir::TO_TX, 0,  true,  0,  0x14, 0},
+#endif
+    {MsgId::RX_BOOT,     ACK_RX_BOOT,              MsgDir::TO_TX, 1,  false, -1, PROTOCOL_CODE_BOOT, 0}, // "RX_UP_<1|0>"
+#ifdef CHANNEL_PLAN_USED
+    {MsgId::CHANNEL,     CMD_CHANNEL,              MsgDir::TO_RX, 2,  false, -1, PROTOCOL_CODE_CHANNEL, MSG_BIT(CHANNEL_ACK)},
+    {MsgId::CHANNEL_ACK, ACK_CHANNEL,              MsgDir::TO_TX, 0,  true,  -1, 0x15, 0},
+#endif
+#ifdef RELAY_TIMER_USED
+    {MsgId::TIMER,       CMD_TIMER,                MsgDir::TO_RX, 40, false, -1, 0,    MSG_BIT(TIMER_ACK)}, // "P_<пауза>_<вкл>_<выкл>_<раз>"
+    {MsgId::TIMER_ACK,   ACK_TIMER,                MsgDir::TO_TX, 12, true,  -1, 0,    0},    // "<реле>_<мс>"
+#endif
+#ifdef GROUP_USED
+    {MsgId::GROUP,       CMD_GROUP,                MsgDir::TO_RX, 16, false, -1, 0,    0},    // Ответы ждёт GroupCommander по окнам
+    {MsgId::GROUP_ACK,   ACK_GROUP,                MsgDir::TO_TX, 0,  false, -1, 0,    0},
+#endif
+#ifdef TDMA_USED
+    {MsgId::BEACON,      CMD_BEACON,               MsgDir::TO_TX, 12 + 2 * TDMA_ASSIGNED_SLOTS, false, -1, 0, 0},
+#endif
+};
+
+constexpr size_t PROTOCOL_COUNT = sizeof(PROTOCOL) / sizeof(PROTOCOL[0]);
+
+
+
+// --- Разбор и сборка кадров (protocol.cpp) ---
+
+/**
+ * @brief Какое это сообщение (метрики линка после '|' не мешают)
+ *
+ * @param frame - принятый текстовый кадр
+ * @param dir - от кого ждём: приёмник разбирает TO_RX, пульт — TO_TX
+ * @return MsgId - MsgId::NONE, если кадр не из протокола или поля длиннее описанных
+ */
+MsgId protocol_decode(const String& frame, MsgDir dir);
+
+/**
+ * @brief То же для текста в буфере (без '\0' в конце): подпись проверяет сообщение до того, как из него сделан String
+ */
+MsgId protocol_decode(const char* text, size_t length, MsgDir dir);
+
+/**
+ * @brief Сообщение с полями: токен + fields (поля длиннее описанных обрезаются)
+ */
+String protocol_encode(MsgId id, const String& fields = String());
+
+/**
+ * @brief Время в эфире кадра сообщения с текстом length байт при текущих настройках радио и профиле кадров, мкс
+ */
+uint32_t protocol_time_on_air(const MsgSpec& m, size_t length);
+
+/**
+ * @brief Время в эфире самого длинного ответа на команду при текущих настройках радио и профиле кадров, мкс
+ */
+uint32_t protocol_reply_time_us(MsgId command);
+
+/**
+ * @brief Команда "protocol": таблица сообщений, самые длинные кадры и их время в эфире
+ */
+bool protocol_handle_command(const String& cmd, void (*reply)(const String& line));
+
+
+
+// --- Вычисляется при сборке ---
+
+constexpr const MsgSpec& protocol_spec(MsgId id) {
+    return PROTOCOL[(uint8_t)id];
+}
+
+// Сообщение для всех узлов сети: только его можно подписывать ключом группы AUTH_KEY_GROUP (см. frame_auth.h)
+constexpr bool protocol_group_signed(MsgId id) {
+    return false
+#ifdef TDMA_USED
+           || id == MsgId::BEACON
+#endif
+#ifdef GROUP_USED
+           || id == MsgId::GROUP
+#endif
+        ;
+}
+
+// Ждёт ли команда такой ответ
+constexpr bool protocol_expects(MsgId command, MsgId reply) {
+    return command < MsgId::COUNT && reply < MsgId::COUNT && (protocol_spec(command).replies & (1UL << (uint8_t)reply)) != 0;
+}
+
+constexpr size_t protocol_strlen(const char* s) {
+    return *s == 0 ? 0 : 1 + protocol_strlen(s + 1);
+}
+
+constexpr bool protocol_starts_with(const char* s, const char* prefix) {
+    return *prefix == 0 ? true : (*s == *prefix && protocol_starts_with(s + 1, prefix + 1));
+}
+
+// Подпись и TTL, которые RadioManager добавит к любому явному кадру
+constexpr size_t protocol_trailer() {
+    return 0
+#ifdef AUTH_USED
+           + AUTH_OVERHEAD
+#endif
+#ifdef REPEATER_USED
+           + 1
+#endif
+        ;
+}
+
+// Самый длинный текст сообщения (без подписи и TTL)
+constexpr size_t protocol_text_max(const MsgSpec& m) {
+    return protocol_strlen(m.token) + m.fieldsMax +
+           (m.metrics ? PROTOCOL_METRICS_MAX + (m.dir == MsgDir::TO_TX ? PROTOCOL_BATTERY_MAX : 0) : 0);
+}
+
+// Самый длинный явный кадр сообщения в эфире
+constexpr size_t protocol_frame_max(const MsgSpec& m) {
+    return protocol_text_max(m) + protocol_trailer();
+}
+
+// Самый длинный ответ на команду i, начиная со строки j
+constexpr size_t protocol_longest_reply(size_t i, size_t j = 0) {
+    return j >= PROTOCOL_COUNT ? 0
+           : (PROTOCOL[i].replies & (1UL << j)) != 0
+               ? (protocol_frame_max(PROTOCOL[j]) > protocol_longest_reply(i, j + 1) ? protocol_frame_max(PROTOCOL[j])
+                                                                                     : protocol_longest_reply(i, j + 1))
+               : protocol_longest_reply(i, j + 1);
+}
+
+// Самый длинный ответ на любую команду
+constexpr size_t protocol_longest_reply_any(size_t i = 0) {
+    return i >= PROTOCOL_COUNT ? 0
+           : protocol_longest_reply(i) > protocol_longest_reply_any(i + 1) ? protocol_longest_reply(i)
+                                                                         : protocol_longest_reply_any(i + 1);
+}
+
+// Самый длинный кадр направления (для оценок эфира: тайм-ауты с ретрансляторами)
+constexpr size_t protocol_longest(MsgDir dir, size_t i = 0) {
+    return i >= PROTOCOL_COUNT ? 0
+           : PROTOCOL[i].dir == dir && protocol_frame_max(PROTOCOL[i]) > protocol_longest(dir, i + 1)
+               ? protocol_frame_max(PROTOCOL[i])
+               : protocol_longest(dir, i + 1);
+}
+
+// Время явного кадра в эфире с параметрами радио по умолчанию, мкс
+constexpr uint32_t protocol_airtime_us(size_t frameLength) {
+    return lora_time_on_air_us(frameLength, RADIO_SPREAD_FACTOR, RADIO_BANDWIDTH, RADIO_CODING_RATE, RADIO_PREAMBLE_LENGTH);
+}
+
+// Обмен команды i: от конца команды до конца самого длинного ответа, мс (приёмник отвечает через TIMEOUT_WAITING_TX)
+constexpr uint32_t protocol_reply_ms(size_t i) {
+    return TIMEOUT_WAITING_TX + protocol_airtime_us(protocol_longest_reply(i)) / 1000 + 1;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * ПОТОКОВАЯ ОЦЕНКА КВАНТИЛЯ (алгоритм P², Jain & Chlamtac, 1985)
+ *
+ * Хранит 5 маркеров (~64 байта) вне зависимости от числа наблюдений и не выделяет память.
+ * Маркеры сдвигаются параболической интерполяцией, так что оценка P50/P95/P99 на тысячах
+ * отсчётов получается с точностью в доли процента от размаха — для оценки запаса линка с головой.
+ */
+class P2Quantile {
+public:
+    explicit P2Quantile(float p) : _p(p) { reset(); }
+
+    void reset() {
+        _count = 0;
+        for (uint8_t i = 0; i < 5; i++) {
+            _q[i] = 0;
+            _n[i] = i;
+        }
+        _np[0] = 0;
+        _np[1] = 2 * _p;
+        _np[2] = 4 * _p;
+        _np[3] = 2 + 2 * _p;
+        _np[4] = 4;
+    }
+
+    void add(float x) {
+        // Первые пять отсчётов просто копим отсортированными
+        if (_count < 5) {
+            uint8_t i = (uint8_t)_count;
+            while (i > 0 && _q[i - 1] > x) {
+                _q[i] = _q[i - 1];
+                i--;
+            }
+            _q[i] = x;
+            _count++;
+            return;
+        }
+        _count++;
+
+        // Ячейка, в которую попал отсчёт; крайние маркеры расширяются
+        uint8_t k;
+        if (x < _q[0]) {
+            _q[0] = x;
+            k = 0;
+        } else if (x >= _q[4]) {
+            _q[4] = x;
+            k = 3;
+        } else {
+            k = 0;
+            while (k < 3 && x >= _q[k + 1]) k++;
+        }
+        for (uint8_t i = k + 1; i < 5; i++) _n[i]++;
+
+        const float dn[5] = {0, _p / 2, _p, (1 + _p) / 2, 1};
+        for (uint8_t i = 0; i < 5; i++) _np[i] += dn[i];
+
+        // Подтягиваем средние маркеры к их желаемым позициям
+        for (uint8_t i = 1; i < 4; i++) {
+            float d = _np[i] - _n[i];
+            if ((d >= 1 && _n[i + 1] - _n[i] > 1) || (d <= -1 && _n[i - 1] - _n[i] < -1)) {
+                int8_t s = d > 0 ? 1 : -1;
+                float q = parabolic(i, s);
+                if (_q[i - 1] < q && q < _q[i + 1]) _q[i] = q;
+                else _q[i] = _q[i] + s * (_q[i + s] - _q[i]) / (float)(_n[i + s] - _n[i]);
+                _n[i] += s;
+            }
+        }
+    }
+
+    // Текущая оценка квантиля (пока отсчётов меньше пяти — ближайший из накопленных)
+    float value() const {
+        if (_count == 0) return 0;
+        if (_count < 5) return _q[(uint8_t)(_p * (_count - 1) + 0.5f)];
+        return _q[2];
+    }
+
+    uint32_t count() const { return _count; }
+
+private:
+    float parabolic(uint8_t i, int8_t s) const {
+        return _q[i] + (float)s / (float)(_n[i + 1] - _n[i - 1]) *
+                           ((_n[i] - _n[i - 1] + s) * (_q[i + 1] - _q[i]) / (float)(_n[i + 1] - _n[i]) +
+                            (_n[i + 1] - _n[i] - s) * (_q[i] - _q[i - 1]) / (float)(_n[i] - _n[i - 1]));
+    }
+
+    float _p;
+    float _q[5];  // Высоты маркеров
+    int32_t _n[5]; // Фактические позиции маркеров
+    float _np[5]; // Желаемые позиции маркеров
+    uint32_t _count;
+};
@@ -1,5 +1,24 @@
 #include "radiomodem.h"
 #include <logger.h>
+#include "trace.h"
+#include "lora_airtime.h"
+#include "frame_auth.h"
+#include "protocol.h"
+#include "channel_plan.h"
+#include "repeater.h"
+#include "tdma.h"
+#include "relay_timer.h"
+#include "site_config.h"
+#include "battery.h"
+
+// Какие кадры мы шлём и какие слушаем — для длины неявного кадра
+#ifdef TRANSMITTER
+    #define FRAME_CLASS_OUT FrameClass::COMMAND
+    #define FRAME_CLASS_IN FrameClass::REPLY
+#else
+    #define FRAME_CLASS_OUT FrameClass::REPLY
+    #define FRAME_CLASS_IN FrameClass::COMMAND
+#endif
 
 
 
@@ -47,13 +66,18 @@ RadioManager MyRadio;
 
 // Флаг прерывания приема данных
 volatile bool receivedFlag = false; 
+volatile uint32_t receivedAtUs = 0;  // micros() последнего прерывания приёма
+volatile uint32_t receivedIrqs = 0;  // Прерываний приёма с включения
 
 /**
  * @brief Функция обработки прерывания приема данных радио 
  * 
  */
 void IRAM_ATTR setFlag(void) {
+    receivedAtUs = micros();
+    receivedIrqs++;
     receivedFlag = true;
+    TRACE(RX_IRQ, 0);
 }
 
 
@@ -127,7 +151,11 @@ bool RadioManager::beginRadio() {
         // #endif
         
         
+        _applied = config; // Дальше перенастройка сравнивает с этим
         log_radio_event(state, "Radio Init Success");
+        #ifdef AUTH_USED
+            MyAuth.begin(); // Ключи и счётчики подписи — до первого кадра
+        #endif
         startListening(); 
         return true;
     }
@@ -149,36 +177,81 @@ bool RadioManager::sendCommandAndWaitAck(String cmd, void (*onTick)()) {
     this->isProcessing = true; // Закрываем "шлагбаум"
     bool ackReceived = false; 
     String response;
+    bool isRetry = (cmd == _lastFailedCmd);
+    MsgId command = protocol_decode(cmd, MsgDir::TO_RX);
 
-    this->send(cmd);         // Кричим команду через наше радио
-    this->startListening();  // Переходим в режим ожидания
+    #ifdef TDMA_USED
+        MyTdma.waitForSlot(onTick); // Ждём начала своего слота (без маяка — передаём сразу). В RTT не входит
+    #endif
+    unsigned long startExchange = micros();
+
+    #ifdef FRAME_IMPLICIT_USED
+        // Некодируемую команду (TMR_…) send() передаст явно, а приёмник в неявном профиле её не разберёт — только
+        // сам вернётся в явный. Нет ответа — сразу повторяем один раз: теперь обе стороны в явном профиле
+        uint8_t compact[FRAME_COMPACT_MAX];
+        uint8_t attempts = (frameMode == FrameMode::IMPLICIT && !frame_encode_compact(cmd, FRAME_CLASS_OUT, compact)) ? 2 : 1;
+    #else
+        uint8_t attempts = 1;
+    #endif
+    for (uint8_t attempt = 0; attempt < attempts && !ackReceived; attempt++) {
+        this->send(cmd);         // Кричим команду через наше радио
+        this->startListening();  // Переходим в режим ожидания
 
-    unsigned long startWait = millis(); 
+        unsigned long startWait = millis(); 
     
-    // Пока не прошло время таймаута из settings.h:
-    while (millis() - startWait < TIMEOUT_WAITING_RX) {
-        // Выполняем фоновую задачу (например, опрос кнопок), если она передана
-        if (onTick != nullptr) onTick();
+        // Пока не прошло время таймаута из settings.h:
+        uint32_t timeout = ackTimeout();
+        while (millis() - startWait < timeout) {
+            // Выполняем фоновую задачу (например, опрос кнопок), если она передана
+            if (onTick != nullptr) onTick();
         
-        if (this->isDataReady()) { 
-            if (this->receive(response) == RADIOLIB_ERR_NONE) {
-                // Проверяем ответы, используя константы из settings.h
-                if (response == ACK_FROM_RECEIVER_IF_ON || response == ACK_RELAY_IS_ON) {
-                    this->relayIsOn = true; 
-                    ackReceived = true; 
-                    break; 
-                }
-                if (response == ACK_FROM_RECEIVER_IF_OFF || response == ACK_RELAY_IS_OFF) {
-                    this->relayIsOn = false; 
-                    ackReceived = true; 
-                    break; 
+            if (this->isDataReady()) { 
+                if (this->receive(response) == RADIOLIB_ERR_NONE) {
+                    #ifdef TDMA_USED
+                        if (MyTdma.onFrame(response)) continue; // Маяк посреди ожидания — только подстройка часов
+                    #endif
+                    this->stripLinkMetrics(response);
+                    // Засчитываем только ответ, которого ждёт эта команда (таблица PROTOCOL). Команду не из
+                    // таблицы подтверждает любой ответ приёмника
+                    MsgId reply = protocol_decode(response, MsgDir::TO_TX);
+                    if (reply == MsgId::NONE || (command != MsgId::NONE && !protocol_expects(command, reply))) continue;
+                    switch (reply) {
+                        #ifdef RELAY_TIMER_USED
+                        case MsgId::TIMER_ACK:
+                            this->relayIsOn = MyRelayTimer.onAck(response); // Расписание принято, реле — как в ответе
+                            break;
+                        #endif
+                        default:
+                            // Приёмник перешёл на новый канал или ответил не о реле — реле не трогаем
+                            if (protocol_spec(reply).relay < 0) break;
+                            this->relayIsOn = protocol_spec(reply).relay == 1;
+                            TRACE(ACK_RX, this->relayIsOn ? 1 : 0);
+                            break;
+                    }
+                    ackReceived = true;
+                    break;
                 }
             }
+            yield(); // Для стабильности систем на базе ESP
         }
-        yield(); // Для стабильности систем на базе ESP
     }
 
+    #ifdef FRAME_IMPLICIT_USED
+        // Явный обмен удался — приёмник уже перешёл на неявный профиль, переходим и мы.
+        // Неявный не удался — возможно, приёмник перезагрузился: следующий обмен снова явный
+        // (только если и команда кодируется: на некодируемую приёмник остаётся в явном профиле)
+        uint8_t probe[FRAME_COMPACT_MAX];
+        if (ackReceived && frameMode == FrameMode::EXPLICIT && frame_encode_compact(cmd, FRAME_CLASS_OUT, probe)) setFrameMode(FrameMode::IMPLICIT);
+        if (!ackReceived && frameMode == FrameMode::IMPLICIT) setFrameMode(FrameMode::EXPLICIT);
+    #endif
+
     this->rxOnline = ackReceived; // Обновляем статус связи в классе
+    if (ackReceived) this->lastAckTime = millis();
+    telemetry[currentPeer].recordExchange(ackReceived, (micros() - startExchange) / 1000, isRetry);
+    #ifdef CHANNEL_PLAN_USED
+        MyChannels.recordExchange(ackReceived); // Табло каналов и аварийный переход после серии неудач
+    #endif
+    _lastFailedCmd = ackReceived ? String() : cmd;
     this->isProcessing = false;   // Открываем "шлагбаум"
     return ackReceived;
 }
@@ -193,6 +266,7 @@ bool RadioManager::sendCommandAndWaitAck(String cmd, void (*onTick)()) {
  */
 void RadioManager::startListening() {
     receivedFlag = false;
+    applyHeader(FRAME_CLASS_IN);
     radio.startReceive();
 }
 
@@ -215,9 +289,10 @@ bool RadioManager::isDataReady() {
  * @brief - Функция отправки сообщения через радио 
  * 
  * @param message - сообщение для отправки 
+ * @param group - подписать ключом группы (кадр для всех пультов)
  * @return int - код состояния \ref status_codes 
  */
-int RadioManager::send(const String& message) {
+int RadioManager::send(const String& message, bool group) {
     #ifdef FAN_USED
     if (config.outputPower >= config.fanThreshold) digitalWrite(FUN, HIGH);
     #endif
@@ -227,7 +302,47 @@ int RadioManager::send(const String& message) {
     //компилятор не может автоматически решить, преобразовать ли её в обычную строку или в указатель
     // на символы. Явный вызов message.c_str() превращает объект String в стандартный массив символов char*,
     // который RadioLib понимает однозначно.
-    int state = radio.transmit(message.c_str());
+    uint8_t frame[RADIO_MAX_FRAME_LENGTH];
+    size_t length = message.length();
+
+    #ifdef FRAME_IMPLICIT_USED
+        if (frameMode == FrameMode::IMPLICIT) {
+            if (frame_encode_compact(message, FRAME_CLASS_OUT, frame)) length = frame_payload_length(FRAME_CLASS_OUT);
+            else setFrameMode(FrameMode::EXPLICIT); // Токена нет в таблице кодов — такой кадр можно отправить только явно
+        }
+        if (frameMode == FrameMode::EXPLICIT)
+    #endif
+    {
+        if (length > sizeof(frame)) return RADIOLIB_ERR_PACKET_TOO_LONG;
+        memcpy(frame, message.c_str(), length);
+    }
+
+    #ifdef AUTH_USED
+        // Дописываем id, счётчик и подпись — приёмник без ключа такой кадр не примет
+        length = MyAuth.seal(frame, length, sizeof(frame), group);
+        if (length == 0) return RADIOLIB_ERR_PACKET_TOO_LONG;
+    #endif
+
+    #ifdef REPEATER_USED
+        // TTL — последним байтом, вне подписи: ретрансляторы уменьшают его при каждой пересылке
+        if (length >= sizeof(frame)) return RADIOLIB_ERR_PACKET_TOO_LONG;
+        frame[length++] = REPEATER_HOP_LIMIT;
+    #endif
+
+    applyHeader(FRAME_CLASS_OUT);
+    TRACE(TX_START, length);
+    int state = radio.transmit(frame, length);
+    TRACE(TX_DONE, length);
+
+    #ifdef FRAME_IMPLICIT_USED
+        if (_implicitAfterSend) {
+            _implicitAfterSend = false;
+            if (state == RADIOLIB_ERR_NONE) setFrameMode(FrameMode::IMPLICIT);
+        }
+    #endif
+    #ifndef AUTH_USED
+        (void)group;
+    #endif
     
     log_radio_event(state, "Send: " + message);
 
@@ -239,6 +354,16 @@ int RadioManager::send(const String& message) {
 }
 
 
+int RadioManager::sendInMode(const String& message, FrameMode mode) {
+    FrameMode own = frameMode;
+    frameMode = mode; // Не setFrameMode(): это не смена профиля — откаты и кеши оценок эфира не трогаем
+    int state = send(message);
+    frameMode = own;
+    return state;
+}
+
+
+
 /**
  * @brief  Функция приема сообщения через радио 
  * 
@@ -247,20 +372,236 @@ int RadioManager::send(const String& message) {
  */
 int RadioManager::receive(String& message) {
     // Читаем данные, которые уже пришли в буфер по прерыванию
-    int state = radio.readData(message);
+    uint8_t frame[RADIO_MAX_FRAME_LENGTH + 1];
+    size_t length = radio.getPacketLength();
+    if (length > RADIO_MAX_FRAME_LENGTH) length = RADIO_MAX_FRAME_LENGTH;
+    int state = radio.readData(frame, length);
     receivedFlag = false; 
+    TRACE(READ_DATA, length);
+
+    #ifdef REPEATER_USED
+        uint8_t hops = 0;
+        if (state == RADIOLIB_ERR_NONE) {
+            if (length == 0) {
+                state = REPEATER_ERR_NO_TTL;
+            } else {
+                uint8_t ttl = frame[--length];
+                hops = ttl < REPEATER_HOP_LIMIT ? REPEATER_HOP_LIMIT - ttl : 0;
+            }
+        }
+    #endif
+
+    #ifdef AUTH_USED
+        // Неподписанный, чужой или повторённый кадр для остального кода как будто не приходил
+        if (state == RADIOLIB_ERR_NONE) state = MyAuth.open(frame, length);
+    #endif
+
+    if (state == RADIOLIB_ERR_NONE) {
+        if (frameMode == FrameMode::IMPLICIT) {
+            if (length != frame_payload_length(FRAME_CLASS_IN) || !frame_decode_compact(frame, FRAME_CLASS_IN, message)) state = FRAME_ERR_UNKNOWN_CODE;
+        } else {
+            frame[length] = '\0'; // Полезная нагрузка — текстовый токен
+            message = String((const char*)frame);
+        }
+    }
+
+    #if defined(FRAME_IMPLICIT_USED) && defined(RECEIVER)
+        _implicitAfterSend = false;
+        if (state != RADIOLIB_ERR_NONE && frameMode == FrameMode::IMPLICIT) {
+            // Так выглядит явный кадр пульта, который перезагрузился и начал обнаружение заново
+            setFrameMode(FrameMode::EXPLICIT);
+        } else if (state == RADIOLIB_ERR_NONE && frameMode == FrameMode::EXPLICIT) {
+            uint8_t probe[FRAME_COMPACT_MAX];
+            _implicitAfterSend = frame_encode_compact(message, FRAME_CLASS_IN, probe); // Пульт поймёт нас и в неявном профиле
+        }
+    #endif
+
+    if (state == RADIOLIB_ERR_NONE) {
+        // Запоминаем, как мы слышим другую сторону — отправим это ей в следующем пакете
+        lastRssi = radio.getRSSI();
+        lastSnr = radio.getSNR();
+
+        float freqError = getFrequencyError();
+
+        #ifdef AUTH_USED
+            // Отправитель теперь известен по подписи — телеметрия ведётся по нему
+            currentPeer = MyAuth.lastPeer() < TELEMETRY_MAX_PEERS ? MyAuth.lastPeer() : 0;
+        #endif
+        telemetry[currentPeer].recordRx(lastRssi, lastSnr, freqError);
+
+        #ifdef REPEATER_USED
+            lastHops = hops;
+        #endif
+    }
+    return state;
+}
+
+
+
+/**
+ * @brief Отправка кадра без изменений
+ */
+int RadioManager::sendRaw(const uint8_t* frame, size_t length) {
+    #ifdef FAN_USED
+    if (config.outputPower >= config.fanThreshold) digitalWrite(FUN, HIGH);
+    #endif
+
+    TRACE(TX_START, length);
+    int state = radio.transmit(frame, length);
+    TRACE(TX_DONE, length);
+
+    #ifdef FAN_USED
+    digitalWrite(FUN, LOW);
+    #endif
     return state;
 }
 
 
+
+/**
+ * @brief Чтение принятого кадра без проверки подписи. RSSI/SNR запоминаются, как и в receive()
+ */
+int RadioManager::receiveRaw(uint8_t* frame, size_t& length) {
+    length = radio.getPacketLength();
+    if (length > RADIO_MAX_FRAME_LENGTH) length = RADIO_MAX_FRAME_LENGTH;
+    int state = radio.readData(frame, length);
+    receivedFlag = false;
+    TRACE(READ_DATA, length);
+
+    if (state == RADIOLIB_ERR_NONE) {
+        lastRssi = radio.getRSSI();
+        lastSnr = radio.getSNR();
+    }
+    return state;
+}
+
+
+
+/**
+ * @brief Время ожидания ответа. Без ретрансляторов — TIMEOUT_WAITING_RX. С ними команда и ответ могут
+ * пройти до REPEATER_HOP_LIMIT пересылок каждый, и каждая добавляет паузу до REPEATER_JITTER_MAX и кадр в эфире
+ *
+ * @return uint32_t - мс
+ */
+uint32_t RadioManager::ackTimeout() {
+    #ifdef REPEATER_USED
+        uint32_t frameMs = getTimeOnAir(protocol_longest_reply_any() - protocol_trailer(), FRAME_CLASS_IN, false) / 1000 + 1; // Самый длинный ответ (с ретранслятором кадры только явные)
+        return MyConfig.data.waitRxMs + 2UL * REPEATER_HOP_LIMIT * (REPEATER_JITTER_MAX + frameMs);
+    #else
+        return MyConfig.data.waitRxMs;
+    #endif
+}
+
+
 /**
  * @brief  Функция применения изменений конфигурации радио
  * 
  * @return int - код состояния \ref status_codes
  */
 int RadioManager::applyChanges() {
-    radio.setCurrentLimit(config.currentLimit);
-    return radio.setOutputPower(config.outputPower);
+    return reconfigure(config);
+}
+
+
+
+/**
+ * @brief Перенастройка по разнице с тенью. Каждый параметр — своя команда чипу (SX126x пересылает
+ * параметры модуляции целиком, SX127x пишет свой регистр); неизменившиеся не трогаем вовсе
+ */
+int RadioManager::reconfigure(const LORA_CONFIGURATION& target) {
+    LORA_CONFIGURATION next = target; // target может быть самим config, который ниже перезаписывается
+    unsigned long t0 = micros();
+    uint8_t writes = 0;
+    int state = RADIOLIB_ERR_NONE;
+    radio.standby();
+
+    // Тень обновляется сразу после удачной записи: при ошибке в ней ровно то, что в чипе
+    #define RECONFIGURE(field, call)                                        \
+        if (state == RADIOLIB_ERR_NONE && next.field != _applied.field) {    \
+            state = call;                                                   \
+            writes++;                                                       \
+            if (state == RADIOLIB_ERR_NONE) _applied.field = next.field;     \
+        }
+
+    #ifdef RADIO_TYPE_SX1268
+        RECONFIGURE(tcxoVoltage, radio.setTCXO(next.tcxoVoltage));
+        RECONFIGURE(useRegulatorLDO, next.useRegulatorLDO ? radio.setRegulatorLDO() : radio.setRegulatorDCDC());
+    #endif
+    RECONFIGURE(frequency, radio.setFrequency(next.frequency));
+    RECONFIGURE(bandwidth, radio.setBandwidth(next.bandwidth));
+    RECONFIGURE(spreadingFactor, radio.setSpreadingFactor(next.spreadingFactor));
+    RECONFIGURE(codingRate, radio.setCodingRate(next.codingRate));
+    RECONFIGURE(syncWord, radio.setSyncWord(next.syncWord));
+    RECONFIGURE(preambleLength, radio.setPreambleLength(next.preambleLength));
+    RECONFIGURE(currentLimit, radio.setCurrentLimit(next.currentLimit));
+    RECONFIGURE(outputPower, radio.setOutputPower(next.outputPower));
+    #ifdef RADIO_TYPE_SX1278
+        RECONFIGURE(gain, radio.setGain(next.gain));
+    #endif
+    #undef RECONFIGURE
+
+    _applied.fanThreshold = next.fanThreshold; // Не параметр чипа
+    config = _applied;
+    lastSwitchUs = micros() - t0;
+    lastSwitchWrites = writes;
+    configRevision++;
+    if (state != RADIOLIB_ERR_NONE) log_radio_event(state, "Reconfigure failed");
+    return state;
+}
+
+
+
+// Команда "radio"
+bool RadioManager::handleCommand(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd != "radio" && !cmd.startsWith("radio ")) return false;
+
+    LORA_CONFIGURATION next = config;
+    uint8_t changes = 0;
+    bool ok = true;
+    unsigned pos = 6;
+    while (ok && pos < cmd.length()) {
+        int keyEnd = cmd.indexOf(' ', pos);
+        if (keyEnd < 0) {
+            ok = false;
+            break;
+        }
+        int valueEnd = cmd.indexOf(' ', keyEnd + 1);
+        if (valueEnd < 0) valueEnd = cmd.length();
+        String key = cmd.substring(pos, keyEnd);
+        String value = cmd.substring(keyEnd + 1, valueEnd);
+        if (key == "freq") next.frequency = value.toFloat();
+        else if (key == "bw") next.bandwidth = value.toFloat();
+        else if (key == "sf") next.spreadingFactor = (uint8_t)value.toInt();
+        else if (key == "cr") next.codingRate = (uint8_t)value.toInt();
+        else if (key == "sync") next.syncWord = (uint8_t)strtoul(value.c_str(), nullptr, 0);
+        else if (key == "power") next.outputPower = (int8_t)value.toInt();
+        else if (key == "preamble") next.preambleLength = (uint16_t)value.toInt();
+        else if (key == "limit") next.currentLimit = value.toFloat();
+        else ok = false;
+        changes++;
+        pos = valueEnd + 1;
+    }
+    if (!ok) {
+        reply("Usage: radio [freq MHz] [bw kHz] [sf n] [cr n] [sync 0x12] [power dBm] [preamble n] [limit mA]");
+        return true;
+    }
+
+    if (changes > 0) {
+        if (isProcessing) {
+            reply("RADIO busy: exchange in progress");
+            return true;
+        }
+        int state = reconfigure(next);
+        startListening();
+        if (state != RADIOLIB_ERR_NONE) reply("RADIO error " + String(state) + ", rest not applied");
+        else reply("RADIO switched in " + String(lastSwitchUs) + " us (" + String(lastSwitchWrites) +
+                   " writes). The other side must switch too");
+    }
+    reply("freq " + String(config.frequency, 3) + " MHz, bw " + String(config.bandwidth, 1) + " kHz, sf " +
+          String(config.spreadingFactor) + ", cr 4/" + String(config.codingRate) + ", sync 0x" + String(config.syncWord, HEX) +
+          ", power " + String(config.outputPower) + " dBm, preamble " + String(config.preambleLength) + ", limit " +
+          String(config.currentLimit, 0) + " mA; last switch " + String(lastSwitchUs) + " us");
+    return true;
 }
 
 
@@ -277,4 +618,169 @@ float RadioManager::getRSSI() { return radio.getRSSI(); }
  * 
  * @return float - значение SNR
  */
-float RadioManager::getSNR() { return radio.getSNR(); }
\ No newline at end of file
+float RadioManager::getSNR() { return radio.getSNR(); }
+
+
+/**
+ * @brief  Ошибка частоты последнего пакета. SX126x умеет отдавать её только в RadioLib 7
+ * 
+ * @return float - Гц (0, если чип или библиотека не умеют)
+ */
+float RadioManager::getFrequencyError() {
+    #if defined(RADIO_TYPE_SX1278) || (RADIOLIB_VERSION_MAJOR >= 7)
+        return radio.getFrequencyError();
+    #else
+        return 0;
+    #endif
+}
+
+
+uint32_t RadioManager::lastRxIrqUs() { return receivedAtUs; }
+uint32_t RadioManager::rxIrqCount() { return receivedIrqs; }
+
+
+/**
+ * @brief Добавление метрик линка к токену команды или ответа
+ * 
+ * @param token - команда или ответ
+ * @return String - "токен|RSSI,SNR" (ответ приёмника с BATTERY_USED — "токен|RSSI,SNR,мВ батареи")
+ */
+String RadioManager::withLinkMetrics(const String& token) {
+    String frame = token + LINK_METRICS_SEPARATOR + String((int)lastRssi) + "," + String((int)lastSnr);
+    #if defined(BATTERY_USED) && defined(RECEIVER)
+        frame += "," + String(MyBattery.millivolts()); // 0 — не измеряем
+    #endif
+    return frame;
+}
+
+
+/**
+ * @brief Отделение метрик линка от принятого кадра
+ * 
+ * @param frame - принятый кадр (изменяется: остаётся только токен)
+ */
+void RadioManager::stripLinkMetrics(String& frame) {
+    int sep = frame.indexOf(LINK_METRICS_SEPARATOR);
+    if (sep < 0) return; // Старый формат без метрик — ничего не трогаем
+
+    int comma = frame.indexOf(',', sep + 1);
+    if (comma > sep) {
+        peerRssi = frame.substring(sep + 1, comma).toInt();
+        peerSnr = frame.substring(comma + 1).toInt(); // Разбор останавливается на запятой перед напряжением
+        peerMetricsValid = true;
+        #if defined(BATTERY_USED) && defined(TRANSMITTER)
+            int second = frame.indexOf(',', comma + 1);
+            if (second > comma) MyBattery.onPeerReport((uint16_t)frame.substring(second + 1).toInt());
+        #endif
+    }
+    frame = frame.substring(0, sep);
+}
+
+
+/**
+ * @brief Запас SNR над порогом демодуляции LoRa (для SF7 это -7.5 дБ, каждый следующий SF ещё -2.5 дБ)
+ * по худшему из направлений TX->RX и RX->TX
+ * 
+ * @return float - запас в дБ (отрицательный — пакеты принимаются "на грани")
+ */
+float RadioManager::getSnrMargin() {
+    float floorSnr = lora_snr_floor_db(config.spreadingFactor);
+    // Линк хорош настолько, насколько хорошо более слабое из двух направлений
+    float snr = (peerMetricsValid && peerSnr < lastSnr) ? (float)peerSnr : lastSnr;
+    return snr - floorSnr;
+}
+
+
+/**
+ * @brief Время в эфире кадра с текущими настройками радио
+ * 
+ * @param length - длина текста в байтах (подпись кадра, если включена, учитывается сама)
+ * @param cls - класс кадра: его длина в неявном профиле
+ * @param compact - сообщение есть в таблице кодов неявного профиля
+ * @return uint32_t - время в микросекундах
+ */
+uint32_t RadioManager::getTimeOnAir(size_t length, FrameClass cls, bool compact) {
+    bool explicitHeader = (frameMode == FrameMode::EXPLICIT || !compact); // Некодируемое сообщение уходит явным кадром
+    if (explicitHeader) {
+        #ifdef AUTH_USED
+            length += AUTH_OVERHEAD;
+        #endif
+        #ifdef REPEATER_USED
+            length += 1; // TTL
+        #endif
+    } else {
+        length = frame_class_length(cls);
+    }
+    return lora_time_on_air_us(length, config.spreadingFactor, config.bandwidth, config.codingRate,
+                               config.preambleLength, explicitHeader);
+}
+
+
+
+/**
+ * @brief Смена профиля кадров
+ *
+ * @param mode - явный или неявный заголовок
+ */
+void RadioManager::setFrameMode(FrameMode mode) {
+    if (mode == frameMode) return;
+    if (mode == FrameMode::EXPLICIT) implicitFallbacks++;
+    frameMode = mode;
+    configRevision++;
+    print_log("[RADIO]", mode == FrameMode::IMPLICIT ? "Implicit header frames" : "Explicit header frames");
+}
+
+
+
+/**
+ * @brief Настройка заголовка в чипе. SPI трогаем только при смене режима или класса кадра
+ *
+ * @param cls - класс кадра, который будем передавать или принимать
+ */
+void RadioManager::applyHeader(FrameClass cls) {
+    size_t length = (frameMode == FrameMode::IMPLICIT) ? frame_class_length(cls) : 0;
+    if (length == _headerLength) return;
+
+    if (length == 0) radio.explicitHeader();
+    else radio.implicitHeader(length);
+    _headerLength = length;
+}
+
+
+
+/**
+ * @brief Перестройка частоты. Менять частоту чип позволяет только в режиме ожидания
+ *
+ * @param frequency - частота, МГц
+ * @return int - код состояния \ref status_codes
+ */
+int RadioManager::tune(float frequency) {
+    radio.standby();
+    int state = radio.setFrequency(frequency);
+    if (state == RADIOLIB_ERR_NONE) config.frequency = _applied.frequency = frequency;
+    else log_radio_event(state, "Tune " + String(frequency, 3) + " MHz failed");
+    return state;
+}
+
+
+
+/**
+ * @brief Замер шума эфира: мгновенный RSSI (не RSSI пакета) несколько раз подряд
+ *
+ * @param samples - число замеров
+ * @param spacingUs - пауза между замерами, мкс
+ * @param peak - максимальный замер (если нужен)
+ * @return float - средний RSSI, дБм
+ */
+float RadioManager::sampleNoise(uint8_t samples, uint16_t spacingUs, float* peak) {
+    float sum = 0;
+    float top = -200;
+    for (uint8_t i = 0; i < samples; i++) {
+        if (i > 0) delayMicroseconds(spacingUs);
+        float rssi = radio.getRSSI(false);
+        sum += rssi;
+        if (rssi > top) top = rssi;
+    }
+    if (peak != nullptr) *peak = top;
+    return samples > 0 ? sum / samples : top;
+}
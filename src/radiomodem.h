@@ -3,6 +3,10 @@
 #include <RadioLib.h>
 #include <SPI.h>
 #include "settings.h"
+#include "link_telemetry.h"
+#include "frame_profile.h"
+
+#define RADIO_MAX_FRAME_LENGTH 255 // Максимальная длина LoRa-кадра (и SX126x, и SX127x)
 
 struct LORA_CONFIGURATION {
     float frequency = RADIO_FREQ;
@@ -36,11 +40,55 @@ public:
     
     bool beginRadio();
     
-    // const String& позволяет передавать String("текст") без ошибок lvalue
-    int send(const String& message); 
+    // const String& позволяет передавать String("текст") без ошибок lvalue.
+    // group — кадр для всех узлов сети (маяк TDMA): подпись ключом группы, а не ключом пары
+    int send(const String& message, bool group = false);
+
+    /**
+     * @brief Отправка в заданном профиле кадров; свой профиль не меняется. Для объявления приёмника после
+     * сброса: в каком профиле слушает пульт, он не знает
+     */
+    int sendInMode(const String& message, FrameMode mode);
     
     int receive(String& message);
-    int applyChanges();
+    int applyChanges(); // Применить правки в config (только то, что отличается от записанного в чип)
+
+    /**
+     * @brief Смена параметров модема на ходу, без сброса чипа и beginRadio(): новые параметры сравниваются
+     * с тенью уже записанных в чип, команды уходят только для изменившихся. Радио остаётся в режиме
+     * ожидания — слушать снова через startListening(). Время смены — в lastSwitchUs
+     *
+     * @param next - новые параметры (можно передать сам config)
+     * @return int - код состояния \ref status_codes. При ошибке в config — то, что успело записаться
+     */
+    int reconfigure(const LORA_CONFIGURATION& next);
+
+    /**
+     * @brief Команда "radio [параметр значение ...]": текущие параметры или их смена на ходу
+     */
+    bool handleCommand(const String& cmd, void (*reply)(const String& line));
+
+    uint32_t lastSwitchUs = 0;    // Сколько заняла последняя перенастройка (мкс)
+    uint8_t lastSwitchWrites = 0; // Сколько команд чипу на неё ушло
+    uint16_t configRevision = 0;  // Растёт при перенастройке и смене профиля кадров: по нему сбрасываются кеши оценок эфира
+
+    /**
+     * @brief Кадр в эфир как есть — без подписи и TTL (ретранслятор пересылает чужие кадры)
+     *
+     * @param frame - кадр
+     * @param length - длина кадра
+     * @return int - код состояния \ref status_codes
+     */
+    int sendRaw(const uint8_t* frame, size_t length);
+
+    /**
+     * @brief Принятый кадр как есть — без проверки подписи и разбора (ретранслятор)
+     *
+     * @param frame - буфер не меньше RADIO_MAX_FRAME_LENGTH
+     * @param length - длина принятого кадра
+     * @return int - код состояния \ref status_codes
+     */
+    int receiveRaw(uint8_t* frame, size_t& length);
 
     // Асинхронные методы (прерывания)
     void startListening(); 
@@ -54,13 +102,96 @@ public:
      */
     bool sendCommandAndWaitAck(String cmd, void (*onTick)() = nullptr);
 
+    uint32_t ackTimeout(); // Сколько ждать ответа (мс): с ретрансляторами — с запасом на пересылки туда и обратно
+
     float getRSSI(); 
     float getSNR();
+    float getFrequencyError(); // Ошибка частоты последнего пакета, Гц
+
+    // Прерывание "кадр принят": время по micros() и сколько их было с включения. Сниффер ставит по ним
+    // метку кадра и замечает кадры, пришедшие раньше, чем был прочитан предыдущий
+    uint32_t lastRxIrqUs();
+    uint32_t rxIrqCount();
+
+    /**
+     * @brief Добавляет к токену команды/ответа метрики того, как мы слышим другую сторону
+     * 
+     * @param token - команда или ответ из settings.h
+     * @return String - "токен|RSSI,SNR" (ответ приёмника с BATTERY_USED — "токен|RSSI,SNR,мВ")
+     */
+    String withLinkMetrics(const String& token);
+
+    /**
+     * @brief Отрезает от принятого кадра метрики (если они есть) и запоминает их в peerRssi/peerSnr
+     * 
+     * @param frame - принятый кадр, после вызова в нём остаётся только токен
+     */
+    void stripLinkMetrics(String& frame);
+
+    float getSnrMargin();                 // Запас SNR последнего пакета над порогом демодуляции текущего SF (дБ)
+
+    /**
+     * @brief Время в эфире кадра с текущими настройками радио и в текущем профиле
+     *
+     * @param length - длина текста кадра (подпись и TTL явного кадра учитываются сами)
+     * @param cls - чей кадр: команда пульта или ответ приёмника (длина кадра в неявном профиле)
+     * @param compact - сообщение кодируется в неявном профиле; false — уходит явным кадром всегда (маяк, расписание)
+     * @return uint32_t - время в микросекундах
+     */
+    uint32_t getTimeOnAir(size_t length, FrameClass cls, bool compact);
+
+    /**
+     * @brief Переключение профиля кадров (явный/неявный заголовок). Обычно вызывается самим RadioManager
+     * по правилам обнаружения и отката из frame_profile.h
+     */
+    void setFrameMode(FrameMode mode);
+
+    /**
+     * @brief Перестройка частоты (радио остаётся в режиме ожидания — слушать снова через startListening)
+     *
+     * @param frequency - частота, МГц
+     * @return int - код состояния \ref status_codes
+     */
+    int tune(float frequency);
+
+    /**
+     * @brief Средний уровень эфира на текущей частоте без пакета (радио должно быть в режиме приёма)
+     *
+     * @param samples - число замеров RSSI
+     * @param spacingUs - пауза между замерами, мкс
+     * @param peak - если задан, сюда пишется максимальный замер
+     * @return float - средний RSSI, дБм
+     */
+    float sampleNoise(uint8_t samples, uint16_t spacingUs, float* peak = nullptr);
+
+    FrameMode frameMode = FrameMode::EXPLICIT; // После включения — всегда явный заголовок (обнаружение)
+    uint32_t implicitFallbacks = 0;            // Сколько раз неявный профиль откатывался в явный
 
     // Флаги (чек-боксы) нашего кода
     bool isProcessing = false; // "Шлагбаум": если true, значит мы сейчас ждем ответ от радио и кнопку нажимать бесполезно
     bool relayIsOn = false;    // Наше мнение о том, в каком состоянии сейчас реле
     bool rxOnline = false;     // Связь: true, если приемник хоть раз ответил на команду успешно
+
+    // Метрики линка
+    float lastRssi = 0;            // RSSI последнего принятого нами пакета (дБм)
+    float lastSnr = 0;             // SNR последнего принятого нами пакета (дБ)
+    int peerRssi = 0;              // Как другая сторона слышит нас (приходит в ответах)
+    int peerSnr = 0;
+    bool peerMetricsValid = false; // true, если peerRssi/peerSnr хоть раз приходили
+    unsigned long lastAckTime = 0; // millis() последнего подтверждённого обмена
+    uint8_t lastHops = 0;          // Через сколько ретрансляторов прошёл последний принятый кадр
+
+    // Телеметрия линка по собеседникам. Адресации в протоколе пока нет, собеседник всегда один — peer 0
+    LinkTelemetry telemetry[TELEMETRY_MAX_PEERS];
+    uint8_t currentPeer = 0;
+
+private:
+    String _lastFailedCmd; // Команда последнего неудачного обмена — её повторная отправка считается повтором
+    bool _implicitAfterSend = false; // Приёмник: ответить на явный кадр явно и после этого перейти на неявный
+    size_t _headerLength = 0;        // Что сейчас настроено в чипе: 0 — явный заголовок, иначе длина неявного кадра
+    LORA_CONFIGURATION _applied;     // Тень: параметры, которые сейчас записаны в чип
+
+    void applyHeader(FrameClass cls); // Настройка заголовка в чипе под класс кадра (только если изменился)
 };
 
 extern RadioManager MyRadio;
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "reconciler.h"
+#include "radiomodem.h"
+#include "command_engine.h"
+#include "protocol.h"
+#include "logger.h"
+
+Reconciler MyReconciler;
+
+
+
+/**
+ * @brief Один шаг фоновой сверки
+ *
+ * @param onTick - фоновая задача на время ожидания ответа
+ */
+void Reconciler::service(void (*onTick)()) {
+    #ifdef RECONCILER_USED
+    // Эфир занят или вот-вот уйдёт команда пользователя — её ACK и так подтвердит связь
+    if (MyRadio.isProcessing || MyCommands.hasPending()) return;
+
+    unsigned long now = millis();
+    uint32_t interval = currentInterval();
+    if (now - _lastPoll < interval) return;
+    if (MyRadio.rxOnline && now - MyRadio.lastAckTime < interval) return; // Недавний ACK — связь и так свежая
+
+    _lastPoll = now;
+    pollCount++;
+
+    bool wasOnline = MyRadio.rxOnline;
+    bool wasOn = MyRadio.relayIsOn;
+
+    // В опросе сообщаем приёмнику, как мы слышали его в прошлый раз
+    bool ok = MyRadio.sendCommandAndWaitAck(MyRadio.withLinkMetrics(CMD_GET_STATUS), onTick);
+
+    if (ok && MyCommands.hasDesired && MyRadio.relayIsOn != MyCommands.desiredOn) {
+        driftCount++;
+        print_log("[RECONCILE]", MyCommands.desiredOn ? "Drift: RX is OFF, restoring ON" : "Drift: RX is ON, restoring OFF");
+        MyCommands.requestRelay(MyCommands.desiredOn, CommandSource::SYSTEM);
+    }
+
+    if (ok) {
+        print_log("[RECONCILE]", "Peer RSSI " + String(MyRadio.peerRssi) + " SNR " + String(MyRadio.peerSnr) +
+                                 ", next poll in " + String(currentInterval() / 1000) + " s");
+    } else {
+        print_log("[RECONCILE]", "No answer from RX");
+    }
+
+    if ((ok != wasOnline || MyRadio.relayIsOn != wasOn) && _onStatusChange != nullptr) _onStatusChange();
+    #endif
+}
+
+
+
+/**
+ * @brief Интервал опроса с учётом качества линка, батареи и бюджета эфира
+ *
+ * @return uint32_t - интервал в мс
+ */
+uint32_t Reconciler::currentInterval() {
+    #ifdef RECONCILER_USED
+    uint32_t interval;
+    if (_lowBattery) {
+        interval = RECONCILE_INTERVAL_MAX;
+    } else if (!MyRadio.rxOnline) {
+        interval = RECONCILE_INTERVAL_MIN;
+    } else {
+        float quality = constrain(MyRadio.getSnrMargin() / RECONCILE_GOOD_SNR_MARGIN, 0.0f, 1.0f);
+        interval = RECONCILE_INTERVAL_MIN + (uint32_t)((RECONCILE_INTERVAL_MAX - RECONCILE_INTERVAL_MIN) * quality);
+    }
+
+    return max(interval, budgetInterval());
+    #else
+    return 0;
+    #endif
+}
+
+
+
+/**
+ * @brief Минимальный интервал по бюджету эфира. Вызывается на каждом проходе loop(), поэтому считается
+ * по самым длинным кадрам из таблицы протокола и только после смены настроек радио или профиля кадров
+ */
+uint32_t Reconciler::budgetInterval() {
+    #ifdef RECONCILER_USED
+    if (_budgetValid && _budgetRevision == MyRadio.configRevision) return _budgetMs;
+
+    // Один опрос = запрос + ответ. Время в эфире (мкс) / бюджет (промилле) = минимальный интервал (мс)
+    const MsgSpec& poll = protocol_spec(MsgId::GET_STATUS);
+    uint32_t exchangeAirtime = protocol_time_on_air(poll, protocol_text_max(poll)) + protocol_reply_time_us(MsgId::GET_STATUS);
+    _budgetMs = exchangeAirtime / RECONCILE_AIRTIME_BUDGET;
+    _budgetRevision = MyRadio.configRevision;
+    _budgetValid = true;
+    return _budgetMs;
+    #else
+    return 0;
+    #endif
+}
+
+
+
+/**
+ * @brief Приёмник включился ("RX_UP_<реле>"): связь есть, реле — как в кадре; расхождение с целью исправляем сразу
+ */
+bool Reconciler::onFrame(const String& frame) {
+    #ifdef TRANSMITTER
+    if (protocol_decode(frame, MsgDir::TO_TX) != MsgId::RX_BOOT) return false;
+    bool wasOnline = MyRadio.rxOnline;
+    bool wasOn = MyRadio.relayIsOn;
+    MyRadio.relayIsOn = frame[strlen(ACK_RX_BOOT)] == '1';
+    MyRadio.rxOnline = true;
+    MyRadio.lastAckTime = millis();
+    #ifdef FRAME_IMPLICIT_USED
+      MyRadio.setFrameMode(FrameMode::EXPLICIT); // Приёмник после сброса в явном профиле — договариваемся заново
+    #endif
+    receiverBoots++;
+    print_log("[RECONCILE]", String("RX restarted, relay ") + (MyRadio.relayIsOn ? "ON" : "OFF"));
+
+    if (MyCommands.hasDesired && MyRadio.relayIsOn != MyCommands.desiredOn) {
+        driftCount++;
+        MyCommands.requestRelay(MyCommands.desiredOn, CommandSource::SYSTEM);
+    }
+    if ((MyRadio.rxOnline != wasOnline || MyRadio.relayIsOn != wasOn) && _onStatusChange != nullptr) _onStatusChange();
+    return true;
+    #else
+    (void)frame;
+    return false;
+    #endif
+}
+
+
+
+void Reconciler::setLowBattery(bool low) {
+    _lowBattery = low;
+}
+
+
+
+void Reconciler::setStatusChangeHandler(void (*handler)()) {
+    _onStatusChange = handler;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * ФОНОВАЯ СВЕРКА СОСТОЯНИЯ (только передатчик)
+ *
+ * Раз в интервал, если в эфире давно не было подтверждённых обменов, пульт посылает короткий опрос
+ * CMD_GET_STATUS. Ответ приёмника обновляет rxOnline и relayIsOn, а метрики линка едут в тех же пакетах.
+ * Если фактическое состояние реле разошлось с последней целью пользователя — цель ставится заново
+ * через коалесцер команд (MyCommands), и расхождение исправляется само.
+ *
+ * Интервал опроса:
+ *  - нет связи                     -> RECONCILE_INTERVAL_MIN (быстро заметить восстановление);
+ *  - связь есть                    -> от MIN до MAX пропорционально запасу SNR линка;
+ *  - низкий заряд батареи          -> RECONCILE_INTERVAL_MAX;
+ *  - в любом случае не чаще, чем позволяет бюджет эфира RECONCILE_AIRTIME_BUDGET.
+ */
+class Reconciler {
+public:
+    /**
+     * @brief Вызывать из loop(). Если подошло время — один опрос приёмника (блокирует до TIMEOUT_WAITING_RX)
+     *
+     * @param onTick - фоновая задача на время ожидания ответа
+     */
+    void service(void (*onTick)() = nullptr);
+
+    /**
+     * @brief Обработчик изменения статуса (связь появилась/пропала или реле переключилось не нами)
+     */
+    void setStatusChangeHandler(void (*handler)());
+
+    /**
+     * @brief Кадр, принятый между обменами. Объявление приёмника о включении (ACK_RX_BOOT) обновляет связь и
+     * реле без опроса, а расхождение с целью пользователя исправляется сразу
+     *
+     * @return true - кадр разобран
+     */
+    bool onFrame(const String& frame);
+
+    void setLowBattery(bool low); // Низкий заряд: опрашиваем как можно реже
+    uint32_t currentInterval();   // Текущий интервал опроса (мс) с учётом линка, батареи и бюджета эфира
+
+    uint32_t pollCount = 0;  // Сколько опросов отправлено
+    uint32_t driftCount = 0; // Сколько раз находили расхождение с целью пользователя
+    uint32_t receiverBoots = 0; // Сколько раз приёмник объявлял о включении
+
+private:
+    uint32_t budgetInterval(); // Не чаще бюджета эфира (мс); пересчёт только после смены настроек радио
+
+    unsigned long _lastPoll = 0;
+    bool _lowBattery = false;
+    uint32_t _budgetMs = 0;
+    uint16_t _budgetRevision = 0;
+    bool _budgetValid = false;
+    void (*_onStatusChange)() = nullptr;
+};
+
+extern Reconciler MyReconciler;
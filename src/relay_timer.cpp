@@ -0,0 +1,448 @@
+#include "relay_timer.h"
+
+#ifdef RELAY_TIMER_USED
+
+#include "radiomodem.h"
+#include "command_engine.h"
+#include "logger.h"
+#include "fast_boot.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include <Preferences.h>
+  #include <esp_timer.h>
+  #include <freertos/FreeRTOS.h>
+  static Preferences timerStore; // Отдельное пространство NVS "timer"
+  static esp_timer_handle_t timerHandle = nullptr;
+  // Шаг идёт в задаче esp_timer, приём расписания — в loop(): состояние меняем под замком
+  static portMUX_TYPE timerMux = portMUX_INITIALIZER_UNLOCKED;
+  #define TIMER_LOCK() portENTER_CRITICAL(&timerMux)
+  #define TIMER_UNLOCK() portEXIT_CRITICAL(&timerMux)
+#elif defined(ARDUINO_ARCH_ESP8266)
+  #include <EEPROM.h>
+  extern "C" {
+    #include <osapi.h>
+  }
+  static os_timer_t timerHandle;
+  // os_timer вызывается между итерациями loop(), а не посреди них — замок не нужен
+  #define TIMER_LOCK()
+  #define TIMER_UNLOCK()
+#else
+  #define TIMER_LOCK()
+  #define TIMER_UNLOCK()
+#endif
+
+#define RELAY_TIMER_MAGIC 0x544D5201UL  // "TMR" + версия записи
+#define RELAY_TIMER_MAX_ARM_MS 3600000UL // os_timer не взводится дольше ~1.9 ч: длинный шаг — несколькими взводами
+
+RelayTimer MyRelayTimer;
+
+// Запись во flash: расписание и сколько его уже отработано
+struct StoredSchedule {
+    uint32_t magic;
+    RelaySchedule schedule;
+    uint32_t elapsedMs;
+};
+
+#if defined(ARDUINO_ARCH_ESP8266)
+static_assert(EEPROM_ADDR_TIMER + sizeof(StoredSchedule) <= EEPROM_SIZE, "EEPROM_SIZE is too small for the relay schedule");
+#endif
+
+
+
+uint32_t RelaySchedule::totalMs() const {
+    if (count == 0) return delayMs;
+    return delayMs + (uint32_t)(count - 1) * (onMs + offMs) + onMs;
+}
+
+
+
+/**
+ * @brief Расписание, которое приёмник возьмётся исполнять: шаги не короче RELAY_TIMER_MIN_STEP_MS,
+ * целиком — не длиннее RELAY_TIMER_MAX_MS
+ */
+static bool scheduleValid(const RelaySchedule& s) {
+    if (s.count == 0) return s.delayMs <= RELAY_TIMER_MAX_MS;
+    if (s.onMs < RELAY_TIMER_MIN_STEP_MS) return false;
+    if (s.count > 1 && s.offMs < RELAY_TIMER_MIN_STEP_MS) return false;
+    uint64_t total = (uint64_t)s.delayMs + (uint64_t)(s.count - 1) * ((uint64_t)s.onMs + s.offMs) + s.onMs;
+    return total <= RELAY_TIMER_MAX_MS;
+}
+
+
+
+#ifdef RECEIVER
+/**
+ * @brief "P_<пауза>_<вкл>_<выкл>_<раз>" или "S_<пауза>_<1|0>" (без CMD_TIMER)
+ */
+static bool parseSchedule(const String& body, RelaySchedule& s) {
+    if (body.length() < 3 || body[1] != '_') return false;
+    uint32_t v[4];
+    uint8_t n = 0;
+    unsigned pos = 2;
+    while (pos <= body.length()) {
+        int end = body.indexOf('_', pos);
+        if (end < 0) end = body.length();
+        if ((unsigned)end == pos || n == 4) return false;
+        v[n++] = strtoul(body.substring(pos, end).c_str(), nullptr, 10);
+        pos = end + 1;
+    }
+
+    s = RelaySchedule();
+    if (body[0] == 'P' && n == 4 && v[3] >= 1 && v[3] <= 0xFFFF) {
+        s.delayMs = v[0];
+        s.onMs = v[1];
+        s.offMs = v[2];
+        s.count = (uint16_t)v[3];
+    } else if (body[0] == 'S' && n == 2) {
+        s.delayMs = v[0];
+        s.finalOn = v[1] != 0;
+    } else {
+        return false;
+    }
+    return scheduleValid(s);
+}
+
+
+
+static String describe(const RelaySchedule& s) {
+    if (s.count == 0) return String(s.finalOn ? "ON" : "OFF") + " after " + String(s.delayMs) + " ms";
+    return String(s.count) + " x (" + String(s.onMs) + " ms on, " + String(s.offMs) + " ms off) after " + String(s.delayMs) + " ms";
+}
+
+
+
+void RelayTimer::onTimer(void* arg) {
+    static_cast<RelayTimer*>(arg)->step();
+}
+
+
+
+void RelayTimer::arm(uint32_t ms) {
+    if (ms > RELAY_TIMER_MAX_ARM_MS) ms = RELAY_TIMER_MAX_ARM_MS; // Проснёмся раньше и взведём ещё раз
+    if (ms == 0) ms = 1;
+    #if defined(ARDUINO_ARCH_ESP32)
+        esp_timer_stop(timerHandle); // Не взведён — вернёт ошибку, это нормально
+        esp_timer_start_once(timerHandle, (uint64_t)ms * 1000);
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        os_timer_disarm(&timerHandle);
+        os_timer_arm(&timerHandle, ms, false);
+    #endif
+}
+
+
+
+/**
+ * @brief Состояние реле по времени от начала расписания. Вызывается таймером и при запуске;
+ * лишний вызов ничего не портит — всё считается заново от _startMs
+ */
+void RelayTimer::step() {
+    uint32_t next = 0;
+    bool done = false;
+
+    TIMER_LOCK();
+    if (!_active) {
+        TIMER_UNLOCK();
+        return;
+    }
+    const RelaySchedule& s = _schedule;
+    uint32_t elapsed = millis() - _startMs;
+    bool on = MyRadio.relayIsOn;
+    if (elapsed < s.delayMs) {
+        next = s.delayMs - elapsed; // Пауза: реле как было
+    } else if (s.count == 0) {
+        on = s.finalOn;
+        done = true;
+    } else {
+        uint32_t period = s.onMs + s.offMs;
+        uint32_t into = elapsed - s.delayMs;
+        uint32_t pulse = into / period;
+        uint32_t phase = into - pulse * period;
+        if (pulse >= s.count || (pulse == s.count - 1u && phase >= s.onMs)) {
+            on = false; // Последний импульс кончился — выключено
+            done = true;
+        } else if (phase < s.onMs) {
+            on = true;
+            next = s.onMs - phase;
+        } else {
+            on = false;
+            next = period - phase;
+        }
+    }
+
+    if (on != MyRadio.relayIsOn) {
+        MyFastBoot.writeRelay(on); // Пин и копия в RTC: после сброса реле вернётся таким
+        MyRadio.relayIsOn = on;
+        transitions++;
+    }
+    if (done) {
+        _active = false;
+        _finished = true; // Сохранение — из loop(): из таймера во flash не пишем
+    }
+    TIMER_UNLOCK();
+
+    if (!done) arm(next);
+}
+
+
+
+void RelayTimer::store(bool commit) {
+    StoredSchedule stored = {};
+    TIMER_LOCK();
+    if (_active) {
+        stored.magic = RELAY_TIMER_MAGIC;
+        stored.schedule = _schedule;
+        stored.elapsedMs = millis() - _startMs;
+    }
+    TIMER_UNLOCK();
+    _checkpointMs = millis();
+
+    #if defined(ARDUINO_ARCH_ESP32)
+        (void)commit; // NVS пишет сразу
+        timerStore.putBytes("s", &stored, sizeof(stored));
+        MyFastBoot.saveRelay(MyRadio.relayIsOn); // Реле могло переключиться по таймеру
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        EEPROM.put(EEPROM_ADDR_TIMER, stored);
+        EEPROM.write(EEPROM_ADDR_RELAY, MyRadio.relayIsOn ? 1 : 0); // Реле могло переключиться по таймеру
+        if (commit) EEPROM.commit();
+    #else
+        (void)commit; (void)stored;
+    #endif
+}
+
+
+
+void RelayTimer::begin() {
+    StoredSchedule stored = {};
+    #if defined(ARDUINO_ARCH_ESP32)
+        esp_timer_create_args_t args = {};
+        args.callback = onTimer;
+        args.arg = this;
+        args.name = "relay_timer";
+        esp_timer_create(&args, &timerHandle);
+        timerStore.begin("timer", false);
+        if (timerStore.getBytesLength("s") == sizeof(stored)) timerStore.getBytes("s", &stored, sizeof(stored));
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        os_timer_setfn(&timerHandle, onTimer, this);
+        EEPROM.get(EEPROM_ADDR_TIMER, stored);
+    #endif
+
+    if (stored.magic != RELAY_TIMER_MAGIC || !scheduleValid(stored.schedule)) return;
+    _schedule = stored.schedule;
+    _startMs = millis() - stored.elapsedMs;
+    _checkpointMs = millis();
+    _active = true;
+    step(); // Кончилось, пока питания не было, — доделает и сохранит service()
+    print_log("[TIMER]", "Resumed " + describe(_schedule) + " at " + String(stored.elapsedMs) + " ms");
+}
+
+
+
+void RelayTimer::service(void (*onTick)()) {
+    (void)onTick;
+    if (_finished) {
+        _finished = false;
+        store(true);
+        print_log("[TIMER]", String("Schedule done, relay ") + (MyRadio.relayIsOn ? "ON" : "OFF"));
+    } else if (_active && millis() - _checkpointMs >= RELAY_TIMER_CHECKPOINT_MS) {
+        store(true);
+    }
+    save(); // Страховка: изменение, после которого save() ещё не вызывали
+}
+
+
+
+bool RelayTimer::accept(const String& message) {
+    if (!message.startsWith(CMD_TIMER)) return false;
+    String body = message.substring(strlen(CMD_TIMER));
+    if (body == "C") {
+        cancel();
+        return true;
+    }
+
+    RelaySchedule schedule;
+    if (!parseSchedule(body, schedule)) {
+        print_log("[TIMER]", "Rejected " + message); // Без ответа: у пульта другие RELAY_TIMER_* в settings.h
+        return false;
+    }
+    TIMER_LOCK();
+    _schedule = schedule;
+    _startMs = millis();
+    _active = true;
+    _finished = false;
+    TIMER_UNLOCK();
+    step();
+    _unsaved = true; // Во flash — после ответа пульту
+    print_log("[TIMER]", "Started " + describe(schedule));
+    return true;
+}
+
+
+
+String RelayTimer::ackToken() {
+    uint32_t left = 0;
+    TIMER_LOCK();
+    if (_active) left = _schedule.totalMs() - (millis() - _startMs);
+    TIMER_UNLOCK();
+    return String(ACK_TIMER) + (MyRadio.relayIsOn ? "1_" : "0_") + String(left);
+}
+
+
+
+void RelayTimer::cancel() {
+    TIMER_LOCK();
+    bool wasActive = _active;
+    _active = false;
+    _finished = false;
+    TIMER_UNLOCK();
+    if (!wasActive) return;
+    _unsaved = true; // Во flash — после ответа пульту
+    print_log("[TIMER]", "Cancelled");
+}
+
+
+
+bool RelayTimer::save() {
+    if (!_unsaved) return false;
+    _unsaved = false;
+    store(true);
+    return true;
+}
+
+
+
+bool RelayTimer::onAck(const String& response) {
+    (void)response;
+    return MyRadio.relayIsOn;
+}
+#else
+// Пульт: реле здесь нет, расписание только отправляется
+void RelayTimer::begin() {}
+void RelayTimer::step() {}
+void RelayTimer::arm(uint32_t ms) { (void)ms; }
+void RelayTimer::store(bool commit) { (void)commit; }
+void RelayTimer::onTimer(void* arg) { (void)arg; }
+bool RelayTimer::accept(const String& message) { (void)message; return false; }
+String RelayTimer::ackToken() { return String(); }
+void RelayTimer::cancel() {}
+bool RelayTimer::save() { return false; }
+
+
+
+static String scheduleFrame(const RelaySchedule& s) {
+    if (s.count == 0) return String(CMD_TIMER) + "S_" + String(s.delayMs) + "_" + String(s.finalOn ? 1 : 0);
+    return String(CMD_TIMER) + "P_" + String(s.delayMs) + "_" + String(s.onMs) + "_" + String(s.offMs) + "_" + String(s.count);
+}
+
+
+
+void RelayTimer::service(void (*onTick)()) {
+    if (!_pending || MyRadio.isProcessing) return;
+    _pending = false;
+    _acked = false;
+    bool delivered = MyRadio.sendCommandAndWaitAck(_frame, onTick) && _acked;
+    // Дальше реле ведёт расписание приёмника — фоновая сверка не должна возвращать его к прошлой цели
+    if (delivered) MyCommands.hasDesired = false;
+
+    if (_reply == nullptr) return;
+    if (!delivered) _reply("TIMER: no reply from receiver");
+    else _reply(String("TIMER accepted: relay ") + (_lastRelayOn ? "ON" : "OFF") + ", " + String(_lastRemainingMs) + " ms left");
+}
+
+
+
+bool RelayTimer::onAck(const String& response) {
+    unsigned pos = strlen(ACK_TIMER);
+    _lastRelayOn = response.length() > pos && response[pos] == '1';
+    _lastRemainingMs = response.length() > pos + 2 ? strtoul(response.substring(pos + 2).c_str(), nullptr, 10) : 0;
+    _lastAckMs = millis();
+    _acked = true;
+    return _lastRelayOn;
+}
+
+
+
+/**
+ * @brief "10m", "30s", "2h" или просто мс
+ */
+static bool parseDuration(const String& text, uint32_t& ms) {
+    if (text.length() == 0 || text[0] < '0' || text[0] > '9') return false;
+    char* end = nullptr;
+    uint64_t value = strtoul(text.c_str(), &end, 10);
+    if (*end == 's') value *= 1000;
+    else if (*end == 'm') value *= 60000;
+    else if (*end == 'h') value *= 3600000;
+    else if (*end != '\0') return false;
+    if (*end != '\0' && end[1] != '\0') return false;
+    if (value > RELAY_TIMER_MAX_MS) return false;
+    ms = (uint32_t)value;
+    return true;
+}
+#endif
+
+
+
+// Команда "timer"
+bool RelayTimer::handleCommand(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd != "timer" && !cmd.startsWith("timer ")) return false;
+
+    #ifdef TRANSMITTER
+        String args[6];
+        uint8_t n = 0;
+        unsigned pos = 6;
+        while (pos < cmd.length() && n < 6) {
+            int end = cmd.indexOf(' ', pos);
+            if (end < 0) end = cmd.length();
+            if ((unsigned)end > pos) args[n++] = cmd.substring(pos, end);
+            pos = end + 1;
+        }
+
+        if (n == 0) {
+            if (!_acked) reply("TIMER: no schedule sent yet");
+            else {
+                uint32_t since = millis() - _lastAckMs;
+                reply(String("TIMER last reply: relay ") + (_lastRelayOn ? "ON" : "OFF") + ", ends in ~" +
+                      String(since < _lastRemainingMs ? _lastRemainingMs - since : 0) + " ms");
+            }
+            return true;
+        }
+
+        RelaySchedule s;
+        uint32_t value;
+        bool ok = false;
+        if (args[0] == "cancel" && n == 1) {
+            _frame = String(CMD_TIMER) + "C";
+            ok = true;
+        } else if (args[0] == "on" && n == 2 && parseDuration(args[1], s.onMs)) {
+            s.count = 1;
+            ok = scheduleValid(s);
+        } else if (args[0] == "delay" && n == 3 && parseDuration(args[1], s.delayMs) && (args[2] == "on" || args[2] == "off")) {
+            s.finalOn = args[2] == "on";
+            ok = scheduleValid(s);
+        } else if (args[0] == "pulse" && (n == 4 || n == 5) && parseDuration(args[1], s.onMs) && parseDuration(args[2], s.offMs) &&
+                   parseDuration(args[3], value) && value >= 1 && value <= 0xFFFF && (n == 4 || parseDuration(args[4], s.delayMs))) {
+            s.count = (uint16_t)value;
+            ok = scheduleValid(s);
+        }
+        if (!ok) {
+            reply("Usage: timer on <t> | timer delay <t> on|off | timer pulse <on> <off> <count> [delay] | timer cancel "
+                  "(t in ms or 10s/5m/2h, steps >= " + String(RELAY_TIMER_MIN_STEP_MS) + " ms, total <= " +
+                  String(RELAY_TIMER_MAX_MS / 3600000) + " h)");
+            return true;
+        }
+        if (args[0] != "cancel") _frame = scheduleFrame(s);
+        _reply = reply;
+        _pending = true; // Уйдёт из service(), когда эфир свободен
+    #else
+        if (cmd != "timer") return false;
+        TIMER_LOCK();
+        bool active = _active;
+        RelaySchedule s = _schedule;
+        uint32_t elapsed = millis() - _startMs;
+        TIMER_UNLOCK();
+        if (active) reply("TIMER " + describe(s) + ", " + String(s.totalMs() - elapsed) + " ms left, transitions " + String(transitions));
+        else reply("TIMER idle, transitions " + String(transitions));
+    #endif
+    return true;
+}
+
+#endif
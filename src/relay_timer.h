@@ -0,0 +1,121 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * РАСПИСАНИЯ РЕЛЕ НА ПРИЁМНИКЕ
+ *
+ * "Включить нагрузку на 10 минут" раньше означало две команды: RELAY_ON сейчас и RELAY_OFF потом —
+ * два обмена, пульт рядом, и надежда, что второй дойдёт. С RELAY_TIMER_USED пульт отправляет одно
+ * расписание, а время отсчитывает приёмник:
+ *
+ *   "TMR_P_<пауза>_<вкл>_<выкл>_<раз>"  пауза, затем <раз> импульсов: <вкл> мс включено, <выкл> мс выключено.
+ *                                        "включить на 10 минут" — TMR_P_0_600000_0_1
+ *   "TMR_S_<пауза>_<1|0>"                через <паузу> мс включить или выключить
+ *   "TMR_C"                              отменить расписание (реле остаётся как есть)
+ *
+ * Приёмник отвечает "TMR_OK_<реле 1|0>_<сколько мс осталось>" — пульт знает, что расписание принято
+ * и когда оно кончится. Реле переключает аппаратный таймер (esp_timer на ESP32, os_timer на ESP8266),
+ * а не loop(): запись во flash, обмен по радио или скан каналов шаг не сдвигают. Состояние реле каждый раз
+ * вычисляется по времени от начала расписания, поэтому ошибка не накапливается от импульса к импульсу.
+ *
+ * Расписание и его ход сохраняются во flash после ответа на команду, раз в RELAY_TIMER_CHECKPOINT_MS и по окончании.
+ * После перезагрузки приёмник продолжает с последней сохранённой точки. Время без питания не считается:
+ * нагрузка отработает своё, но закончит позже. Команды RELAY_ON/RELAY_OFF (и групповые) отменяют
+ * расписание — ручное управление главнее.
+ *
+ * Пульт: "timer on <время>", "timer delay <время> on|off", "timer pulse <вкл> <выкл> <раз> [пауза]",
+ * "timer cancel", "timer" — последний ответ. Время в мс или с суффиксом s, m, h ("10m").
+ * Приёмник: "timer" — текущее расписание.
+ */
+
+#ifdef RELAY_TIMER_USED
+
+struct RelaySchedule {
+    uint32_t delayMs = 0; // Пауза до первого шага
+    uint32_t onMs = 0;    // Импульс: сколько включено
+    uint32_t offMs = 0;   // Импульс: сколько выключено между импульсами
+    uint16_t count = 0;   // Импульсов; 0 — не импульсы, а переключение в finalOn после паузы
+    uint8_t finalOn = 0;  // Состояние после паузы (count == 0)
+
+    uint32_t totalMs() const; // Длительность расписания целиком
+};
+
+class RelayTimer {
+public:
+    /**
+     * @brief Приёмник: восстановить сохранённое расписание. Вызывать после восстановления состояния реле
+     */
+    void begin();
+
+    /**
+     * @brief Вызывать из loop(). Приёмник: сохранение хода расписания. Пульт: отправка расписания из команды
+     */
+    void service(void (*onTick)() = nullptr);
+
+    /**
+     * @brief Приёмник: разбор и запуск расписания (или отмена)
+     *
+     * @param message - принятый токен
+     * @return true - это команда расписания, ответ — ackToken()
+     */
+    bool accept(const String& message);
+
+    String ackToken(); // Приёмник: "TMR_OK_<реле>_<осталось мс>"
+
+    /**
+     * @brief Приёмник: отменить расписание (ручная команда реле). Реле не трогает
+     */
+    void cancel();
+
+    /**
+     * @brief Приёмник: сохранить расписание, принятое или отменённое командой. Вызывать после ответа
+     * пульту — запись NVS длится до сотен мс и не должна съедать его ожидание
+     *
+     * @return true - записано (вместе с состоянием реле)
+     */
+    bool save();
+
+    /**
+     * @brief Пульт: разбор ответа приёмника
+     *
+     * @param response - ответ без метрик линка, начинается с ACK_TIMER
+     * @return true - реле приёмника сейчас включено
+     */
+    bool onAck(const String& response);
+
+    /**
+     * @brief Пульт: "timer ..." — отправить расписание. Приёмник: "timer" — текущее расписание
+     */
+    bool handleCommand(const String& cmd, void (*reply)(const String& line));
+
+    bool active() { return _active; }
+
+    uint32_t transitions = 0; // Приёмник: переключений реле по расписаниям
+
+private:
+    void step();              // Приёмник: реле по времени от начала расписания и взвод таймера на следующий шаг
+    void arm(uint32_t ms);
+    void store(bool commit);  // Приёмник: расписание и его ход во flash
+    static void onTimer(void* arg);
+
+    RelaySchedule _schedule;
+    volatile bool _active = false;
+    volatile bool _finished = false; // Таймер дошёл до конца — сохранить из loop()
+    bool _unsaved = false;           // Команда изменила расписание — сохранить после ответа (save())
+    unsigned long _startMs = 0;      // millis() начала расписания (с поправкой на ход до перезагрузки)
+    unsigned long _checkpointMs = 0; // millis() последнего сохранения хода
+
+    // Пульт
+    bool _pending = false;
+    String _frame;
+    void (*_reply)(const String& line) = nullptr;
+    bool _lastRelayOn = false;
+    uint32_t _lastRemainingMs = 0;
+    unsigned long _lastAckMs = 0;
+    bool _acked = false;
+};
+
+extern RelayTimer MyRelayTimer;
+
+#endif
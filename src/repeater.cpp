@@ -0,0 +1,124 @@
+#include "repeater.h"
+
+#ifdef REPEATER
+
+#include "radiomodem.h"
+#include "channel_plan.h"
+#include "output_display.h"
+#include "logger.h"
+
+Repeater MyRepeater;
+
+// Кадр в очереди на пересылку (TTL уже уменьшен)
+struct PendingFrame {
+    uint8_t data[RADIO_MAX_FRAME_LENGTH];
+    uint8_t length = 0;      // 0 — ячейка свободна
+    unsigned long due = 0;   // millis(), когда передавать
+};
+
+static PendingFrame queue[REPEATER_QUEUE_SIZE];
+static uint32_t cache[REPEATER_CACHE_SIZE]; // (id отправителя << 16) | счётчик; 0 не встречается — счётчик с 1
+static uint8_t cacheNext = 0;
+
+
+
+bool Repeater::seen(uint8_t sender, uint16_t counter) {
+    uint32_t key = ((uint32_t)sender << 16) | counter;
+    for (uint8_t i = 0; i < REPEATER_CACHE_SIZE; i++) {
+        if (cache[i] == key) return true;
+    }
+    cache[cacheNext] = key;
+    cacheNext = (cacheNext + 1) % REPEATER_CACHE_SIZE;
+    return false;
+}
+
+
+
+/**
+ * @brief Новый кадр из эфира: отсев дублей, TTL, постановка в очередь со случайной паузой
+ */
+void Repeater::accept(uint8_t* frame, size_t length) {
+    if (length < AUTH_OVERHEAD + 1) { rejected++; return; }
+    heard++;
+    #ifdef CHANNEL_PLAN_USED
+        MyChannels.recordRx(); // Пара жива на этом канале
+    #endif
+
+    size_t header = length - 1 - AUTH_OVERHEAD; // Начало заголовка подписи
+    uint16_t counter = (uint16_t)(frame[header + 1] | (frame[header + 2] << 8));
+    if (seen(frame[header], counter)) { duplicates++; return; }
+
+    uint8_t& ttl = frame[length - 1];
+    if (ttl == 0) { expired++; return; }
+    ttl--;
+
+    for (PendingFrame& slot : queue) {
+        if (slot.length != 0) continue;
+        memcpy(slot.data, frame, length);
+        slot.length = (uint8_t)length;
+        slot.due = millis() + random(REPEATER_JITTER_MIN, REPEATER_JITTER_MAX + 1);
+        return;
+    }
+    dropped++;
+}
+
+
+
+/**
+ * @brief Пересылка кадров, у которых вышла пауза. Пока идёт передача, эфир не слушаем — как и все узлы
+ */
+void Repeater::transmitDue() {
+    for (PendingFrame& slot : queue) {
+        if (slot.length == 0 || (long)(millis() - slot.due) < 0) continue;
+
+        int state = MyRadio.sendRaw(slot.data, slot.length);
+        if (state == RADIOLIB_ERR_NONE) forwarded++;
+        else log_radio_event(state, "Forward failed");
+        #ifdef CHANNEL_PLAN_USED
+            MyChannels.follow(slot.data, slot.length); // Уже переслав: ответ CH_OK уходит на старом канале, потом переходим сами
+        #endif
+        slot.length = 0;
+        MyRadio.startListening();
+
+        display_print_status("REPEATER", "FWD " + String(forwarded) + " DUP " + String(duplicates) + "\nRSSI " +
+                                         String((int)MyRadio.lastRssi) + " SNR " + String((int)MyRadio.lastSnr));
+    }
+}
+
+
+
+void Repeater::service() {
+    if (MyRadio.isDataReady()) {
+        uint8_t frame[RADIO_MAX_FRAME_LENGTH];
+        size_t length;
+        if (MyRadio.receiveRaw(frame, length) == RADIOLIB_ERR_NONE) accept(frame, length);
+        else rejected++;
+    }
+
+    transmitDue();
+
+    #ifdef CHANNEL_PLAN_USED
+        MyChannels.followTimeout();
+    #endif
+}
+
+
+
+// Команда "repeater"
+bool Repeater::handleCommand(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd != "repeater") return false;
+
+    uint8_t queued = 0;
+    for (const PendingFrame& slot : queue) {
+        if (slot.length != 0) queued++;
+    }
+    reply("REPEATER heard " + String(heard) + ", forwarded " + String(forwarded) + ", duplicates " +
+          String(duplicates) + ", TTL expired " + String(expired) + ", queue full " + String(dropped) +
+          ", rejected " + String(rejected));
+    reply("hop limit " + String(REPEATER_HOP_LIMIT) + ", jitter " + String(REPEATER_JITTER_MIN) + ".." +
+          String(REPEATER_JITTER_MAX) + " ms, queued " + String(queued) + "/" + String(REPEATER_QUEUE_SIZE) +
+          ", ack timeout at ends " + String(MyRadio.ackTimeout()) + " ms");
+    return true;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * РЕТРАНСЛЯТОР (роль REPEATER, формат кадров REPEATER_USED)
+ *
+ * При REPEATER_USED каждый кадр заканчивается байтом TTL:
+ *
+ *   [ полезная нагрузка ][ id отправителя ][ счётчик, 2 байта ][ подпись ][ TTL ]
+ *
+ * Пульт и приёмник отправляют кадр с TTL = REPEATER_HOP_LIMIT и отрезают TTL при приёме. Ретранслятор
+ * ключей не знает и кадр не проверяет: он принимает любой кадр, отсеивает уже виденные (ключ — id
+ * отправителя и счётчик из заголовка подписи), уменьшает TTL и пересылает кадр через случайную паузу
+ * REPEATER_JITTER_MIN..MAX, чтобы два ретранслятора, услышавшие один кадр, не передавали его одновременно.
+ * Кадр с TTL = 0 дальше не идёт. TTL не входит в подпись — его и так меняет каждый ретранслятор.
+ *
+ * Подтверждение остаётся сквозным: ответ приёмника — обычный подписанный кадр, он идёт к пульту тем же
+ * путём. Пульт ждёт его дольше (RadioManager::ackTimeout). Копии, пришедшие разными путями, конечные
+ * узлы отбрасывают по счётчику (AUTH_ERR_DUPLICATE), команда исполняется один раз.
+ *
+ * С планом каналов ретранслятор ведёт себя как приёмник (помеха, обход) и переходит вместе с парой:
+ * переслав "CH_<n>", он переходит после пересылки ответа CH_OK или по истечении времени ожидания ответа.
+ *
+ * Команда "repeater" — счётчики.
+ */
+
+#define REPEATER_ERR_NO_TTL (-1301) // Кадр короче заголовка подписи и TTL — не из этой сети
+
+#ifdef REPEATER
+
+class Repeater {
+public:
+    /**
+     * @brief Вызывать из loop(): приём, отсев дублей, очередь пересылки
+     */
+    void service();
+
+    /**
+     * @brief Команда "repeater": принято, переслано, дубли, истёкший TTL, переполнение очереди
+     */
+    bool handleCommand(const String& cmd, void (*reply)(const String& line));
+
+    uint32_t heard = 0;      // Принято кадров без ошибок
+    uint32_t forwarded = 0;  // Переслано
+    uint32_t duplicates = 0; // Уже пересылали (или слышим свою же пересылку от соседа)
+    uint32_t expired = 0;    // TTL кончился
+    uint32_t dropped = 0;    // Очередь была полна
+    uint32_t rejected = 0;   // Слишком короткий кадр или ошибка приёма
+
+private:
+    void accept(uint8_t* frame, size_t length);
+    bool seen(uint8_t sender, uint16_t counter); // Проверяет кэш и запоминает ключ
+    void transmitDue();
+};
+
+extern Repeater MyRepeater;
+
+#endif
@@ -0,0 +1,41 @@
+#include "rgb_led.h"
+
+
+
+void WriteColorPixel(COLORS_RGB_LED color, uint8_t level)
+{
+    #ifdef ARDUINO_ARCH_ESP32
+    // ЛОГИКА ДЛЯ ESP32 (RGB NeoPixel)
+        uint8_t value = (uint16_t)RGB_BRIGHTNESS * level / 255;
+        switch (color)
+        {
+        case COLORS_RGB_LED::red :
+            neopixelWrite(LED_PIN,0,value,0); // Red
+            break;
+        case COLORS_RGB_LED::green:
+            neopixelWrite(LED_PIN,value,0,0); // Green
+            break;
+        case COLORS_RGB_LED::blue:
+            neopixelWrite(LED_PIN,0,0,value); // Blue
+            break;
+        case COLORS_RGB_LED::black:
+            neopixelWrite(LED_PIN,0,0,0); // Off / black
+            break;
+
+        default:
+            break;
+        }
+
+    #elif defined(ARDUINO_ARCH_ESP8266)
+
+        // ЛОГИКА ДЛЯ ESP8266 (Обычный светодиод/Реле) логику обработки выставляем следующую:
+        // HIGH - выключено, LOW - включено (речь идёт о реле , светодид как-бы между прочим будет)
+        if (color == COLORS_RGB_LED::black || level == 0) {
+            digitalWrite(LED_PIN, HIGH); // Выключено (подтянуто к плюсу)
+        } else {
+            digitalWrite(LED_PIN, LOW);  // Включено (любой активный статус)
+        }
+
+    #endif
+
+}
@@ -27,42 +27,13 @@ enum class COLORS_RGB_LED
 
 
 
-void WriteColorPixel(COLORS_RGB_LED color)
-{
-    #ifdef ARDUINO_ARCH_ESP32    
-    // ЛОГИКА ДЛЯ ESP32 (RGB NeoPixel)
-        switch (color)
-        {
-        case COLORS_RGB_LED::red :
-            neopixelWrite(LED_PIN,0,RGB_BRIGHTNESS,0); // Red
-            break;
-        case COLORS_RGB_LED::green:
-            neopixelWrite(LED_PIN,RGB_BRIGHTNESS,0,0); // Green  
-            break;
-        case COLORS_RGB_LED::blue:
-            neopixelWrite(LED_PIN,0,0,RGB_BRIGHTNESS); // Blue
-            break;
-        case COLORS_RGB_LED::black:
-            neopixelWrite(LED_PIN,0,0,0); // Off / black  
-            break;
-
-        default:
-            break;
-        }
-    
-    #elif defined(ARDUINO_ARCH_ESP8266)
-        
-        // ЛОГИКА ДЛЯ ESP8266 (Обычный светодиод/Реле) логику обработки выставляем следующую:
-        // HIGH - выключено, LOW - включено (речь идёт о реле , светодид как-бы между прочим будет)
-        if (color == COLORS_RGB_LED::black) {
-            digitalWrite(LED_PIN, HIGH); // Выключено (подтянуто к плюсу)
-        } else {
-            digitalWrite(LED_PIN, LOW);  // Включено (любой активный статус)
-        }
-
-    #endif
-    
-}
+/**
+ * @brief Цвет встроенного светодиода. Из loop() не вызывать — светодиодом управляет MyFeedback (feedback.h)
+ *
+ * @param color - цвет
+ * @param level - доля RGB_BRIGHTNESS, 0..255 (на ESP8266 — просто вкл/выкл)
+ */
+void WriteColorPixel(COLORS_RGB_LED color, uint8_t level = 255);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "serial_console.h"
+#include "host_link.h"
+
+#define CONSOLE_LINE_MAX 64 // Самая длинная команда ("timer pulse <вкл> <выкл> <раз> <пауза>" в мс) с запасом
+
+/**
+ * @brief Неблокирующий сбор строк из Serial
+ *
+ * @param handler - обработчик полной строки
+ */
+void console_poll(void (*handler)(const String& line)) {
+    #ifdef DEBUG_PRINT
+    static char line[CONSOLE_LINE_MAX];
+    static uint8_t length = 0;
+    static bool overflow = false; // Строка длиннее буфера: выполнять обрезанную нельзя — отвергаем целиком
+
+    #ifdef HOST_LINK_USED
+        if (MyHost.active()) {
+            MyHost.poll(); // Хост поздоровался: вход — только кадры хоста
+            return;
+        }
+    #endif
+    while (Serial.available() > 0) {
+        char c = (char)Serial.read();
+        #ifdef HOST_LINK_USED
+            if (MyHost.feed((uint8_t)c)) {
+                if (MyHost.active()) return; // Это был HELLO — остальное прочитает MyHost.poll()
+                continue;
+            }
+        #endif
+        if (c != '\n' && c != '\r') {
+            if (length < sizeof(line) - 1) line[length++] = c;
+            else overflow = true;
+            continue;
+        }
+        if (overflow) {
+            overflow = false;
+            length = 0;
+            console_reply("Line too long (max " + String(CONSOLE_LINE_MAX - 1) + " chars), ignored");
+            continue;
+        }
+        if (length == 0) continue;
+        line[length] = '\0';
+        length = 0;
+        handler(String(line));
+    }
+    #endif
+}
+
+
+void console_reply(const String& line) {
+    #ifdef HOST_LINK_USED
+        if (MyHost.active()) {
+            MyHost.log(line);
+            return;
+        }
+    #endif
+    #ifdef DEBUG_PRINT
+    Serial.println(line);
+    #endif
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * ТЕКСТОВАЯ КОНСОЛЬ В SERIAL
+ *
+ * Неблокирующий сбор строк из монитора порта. Каждая полная строка отдаётся обработчику,
+ * который сам решает, какому модулю она адресована (trace, soak и т.д.).
+ * Ответы модули пишут через console_reply — тем же способом, что и в BLE (построчно).
+ * С HOST_LINK_USED байт 0x00 начинает кадр двоичного протокола хоста (см. host_link.h): после HELLO
+ * вход читает MyHost, а вывод консоли уходит кадрами LOG.
+ */
+
+/**
+ * @brief Вызывать из loop(): читает всё, что пришло в Serial, и на каждую строку вызывает handler
+ *
+ * @param handler - обработчик строки (без \r\n)
+ */
+void console_poll(void (*handler)(const String& line));
+
+/**
+ * @brief Вывод строки ответа в Serial (подходит как writeLine для trace_dump и т.п.)
+ */
+void console_reply(const String& line);
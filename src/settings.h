@@ -9,8 +9,19 @@
 
 #define TRANSMITTER     //раскомментировать, если модуль будет использоваться как передатчик
 //#define RECEIVER      //раскомментировать, если модуль будет использоваться как приёмник
+//#define REPEATER      //раскомментировать, если модуль будет ретранслятором между пультом и приёмником (нужен REPEATER_USED)
+//#define SNIFFER       //раскомментировать, если модуль будет сниффером: только слушает эфир и отдаёт кадры на ПК (см. sniffer.h)
 
 #define DEBUG_PRINT     //раскомментировать для включения отладочного вывода в Serial Monitor
+#define TRACE_USED      //раскомментировать для трассировки задержек (кольцевой буфер меток времени, см. trace.h)
+#define TRACE_BUFFER_SIZE 128 // Сколько последних меток хранить (12 байт ОЗУ на метку)
+
+// Контроль здоровья системы (см. health.h): куча, стеки задач, длительность итераций loop()
+#define HEALTH_SAMPLE_INTERVAL 5000   // Как часто снимать показания кучи и стеков (мс)
+#define HEALTH_WARN_FREE_HEAP 20000   // Предупреждение: свободной кучи меньше (байт)
+#define HEALTH_WARN_MAX_BLOCK 8000    // Предупреждение: самый большой свободный блок меньше (байт) — фрагментация
+#define HEALTH_WARN_STACK 512         // Предупреждение: запас стека задачи меньше (байт)
+#define HEALTH_WARN_LOOP_MS 1000      // Предупреждение: итерация loop() дольше (мс)
 
 //Дисплеи не используются в ESP8266 так как все пины заняты модемом и некоторыми задачами
 #if defined(ARDUINO_ARCH_ESP32)
@@ -19,12 +30,20 @@
 #endif
 
 
+// Светодиод и вибромотор (см. feedback.h): узоры отрабатывает таймер, loop() их не ждёт
+#define FEEDBACK_FADE_STEP_MS 20 // Шаг плавного изменения яркости (мс)
+
 #if defined(TRANSMITTER)
   #define VIBRO_USED      //раскомментировать для использования вибромотора при передаче
 #elif defined(RECEIVER)
   #define RELAY_USED      //раскомментировать, если будет использоваться реле
 #endif
 
+#if defined(TRANSMITTER)
+  #define BLE_DEFAULT_PASS "123456" // Пароль BLE, пока его не сменили командой setpass
+  #define BLE_PASS_MAX_LEN 32       // Максимальная длина пароля BLE (минимальная — 4)
+#endif
+
 
 
 #if defined(ARDUINO_ARCH_ESP32)
@@ -49,8 +68,226 @@
 
 #define CMD_RELAY_ON  "RELAY_ON"   // Команда на включение
 #define CMD_RELAY_OFF "RELAY_OFF"  // Команда на выключение
+#define ACK_RX_BOOT "RX_UP_"       // Приёмник включился и радио готово: "RX_UP_<реле 1|0>" (один раз, см. fast_boot.h)
 #define TIMEOUT_WAITING_TX 80      // Время ожидания приёмником пока передатчик переключается в режим приёма (мс)
 #define TIMEOUT_WAITING_RX 400    // Время ожидания передатчиком ответа от приёмника (мс)
+// Параметры радио, таймауты, id узла и пароль BLE выше — умолчания: действующие значения хранятся во flash
+// (см. site_config.h) и меняются командой "config" без перепрошивки
+
+// Метрики линка, которые едут "прицепом" в ответах и опросах: "RELAY_IS_ON|-87,9" = токен|RSSI,SNR
+// Сторона, принявшая пакет, сообщает, как она слышит отправителя. Отдельных пакетов под телеметрию нет.
+// С BATTERY_USED приёмник дописывает третье поле — напряжение своей батареи: "ACK_OK|-87,9,23150" (мВ)
+#define LINK_METRICS_SEPARATOR '|'
+
+// Телеметрия линка (см. link_telemetry.h): память фиксирована и растёт линейно с числом собеседников
+#if defined(ARDUINO_ARCH_ESP8266)
+  #define TELEMETRY_MAX_PEERS 1   // На ESP8266 ОЗУ мало — только один собеседник
+#else
+  #define TELEMETRY_MAX_PEERS 4   // Сколько собеседников отслеживать (~1 КБ ОЗУ на каждого)
+#endif
+#define TELEMETRY_WINDOW 16       // Длина скользящего окна последних отсчётов
+
+// Фоновая сверка состояния (только передатчик): периодически спрашиваем у приёмника статус реле,
+// чтобы "RELAY ONLINE" на экране не врал часами, и исправляем расхождение с последней целью пользователя.
+#if defined(TRANSMITTER) && defined(RELAY_GET_STATUS)
+  #define RECONCILER_USED               // закомментировать, чтобы отключить фоновую сверку
+  #define RECONCILE_INTERVAL_MIN 10000  // Минимальный интервал опроса (мс): плохой линк или нет ответа
+  #define RECONCILE_INTERVAL_MAX 120000 // Максимальный интервал опроса (мс): отличный линк или низкий заряд
+  #define RECONCILE_GOOD_SNR_MARGIN 10  // Запас SNR (дБ) над порогом демодуляции, при котором линк считается отличным
+  #define RECONCILE_AIRTIME_BUDGET 10   // Доля эфира на сверку в промилле (10 = 1%). Ограничивает интервал снизу
+#endif
+
+// Подпись кадров (см. frame_auth.h): AES-128-CMAC + счётчик против повторов. Без неё любое устройство
+// с тем же SyncWord может прислать RELAY_ON. Включать на ВСЕХ узлах сразу — неподписанные кадры отбрасываются.
+#define AUTH_USED
+#ifdef AUTH_USED
+  #define AUTH_TAG_LEN 4          // Байт подписи в кадре (обрезанный CMAC): 2^-32 шанс подделки с одной попытки
+  #define AUTH_OVERHEAD (3 + AUTH_TAG_LEN) // Вся добавка к кадру: id отправителя + 2 младших байта счётчика + подпись
+  #define AUTH_MAX_GAP 16384      // Насколько счётчик собеседника может убежать вперёд (потерянные кадры, перезагрузки)
+  #define AUTH_COUNTER_BLOCK 64   // Свой счётчик сохраняется раз в столько кадров (после сброса — скачок вперёд)
+
+  // Ключи пары и группы (AES-128) — в src/auth_keys.h, которого нет в git: ключи из общего репозитория знает
+  // каждый, и подпись с ними ничего не защищает. Создать (один файл на все узлы сети):
+  //     python3 tools/auth_keygen.py > src/auth_keys.h
+  // Формат — src/auth_keys.example.h. Хостовым инструментам (tools/) ключи не нужны — им хватает образца
+  #if __has_include("auth_keys.h")
+    #include "auth_keys.h"
+  #elif defined(ARDUINO)
+    #error "AUTH_USED needs your own keys: run python3 tools/auth_keygen.py > src/auth_keys.h"
+  #else
+    #include "auth_keys.example.h"
+  #endif
+  #if defined(ARDUINO) && defined(AUTH_KEYS_PLACEHOLDER)
+    #error "src/auth_keys.h holds the placeholder keys from auth_keys.example.h: run python3 tools/auth_keygen.py > src/auth_keys.h"
+  #endif
+
+  // Свой id и таблица собеседников {id, ключ пары}. Id пультов 0x01..0x7F, приёмников 0x80..0xFE
+  #if defined(TRANSMITTER)
+    #define AUTH_NODE_ID 0x01
+    #define AUTH_PEERS { {0x80, AUTH_KEY_REMOTE_1} }
+  #else
+    #define AUTH_NODE_ID 0x80
+    #define AUTH_PEERS { {0x01, AUTH_KEY_REMOTE_1} }
+  #endif
+#endif
+
+// Неявный заголовок LoRa (см. frame_profile.h): кадры фиксированной длины с однобайтовым кодом вместо текста.
+// Связь начинается явными кадрами и переходит на неявные после первого подтверждённого обмена
+#define FRAME_IMPLICIT_USED
+
+// Ретрансляция (см. repeater.h): к каждому кадру дописывается байт TTL, ретрансляторы пересылают кадры
+// между пультами и приёмниками вне прямой видимости. Включать на ВСЕХ узлах сети сразу — меняется формат кадра
+//#define REPEATER_USED
+#ifdef REPEATER_USED
+  #define REPEATER_HOP_LIMIT 3     // TTL нового кадра: через сколько ретрансляторов он может пройти
+  #define REPEATER_CACHE_SIZE 32   // Сколько последних кадров (отправитель + счётчик) помнить для отсева дублей
+  #define REPEATER_QUEUE_SIZE 4    // Кадров в очереди на пересылку
+  #define REPEATER_JITTER_MIN 10   // Пауза перед пересылкой — случайная от MIN до MAX (мс), чтобы соседние
+  #define REPEATER_JITTER_MAX 200  // ретрансляторы не накрывали друг друга одним и тем же кадром
+  #ifndef AUTH_USED
+    #error "REPEATER_USED needs AUTH_USED: duplicates are recognised by sender id and frame counter"
+  #endif
+  #undef FRAME_IMPLICIT_USED       // Ретранслятор не знает, в каком профиле сейчас пара, — только явные кадры
+#endif
+// Слоты TDMA (см. tdma.h): приёмник раз в суперкадр шлёт маяк с номером и картой слотов, пульты передают
+// только в начале своего слота (закреплённого или общего). Для нескольких пультов на один приёмник: ответ
+// приёмника больше не накрывает команда другого пульта. Включать на ВСЕХ узлах сразу
+//#define TDMA_USED
+#ifdef TDMA_USED
+  #define TDMA_SLOTS 8               // Слотов в суперкадре; слот 0 — маяк
+  #define TDMA_ASSIGNED_SLOTS 4      // Слоты 1..N закрепляются за пультами, остальные — общие (выбор случайный)
+  #define TDMA_SLOT_MS 500           // Длина слота (мс): защитный интервал + команда + TIMEOUT_WAITING_TX + ответ
+  #define TDMA_GUARD_MS 20           // Пульт начинает передачу через столько мс после начала слота (уход часов)
+  #define TDMA_ASSIGN_TIMEOUT 600000 // Пульт, не слышанный столько (мс), теряет закреплённый слот
+  #define TDMA_SYNC_LOST 4           // Столько суперкадров без маяка — синхронизации нет, пульт передаёт сразу, как без TDMA
+  #define CMD_BEACON "BCN_"          // Маяк: "BCN_<номер>_<опоздание, мс>_<id владельцев слотов, hex>"
+  #ifndef AUTH_USED
+    #error "TDMA_USED needs AUTH_USED: slots are assigned by sender id, beacons are signed with AUTH_KEY_GROUP"
+  #endif
+  #ifdef REPEATER_USED
+    #error "TDMA_USED and REPEATER_USED do not mix: a forwarded exchange does not fit into one slot"
+  #endif
+  #undef FRAME_IMPLICIT_USED        // Маяк слушают пульты в разных профилях — только явные кадры
+  #undef AUTH_COUNTER_BLOCK
+  #define AUTH_COUNTER_BLOCK 1024    // Маяк каждые несколько секунд: счётчики подписи во flash раз в час, а не в минуты
+#endif
+
+// Групповые команды (см. group_command.h): один кадр переключает все приёмники группы, каждый отвечает
+// в своём окне по порядку id, пульт повторяет команду только для не ответивших. Включать на ВСЕХ узлах сразу
+//#define GROUP_USED
+#ifdef GROUP_USED
+  #define CMD_GROUP "GRP_"           // Команда: "GRP_<группа>_ON|OFF_<маска приёмников, которых ждём, hex>"
+  #define ACK_GROUP "G_OK"           // Ответ члена группы (короткий — окна ответов узкие)
+  #define GROUP_FIRST_ID 0x80        // Id приёмника GROUP_FIRST_ID + i — бит i маски
+  #define GROUP_MAX_MEMBERS 32       // Приёмников в маске
+  #define GROUP_ACK_GUARD_MS 15      // Зазор между соседними окнами ответов (мс)
+  #define GROUP_RETRIES 2            // Повторов команды для не ответивших
+  #if defined(TRANSMITTER)
+    #define GROUP_TABLE { {1, 0x0000000F} } // {группа, маска приёмников}: группа 1 — приёмники 0x80..0x83
+  #else
+    #define GROUP_MEMBERSHIP 0x01    // В каких группах состоит приёмник: бит g-1 — группа g (1..32)
+  #endif
+  #ifndef AUTH_USED
+    #error "GROUP_USED needs AUTH_USED: confirmations are matched to receivers by sender id"
+  #endif
+  #ifdef REPEATER_USED
+    #error "GROUP_USED and REPEATER_USED do not mix: forwarding jitter breaks the reply windows"
+  #endif
+  #ifdef TDMA_USED
+    #error "GROUP_USED and TDMA_USED do not mix: the reply windows do not fit into one TDMA slot"
+  #endif
+  #undef FRAME_IMPLICIT_USED        // Групповую команду слушают приёмники в разных профилях — только явные кадры
+#endif
+
+// Расписания реле (см. relay_timer.h): "включить на 10 минут", "выключить через час", серии импульсов.
+// Приёмник отрабатывает их сам по аппаратному таймеру и помнит после перезагрузки — второй команды по радио не нужно
+#if !defined(REPEATER) && !defined(SNIFFER)
+  #define RELAY_TIMER_USED               // Ретранслятору и снифферу не нужно: они кадры не исполняют
+#endif
+#ifdef RELAY_TIMER_USED
+  #define CMD_TIMER "TMR_"               // "TMR_P_<пауза>_<вкл>_<выкл>_<раз>" — импульсы, "TMR_S_<пауза>_<1|0>" — переключить позже, "TMR_C" — отмена (мс)
+  #define ACK_TIMER "TMR_OK_"            // Ответ приёмника: "TMR_OK_<реле 1|0>_<до конца расписания, мс>"
+  #define RELAY_TIMER_MAX_MS 604800000UL // Самое длинное расписание (неделя)
+  #define RELAY_TIMER_MIN_STEP_MS 20     // Короче шага реле не отрабатывает (механика контактов)
+  #define RELAY_TIMER_CHECKPOINT_MS 300000 // Как часто сохранять ход расписания во flash (мс): столько его может повториться после сбоя питания
+#endif
+
+#if defined(REPEATER) && !defined(REPEATER_USED)
+  #error "REPEATER role needs REPEATER_USED on all nodes"
+#endif
+
+// Частотная агильность (см. channel_plan.h): вместо одной FREQUENCY_RADIO — план каналов, замер шума на каждом,
+// табло качества и согласованный переход пульта и приёмника на лучший канал. Включать на ВСЕХ узлах сразу
+#define CHANNEL_PLAN_USED
+#ifdef CHANNEL_PLAN_USED
+  #define CHANNEL_PLAN {433.325, 433.725, 434.125, 434.525, 434.925} // Частоты каналов (МГц), шаг больше BW
+  #define CHANNEL_HOME 2                 // Индекс FREQUENCY_RADIO в плане: с него обе стороны начинают после включения
+  #define CMD_CHANNEL "CH_"              // Команда перехода: "CH_3" — перейти на канал 3 плана (после ответа)
+  #define ACK_CHANNEL "CH_OK"            // Ответ приёмника на команду перехода
+  #define CHANNEL_SCAN_SAMPLES 16        // Замеров RSSI на канал при сканировании (по CHANNEL_SAMPLE_SPACING_US)
+  #define CHANNEL_SAMPLE_SPACING_US 500  // Пауза между замерами RSSI (мкс)
+  #define CHANNEL_SCAN_INTERVAL 300000   // Пульт: как часто пересканировать план и искать канал получше (мс)
+  #define CHANNEL_SWITCH_MARGIN 6        // Переходить, только если лучший канал лучше текущего на столько дБ
+  #define CHANNEL_LOSS_PENALTY 20        // Штраф к оценке канала за 100% потерь обменов на нём (дБ)
+  #define CHANNEL_JAM_MARGIN 15          // Канал считается забитым, если шум на нём выше самого тихого канала на столько дБ
+  #define CHANNEL_TX_FAILS 3             // Пульт: столько неудачных обменов подряд — объявляем и делаем переход на следующий канал
+  #define CHANNEL_RX_SAMPLE_INTERVAL 2000 // Приёмник: как часто замерять шум своего канала (мс)
+  #define CHANNEL_RX_JAM_SAMPLES 3       // Приёмник: столько замеров подряд над порогом — уходим на следующий канал
+  #define CHANNEL_RX_LOST 600000         // Приёмник: столько тишины (мс) — начинаем обход каналов в поисках пульта
+  #define CHANNEL_RX_DWELL 240000        // Приёмник: время на каждом канале при обходе (больше полного круга пульта)
+#endif
+
+// Напряжение батареи (см. battery.h): АЦП в непрерывном режиме с DMA, усреднение, фильтр и калибровка — без analogRead в loop().
+// Приёмник отправляет своё напряжение в каждом ответе (+2 байта к метрикам линка), пульт показывает его на экране и по BLE.
+// Включать на ВСЕХ узлах сразу — ответ приёмника в неявном профиле становится длиннее. Измеряют узлы с BATTERY_PIN
+#define BATTERY_USED
+#ifdef BATTERY_USED
+  #define BATTERY_CELLS 6                // Банок в сборке (6S, 22.2 В номинал, 25.2 В полная)
+  #define BATTERY_DIVIDER_RATIO 11.0f    // Делитель на входе АЦП (R1 + R2) / R2: 100k/10k — 25.2 В -> 2.29 В на пине
+  #define BATTERY_SAMPLE_HZ 1000         // Частота выборок АЦП (Гц)
+  #define BATTERY_OVERSAMPLE 250         // Выборок на одно усреднённое значение (4 значения в секунду)
+  #define BATTERY_FILTER_SHIFT 3         // Фильтр: новое значение входит с весом 1/2^N (просадки от реле и передачи сглаживаются за ~2 с)
+  #define BATTERY_CELL_LOW_MV 3500       // Низкий заряд: ниже стольких мВ на банку
+  #define BATTERY_CELL_HYSTERESIS_MV 50  // Выход из "низкого" — на столько мВ на банку выше порога
+  #define BATTERY_CELL_ABSENT_MV 1000    // Ниже — батареи (или делителя) нет, напряжение не сообщаем
+  #define BATTERY_PEER_MAX_AGE 600000    // Пульт: напряжение приёмника старше (мс) не показываем
+#endif
+
+// Двоичный протокол хоста по USB CDC (см. host_link.h): стенд на ПК управляет узлом кадрами с id запроса и
+// получает ответы и лог раздельно — без разбора текста монитора порта. Пока хост не поздоровался, Serial — обычная консоль
+#if defined(ARDUINO_ARCH_ESP32) && defined(DEBUG_PRINT)
+  #define HOST_LINK_USED
+#endif
+#ifdef HOST_LINK_USED
+  #define HOST_LINK_FRAME_MAX 288   // Данных в кадре (байт): длинная строка ответа уходит несколькими кадрами, кадр сниффера — одним
+  #define HOST_LINK_IDLE_MS 60000   // Столько без кадров от хоста — обратно в текстовую консоль (хосту — слать STATUS)
+  #define HOST_LINK_PENDING 16      // Запросов RELAY, ждущих итога обмена
+#endif
+
+// Сниффер (см. sniffer.h): роль SNIFFER слушает эфир без перерыва и отдаёт каждый кадр с меткой времени (мкс),
+// RSSI, SNR и ошибкой частоты на ПК кадрами CAPTURE протокола хоста. Сам ничего не передаёт
+#ifdef SNIFFER
+  #define SNIFFER_QUEUE_SIZE 32          // Кадров в ОЗУ, пока USB занят (до 281 байта на кадр)
+  #define SNIFFER_DISPLAY_INTERVAL 1000  // Экран — не чаще (мс) и только с пустой очередью: отрисовка дольше кадра SF7
+  #ifndef HOST_LINK_USED
+    #error "SNIFFER streams captures over the host link: ESP32 with DEBUG_PRINT"
+  #endif
+  #ifdef TDMA_USED
+    #undef TDMA_USED                     // Маяки сниффер только записывает, слоты ему не нужны
+  #endif
+  #ifdef FRAME_IMPLICIT_USED
+    // Неявный кадр без заголовка демодулирует только тот, кто заранее знает его длину: сниффер слышит пару
+    // лишь до первого подтверждённого обмена. Для полной записи выключить FRAME_IMPLICIT_USED на ВСЕХ узлах
+    #warning "SNIFFER hears explicit frames only: with FRAME_IMPLICIT_USED the capture goes silent after the first acknowledged exchange"
+  #endif
+#endif
+
+// Разметка EEPROM на ESP8266 (на ESP32 — NVS)
+#define EEPROM_SIZE 256
+#define EEPROM_ADDR_RELAY 0       // Состояние реле приёмника (1 байт)
+#define EEPROM_ADDR_AUTH 4        // Счётчики подписи кадров: свой + по одному на собеседника (по 4 байта)
+#define EEPROM_ADDR_TIMER 32      // Расписание реле и его ход (см. relay_timer.h)
+#define EEPROM_ADDR_CONFIG 64     // Настройки узла: заголовок с CRC + SiteConfig (см. site_config.h)
 // ################## КОНЕЦ НАСТРОЕК ПРОТОКОЛА ОБМЕНА И КОМАНД МЕЖДУ TX И RX ##################
 
 
@@ -138,6 +375,14 @@
   extern String RADIO_NAME; // Только объявление
 #endif
 
+#ifdef REPEATER
+  extern String RADIO_NAME; // Только объявление
+#endif
+
+#ifdef SNIFFER
+  extern String RADIO_NAME; // Только объявление
+#endif
+
 
 
 
@@ -161,6 +406,13 @@
       #define RELAY_PIN 4
     #endif
 
+    #ifdef BATTERY_USED
+      #define BATTERY_PIN 5   // Делитель батареи. Только АЦП1 (GPIO1..10): DMA на S3 есть только у него
+      #ifdef FAN_USED
+        #error "BATTERY_PIN 5 is the fan pin on this board: move the divider or disable FAN_USED"
+      #endif
+    #endif
+
     #ifdef USE_OLED_SSD1306
       #define OLED_SDA 12
       #define OLED_SCL 13
@@ -198,6 +450,10 @@
       #define RELAY_PIN 4
     #endif
 
+    #ifdef BATTERY_USED
+      #define BATTERY_PIN 6   // Делитель батареи. Только АЦП1 (GPIO1..10): DMA на S3 есть только у него
+    #endif
+
     #define LED_PIN 21      // Пин RGB светодиода
     #define BUTTON_PIN 0    // Пин кнопки
 
@@ -0,0 +1,385 @@
+#include "site_config.h"
+#include "radiomodem.h"
+#include "logger.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include <Preferences.h>
+  static Preferences siteStore; // Пространство NVS "site", ключ "cfg"
+#elif defined(ARDUINO_ARCH_ESP8266)
+  #include <EEPROM.h>
+#endif
+
+#define SITE_CONFIG_MAGIC 0x5343     // "SC"
+#define SITE_CONFIG_IMAGE_MAX 256    // Буфер чтения: запись более новой версии тоже помещается
+
+SiteConfigStore MyConfig;
+
+struct SiteConfigHeader {
+    uint16_t magic;
+    uint8_t version;  // SITE_CONFIG_VERSION, которой записано
+    uint8_t reserved;
+    uint16_t length;  // Байт данных за заголовком (sizeof(SiteConfig) той версии)
+    uint16_t reserved2;
+    uint32_t crc;     // CRC-32 данных
+};
+
+static_assert(sizeof(SiteConfigHeader) + sizeof(SiteConfig) <= SITE_CONFIG_IMAGE_MAX, "SiteConfig is too large");
+#if defined(ARDUINO_ARCH_ESP8266)
+static_assert(EEPROM_ADDR_CONFIG + sizeof(SiteConfigHeader) + sizeof(SiteConfig) <= EEPROM_SIZE,
+              "EEPROM_SIZE is too small for SiteConfig");
+#endif
+#ifdef TRANSMITTER
+static_assert(BLE_PASS_MAX_LEN < SITE_PASS_CAPACITY, "BLE_PASS_MAX_LEN does not fit SiteConfig");
+#endif
+
+
+
+static uint32_t crc32(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    while (length--) {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+
+
+void SiteConfigStore::defaults(SiteConfig& config) {
+    memset(&config, 0, sizeof(config));
+    LORA_CONFIGURATION radio; // Умолчания радио — из settings.h
+    config.frequency = radio.frequency;
+    config.bandwidth = radio.bandwidth;
+    config.currentLimit = radio.currentLimit;
+    config.spreadingFactor = radio.spreadingFactor;
+    config.codingRate = radio.codingRate;
+    config.syncWord = radio.syncWord;
+    config.outputPower = radio.outputPower;
+    config.preambleLength = radio.preambleLength;
+    config.waitTxMs = TIMEOUT_WAITING_TX;
+    config.waitRxMs = TIMEOUT_WAITING_RX;
+    #ifdef AUTH_NODE_ID
+        config.nodeId = AUTH_NODE_ID;
+    #endif
+    #ifdef TRANSMITTER
+        strncpy(config.blePass, BLE_DEFAULT_PASS, sizeof(config.blePass) - 1);
+    #endif
+    config.batteryScale = 1.0f;
+}
+
+
+
+// Пределы чипа (как их проверяет RadioLib): запись за пределами не даст поднять радио ни при одном следующем включении
+#if defined(RADIO_TYPE_SX1268)
+  #define SITE_FREQ_MIN 410.0f
+  #define SITE_FREQ_MAX 810.0f
+  #define SITE_SF_MIN 5
+  #define SITE_POWER_MIN (-9)
+  #define SITE_POWER_MAX 22
+  #define SITE_POWER_TEXT "-9..22"
+  #define SITE_LIMIT_MIN 0.0f
+  #define SITE_LIMIT_MAX 140.0f
+#else // RADIO_TYPE_SX1278
+  #define SITE_FREQ_MIN 137.0f
+  #define SITE_FREQ_MAX 525.0f
+  #define SITE_SF_MIN 6
+  #define SITE_POWER_MIN 2 // PA_BOOST: 2..17 дБм или ровно 20
+  #define SITE_POWER_MAX 20
+  #define SITE_POWER_TEXT "2..17 or 20"
+  #define SITE_LIMIT_MIN 45.0f
+  #define SITE_LIMIT_MAX 240.0f
+#endif
+
+static const float SITE_BANDWIDTHS[] = {7.8f, 10.4f, 15.6f, 20.8f, 31.25f, 41.7f, 62.5f, 125.0f, 250.0f, 500.0f};
+
+static bool bandwidth_allowed(float bw) {
+    for (float allowed : SITE_BANDWIDTHS) {
+        if (fabsf(bw - allowed) < 0.01f) return true;
+    }
+    return false;
+}
+
+
+
+// Целое значение "config set" в пределах типа поля. Сужение без проверки молча заворачивает число
+// ("waitrx 70000" -> 4464 мс), и такое значение проходит validate()
+static bool parse_field(const String& text, int base, long min, long max, long& value) {
+    char* end = nullptr;
+    value = strtol(text.c_str(), &end, base);
+    return text.length() > 0 && *end == '\0' && value >= min && value <= max;
+}
+
+
+
+bool SiteConfigStore::validate(const SiteConfig& config, String& error) {
+    bool powerOk = config.outputPower >= SITE_POWER_MIN && config.outputPower <= SITE_POWER_MAX;
+    #ifdef RADIO_TYPE_SX1278
+        powerOk = powerOk && config.outputPower != 18 && config.outputPower != 19;
+    #endif
+
+    if (!(config.frequency >= SITE_FREQ_MIN && config.frequency <= SITE_FREQ_MAX))
+        error = "freq out of " + String(SITE_FREQ_MIN, 0) + ".." + String(SITE_FREQ_MAX, 0) + " MHz";
+    else if (!bandwidth_allowed(config.bandwidth)) error = "bw must be 7.8, 10.4, 15.6, 20.8, 31.25, 41.7, 62.5, 125, 250 or 500";
+    else if (config.spreadingFactor < SITE_SF_MIN || config.spreadingFactor > 12) error = "sf out of " + String(SITE_SF_MIN) + "..12";
+    else if (config.codingRate < 5 || config.codingRate > 8) error = "cr out of 5..8";
+    else if (!powerOk)
+        error = "power out of " SITE_POWER_TEXT " dBm";
+    else if (!(config.currentLimit >= SITE_LIMIT_MIN && config.currentLimit <= SITE_LIMIT_MAX))
+        error = "limit out of " + String(SITE_LIMIT_MIN, 0) + ".." + String(SITE_LIMIT_MAX, 0) + " mA";
+    else if (config.preambleLength < 6) error = "preamble below 6";
+    else if (config.waitTxMs < 10 || config.waitTxMs >= config.waitRxMs) error = "waittx must be 10..waitrx";
+    else if (config.waitRxMs > 10000) error = "waitrx above 10000 ms";
+    else if (!(config.batteryScale >= 0.8f && config.batteryScale <= 1.25f)) error = "battery scale out of 0.8..1.25";
+    #ifdef AUTH_USED
+    else if (config.nodeId == 0 || config.nodeId == 0xFF) error = "node must be 0x01..0xFE";
+    #endif
+    #ifdef TRANSMITTER
+    else if (strnlen(config.blePass, sizeof(config.blePass)) < 4 || strnlen(config.blePass, sizeof(config.blePass)) > BLE_PASS_MAX_LEN)
+        error = "BLE password length";
+    #endif
+    else return true;
+    return false;
+}
+
+
+
+/**
+ * @brief Одно чтение записи. Нет записи или она битая — умолчания и перенос старых ключей пульта
+ */
+void SiteConfigStore::begin() {
+    uint8_t image[SITE_CONFIG_IMAGE_MAX];
+    size_t length = 0;
+    #if defined(ARDUINO_ARCH_ESP32)
+        siteStore.begin("site", false);
+        length = siteStore.getBytes("cfg", image, sizeof(image));
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        EEPROM.begin(EEPROM_SIZE); // Вся эмулированная EEPROM читается в ОЗУ одним обращением к flash
+        length = EEPROM_SIZE - EEPROM_ADDR_CONFIG;
+        if (length > sizeof(image)) length = sizeof(image);
+        for (size_t i = 0; i < length; i++) image[i] = EEPROM.read(EEPROM_ADDR_CONFIG + i);
+    #endif
+
+    defaults(data);
+    SiteConfigHeader header = {};
+    if (length >= sizeof(header)) memcpy(&header, image, sizeof(header));
+    bool valid = header.magic == SITE_CONFIG_MAGIC && header.length <= length - sizeof(header) &&
+                 crc32(image + sizeof(header), header.length) == header.crc;
+
+    String error;
+    if (valid) {
+        // Схема только дополняется: известная часть — из записи, остальное — умолчания
+        memcpy(&data, image + sizeof(header), header.length < sizeof(data) ? header.length : sizeof(data));
+        data.blePass[sizeof(data.blePass) - 1] = '\0';
+        if (!validate(data, error)) {
+            print_log("[CONFIG]", "Stored config rejected (" + error + "), using defaults");
+            defaults(data);
+            valid = false;
+        }
+    }
+
+    if (valid) {
+        loadedVersion = header.version;
+        if (header.version < SITE_CONFIG_VERSION) {
+            save();
+            print_log("[CONFIG]", "Migrated v" + String(header.version) + " -> v" + String(SITE_CONFIG_VERSION));
+        }
+        // Запись более новой версии не трогаем: после обновления прошивки её поля вернутся
+    } else {
+        #if defined(ARDUINO_ARCH_ESP32) && defined(TRANSMITTER)
+            // Прошивка до этого модуля хранила состояние и пароль отдельными ключами
+            Preferences legacy;
+            legacy.begin("relay-app", false);
+            data.relayOn = legacy.getBool("state", false);
+            char pass[SITE_PASS_CAPACITY] = {};
+            if (legacy.getString("ble_pass", pass, sizeof(pass)) > 0 && strlen(pass) >= 4) memcpy(data.blePass, pass, sizeof(pass));
+            legacy.clear();
+            legacy.end();
+        #endif
+        save();
+        print_log("[CONFIG]", "No stored config, saved defaults v" + String(SITE_CONFIG_VERSION));
+    }
+
+    LORA_CONFIGURATION& radio = MyRadio.config; // beginRadio() запустит чип уже с этими параметрами
+    radio.frequency = data.frequency;
+    radio.bandwidth = data.bandwidth;
+    radio.currentLimit = data.currentLimit;
+    radio.spreadingFactor = data.spreadingFactor;
+    radio.codingRate = data.codingRate;
+    radio.syncWord = data.syncWord;
+    radio.outputPower = data.outputPower;
+    radio.preambleLength = data.preambleLength;
+}
+
+
+
+bool SiteConfigStore::save() {
+    uint8_t image[sizeof(SiteConfigHeader) + sizeof(SiteConfig)];
+    SiteConfigHeader header = {};
+    header.magic = SITE_CONFIG_MAGIC;
+    header.version = SITE_CONFIG_VERSION;
+    header.length = sizeof(SiteConfig);
+    header.crc = crc32((const uint8_t*)&data, sizeof(data));
+    memcpy(image, &header, sizeof(header));
+    memcpy(image + sizeof(header), &data, sizeof(data));
+
+    bool ok = false;
+    #if defined(ARDUINO_ARCH_ESP32)
+        ok = siteStore.putBytes("cfg", image, sizeof(image)) == sizeof(image); // Старая запись стирается после записи новой
+    #elif defined(ARDUINO_ARCH_ESP8266)
+        for (size_t i = 0; i < sizeof(image); i++) EEPROM.write(EEPROM_ADDR_CONFIG + i, image[i]);
+        ok = EEPROM.commit();
+    #endif
+    if (ok) saves++;
+    else print_log("[CONFIG]", "Save failed");
+    return ok;
+}
+
+
+
+static void describe(const SiteConfig& c, const String& title, void (*reply)(const String& line)) {
+    #ifdef CHANNEL_PLAN_USED
+        String freq = "by channel plan"; // Частоту ведёт ChannelPlan, запись её не задаёт
+    #else
+        String freq = String(c.frequency, 3) + " MHz";
+    #endif
+    reply(title + ": freq " + freq + ", bw " + String(c.bandwidth, 1) + " kHz, sf " +
+          String(c.spreadingFactor) + ", cr 4/" + String(c.codingRate) + ", sync 0x" + String(c.syncWord, HEX) + ", power " +
+          String(c.outputPower) + " dBm, preamble " + String(c.preambleLength) + ", limit " + String(c.currentLimit, 0) + " mA");
+    reply("  waittx " + String(c.waitTxMs) + " ms, waitrx " + String(c.waitRxMs) + " ms, node 0x" + String(c.nodeId, HEX) +
+          ", battery scale " + String(c.batteryScale, 4));
+}
+
+
+
+// Команды "config", "config set <параметр> <значение>", "config save", "config discard", "config reset"
+bool SiteConfigStore::handleCommand(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd != "config" && !cmd.startsWith("config ")) return false;
+
+    if (cmd == "config") {
+        describe(data, "active", reply);
+        if (_hasDraft) describe(_draft, "draft (config save to apply)", reply);
+        reply("CONFIG v" + String(SITE_CONFIG_VERSION) + " (loaded v" + String(loadedVersion) + "), " +
+              String(sizeof(SiteConfigHeader) + sizeof(SiteConfig)) + " bytes, saves " + String(saves));
+        return true;
+    }
+
+    String rest = cmd.substring(7);
+    if (rest == "discard") {
+        _hasDraft = false;
+        reply("CONFIG draft discarded");
+        return true;
+    }
+    if (rest == "reset") {
+        defaults(_draft);
+        memcpy(_draft.blePass, data.blePass, sizeof(_draft.blePass)); // Пароль — только через setpass
+        _draft.relayOn = data.relayOn;
+        _hasDraft = true;
+        reply("CONFIG draft = defaults (config save to apply)");
+        return true;
+    }
+
+    if (rest == "save") {
+        if (!_hasDraft) {
+            reply("CONFIG nothing to save");
+            return true;
+        }
+        String error;
+        if (!validate(_draft, error)) {
+            reply("CONFIG rejected: " + error);
+            return true;
+        }
+        if (MyRadio.isProcessing) {
+            reply("CONFIG busy: exchange in progress");
+            return true;
+        }
+        bool nodeChanged = _draft.nodeId != data.nodeId;
+        // Могли измениться, пока правили черновик: реле — обменом, пароль — setpass, поправка батареи — "battery cal"
+        _draft.relayOn = data.relayOn;
+        memcpy(_draft.blePass, data.blePass, sizeof(_draft.blePass));
+        _draft.batteryScale = data.batteryScale;
+        #ifdef CHANNEL_PLAN_USED
+            _draft.frequency = data.frequency; // "config reset" не должен уводить радио с канала плана
+        #endif
+
+        // Сначала радио: во flash попадает только то, что чип принял, — иначе запись не даст подняться радио после сброса
+        LORA_CONFIGURATION previous = MyRadio.config;
+        LORA_CONFIGURATION radio = previous;
+        #ifndef CHANNEL_PLAN_USED
+            radio.frequency = _draft.frequency; // С планом каналов остаёмся на текущем канале
+        #endif
+        radio.bandwidth = _draft.bandwidth;
+        radio.currentLimit = _draft.currentLimit;
+        radio.spreadingFactor = _draft.spreadingFactor;
+        radio.codingRate = _draft.codingRate;
+        radio.syncWord = _draft.syncWord;
+        radio.outputPower = _draft.outputPower;
+        radio.preambleLength = _draft.preambleLength;
+        int state = MyRadio.reconfigure(radio);
+        if (state != RADIOLIB_ERR_NONE) {
+            MyRadio.reconfigure(previous); // Откат того, что успело записаться
+            MyRadio.startListening();
+            reply("CONFIG rejected by radio: error " + String(state) + ", nothing saved (draft kept)");
+            return true;
+        }
+        MyRadio.startListening();
+
+        data = _draft;
+        _hasDraft = false;
+        unsigned long t0 = micros();
+        bool ok = save();
+        uint32_t saveUs = micros() - t0;
+
+        reply(String(ok ? "CONFIG saved" : "CONFIG save FAILED") + " in " + String(saveUs) + " us, radio switched in " +
+              String(MyRadio.lastSwitchUs) + " us" + (nodeChanged ? ", node id after reboot" : ""));
+        return true;
+    }
+
+    // "set <параметр> <значение>"
+    int space = rest.indexOf(' ', 4);
+    if (!rest.startsWith("set ") || space < 0) {
+        reply("Usage: config [set <freq|bw|sf|cr|sync|power|preamble|limit|waittx|waitrx|node> <value> | save | discard | reset]");
+        return true;
+    }
+    String key = rest.substring(4, space);
+    String value = rest.substring(space + 1);
+    if (!_hasDraft) {
+        _draft = data;
+        _hasDraft = true;
+    }
+    bool wide = key == "preamble" || key == "waittx" || key == "waitrx";
+    bool integer = wide || key == "sf" || key == "cr" || key == "sync" || key == "power" || key == "node";
+    long number = 0;
+    if (integer) {
+        long min = key == "power" ? INT8_MIN : 0;
+        long max = key == "power" ? INT8_MAX : wide ? UINT16_MAX : UINT8_MAX;
+        if (!parse_field(value, key == "sync" || key == "node" ? 0 : 10, min, max, number)) {
+            reply("CONFIG " + key + " must be an integer " + String(min) + ".." + String(max));
+            return true;
+        }
+    }
+
+    #ifdef CHANNEL_PLAN_USED
+    if (key == "freq") {
+        // Частоту выбирает план каналов (и перезаписывает при каждом старте): своя частота разведёт пару
+        reply("CONFIG freq is set by the channel plan (CHANNEL_PLAN), see \"channels\"");
+        return true;
+    }
+    #endif
+    if (key == "freq") _draft.frequency = value.toFloat();
+    else if (key == "bw") _draft.bandwidth = value.toFloat();
+    else if (key == "sf") _draft.spreadingFactor = (uint8_t)number;
+    else if (key == "cr") _draft.codingRate = (uint8_t)number;
+    else if (key == "sync") _draft.syncWord = (uint8_t)number;
+    else if (key == "power") _draft.outputPower = (int8_t)number;
+    else if (key == "preamble") _draft.preambleLength = (uint16_t)number;
+    else if (key == "limit") _draft.currentLimit = value.toFloat();
+    else if (key == "waittx") _draft.waitTxMs = (uint16_t)number;
+    else if (key == "waitrx") _draft.waitRxMs = (uint16_t)number;
+    else if (key == "node") _draft.nodeId = (uint8_t)number;
+    else {
+        reply("CONFIG unknown parameter " + key);
+        return true;
+    }
+    reply("CONFIG draft " + key + " = " + value + " (config save to apply)");
+    return true;
+}
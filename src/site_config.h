@@ -0,0 +1,87 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * НАСТРОЙКИ УЗЛА ВО FLASH (одна запись с версией и CRC)
+ *
+ * Параметры радио, таймауты обмена, id узла, пароль BLE и последнее состояние реле пульта лежат
+ * во flash одной записью: заголовок (метка, версия схемы, длина, CRC-32) + SiteConfig. При включении
+ * запись читается целиком одним обращением (NVS "site"/"cfg" на ESP32, EEPROM с EEPROM_ADDR_CONFIG
+ * на ESP8266) и дальше код работает с копией в ОЗУ. Значения из settings.h — только умолчания: для
+ * первого включения, битой записи и команды "config reset".
+ *
+ * Схема только дополняется: новые поля — в конец SiteConfig и SITE_CONFIG_VERSION + 1. Запись старой
+ * версии короче — известная часть копируется поверх умолчаний, новые поля получают умолчания, и запись
+ * сразу пересохраняется в новой версии. Первое включение прошивки с этим модулем переносит в запись
+ * старые ключи NVS пульта ("relay-app": "state", "ble_pass") и удаляет их.
+ *
+ * Изменение — через черновик: "config set <параметр> <значение>" правит копию, "config save" проверяет
+ * её и записывает целиком одной операцией (NVS сохраняет новую запись раньше, чем стирает старую,
+ * поэтому сбой питания оставляет либо старую, либо новую запись; на ESP8266 оборванную запись отбросит CRC).
+ * Радио перенастраивается сразу (MyRadio.reconfigure), таймауты действуют со следующего обмена,
+ * id узла — после перезагрузки. С CHANNEL_PLAN_USED частоту выбирает план каналов (CHANNEL_HOME при
+ * включении, дальше переходы): "config set freq" отклоняется, "config save" канал не меняет.
+ *
+ * Одно обращение при старте — только для этой записи. Состояние реле приёмника, ход расписания и счётчики
+ * подписи остаются в своих пространствах NVS ("relay", "timer", "auth"): они пишутся часто и по отдельности,
+ * а перезапись всей записи ради каждого из них изнашивала бы flash и удлиняла паузу перед ответом пульту.
+ * Команды: "config", "config set ...", "config save", "config discard", "config reset".
+ */
+
+#define SITE_CONFIG_VERSION 2
+#define SITE_PASS_CAPACITY 33 // Пароль BLE с завершающим нулём
+
+struct SiteConfig {
+    // Радио (LORA_CONFIGURATION без параметров, зависящих от чипа)
+    float frequency;
+    float bandwidth;
+    float currentLimit;
+    uint8_t spreadingFactor;
+    uint8_t codingRate;
+    uint8_t syncWord;
+    int8_t outputPower;
+    uint16_t preambleLength;
+
+    uint16_t waitTxMs; // TIMEOUT_WAITING_TX
+    uint16_t waitRxMs; // TIMEOUT_WAITING_RX
+    uint8_t nodeId;    // AUTH_NODE_ID (действует после перезагрузки)
+    uint8_t relayOn;   // Пульт: последнее подтверждённое состояние реле
+    char blePass[SITE_PASS_CAPACITY];
+    // Версия 2
+    float batteryScale; // Поправка делителя батареи по вольтметру ("battery cal"), 1.0 — по номиналу резисторов
+    // Версия 3 и дальше — новые поля сюда
+};
+
+class SiteConfigStore {
+public:
+    /**
+     * @brief Чтение записи одним обращением к flash (или умолчания и перенос старых ключей). Вызывать первым в setup()
+     */
+    void begin();
+
+    /**
+     * @brief Записать data целиком (одна операция)
+     *
+     * @return true - записано
+     */
+    bool save();
+
+    /**
+     * @brief Команды "config ...": просмотр, черновик, запись
+     */
+    bool handleCommand(const String& cmd, void (*reply)(const String& line));
+
+    SiteConfig data;          // Действующие настройки (копия в ОЗУ)
+    uint8_t loadedVersion = 0; // Версия прочитанной записи (0 — записи не было или она битая)
+    uint32_t saves = 0;       // Сколько раз запись сохранялась с включения
+
+private:
+    static void defaults(SiteConfig& config);
+    static bool validate(const SiteConfig& config, String& error);
+
+    SiteConfig _draft;
+    bool _hasDraft = false;
+};
+
+extern SiteConfigStore MyConfig;
@@ -0,0 +1,195 @@
+#include "sniffer.h"
+
+#ifdef SNIFFER
+
+#include "radiomodem.h"
+#include "host_link.h"
+#include "channel_plan.h"
+#include "lora_airtime.h"
+#include "output_display.h"
+#include "logger.h"
+
+static_assert(SNIFFER_RECORD_HEADER + RADIO_MAX_FRAME_LENGTH <= HOST_LINK_FRAME_MAX, "HOST_LINK_FRAME_MAX must fit a whole capture record");
+
+// Сколько байт в конце кадра не относятся к тексту: подпись и TTL ретрансляции
+#if defined(AUTH_USED) && defined(REPEATER_USED)
+  #define SNIFFER_TRAILER (AUTH_OVERHEAD + 1)
+#elif defined(AUTH_USED)
+  #define SNIFFER_TRAILER AUTH_OVERHEAD
+#else
+  #define SNIFFER_TRAILER 0
+#endif
+
+Sniffer MySniffer;
+
+// Запись в очереди: заголовок CAPTURE уже собран, кадр читается прямо в record
+struct CapturedFrame {
+    uint8_t record[SNIFFER_RECORD_HEADER + RADIO_MAX_FRAME_LENGTH];
+    uint16_t length; // Длина всей записи
+};
+
+static CapturedFrame queue[SNIFFER_QUEUE_SIZE];
+static uint8_t queueHead = 0;  // Следующая на выдачу
+static uint8_t queueCount = 0;
+static uint16_t sequence = 0;
+static uint16_t lostSinceLast = 0; // Потеряно после последней поставленной в очередь записи
+static uint32_t irqsSeen = 0;
+static unsigned long lastDisplayMs = 0;
+
+
+
+static void put(uint8_t* out, size_t& pos, uint32_t value, uint8_t bytes) {
+    for (uint8_t i = 0; i < bytes; i++) out[pos++] = (value >> (8 * i)) & 0xFF;
+}
+
+
+
+/**
+ * @brief Кадр из чипа — в очередь. Полная очередь: кадр всё равно читаем (иначе чип не освободить) и считаем потерянным
+ */
+void Sniffer::capture() {
+    uint32_t atUs = MyRadio.lastRxIrqUs();
+    uint32_t irqs = MyRadio.rxIrqCount();
+    uint32_t latency = micros() - atUs;
+    if (latency > maxReadLatencyUs) maxReadLatencyUs = latency;
+    if (irqs - irqsSeen > 1) {
+        overruns += irqs - irqsSeen - 1;
+        lostSinceLast += irqs - irqsSeen - 1;
+    }
+    irqsSeen = irqs;
+
+    static uint8_t scratch[RADIO_MAX_FRAME_LENGTH];
+    bool full = queueCount >= SNIFFER_QUEUE_SIZE;
+    CapturedFrame& slot = queue[(queueHead + queueCount) % SNIFFER_QUEUE_SIZE];
+    uint8_t* frame = full ? scratch : slot.record + SNIFFER_RECORD_HEADER;
+
+    size_t length = 0;
+    int state = MyRadio.receiveRaw(frame, length);
+    captured++;
+    uint8_t flags = 0;
+    if (state == RADIOLIB_ERR_CRC_MISMATCH) { flags |= SNIFFER_FLAG_CRC; crcErrors++; }
+    else if (state != RADIOLIB_ERR_NONE) { flags |= SNIFFER_FLAG_ERROR; readErrors++; length = 0; }
+    #ifdef CHANNEL_PLAN_USED
+        if (state == RADIOLIB_ERR_NONE) MyChannels.follow(frame, length); // Пара перешла на другой канал — и мы за ней
+    #endif
+
+    if (full) {
+        queueDrops++;
+        lostSinceLast++;
+        return;
+    }
+
+    // receiveRaw запоминает RSSI и SNR только у целых кадров — у битых берём их из чипа сами
+    float rssi = state == RADIOLIB_ERR_NONE ? MyRadio.lastRssi : MyRadio.getRSSI();
+    float snr = state == RADIOLIB_ERR_NONE ? MyRadio.lastSnr : MyRadio.getSNR();
+    const LORA_CONFIGURATION& config = MyRadio.config;
+
+    size_t pos = 0;
+    put(slot.record, pos, atUs, 4);
+    put(slot.record, pos, sequence++, 2);
+    put(slot.record, pos, lostSinceLast, 2);
+    put(slot.record, pos, flags, 1);
+    put(slot.record, pos, config.spreadingFactor, 1);
+    put(slot.record, pos, config.codingRate, 1);
+    put(slot.record, pos, (uint16_t)lroundf(config.bandwidth * 10), 2);
+    put(slot.record, pos, (uint16_t)(int16_t)lroundf(rssi * 10), 2);
+    put(slot.record, pos, (uint16_t)(int16_t)lroundf(snr * 10), 2);
+    put(slot.record, pos, (uint32_t)(int32_t)lroundf(MyRadio.getFrequencyError()), 4);
+    put(slot.record, pos, (uint32_t)((double)config.frequency * 1000000.0 + 0.5), 4);
+    put(slot.record, pos, length, 1);
+    slot.length = SNIFFER_RECORD_HEADER + length;
+    queueCount++;
+    lostSinceLast = 0;
+}
+
+
+
+// Строка для монитора порта, когда хоста нет: "#12 t=123456789 -87.5 dBm 9.2 dB +1234 Hz len 18 RELAY_ON|-80,7"
+static String describe(const uint8_t* record, size_t length) {
+    auto get = [&](size_t pos, uint8_t bytes) {
+        uint32_t value = 0;
+        for (uint8_t i = 0; i < bytes; i++) value |= (uint32_t)record[pos + i] << (8 * i);
+        return value;
+    };
+    size_t frameLength = length - SNIFFER_RECORD_HEADER;
+    String line = "#" + String(get(4, 2)) + " t=" + String(get(0, 4)) + " " + String((int16_t)get(13, 2) / 10.0f, 1) +
+                  " dBm " + String((int16_t)get(15, 2) / 10.0f, 1) + " dB " + String((int32_t)get(17, 4)) + " Hz len " +
+                  String(frameLength) + " ";
+    size_t text = frameLength > SNIFFER_TRAILER ? frameLength - SNIFFER_TRAILER : frameLength;
+    for (size_t i = 0; i < text; i++) {
+        char c = (char)record[SNIFFER_RECORD_HEADER + i];
+        line += (c >= 0x20 && c < 0x7F) ? c : '.';
+    }
+    if (record[8] & SNIFFER_FLAG_CRC) line += " CRC!";
+    if (record[8] & SNIFFER_FLAG_ERROR) line += " ERR!";
+    if (get(6, 2) != 0) line += " (lost " + String(get(6, 2)) + " before)";
+    return line;
+}
+
+
+
+/**
+ * @brief Очередь — в USB, пока буфер передачи её принимает. Не ждёт: остаток уйдёт на следующем проходе loop()
+ */
+void Sniffer::flush() {
+    while (queueCount > 0) {
+        const CapturedFrame& slot = queue[queueHead];
+        if (MyHost.active()) {
+            if (!MyHost.capture(slot.record, slot.length)) return;
+        } else {
+            String line = describe(slot.record, slot.length);
+            if ((size_t)Serial.availableForWrite() < line.length() + 16) return;
+            print_log("[SNIFF]", line);
+        }
+        streamed++;
+        queueHead = (queueHead + 1) % SNIFFER_QUEUE_SIZE;
+        queueCount--;
+    }
+}
+
+
+
+void Sniffer::showStatus() {
+    if (queueCount > 0 || millis() - lastDisplayMs < SNIFFER_DISPLAY_INTERVAL) return;
+    lastDisplayMs = millis();
+    display_print_status("SNIFFER", "RX " + String(captured) + " LOST " + String(overruns + queueDrops) + "\nRSSI " +
+                                    String((int)MyRadio.lastRssi) + " SNR " + String((int)MyRadio.lastSnr));
+}
+
+
+
+void Sniffer::service() {
+    if (MyRadio.isDataReady()) capture();
+    flush();
+
+    #ifdef CHANNEL_PLAN_USED
+        MyChannels.followTimeout();
+    #endif
+
+    showStatus();
+}
+
+
+
+// Команда "sniffer"
+bool Sniffer::handleCommand(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd != "sniffer") return false;
+
+    const LORA_CONFIGURATION& config = MyRadio.config;
+    // Самый частый поток кадров — кадры по 1 байту подряд: читать надо быстрее, чем идёт такой кадр
+    uint32_t shortestUs = lora_time_on_air_us(1, config.spreadingFactor, config.bandwidth, config.codingRate,
+                                              config.preambleLength);
+    reply("SNIFFER captured " + String(captured) + ", streamed " + String(streamed) + ", lost: overrun " +
+          String(overruns) + ", queue full " + String(queueDrops) + "; CRC errors " + String(crcErrors) +
+          ", read errors " + String(readErrors));
+    reply("queued " + String(queueCount) + "/" + String(SNIFFER_QUEUE_SIZE) + ", worst read latency " +
+          String(maxReadLatencyUs) + " us, shortest frame at SF" + String(config.spreadingFactor) + " " +
+          String(shortestUs) + " us" + (maxReadLatencyUs < shortestUs ? "" : " (overruns possible)") + ", " +
+          (MyHost.active() ? "host link" : "text console") + ", " + String(config.frequency, 3) + " MHz");
+    #ifdef FRAME_IMPLICIT_USED
+        reply("WARNING: FRAME_IMPLICIT_USED - pairs switch to implicit frames after the first acknowledged exchange, those are not captured");
+    #endif
+    return true;
+}
+
+#endif
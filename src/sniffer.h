@@ -0,0 +1,65 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * СНИФФЕР (роль SNIFFER)
+ *
+ * Узел без реле и кнопки: радио всё время в приёме, каждый кадр из эфира (и с ошибкой CRC тоже) читается
+ * сразу после прерывания и встаёт в очередь SNIFFER_QUEUE_SIZE. Метка времени — micros() в самом прерывании
+ * "кадр принят" (конец кадра; начало — минус время в эфире). Сниффер ничего не передаёт и подписи
+ * не проверяет — ключи ему не нужны. Неявные кадры (frame_profile.h) без заголовка он не видит, а пара
+ * переходит на них после первого подтверждённого обмена: с FRAME_IMPLICIT_USED запись обрывается. Поэтому
+ * сборка с ним даёт предупреждение, а старт и команда "sniffer" — WARNING; на время записи выключить
+ * FRAME_IMPLICIT_USED на всех узлах.
+ *
+ * Очередь уходит на ПК кадрами CAPTURE протокола хоста (host_link.h), только когда буфер USB вмещает
+ * кадр целиком — приём не ждёт USB. Запись, все числа LE:
+ *
+ *   [мкс, 4][номер, 2][потеряно перед этим кадром, 2][флаги][SF][CR][BW, 0.1 кГц, 2]
+ *   [RSSI, 0.1 дБм, 2][SNR, 0.1 дБ, 2][ошибка частоты, Гц, 4][частота, Гц, 4][длина][кадр]
+ *
+ * Флаги: бит 0 — ошибка CRC, бит 1 — другая ошибка чтения. "Потеряно" — кадры, которые не дошли до ПК:
+ * пришли раньше, чем прочитан предыдущий (в чипе один буфер), или не влезли в полную очередь.
+ * Без хоста те же кадры идут строками в монитор порта (и тоже не дольше, чем позволяет буфер USB).
+ *
+ * С планом каналов сниффер идёт за парой: услышав "CH_<n>" и ответ CH_OK, переходит на канал n.
+ * На ПК: tools/sniffer_pcap.py — запись в pcap (DLT_USER0) и разбор наших кадров.
+ * Команда "sniffer" — счётчики, худшая задержка чтения и запас до самого короткого кадра.
+ */
+
+#ifdef SNIFFER
+
+#define SNIFFER_RECORD_HEADER 26 // Заголовок записи CAPTURE до байтов кадра
+#define SNIFFER_FLAG_CRC 0x01
+#define SNIFFER_FLAG_ERROR 0x02
+
+class Sniffer {
+public:
+    /**
+     * @brief Вызывать из loop(): чтение принятого кадра в очередь, выдача очереди в USB
+     */
+    void service();
+
+    /**
+     * @brief Команда "sniffer": счётчики и запас по скорости
+     */
+    bool handleCommand(const String& cmd, void (*reply)(const String& line));
+
+    uint32_t captured = 0;    // Прочитано кадров из чипа
+    uint32_t streamed = 0;    // Отдано на ПК (кадрами или строками)
+    uint32_t overruns = 0;    // Не прочитаны: следующий кадр пришёл раньше
+    uint32_t queueDrops = 0;  // Прочитаны, но очередь была полна (USB не успевает)
+    uint32_t crcErrors = 0;
+    uint32_t readErrors = 0;
+    uint32_t maxReadLatencyUs = 0; // Худшее время от прерывания до чтения кадра
+
+private:
+    void capture();
+    void flush();
+    void showStatus();
+};
+
+extern Sniffer MySniffer;
+
+#endif
@@ -0,0 +1,190 @@
+#include "soak_test.h"
+#include "radiomodem.h"
+#include "logger.h"
+
+SoakTest MySoak;
+
+static const char* const PATTERN_NAMES[] = {"toggle", "on", "off", "status", "random"};
+
+
+
+/**
+ * @brief Разбор команд нагрузочного теста
+ *
+ * @param cmd - команда
+ * @param reply - куда писать ответ
+ * @return true - команда обработана
+ */
+bool SoakTest::handleCommand(const String& cmd, void (*reply)(const String& line)) {
+    if (!cmd.startsWith("soak")) return false;
+
+    if (cmd.equalsIgnoreCase("soak stop")) {
+        if (_active) {
+            stop();
+            report(reply);
+        } else {
+            reply("SOAK NOT RUNNING");
+        }
+        return true;
+    }
+    if (cmd.equalsIgnoreCase("soak report")) {
+        report(reply);
+        return true;
+    }
+
+    // soak <кол-во> <интервал_мс> [шаблон] [повторы]
+    char pattern[8] = "toggle";
+    unsigned long count = 0, interval = 0, retries = 0;
+    int fields = sscanf(cmd.c_str(), "soak %lu %lu %7s %lu", &count, &interval, pattern, &retries);
+    if (fields < 2 || count == 0) {
+        reply("Usage: soak <count> <interval_ms> [toggle|on|off|status|random] [retries]");
+        return true;
+    }
+
+    int p = -1;
+    for (uint8_t i = 0; i < sizeof(PATTERN_NAMES) / sizeof(PATTERN_NAMES[0]); i++) {
+        if (strcmp(pattern, PATTERN_NAMES[i]) == 0) p = i;
+    }
+    if (p < 0) {
+        reply("SOAK: unknown pattern");
+        return true;
+    }
+
+    // Быстрее, чем длится один обмен, всё равно не получится — интервал отсчитывается от начала обмена
+    start(count, interval, (SoakPattern)p, (uint8_t)min(retries, 5UL));
+    _reply = reply;
+    reply("SOAK STARTED: " + String(count) + " x " + String(interval) + " ms, " + PATTERN_NAMES[p] +
+          ", retries " + String(_maxRetries));
+    return true;
+}
+
+
+
+void SoakTest::start(uint32_t count, uint32_t intervalMs, SoakPattern pattern, uint8_t retries) {
+    _active = true;
+    _pattern = pattern;
+    _count = count;
+    _intervalMs = intervalMs;
+    _maxRetries = retries;
+    _next = millis();
+    _startedAt = _next;
+    _expectedKnown = false;
+    _sent = _ok = _failed = _retries = _mismatches = 0;
+    _rttMs.reset();
+    _rssi.reset();
+    _snr.reset();
+    _peerRssi.reset();
+    _peerSnr.reset();
+}
+
+
+
+void SoakTest::stop() {
+    _active = false;
+}
+
+
+
+/**
+ * @brief Один шаг нагрузочного теста
+ *
+ * @param onTick - фоновая задача на время ожидания ACK
+ */
+void SoakTest::service(void (*onTick)()) {
+    if (!_active || MyRadio.isProcessing) return;
+    if ((long)(millis() - _next) < 0) return;
+    _next += _intervalMs;
+
+    // Выбираем команду по шаблону. Ожидаемое состояние реле: для команд — то, что просили,
+    // для запроса статуса — то, что было после последней успешной команды
+    bool on;
+    switch (_pattern) {
+        case SoakPattern::ON:     on = true; break;
+        case SoakPattern::OFF:    on = false; break;
+        case SoakPattern::RANDOM: on = random(2) == 1; break;
+        case SoakPattern::TOGGLE: on = (_sent % 2) == 0; break;
+        default:                  on = _expectedOn; break;
+    }
+    bool isStatus = (_pattern == SoakPattern::STATUS);
+    const char* cmd = isStatus ? CMD_GET_STATUS : (on ? CMD_RELAY_ON : CMD_RELAY_OFF);
+
+    _sent++;
+    bool ok = false;
+    unsigned long t0 = micros();
+    for (uint8_t attempt = 0; attempt <= _maxRetries && !ok; attempt++) {
+        if (attempt > 0) _retries++;
+        t0 = micros(); // RTT считаем по последней попытке
+        ok = MyRadio.sendCommandAndWaitAck(cmd, onTick);
+    }
+    unsigned long rtt = micros() - t0;
+
+    if (ok) {
+        _ok++;
+        _rttMs.add((int32_t)(rtt / 1000));
+        _rssi.add((int32_t)MyRadio.lastRssi);
+        _snr.add((int32_t)MyRadio.lastSnr);
+        if (MyRadio.peerMetricsValid) {
+            _peerRssi.add(MyRadio.peerRssi);
+            _peerSnr.add(MyRadio.peerSnr);
+        }
+
+        // Приёмник ответил не тем состоянием, которое мы ожидали
+        if ((!isStatus || _expectedKnown) && MyRadio.relayIsOn != on) _mismatches++;
+        if (!isStatus) {
+            _expectedOn = on;
+            _expectedKnown = true;
+        } else if (!_expectedKnown) {
+            _expectedOn = MyRadio.relayIsOn;
+            _expectedKnown = true;
+        }
+    } else {
+        _failed++;
+    }
+
+    if (_sent >= _count) {
+        stop();
+        print_log("[SOAK]", "Finished");
+        if (_reply != nullptr) report(_reply);
+    }
+}
+
+
+
+/**
+ * @brief Итоги нагрузочного теста
+ *
+ * @param reply - куда писать строки отчёта
+ */
+void SoakTest::report(void (*reply)(const String& line)) {
+    if (_sent == 0) {
+        reply("SOAK: no data");
+        return;
+    }
+    unsigned long elapsed = millis() - _startedAt;
+    reply("SOAK " + String(_active ? "RUNNING" : "DONE") + ": " + String(_sent) + "/" + String(_count) + " in " +
+          String(elapsed / 1000) + " s");
+    reply("ok " + String(_ok) + " (" + String(100.0f * _ok / _sent, 1) + "%), fail " + String(_failed) +
+          ", retries " + String(_retries) + ", mismatch " + String(_mismatches));
+
+    if (_rttMs.count == 0) return;
+    reply("RTT ms min/avg/p50/p95/p99/max " + String(_rttMs.min) + "/" + String(_rttMs.mean()) + "/" +
+          String(_rttMs.percentile(50)) + "/" + String(_rttMs.percentile(95)) + "/" +
+          String(_rttMs.percentile(99)) + "/" + String(_rttMs.max));
+
+    // Гистограмма RTT — только непустые корзины, чтобы влезло в пару строк BLE
+    String hist = "RTT hist";
+    for (uint16_t i = 0; i < 24; i++) {
+        if (_rttMs.bins[i] == 0) continue;
+        hist += " " + String(_rttMs.binStart(i)) + ":" + String(_rttMs.bins[i]);
+    }
+    reply(hist);
+
+    reply("RX->TX RSSI p5/p50/p95 " + String(_rssi.percentile(5)) + "/" + String(_rssi.percentile(50)) + "/" +
+          String(_rssi.percentile(95)) + " SNR " + String(_snr.percentile(5)) + "/" + String(_snr.percentile(50)) +
+          "/" + String(_snr.percentile(95)));
+    if (_peerRssi.count > 0) {
+        reply("TX->RX RSSI p5/p50/p95 " + String(_peerRssi.percentile(5)) + "/" + String(_peerRssi.percentile(50)) +
+              "/" + String(_peerRssi.percentile(95)) + " SNR " + String(_peerSnr.percentile(5)) + "/" +
+              String(_peerSnr.percentile(50)) + "/" + String(_peerSnr.percentile(95)));
+    }
+}
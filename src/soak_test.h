@@ -0,0 +1,73 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+#include "histogram.h"
+
+/**
+ * НАГРУЗОЧНЫЙ ТЕСТ (SOAK) НА ПУЛЬТЕ
+ *
+ * Пульт сам шлёт команды с заданным интервалом и по заданному шаблону через обычный
+ * MyRadio.sendCommandAndWaitAck() и собирает статистику: долю успешных обменов, гистограмму RTT,
+ * повторы, распределение RSSI/SNR в обе стороны и расхождения состояния реле с ожидаемым.
+ * Любая развёрнутая пара TX+RX превращается в стенд для проверки новых настроек без ПК.
+ *
+ * Команды (консоль Serial или BLE):
+ *   soak <кол-во> <интервал_мс> [toggle|on|off|status|random] [повторы] — запуск
+ *   soak stop   — остановка (итоги выводятся сразу)
+ *   soak report — текущие итоги, не останавливая тест
+ */
+
+enum class SoakPattern : uint8_t {
+    TOGGLE, // ВКЛ, ВЫКЛ, ВКЛ, ...
+    ON,     // Всё время ВКЛ
+    OFF,    // Всё время ВЫКЛ
+    STATUS, // Только запросы статуса (минимальная нагрузка на реле)
+    RANDOM, // ВКЛ/ВЫКЛ случайно
+};
+
+class SoakTest {
+public:
+    /**
+     * @brief Разбор команд "soak ..."
+     *
+     * @param cmd - команда
+     * @param reply - куда писать ответ (запоминается для итогов по окончании теста)
+     * @return true - команда относилась к нагрузочному тесту
+     */
+    bool handleCommand(const String& cmd, void (*reply)(const String& line));
+
+    /**
+     * @brief Вызывать из loop(). Когда подошло время — один обмен (блокирует до TIMEOUT_WAITING_RX на попытку)
+     *
+     * @param onTick - фоновая задача на время ожидания ACK
+     */
+    void service(void (*onTick)() = nullptr);
+
+    bool isActive() { return _active; }
+    void report(void (*reply)(const String& line));
+
+private:
+    void start(uint32_t count, uint32_t intervalMs, SoakPattern pattern, uint8_t retries);
+    void stop();
+
+    bool _active = false;
+    SoakPattern _pattern = SoakPattern::TOGGLE;
+    uint32_t _count = 0;       // Сколько команд нужно отправить
+    uint32_t _intervalMs = 0;  // Интервал между началами обменов
+    uint8_t _maxRetries = 0;   // Повторов на команду после таймаута
+    unsigned long _next = 0;   // millis() следующего обмена
+    unsigned long _startedAt = 0;
+    bool _expectedOn = false;  // Каким реле должно быть после последней успешной команды
+    bool _expectedKnown = false;
+    void (*_reply)(const String& line) = nullptr;
+
+    // Статистика
+    uint32_t _sent = 0, _ok = 0, _failed = 0, _retries = 0, _mismatches = 0;
+    Histogram<24> _rttMs{0, 20};         // 0..480 мс
+    Histogram<26> _rssi{-140, 5};        // Как пульт слышит приёмник, дБм
+    Histogram<20> _snr{-20, 2};          // дБ
+    Histogram<26> _peerRssi{-140, 5};    // Как приёмник слышит пульт
+    Histogram<20> _peerSnr{-20, 2};
+};
+
+extern SoakTest MySoak;
@@ -0,0 +1,199 @@
+#include "status_renderer.h"
+#include <string.h>
+
+#if defined(ARDUINO)
+  #include <pgmspace.h>
+#else
+  #define PROGMEM
+  #define pgm_read_byte(p) (*(const uint8_t*)(p))
+#endif
+
+#define FONT_FIRST 0x20
+#define FONT_LAST 0x7E
+
+// 5x7, ASCII 0x20..0x7E: 5 столбцов на символ, бит 0 — верхний ряд
+static const uint8_t FONT[(FONT_LAST - FONT_FIRST + 1) * 5] PROGMEM = {
+    0x00, 0x00, 0x00, 0x00, 0x00, // ' '
+    0x00, 0x00, 0x5F, 0x00, 0x00, // !
+    0x00, 0x07, 0x00, 0x07, 0x00, // "
+    0x14, 0x7F, 0x14, 0x7F, 0x14, // #
+    0x24, 0x2A, 0x7F, 0x2A, 0x12, // $
+    0x23, 0x13, 0x08, 0x64, 0x62, // %
+    0x36, 0x49, 0x55, 0x22, 0x50, // &
+    0x00, 0x05, 0x03, 0x00, 0x00, // '
+    0x00, 0x1C, 0x22, 0x41, 0x00, // (
+    0x00, 0x41, 0x22, 0x1C, 0x00, // )
+    0x14, 0x08, 0x3E, 0x08, 0x14, // *
+    0x08, 0x08, 0x3E, 0x08, 0x08, // +
+    0x00, 0x50, 0x30, 0x00, 0x00, // ,
+    0x08, 0x08, 0x08, 0x08, 0x08, // -
+    0x00, 0x60, 0x60, 0x00, 0x00, // .
+    0x20, 0x10, 0x08, 0x04, 0x02, // /
+    0x3E, 0x51, 0x49, 0x45, 0x3E, // 0
+    0x00, 0x42, 0x7F, 0x40, 0x00, // 1
+    0x42, 0x61, 0x51, 0x49, 0x46, // 2
+    0x21, 0x41, 0x45, 0x4B, 0x31, // 3
+    0x18, 0x14, 0x12, 0x7F, 0x10, // 4
+    0x27, 0x45, 0x45, 0x45, 0x39, // 5
+    0x3C, 0x4A, 0x49, 0x49, 0x30, // 6
+    0x01, 0x71, 0x09, 0x05, 0x03, // 7
+    0x36, 0x49, 0x49, 0x49, 0x36, // 8
+    0x06, 0x49, 0x49, 0x29, 0x1E, // 9
+    0x00, 0x36, 0x36, 0x00, 0x00, // :
+    0x00, 0x56, 0x36, 0x00, 0x00, // ;
+    0x08, 0x14, 0x22, 0x41, 0x00, // <
+    0x14, 0x14, 0x14, 0x14, 0x14, // =
+    0x00, 0x41, 0x22, 0x14, 0x08, // >
+    0x02, 0x01, 0x51, 0x09, 0x06, // ?
+    0x32, 0x49, 0x79, 0x41, 0x3E, // @
+    0x7E, 0x11, 0x11, 0x11, 0x7E, // A
+    0x7F, 0x49, 0x49, 0x49, 0x36, // B
+    0x3E, 0x41, 0x41, 0x41, 0x22, // C
+    0x7F, 0x41, 0x41, 0x22, 0x1C, // D
+    0x7F, 0x49, 0x49, 0x49, 0x41, // E
+    0x7F, 0x09, 0x09, 0x09, 0x01, // F
+    0x3E, 0x41, 0x49, 0x49, 0x7A, // G
+    0x7F, 0x08, 0x08, 0x08, 0x7F, // H
+    0x00, 0x41, 0x7F, 0x41, 0x00, // I
+    0x20, 0x40, 0x41, 0x3F, 0x01, // J
+    0x7F, 0x08, 0x14, 0x22, 0x41, // K
+    0x7F, 0x40, 0x40, 0x40, 0x40, // L
+    0x7F, 0x02, 0x0C, 0x02, 0x7F, // M
+    0x7F, 0x04, 0x08, 0x10, 0x7F, // N
+    0x3E, 0x41, 0x41, 0x41, 0x3E, // O
+    0x7F, 0x09, 0x09, 0x09, 0x06, // P
+    0x3E, 0x41, 0x51, 0x21, 0x5E, // Q
+    0x7F, 0x09, 0x19, 0x29, 0x46, // R
+    0x46, 0x49, 0x49, 0x49, 0x31, // S
+    0x01, 0x01, 0x7F, 0x01, 0x01, // T
+    0x3F, 0x40, 0x40, 0x40, 0x3F, // U
+    0x1F, 0x20, 0x40, 0x20, 0x1F, // V
+    0x3F, 0x40, 0x38, 0x40, 0x3F, // W
+    0x63, 0x14, 0x08, 0x14, 0x63, // X
+    0x07, 0x08, 0x70, 0x08, 0x07, // Y
+    0x61, 0x51, 0x49, 0x45, 0x43, // Z
+    0x00, 0x7F, 0x41, 0x41, 0x00, // [
+    0x02, 0x04, 0x08, 0x10, 0x20, // обратная косая
+    0x00, 0x41, 0x41, 0x7F, 0x00, // ]
+    0x04, 0x02, 0x01, 0x02, 0x04, // ^
+    0x40, 0x40, 0x40, 0x40, 0x40, // _
+    0x00, 0x01, 0x02, 0x04, 0x00, // `
+    0x20, 0x54, 0x54, 0x54, 0x78, // a
+    0x7F, 0x48, 0x44, 0x44, 0x38, // b
+    0x38, 0x44, 0x44, 0x44, 0x20, // c
+    0x38, 0x44, 0x44, 0x48, 0x7F, // d
+    0x38, 0x54, 0x54, 0x54, 0x18, // e
+    0x08, 0x7E, 0x09, 0x01, 0x02, // f
+    0x0C, 0x52, 0x52, 0x52, 0x3E, // g
+    0x7F, 0x08, 0x04, 0x04, 0x78, // h
+    0x00, 0x44, 0x7D, 0x40, 0x00, // i
+    0x20, 0x40, 0x44, 0x3D, 0x00, // j
+    0x7F, 0x10, 0x28, 0x44, 0x00, // k
+    0x00, 0x41, 0x7F, 0x40, 0x00, // l
+    0x7C, 0x04, 0x18, 0x04, 0x78, // m
+    0x7C, 0x08, 0x04, 0x04, 0x78, // n
+    0x38, 0x44, 0x44, 0x44, 0x38, // o
+    0x7C, 0x14, 0x14, 0x14, 0x08, // p
+    0x08, 0x14, 0x14, 0x18, 0x7C, // q
+    0x7C, 0x08, 0x04, 0x04, 0x08, // r
+    0x48, 0x54, 0x54, 0x54, 0x20, // s
+    0x04, 0x3F, 0x44, 0x40, 0x20, // t
+    0x3C, 0x40, 0x40, 0x20, 0x7C, // u
+    0x1C, 0x20, 0x40, 0x20, 0x1C, // v
+    0x3C, 0x40, 0x30, 0x40, 0x3C, // w
+    0x44, 0x28, 0x10, 0x28, 0x44, // x
+    0x0C, 0x50, 0x50, 0x50, 0x3C, // y
+    0x44, 0x64, 0x54, 0x4C, 0x44, // z
+    0x00, 0x08, 0x36, 0x41, 0x00, // {
+    0x00, 0x00, 0x7F, 0x00, 0x00, // |
+    0x00, 0x41, 0x36, 0x08, 0x00, // }
+    0x08, 0x04, 0x08, 0x10, 0x08, // ~
+};
+
+
+
+const uint8_t* StatusRenderer::glyph(char c) {
+    if ((uint8_t)c < FONT_FIRST || (uint8_t)c > FONT_LAST) c = '?';
+    CachedGlyph& slot = _cache[(uint8_t)c % STATUS_GLYPH_CACHE];
+    if (slot.c == c) {
+        glyphHits++;
+        return slot.columns;
+    }
+    glyphMisses++;
+    const uint8_t* source = FONT + ((uint8_t)c - FONT_FIRST) * 5;
+    for (uint8_t i = 0; i < 5; i++) slot.columns[i] = pgm_read_byte(source + i);
+    slot.c = c;
+    return slot.columns;
+}
+
+
+
+/**
+ * @brief Страница = ряды 8*page..8*page+7. Строка текста может задевать две страницы — берём свою часть глифа сдвигом
+ */
+void StatusRenderer::composePage(uint8_t page, const Line* lines, uint8_t count) {
+    memset(_page, 0, sizeof(_page));
+    int16_t top = page * 8;
+    for (uint8_t l = 0; l < count; l++) {
+        const Line& line = lines[l];
+        int16_t shift = line.y - top;
+        if (shift <= -8 || shift >= 8) continue;
+        for (uint8_t i = 0; i < line.length; i++) {
+            int16_t x = line.x + i * STATUS_CHAR_WIDTH;
+            if (x >= STATUS_WIDTH) break;
+            if (x + 5 <= 0) continue;
+            const uint8_t* columns = glyph(line.text[i]);
+            for (uint8_t col = 0; col < 5; col++) {
+                int16_t px = x + col;
+                if (px < 0 || px >= STATUS_WIDTH) continue;
+                _page[px] |= shift >= 0 ? (uint8_t)(columns[col] << shift) : (uint8_t)(columns[col] >> -shift);
+            }
+        }
+    }
+}
+
+
+
+uint8_t StatusRenderer::render(int16_t x, int16_t y, const char* text, void (*sendPage)(uint8_t page, const uint8_t* data)) {
+    // Раскладка по строкам: перенос по '\n' и по ширине экрана
+    Line lines[STATUS_MAX_LINES];
+    uint8_t count = 0;
+    int16_t cx = x, cy = y;
+    const char* start = text;
+    uint8_t length = 0;
+    for (const char* p = text;; p++) {
+        bool end = *p == '\0';
+        bool wrap = !end && *p != '\n' && *p != '\r' && cx + (length + 1) * STATUS_CHAR_WIDTH > STATUS_WIDTH;
+        if (end || *p == '\n' || wrap) {
+            if (length > 0 && count < STATUS_MAX_LINES && cy < STATUS_HEIGHT) lines[count++] = {start, length, cx, cy};
+            if (end) break;
+            cx = 0;
+            cy += STATUS_LINE_HEIGHT;
+            length = 0;
+            start = p + (wrap ? 0 : 1);
+            if (!wrap) continue;
+        }
+        if (*p == '\r') {
+            // '\r' не рисуется: закрываем строку перед ним, продолжение — с той же позиции
+            if (length > 0 && count < STATUS_MAX_LINES && cy < STATUS_HEIGHT) lines[count++] = {start, length, cx, cy};
+            cx += length * STATUS_CHAR_WIDTH;
+            length = 0;
+            start = p + 1;
+            continue;
+        }
+        length++;
+    }
+
+    uint8_t sent = 0;
+    for (uint8_t page = 0; page < STATUS_PAGES; page++) {
+        composePage(page, lines, count);
+        uint32_t hash = 2166136261u;
+        for (uint8_t i = 0; i < STATUS_WIDTH; i++) hash = (hash ^ _page[i]) * 16777619u;
+        if ((_valid & (1 << page)) && _pageHash[page] == hash) continue;
+        sendPage(page, _page);
+        _pageHash[page] = hash;
+        _valid |= 1 << page;
+        sent++;
+    }
+    return sent;
+}
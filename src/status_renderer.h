@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * ОТРИСОВКА ЭКРАНА СОСТОЯНИЯ ПО СТРАНИЦАМ (SSD1306 128x64)
+ *
+ * Вместо кадра в ОЗУ (1 КБ у Adafruit_SSD1306) — одна страница 128x8 (128 байт): текст раскладывается
+ * по строкам, каждая страница собирается из столбцов глифов со сдвигом (строки текста не обязаны
+ * совпадать со страницами) и сразу уходит в дисплей. Для каждой страницы хранится хеш отправленного:
+ * не изменившиеся страницы в I2C не идут — при смене одной строки (RSSI, напряжение) передаётся
+ * одна-две страницы из восьми.
+ *
+ * Шрифт — только ASCII 0x20..0x7E 5x7 (ячейка 6x8, как размер текста 1 у Adafruit GFX), остальные
+ * символы рисуются как '?'. Глифы берутся из flash через маленький кеш в ОЗУ (на ESP8266 чтение
+ * PROGMEM побайтно медленное). Перенос — как у Adafruit GFX: по ширине экрана и по '\n'.
+ *
+ * Не зависит от Arduino: собирается на хосте для сравнения с прежней отрисовкой (tools/display_bench).
+ */
+
+#define STATUS_WIDTH 128
+#define STATUS_HEIGHT 64
+#define STATUS_PAGES (STATUS_HEIGHT / 8)
+#define STATUS_CHAR_WIDTH 6        // Ячейка символа: 5 столбцов глифа + промежуток
+#define STATUS_LINE_HEIGHT 8
+#define STATUS_MAX_LINES 10        // Строк текста до нижнего края (больше — не видны)
+#define STATUS_GLYPH_CACHE 16      // Глифов в кеше (прямое отображение по коду символа)
+
+class StatusRenderer {
+public:
+    /**
+     * @brief Отрисовка текста и отправка изменившихся страниц
+     *
+     * @param x, y - начало первой строки (пиксели); следующие строки — с x = 0, как у Adafruit GFX
+     * @param text - строки через '\n'
+     * @param sendPage - отправка страницы 0..7 (128 байт, бит 0 — верхний ряд)
+     * @return uint8_t - сколько страниц отправлено
+     */
+    uint8_t render(int16_t x, int16_t y, const char* text, void (*sendPage)(uint8_t page, const uint8_t* data));
+
+    /**
+     * @brief Следующий render() отправит все страницы (после инициализации или очистки дисплея)
+     */
+    void invalidate() { _valid = 0; }
+
+    uint32_t glyphHits = 0;
+    uint32_t glyphMisses = 0;
+
+private:
+    struct Line {
+        const char* text;
+        uint8_t length;
+        int16_t x;
+        int16_t y;
+    };
+    struct CachedGlyph {
+        char c = 0; // 0 — ячейка пуста
+        uint8_t columns[5];
+    };
+
+    const uint8_t* glyph(char c);
+    void composePage(uint8_t page, const Line* lines, uint8_t count);
+
+    uint8_t _page[STATUS_WIDTH];
+    uint32_t _pageHash[STATUS_PAGES]; // FNV-1a отправленных страниц
+    uint8_t _valid = 0; // Бит на страницу: _pageHash действителен
+    CachedGlyph _cache[STATUS_GLYPH_CACHE];
+};
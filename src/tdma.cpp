@@ -0,0 +1,231 @@
+#include "tdma.h"
+
+#ifdef TDMA_USED
+
+#include "radiomodem.h"
+#include "frame_auth.h"
+#include "protocol.h"
+#include "logger.h"
+#include "reconciler.h"
+
+#define TDMA_SUPERFRAME_MS ((unsigned long)TDMA_SLOTS * TDMA_SLOT_MS)
+#define TDMA_MAX_DRIFT 0.01f // Длина суперкадра по маякам дальше от номинала — это не уход часов, а сбой (перезагрузка приёмника)
+
+TdmaMac MyTdma;
+
+
+
+void TdmaMac::begin() {
+    #ifdef TRANSMITTER
+        print_log("[TDMA]", "Waiting for beacon, superframe " + String(TDMA_SUPERFRAME_MS) + " ms");
+    #else
+        _nextBeacon = millis();
+        print_log("[TDMA]", "Beacon every " + String(TDMA_SUPERFRAME_MS) + " ms, " + String(TDMA_ASSIGNED_SLOTS) +
+                            " assigned + " + String(TDMA_SLOTS - 1 - TDMA_ASSIGNED_SLOTS) + " contention slots");
+    #endif
+}
+
+
+
+/**
+ * @brief Приёмник: маяк в начале суперкадра. Пульт: маяки, пришедшие между обменами
+ */
+void TdmaMac::service() {
+    unsigned long now = millis();
+
+    #ifdef TRANSMITTER
+        if (MyRadio.isProcessing || !MyRadio.isDataReady()) return;
+        String message;
+        if (MyRadio.receive(message) == RADIOLIB_ERR_NONE && !onFrame(message)) MyReconciler.onFrame(message); // Объявление приёмника или запоздавший ответ
+        MyRadio.startListening();
+        (void)now;
+    #else
+        for (uint8_t i = 0; i < TDMA_ASSIGNED_SLOTS; i++) {
+            if (_owner[i] != 0 && now - _ownerHeard[i] >= TDMA_ASSIGN_TIMEOUT) {
+                print_log("[TDMA]", "Slot " + String(i + 1) + " released by 0x" + String(_owner[i], HEX));
+                _owner[i] = 0;
+            }
+        }
+
+        if ((long)(now - _nextBeacon) < 0) return;
+        unsigned long late = now - _nextBeacon;
+        if (late >= TDMA_SUPERFRAME_MS) {
+            // Пропустили суперкадр целиком (долгий скан каналов) — сетка остаётся прежней, номер идёт дальше
+            _seq += (uint8_t)(late / TDMA_SUPERFRAME_MS);
+            _nextBeacon += (late / TDMA_SUPERFRAME_MS) * TDMA_SUPERFRAME_MS;
+            late %= TDMA_SUPERFRAME_MS;
+        }
+        _seq++;
+
+        char map[2 * TDMA_ASSIGNED_SLOTS + 1];
+        for (uint8_t i = 0; i < TDMA_ASSIGNED_SLOTS; i++) snprintf(map + 2 * i, 3, "%02X", _owner[i]);
+        MyRadio.send(String(CMD_BEACON) + String(_seq) + "_" + String(late) + "_" + map, true);
+        MyRadio.startListening();
+        _nextBeacon += TDMA_SUPERFRAME_MS;
+        beacons++;
+    #endif
+}
+
+
+
+void TdmaMac::recordRx(uint8_t senderId) {
+    #ifdef TRANSMITTER
+        (void)senderId;
+    #else
+        unsigned long now = millis();
+        int8_t free = -1;
+        for (uint8_t i = 0; i < TDMA_ASSIGNED_SLOTS; i++) {
+            if (_owner[i] == senderId) {
+                _ownerHeard[i] = now;
+                return;
+            }
+            if (_owner[i] == 0 && free < 0) free = i;
+        }
+        if (free < 0) return; // Все закреплённые слоты заняты — пульт остаётся в общих
+        _owner[free] = senderId;
+        _ownerHeard[free] = now;
+        print_log("[TDMA]", "Slot " + String(free + 1) + " assigned to 0x" + String(senderId, HEX));
+    #endif
+}
+
+
+
+/**
+ * @brief Маяк: часы по началу суперкадра и длина суперкадра в наших millis() по всем маякам с первого
+ */
+bool TdmaMac::onFrame(const String& message) {
+    if (!message.startsWith(CMD_BEACON)) return false;
+
+    #ifdef TRANSMITTER
+        unsigned long received = millis();
+        int first = strlen(CMD_BEACON);
+        int second = message.indexOf('_', first);
+        int third = second < 0 ? -1 : message.indexOf('_', second + 1);
+        // Другая длина карты — у приёмника другие TDMA_* в settings.h: такому маяку не верим
+        if (third < 0 || message.length() != (unsigned)(third + 1 + 2 * TDMA_ASSIGNED_SLOTS)) return true;
+        if (!MyAuth.lastWasGroup()) return true;
+
+        uint8_t seq = (uint8_t)message.substring(first, second).toInt();
+        unsigned long late = message.substring(second + 1, third).toInt();
+        for (uint8_t i = 0; i < TDMA_ASSIGNED_SLOTS; i++) {
+            _owner[i] = (uint8_t)strtoul(message.substring(third + 1 + 2 * i, third + 3 + 2 * i).c_str(), nullptr, 16);
+        }
+        unsigned long start = received - protocol_time_on_air(protocol_spec(MsgId::BEACON), message.length()) / 1000 - late;
+
+        bool anchor = !synced();
+        if (!anchor) {
+            uint8_t frames = (uint8_t)(seq - _seq);
+            if (frames == 0) return true;
+            missed += frames - 1;
+            _anchorFrames += frames;
+            float period = (float)(start - _anchorStart) / _anchorFrames;
+            if (fabsf(period - TDMA_SUPERFRAME_MS) > TDMA_SUPERFRAME_MS * TDMA_MAX_DRIFT) anchor = true;
+            else _periodMs = period;
+        }
+        if (anchor) {
+            _anchorStart = start;
+            _anchorFrames = 0;
+            _periodMs = TDMA_SUPERFRAME_MS;
+            if (!_synced) print_log("[TDMA]", "Synced to beacon " + String(seq));
+        }
+
+        _synced = true;
+        _seq = seq;
+        _frameStart = start;
+        beacons++;
+    #endif
+    return true;
+}
+
+
+
+bool TdmaMac::synced() {
+    return _synced && millis() - _frameStart < (unsigned long)(TDMA_SYNC_LOST * _periodMs);
+}
+
+
+
+uint8_t TdmaMac::ownSlot() {
+    for (uint8_t i = 0; i < TDMA_ASSIGNED_SLOTS; i++) {
+        if (_owner[i] == MyAuth.nodeId()) return i + 1;
+    }
+    return 1 + TDMA_ASSIGNED_SLOTS + random(TDMA_SLOTS - 1 - TDMA_ASSIGNED_SLOTS);
+}
+
+
+
+/**
+ * @brief Начало слота в ближайшем суперкадре, где до начала передачи (слот + TDMA_GUARD_MS) ещё не поздно
+ */
+unsigned long TdmaMac::slotStart(uint8_t slot) {
+    float slotMs = _periodMs / TDMA_SLOTS;
+    unsigned long since = millis() - _frameStart;
+    uint32_t n = (uint32_t)(since / _periodMs);
+    unsigned long at = _frameStart + (unsigned long)(n * _periodMs + slot * slotMs);
+    if ((long)(millis() - (at + TDMA_GUARD_MS)) > 0) at = _frameStart + (unsigned long)((n + 1) * _periodMs + slot * slotMs);
+    return at;
+}
+
+
+
+/**
+ * @brief Ожидание своего слота. Маяк, пришедший за это время, подстраивает часы и может закрепить за нами слот
+ */
+void TdmaMac::waitForSlot(void (*onTick)()) {
+    #ifdef TRANSMITTER
+        if (!synced()) {
+            unslotted++;
+            return;
+        }
+
+        unsigned long t0 = millis();
+        uint8_t slot = ownSlot();
+        unsigned long at = slotStart(slot) + TDMA_GUARD_MS;
+        while ((long)(millis() - at) < 0) {
+            if (onTick != nullptr) onTick();
+            if (MyRadio.isDataReady()) {
+                String message;
+                if (MyRadio.receive(message) == RADIOLIB_ERR_NONE && onFrame(message)) {
+                    if (slot > TDMA_ASSIGNED_SLOTS) slot = ownSlot(); // Общий слот меняем, только если закрепили свой
+                    at = slotStart(slot) + TDMA_GUARD_MS;
+                }
+                MyRadio.startListening();
+            }
+            yield();
+        }
+
+        uint32_t waited = millis() - t0;
+        if (waited > maxWaitMs) maxWaitMs = waited;
+    #else
+        (void)onTick;
+    #endif
+}
+
+
+
+// Команда "tdma"
+bool TdmaMac::handleCommand(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd != "tdma") return false;
+
+    String map;
+    for (uint8_t i = 0; i < TDMA_ASSIGNED_SLOTS; i++) {
+        map += " " + String(i + 1) + ":" + (_owner[i] != 0 ? "0x" + String(_owner[i], HEX) : String("-"));
+    }
+
+    #ifdef TRANSMITTER
+        float driftPpm = (_periodMs / TDMA_SUPERFRAME_MS - 1.0f) * 1e6f;
+        reply("TDMA " + String(synced() ? "synced" : "no beacon") + ", superframe " + String(_periodMs, 1) +
+              " ms (drift " + String(driftPpm, 0) + " ppm over " + String(_anchorFrames) + " frames), beacons " +
+              String(beacons) + ", missed " + String(missed));
+        reply("slots" + map + ", unslotted exchanges " + String(unslotted) + ", max wait " + String(maxWaitMs) + " ms");
+    #else
+        uint32_t beaconUs = protocol_time_on_air(protocol_spec(MsgId::BEACON), strlen(CMD_BEACON) + 8 + 2 * TDMA_ASSIGNED_SLOTS);
+        reply("TDMA superframe " + String(TDMA_SUPERFRAME_MS) + " ms (" + String(TDMA_SLOTS) + " x " + String(TDMA_SLOT_MS) +
+              "), beacons " + String(beacons) + ", beacon " + String(beaconUs / 1000.0f, 1) + " ms = " +
+              String(beaconUs / 10.0f / TDMA_SUPERFRAME_MS, 1) + "% of air");
+        reply("slots" + map);
+    #endif
+    return true;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * СЛОТЫ TDMA ПО МАЯКУ ПРИЁМНИКА (несколько пультов на один приёмник)
+ *
+ * Без слотов пульты передают когда придётся: команда одного пульта накрывает ответ приёмника другому,
+ * и чем больше пультов, тем больше таких потерь и повторов. С TDMA_USED время делится на суперкадры
+ * из TDMA_SLOTS слотов по TDMA_SLOT_MS:
+ *
+ *   | маяк | слот пульта 1 | ... | слот пульта N | общий | ... | общий |
+ *     0      1                     TDMA_ASSIGNED_SLOTS              TDMA_SLOTS - 1
+ *
+ * Приёмник — хранитель времени. В начале каждого суперкадра он шлёт маяк "BCN_<номер>_<опоздание>_<карта>":
+ * номер суперкадра (0..255), на сколько мс маяк ушёл позже начала суперкадра (приёмник был занят) и id
+ * владельцев закреплённых слотов (по два hex-символа, "00" — слот свободен). Маяк подписан ключом группы:
+ * его проверяет любой пульт сети. Закреплённый слот достаётся пульту, от которого приёмник принял кадр,
+ * и освобождается, если пульт молчит TDMA_ASSIGN_TIMEOUT.
+ *
+ * Пульт выставляет часы по маяку: начало суперкадра = конец приёма маяка - время маяка в эфире - опоздание.
+ * Длину суперкадра в своих millis() он считает по всем маякам от первого (уход кварца обоих узлов —
+ * десятки ppm), поэтому и после нескольких пропущенных маяков начало слота предсказывается точно.
+ * Любой обмен (команда, сверка, нагрузочный тест, переход на канал) начинается через TDMA_GUARD_MS после
+ * начала своего слота: закреплённого, если он есть в карте, иначе случайного общего. Ожидание — не дольше
+ * суперкадра, кнопка и BLE на это время не засыпают (onTick). Обмен целиком укладывается в слот.
+ * TDMA_SYNC_LOST суперкадров без маяка — пульт передаёт сразу, как без TDMA, пока не услышит маяк снова.
+ *
+ * Рассчитано на один приёмник, шлющий маяки, на канал. Команда "tdma" — слоты, синхронизация, ожидание.
+ */
+
+#ifdef TDMA_USED
+
+static_assert(TDMA_ASSIGNED_SLOTS >= 1 && TDMA_ASSIGNED_SLOTS < TDMA_SLOTS - 1, "TDMA needs at least one contention slot");
+static_assert(TDMA_SLOT_MS >= TDMA_GUARD_MS + TIMEOUT_WAITING_RX, "TDMA_SLOT_MS is shorter than an exchange");
+
+class TdmaMac {
+public:
+    /**
+     * @brief Приёмник: первый маяк сразу. Пульт: ждём маяк. Вызывать после beginRadio()
+     */
+    void begin();
+
+    /**
+     * @brief Вызывать из loop(). Приёмник: маяк в начале суперкадра. Пульт: приём маяков вне обменов
+     */
+    void service();
+
+    /**
+     * @brief Приёмник: принят кадр от пульта — закрепить за ним слот или продлить закрепление
+     *
+     * @param senderId - id отправителя из подписи
+     */
+    void recordRx(uint8_t senderId);
+
+    /**
+     * @brief Пульт: разбор принятого кадра
+     *
+     * @param message - принятый токен
+     * @return true - это маяк (часы и карта слотов обновлены), обрабатывать дальше не нужно
+     */
+    bool onFrame(const String& message);
+
+    /**
+     * @brief Пульт: дождаться начала своего слота. Без синхронизации возвращается сразу
+     *
+     * @param onTick - фоновая задача на время ожидания
+     */
+    void waitForSlot(void (*onTick)() = nullptr);
+
+    bool synced(); // Пульт: маяк слышен, слоты действуют
+
+    /**
+     * @brief Команда "tdma": карта слотов, синхронизация, уход часов, ожидание слота
+     */
+    bool handleCommand(const String& cmd, void (*reply)(const String& line));
+
+    uint32_t beacons = 0;     // Приёмник: отправлено маяков. Пульт: принято
+    uint32_t missed = 0;      // Пульт: пропущено маяков (по номерам)
+    uint32_t unslotted = 0;   // Пульт: обменов без синхронизации
+    uint32_t maxWaitMs = 0;   // Пульт: самое долгое ожидание слота
+
+private:
+    uint8_t ownSlot();                          // Пульт: закреплённый слот или случайный общий
+    unsigned long slotStart(uint8_t slot);      // Пульт: ближайшее начало слота, до которого ещё не поздно
+
+    // Общее
+    uint8_t _owner[TDMA_ASSIGNED_SLOTS] = {};   // Id владельцев закреплённых слотов (0 — свободен)
+    uint8_t _seq = 0;                           // Номер суперкадра последнего маяка
+
+    // Приёмник
+    unsigned long _ownerHeard[TDMA_ASSIGNED_SLOTS] = {};
+    unsigned long _nextBeacon = 0;
+
+    // Пульт
+    unsigned long _frameStart = 0;   // Начало суперкадра последнего маяка (millis)
+    unsigned long _anchorStart = 0;  // Начало суперкадра первого маяка после синхронизации
+    uint32_t _anchorFrames = 0;      // Сколько суперкадров от него прошло
+    float _periodMs = TDMA_SLOTS * TDMA_SLOT_MS; // Длина суперкадра в наших millis()
+    bool _synced = false;
+};
+
+extern TdmaMac MyTdma;
+
+#endif
@@ -0,0 +1,106 @@
+#include "trace.h"
+
+#ifdef TRACE_USED
+
+// Одна метка трассировки: 12 байт
+struct TraceEntry {
+    uint32_t cycles; // Счётчик тактов процессора
+    uint32_t micros; // micros() — для разворачивания переполнений счётчика тактов на хосте
+    uint16_t arg;
+    uint8_t probe;
+};
+
+static TraceEntry traceBuffer[TRACE_BUFFER_SIZE];
+static volatile uint32_t traceHead = 0; // Сколько меток записано всего (индекс в буфере = traceHead % размер)
+
+static const char* const PROBE_NAMES[] = {
+    "BUTTON_EVENT", "BLE_COMMAND", "TX_START", "TX_DONE", "RX_IRQ",
+    "READ_DATA", "RELAY_WRITE", "ACK_TX", "ACK_RX",
+};
+static_assert(sizeof(PROBE_NAMES) / sizeof(PROBE_NAMES[0]) == (size_t)TraceProbe::PROBE_COUNT,
+              "PROBE_NAMES must list every TraceProbe");
+
+
+
+/**
+ * @brief Запись метки времени (вызывается и из прерывания, поэтому в IRAM и без выделения памяти)
+ *
+ * @param probe - точка трассировки
+ * @param arg - аргумент пробы
+ */
+void IRAM_ATTR trace_record(TraceProbe probe, uint16_t arg) {
+    uint32_t cycles = ESP.getCycleCount();
+
+    // Индекс резервируем атомарно: метку может писать и loop(), и прерывание модема
+    #if defined(ARDUINO_ARCH_ESP32)
+        uint32_t index = __atomic_fetch_add(&traceHead, 1, __ATOMIC_RELAXED);
+    #else
+        noInterrupts();
+        uint32_t index = traceHead++;
+        interrupts();
+    #endif
+
+    TraceEntry& entry = traceBuffer[index % TRACE_BUFFER_SIZE];
+    entry.cycles = cycles;
+    entry.micros = micros();
+    entry.arg = arg;
+    entry.probe = (uint8_t)probe;
+}
+
+
+
+/**
+ * @brief Выгрузка буфера построчно
+ *
+ * @param writeLine - приёмник строк
+ */
+void trace_dump(void (*writeLine)(const String& line)) {
+    uint32_t head = traceHead;
+    uint32_t first = (head > TRACE_BUFFER_SIZE) ? head - TRACE_BUFFER_SIZE : 0;
+
+    writeLine("TRACE_BEGIN," + RADIO_NAME + "," + String(ESP.getCpuFreqMHz()) + "," + String(head - first));
+    for (uint32_t i = first; i < head; i++) {
+        const TraceEntry& entry = traceBuffer[i % TRACE_BUFFER_SIZE];
+        if (entry.probe >= (uint8_t)TraceProbe::PROBE_COUNT) continue;
+        writeLine("TRACE," + String(PROBE_NAMES[entry.probe]) + "," + String(entry.arg) + "," +
+                  String(entry.micros) + "," + String(entry.cycles));
+    }
+    writeLine("TRACE_END");
+}
+
+
+
+void trace_clear() {
+    traceHead = 0;
+}
+
+
+
+/**
+ * @brief Разбор команд трассировки
+ *
+ * @param cmd - команда
+ * @param reply - куда писать ответ
+ * @return true - команда обработана
+ */
+bool trace_handle_command(const String& cmd, void (*reply)(const String& line)) {
+    if (cmd.equalsIgnoreCase("trace")) {
+        trace_dump(reply);
+        return true;
+    }
+    if (cmd.equalsIgnoreCase("trace clear")) {
+        trace_clear();
+        reply("TRACE CLEARED");
+        return true;
+    }
+    return false;
+}
+
+#else
+
+void trace_record(TraceProbe probe, uint16_t arg) {}
+void trace_dump(void (*writeLine)(const String& line)) {}
+void trace_clear() {}
+bool trace_handle_command(const String& cmd, void (*reply)(const String& line)) { return false; }
+
+#endif
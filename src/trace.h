@@ -0,0 +1,70 @@
+#pragma once
+#include <Arduino.h>
+#include "settings.h"
+
+/**
+ * ТРАССИРОВКА ЗАДЕРЖЕК
+ *
+ * В фиксированных точках кода (пробах) записываем метку времени в статический кольцевой буфер:
+ * счётчик тактов процессора (точность до такта, но переполняется за ~18 с на 240 МГц) и micros()
+ * (грубая шкала, по которой хост "разворачивает" переполнения счётчика тактов).
+ * Запись — несколько десятков тактов и без выделения памяти, поэтому пробы можно ставить
+ * даже в прерывание setFlag().
+ *
+ * Выгрузка: команда "trace" в консоли Serial (обе стороны) или в BLE (пульт). "trace clear" — очистить буфер.
+ * Формат строк:
+ *   TRACE_BEGIN,<узел>,<МГц>,<кол-во>
+ *   TRACE,<проба>,<аргумент>,<micros>,<такты>
+ *   TRACE_END
+ * Логи пульта и приёмника сводит в разбивку задержек скрипт tools/trace_merge.py
+ */
+
+// Точки трассировки. Имена выводятся при выгрузке — по ним работает tools/trace_merge.py
+enum class TraceProbe : uint8_t {
+    BUTTON_EVENT = 0, // Пульт: нажатие кнопки дошло до обработчика
+    BLE_COMMAND,      // Пульт: команда с телефона дошла до обработчика
+    TX_START,         // Начало передачи пакета (аргумент — длина)
+    TX_DONE,          // Пакет ушёл в эфир
+    RX_IRQ,           // Прерывание модема "пакет принят" (setFlag)
+    READ_DATA,        // Пакет вычитан из модема (аргумент — длина)
+    RELAY_WRITE,      // Приёмник: запись в RELAY_PIN (аргумент — 1 ВКЛ / 0 ВЫКЛ)
+    ACK_TX,           // Приёмник: начинаем отправку подтверждения (1 ВКЛ / 0 ВЫКЛ / 2 статус)
+    ACK_RX,           // Пульт: подтверждение принято и распознано
+    PROBE_COUNT
+};
+
+/**
+ * @brief Запись метки времени. Безопасно вызывать из прерывания
+ *
+ * @param probe - точка трассировки
+ * @param arg - произвольный аргумент пробы (длина пакета, состояние реле и т.п.)
+ */
+void trace_record(TraceProbe probe, uint16_t arg = 0);
+
+/**
+ * @brief Выгрузка буфера построчно (от старых меток к новым)
+ *
+ * @param writeLine - куда отдавать строки (Serial, BLE)
+ */
+void trace_dump(void (*writeLine)(const String& line));
+
+/**
+ * @brief Очистка буфера трассировки
+ */
+void trace_clear();
+
+/**
+ * @brief Разбор команд "trace" / "trace clear" (из консоли Serial или BLE)
+ *
+ * @param cmd - команда
+ * @param reply - куда писать ответ
+ * @return true - команда относилась к трассировке и обработана
+ */
+bool trace_handle_command(const String& cmd, void (*reply)(const String& line));
+
+// Пробы в коде ставим через макрос: без TRACE_USED они не компилируются вовсе
+#ifdef TRACE_USED
+  #define TRACE(probe, arg) trace_record(TraceProbe::probe, arg)
+#else
+  #define TRACE(probe, arg)
+#endif
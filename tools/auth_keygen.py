@@ -0,0 +1,30 @@
+#!/usr/bin/env python3
+"""
+Случайные ключи подписи кадров (AUTH_USED, см. src/frame_auth.h) для своей сети.
+
+    python3 tools/auth_keygen.py > src/auth_keys.h
+
+Один и тот же файл — на все узлы сети (пульты, приёмники, ретрансляторы). src/auth_keys.h в git не попадает
+(.gitignore): ключи из общего репозитория знает каждый, и подпись с ними ничего не защищает.
+Формат файла — src/auth_keys.example.h.
+"""
+import secrets
+
+
+def key_literal():
+    return "{" + ", ".join("0x%02x" % b for b in secrets.token_bytes(16)) + "}"
+
+
+def main():
+    print("#pragma once")
+    print("// Ключи подписи кадров этой сети (tools/auth_keygen.py). НЕ добавлять в git, хранить как пароль")
+    print()
+    print("// Ключ пары пульт <-> приёмник (AES-128)")
+    print("#define AUTH_KEY_REMOTE_1 " + key_literal())
+    print()
+    print("// Ключ группы (AES-128), общий для всех узлов сети: маяки TDMA и команды группе")
+    print("#define AUTH_KEY_GROUP " + key_literal())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,271 @@
+/**
+ * ФАЗЗИНГ И ЗАМЕР СКОРОСТИ ТАБЛИЧНОГО РАЗБОРА КОМАНД (src/command_table.*)
+ *
+ * 1. Фаззинг: случайные строки (печатные символы, разделители, произвольные байты) длиной до
+ *    BLE_COMMAND_MAX_LEN - 1 разбираются cmd_dispatch() по случайным таблицам. Проверяется, что:
+ *    разбор не пишет за пределы строки, слова лежат внутри буфера и не содержат разделителей,
+ *    найденная команда совпадает с линейным поиском через strcasecmp, число аргументов проверено,
+ *    а во время разбора нет ни одного выделения памяти (operator new/malloc подсчитываются).
+ * 2. Замер: среднее время одного разбора для таблиц разного размера в сравнении со "старым"
+ *    способом (копия строки + цепочка сравнений startsWith/equalsIgnoreCase по std::string).
+ *
+ * Сборка и запуск (из корня репозитория):
+ *   g++ -O2 -std=c++17 -Isrc tools/cmd_bench/cmd_bench.cpp src/command_table.cpp -o cmd_bench
+ *   ./cmd_bench [итераций фаззинга] [seed]
+ */
+#include "command_table.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <strings.h>
+#include <vector>
+
+static const size_t LINE_MAX_LEN = 64; // как BLE_COMMAND_MAX_LEN
+static const size_t GUARD = 16;        // Контрольные байты вокруг строки
+
+// ######################################## ПОДСЧЁТ ВЫДЕЛЕНИЙ ########################################
+
+static size_t g_allocations = 0;
+
+void* operator new(size_t size) {
+    g_allocations++;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// ######################################## ТАБЛИЦЫ ########################################
+
+static int g_lastHandler = -1;
+static CommandArgs g_lastArgs;
+
+template <int N>
+static void handler(const CommandArgs& args) {
+    g_lastHandler = N;
+    g_lastArgs = args;
+}
+
+static const CommandHandler HANDLERS[] = {handler<0>, handler<1>, handler<2>, handler<3>,
+                                          handler<4>, handler<5>, handler<6>, handler<7>};
+
+// Таблица с именами, которые живут столько же, сколько и она сама
+struct Table {
+    std::vector<std::string> names;
+    std::vector<CommandSpec> specs;
+};
+
+static Table makeTable(size_t count, std::mt19937& rng) {
+    static const char* const BASE[] = {"?", "ble", "health", "off", "on", "pass", "setpass", "soak", "stats", "status", "trace"};
+    Table t;
+    for (const char* n : BASE) if (t.names.size() < count) t.names.push_back(n);
+    while (t.names.size() < count) {
+        std::string n = "cmd";
+        size_t len = 1 + rng() % 6;
+        for (size_t i = 0; i < len; i++) n += (char)('a' + rng() % 26);
+        t.names.push_back(n);
+    }
+    std::sort(t.names.begin(), t.names.end(), [](const std::string& a, const std::string& b) {
+        return strcasecmp(a.c_str(), b.c_str()) < 0;
+    });
+    t.names.erase(std::unique(t.names.begin(), t.names.end(), [](const std::string& a, const std::string& b) {
+        return strcasecmp(a.c_str(), b.c_str()) == 0;
+    }), t.names.end());
+
+    for (size_t i = 0; i < t.names.size(); i++) {
+        uint8_t minArgs = rng() % 3;
+        uint8_t maxArgs = minArgs + rng() % 3;
+        t.specs.push_back({t.names[i].c_str(), nullptr, minArgs, maxArgs, (rng() % 2) == 0, HANDLERS[i % 8]});
+    }
+    return t;
+}
+
+// ######################################## ФАЗЗИНГ ########################################
+
+static bool isSeparator(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static std::string randomLine(std::mt19937& rng, const Table& t) {
+    std::string s;
+    size_t len = rng() % LINE_MAX_LEN;
+    int mode = rng() % 4;
+    while (s.size() < len) {
+        switch (mode) {
+            case 0: s += (char)(1 + rng() % 255); break;                      // произвольные байты
+            case 1: s += " \t\r\nAaZz?09"[rng() % 11]; break;                 // разделители и граничные символы
+            default: {                                                       // слова из таблицы вперемешку с мусором
+                const std::string& n = t.names[rng() % t.names.size()];
+                for (char c : n) s += (rng() % 4 == 0) ? (char)toupper(c) : c;
+                s += (rng() % 3 == 0) ? "  " : " ";
+                if (rng() % 3 == 0) s += std::to_string(rng() % 1000);
+                break;
+            }
+        }
+    }
+    if (s.size() >= LINE_MAX_LEN) s.resize(LINE_MAX_LEN - 1);
+    return s;
+}
+
+static int fail(const char* what, const std::string& line) {
+    printf("FAIL: %s on \"", what);
+    for (unsigned char c : line) (c >= 32 && c < 127) ? (void)putchar(c) : (void)printf("\\x%02x", c);
+    printf("\"\n");
+    return 1;
+}
+
+static int fuzz(size_t iterations, uint32_t seed) {
+    std::mt19937 rng(seed);
+    size_t dispatched = 0, unknown = 0, badArgs = 0, noAuth = 0;
+
+    for (size_t it = 0; it < iterations; it++) {
+        static Table t;
+        if (it % 1000 == 0) t = makeTable(1 + rng() % 40, rng);
+
+        std::string line = randomLine(rng, t);
+        char buffer[GUARD + LINE_MAX_LEN + GUARD];
+        memset(buffer, 0xA5, sizeof(buffer));
+        char* text = buffer + GUARD;
+        memcpy(text, line.c_str(), line.size() + 1);
+
+        // Эталон: слова и поиск команды без хитростей
+        std::vector<std::string> words;
+        std::string cur;
+        for (char c : line) {
+            if (isSeparator(c)) { if (!cur.empty()) words.push_back(cur); cur.clear(); }
+            else cur += c;
+        }
+        if (!cur.empty()) words.push_back(cur);
+        const CommandSpec* expected = nullptr;
+        if (!words.empty()) {
+            for (const CommandSpec& s : t.specs) if (strcasecmp(s.name, words[0].c_str()) == 0) expected = &s;
+        }
+        bool authorized = rng() % 2;
+
+        g_lastHandler = -1;
+        const CommandSpec* matched = nullptr;
+        size_t allocationsBefore = g_allocations;
+        DispatchResult r = cmd_dispatch(text, t.specs.data(), t.specs.size(), authorized, &matched);
+        if (g_allocations != allocationsBefore) return fail("allocation during dispatch", line);
+
+        for (size_t i = 0; i < GUARD; i++) {
+            if ((uint8_t)buffer[i] != 0xA5) return fail("write before buffer", line);
+        }
+        for (size_t i = GUARD + line.size() + 1; i < sizeof(buffer); i++) {
+            if ((uint8_t)buffer[i] != 0xA5) return fail("write after string", line);
+        }
+
+        if (words.empty()) {
+            if (r != DispatchResult::EMPTY) return fail("empty line not reported", line);
+            continue;
+        }
+        if (matched != expected) return fail("lookup differs from reference", line);
+        if (expected == nullptr) {
+            if (r != DispatchResult::UNKNOWN) return fail("unknown command not reported", line);
+            unknown++;
+            continue;
+        }
+        if (expected->needsAuth && !authorized) {
+            if (r != DispatchResult::NOT_AUTHORIZED || g_lastHandler != -1) return fail("auth bypass", line);
+            noAuth++;
+            continue;
+        }
+        size_t argCount = words.size() - 1;
+        bool argsOk = argCount >= expected->minArgs && argCount <= expected->maxArgs && words.size() <= CMD_MAX_TOKENS;
+        if (!argsOk) {
+            if (r != DispatchResult::BAD_ARGS || g_lastHandler != -1) return fail("bad args accepted", line);
+            badArgs++;
+            continue;
+        }
+        if (r != DispatchResult::OK || g_lastHandler < 0) return fail("handler not called", line);
+        if (g_lastArgs.count != words.size()) return fail("token count", line);
+        for (size_t i = 0; i < words.size(); i++) {
+            const char* w = g_lastArgs.argv[i];
+            if (w < text || w >= text + line.size()) return fail("token outside buffer", line);
+            std::string word = words[i];
+            if (i == 0) for (char& c : word) c = cmd_lower(c); // Имя команды диспетчер приводит к нижнему регистру
+            if (word != w) return fail("token text", line);
+        }
+        dispatched++;
+    }
+
+    printf("fuzz: %zu lines OK (dispatched %zu, unknown %zu, bad args %zu, not authorized %zu)\n",
+           iterations, dispatched, unknown, badArgs, noAuth);
+    return 0;
+}
+
+// ######################################## ЗАМЕР ########################################
+
+// Как было: копия строки, trim и цепочка сравнений по всем командам подряд
+static int legacyDispatch(const std::string& input, const Table& t) {
+    std::string cmd = input;
+    while (!cmd.empty() && isSeparator(cmd.back())) cmd.pop_back();
+    size_t start = 0;
+    while (start < cmd.size() && isSeparator(cmd[start])) start++;
+    cmd = cmd.substr(start);
+    for (size_t i = 0; i < t.specs.size(); i++) {
+        size_t n = strlen(t.specs[i].name);
+        if (strncasecmp(cmd.c_str(), t.specs[i].name, n) == 0 && (cmd.size() == n || cmd[n] == ' ')) {
+            std::string args = cmd.size() > n ? cmd.substr(n + 1) : std::string();
+            return (int)i + (int)args.size();
+        }
+    }
+    return -1;
+}
+
+static void bench() {
+    std::mt19937 rng(7);
+    printf("%8s %14s %14s %12s\n", "commands", "table, ns", "legacy, ns", "allocs/line");
+
+    for (size_t count : {4, 11, 32, 128, 512}) {
+        Table t = makeTable(count, rng);
+        std::vector<std::string> lines;
+        for (int i = 0; i < 256; i++) {
+            const CommandSpec& s = t.specs[rng() % t.specs.size()];
+            std::string l = s.name;
+            for (int a = 0; a < s.maxArgs; a++) l += " arg" + std::to_string(a);
+            lines.push_back(l);
+        }
+
+        const size_t rounds = 2000;
+        char buffer[LINE_MAX_LEN];
+        volatile int sink = 0;
+
+        size_t allocationsBefore = g_allocations;
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < rounds; r++) {
+            for (const std::string& l : lines) {
+                memcpy(buffer, l.c_str(), l.size() + 1);
+                sink = sink + (int)cmd_dispatch(buffer, t.specs.data(), t.specs.size(), true);
+            }
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        size_t allocations = g_allocations - allocationsBefore;
+        for (size_t r = 0; r < rounds; r++) {
+            for (const std::string& l : lines) sink = sink + legacyDispatch(l, t);
+        }
+        auto t2 = std::chrono::steady_clock::now();
+
+        double n = (double)(rounds * lines.size());
+        printf("%8zu %14.1f %14.1f %12.2f\n", t.specs.size(),
+               std::chrono::duration<double, std::nano>(t1 - t0).count() / n,
+               std::chrono::duration<double, std::nano>(t2 - t1).count() / n, allocations / n);
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? (size_t)atol(argv[1]) : 200000;
+    uint32_t seed = argc > 2 ? (uint32_t)atol(argv[2]) : 1;
+
+    if (fuzz(iterations, seed) != 0) return 1;
+    bench();
+    return 0;
+}
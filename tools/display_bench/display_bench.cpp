@@ -0,0 +1,177 @@
+/**
+ * ПРОВЕРКА И ЗАМЕР ПОСТРАНИЧНОЙ ОТРИСОВКИ ЭКРАНА (src/status_renderer.*) НА ХОСТЕ
+ *
+ * 1. Совпадение по пикселям с прежним путём (Adafruit_SSD1306 + GFX): модель кадра 1 КБ, символы
+ *    размера 1 рисуются попиксельно с теми же правилами курсора и переноса, что у println(). На каждом
+ *    кадре память "дисплея", собранная только из отправленных страниц, сравнивается с моделью — так
+ *    проверяется и раскладка, и пропуск неизменившихся страниц. Глифы модель берёт у рендерера
+ *    (символ в углу пустого экрана): сверяется отрисовка, а не сам шрифт.
+ * 2. Замер на типичной последовательности экранов пульта (меняются RSSI/RTT, напряжение, реле):
+ *    время сборки кадра, байты по I2C на кадр и время шины на 400 кГц (9 бит на байт), ОЗУ.
+ *    Время на плате — команда "display bench".
+ *
+ * Сборка и запуск (из корня репозитория):
+ *   g++ -O2 -std=c++17 -Isrc tools/display_bench/display_bench.cpp src/status_renderer.cpp -o display_bench
+ *   ./display_bench
+ */
+#include "status_renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#define I2C_HZ 400000
+#define WIRE_CHUNK 31        // Данных за передачу в output_display.cpp
+#define ADAFRUIT_CHUNK 127   // Adafruit_SSD1306 на ESP32: буфер Wire 128 байт минус байт управления
+#define ADAFRUIT_FONT_BYTES (256 * 5) // glcdfont.c: все 256 кодов
+#define RENDERER_FONT_BYTES ((0x7E - 0x20 + 1) * 5)
+
+static uint8_t glyphs[256][5];
+
+// --- Модель прежнего пути: кадр в ОЗУ, drawChar попиксельно, display() шлёт весь кадр ---
+struct ReferenceDisplay {
+    uint8_t buffer[STATUS_WIDTH * STATUS_PAGES];
+
+    void clear() { memset(buffer, 0, sizeof(buffer)); }
+
+    void drawPixel(int x, int y) {
+        if (x < 0 || x >= STATUS_WIDTH || y < 0 || y >= STATUS_HEIGHT) return;
+        buffer[x + (y / 8) * STATUS_WIDTH] |= 1 << (y & 7);
+    }
+
+    void drawChar(int x, int y, unsigned char c) {
+        if (x >= STATUS_WIDTH || y >= STATUS_HEIGHT || x + 5 < 0 || y + 7 < 0) return;
+        for (int col = 0; col < 5; col++)
+            for (int row = 0; row < 8; row++)
+                if (glyphs[c][col] & (1 << row)) drawPixel(x + col, y + row);
+    }
+
+    // Правила курсора Adafruit GFX при размере 1 и включённом переносе
+    void print(int& x, int& y, const std::string& text) {
+        for (unsigned char c : text) {
+            if (c == '\n') {
+                x = 0;
+                y += 8;
+            } else if (c != '\r') {
+                if (x + 6 > STATUS_WIDTH) {
+                    x = 0;
+                    y += 8;
+                }
+                drawChar(x, y, c);
+                x += 6;
+            }
+        }
+    }
+};
+
+// --- Приёмник страниц нового пути: память дисплея и счёт байтов шины ---
+static uint8_t panel[STATUS_WIDTH * STATUS_PAGES];
+static uint64_t newBusBytes = 0;
+
+static void sendPage(uint8_t page, const uint8_t* data) {
+    memcpy(panel + page * STATUS_WIDTH, data, STATUS_WIDTH);
+    newBusBytes += 1 + 1 + 6; // Адрес, байт управления, окно 0x21/0x22
+    for (int offset = 0; offset < STATUS_WIDTH; offset += WIRE_CHUNK)
+        newBusBytes += 2 + std::min(WIRE_CHUNK, STATUS_WIDTH - offset);
+}
+
+static void discardPage(uint8_t, const uint8_t*) {}
+
+static uint64_t referenceBusBytes() {
+    uint64_t bytes = 1 + 1 + 6; // Окно на весь экран
+    for (int offset = 0; offset < (int)sizeof(panel); offset += ADAFRUIT_CHUNK)
+        bytes += 2 + std::min(ADAFRUIT_CHUNK, (int)sizeof(panel) - offset);
+    return bytes;
+}
+
+static void loadGlyphs() {
+    StatusRenderer probe;
+    for (int c = 0; c < 256; c++) {
+        if (c == '\n' || c == '\r' || c == 0) continue;
+        char text[2] = {(char)c, 0};
+        memset(panel, 0, sizeof(panel));
+        probe.invalidate();
+        probe.render(0, 0, text, sendPage);
+        memcpy(glyphs[c], panel, 5);
+    }
+}
+
+// Экран пульта: как updateDisplayStatus() — статус, связь, сообщение, сводка линка, батареи
+static std::string statusScreen(std::mt19937& rng, int frame) {
+    bool online = rng() % 10 != 0;
+    bool relay = (frame / 20) % 2;
+    char summary[96], battery[48];
+    snprintf(summary, sizeof(summary), "RSSI %d SNR %.1f RTT %u", -60 - (int)(rng() % 60),
+             (int)(rng() % 200) / 10.0 - 5, 180 + (unsigned)(rng() % 120));
+    snprintf(battery, sizeof(battery), "TX %.2fV RX %.2fV", 3.9 - frame * 0.001, 4.1 - (rng() % 3) * 0.01);
+    return std::string("RELAY") + (online ? " [RELAY ONLINE]" : " [RELAY NOT ONLINE]") + "\n---------\n" +
+           (relay ? "STATUS: ON" : "STATUS: OFF") + "\n" + summary + "\n" + battery;
+}
+
+int main() {
+    loadGlyphs();
+    const int frames = 2000;
+    std::mt19937 rng(1);
+    std::vector<std::string> screens;
+    for (int i = 0; i < frames; i++) screens.push_back(statusScreen(rng, i));
+    // Крайние случаи раскладки: длинные строки с переносом, сдвиг, выход за края, символы вне шрифта
+    screens.push_back("0123456789012345678901234567890123456789012345678901234567890123456789");
+    screens.push_back("\r\rA\rB\n\n\n\n\n\n\n\n\n\nbelow bottom");
+    screens.push_back("\x01\xC0\xFF ~{|}\n`^_");
+
+    // 1. Совпадение по пикселям, в том числе с ненулевым началом
+    bool ok = true;
+    StatusRenderer renderer;
+    ReferenceDisplay reference;
+    const int origins[][2] = {{0, 5}, {0, 0}, {3, 1}, {-4, -3}, {100, 60}};
+    for (auto& origin : origins) {
+        renderer.invalidate();
+        memset(panel, 0xAA, sizeof(panel));
+        for (auto& text : screens) {
+            reference.clear();
+            int x = origin[0], y = origin[1];
+            reference.print(x, y, text);
+            renderer.render(origin[0], origin[1], text.c_str(), sendPage);
+            if (memcmp(panel, reference.buffer, sizeof(panel)) != 0) {
+                printf("MISMATCH at origin %d,%d: \"%s\"\n", origin[0], origin[1], text.c_str());
+                ok = false;
+                break;
+            }
+        }
+    }
+    printf("%-28s %s\n", "pixel-identical to GFX", ok ? "OK" : "FAIL");
+
+    // 2. Последовательность экранов: байты шины и время сборки
+    renderer = StatusRenderer();
+    newBusBytes = 0;
+    for (int i = 0; i < frames; i++) renderer.render(0, 5, screens[i].c_str(), sendPage);
+    uint64_t refBus = referenceBusBytes() * frames;
+
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        reference.clear();
+        int x = 0, y = 5;
+        reference.print(x, y, screens[i]);
+    }
+    double refUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count() / frames;
+    StatusRenderer timed;
+    started = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) timed.render(0, 5, screens[i].c_str(), discardPage);
+    double newUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count() / frames;
+
+    double refBusMs = refBus * 9.0 / I2C_HZ * 1000 / frames;
+    double newBusMs = newBusBytes * 9.0 / I2C_HZ * 1000 / frames;
+    printf("\n%d status frames, I2C %d kHz\n", frames, I2C_HZ / 1000);
+    printf("%-22s %12s %12s\n", "", "GFX 1KB", "pages");
+    printf("%-22s %12.2f %12.2f\n", "compose, us/frame", refUs, newUs);
+    printf("%-22s %12.0f %12.0f\n", "I2C bytes/frame", (double)refBus / frames, (double)newBusBytes / frames);
+    printf("%-22s %12.2f %12.2f\n", "I2C time, ms/frame", refBusMs, newBusMs);
+    printf("%-22s %12d %12zu\n", "RAM, bytes", STATUS_WIDTH * STATUS_PAGES, sizeof(StatusRenderer));
+    printf("%-22s %12d %12d\n", "font flash, bytes", ADAFRUIT_FONT_BYTES, RENDERER_FONT_BYTES);
+    printf("glyph cache: %u hits, %u misses\n", renderer.glyphHits, renderer.glyphMisses);
+    return ok ? 0 : 1;
+}
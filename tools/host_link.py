@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""
+Клиент двоичного протокола хоста (см. src/host_link.h) для стендов и автоматизации.
+
+    python3 tools/host_link.py /dev/ttyACM0 status
+    python3 tools/host_link.py /dev/ttyACM0 relay on
+    python3 tools/host_link.py /dev/ttyACM0 command "config"
+    python3 tools/host_link.py /dev/ttyACM0 log          # только лог, до Ctrl+C
+
+Как модуль: HostLink(port).relay(True) -> (флаги, мс), .status() -> dict, .command("stats") -> [строки].
+Кадры LOG, пришедшие между ответами, складываются в .logs (или печатаются с --verbose).
+Нужен pyserial.
+"""
+import struct
+import sys
+import time
+
+HELLO, RELAY, STATUS, COMMAND, BYE = 0x01, 0x02, 0x03, 0x04, 0x05
+ACK, TEXT, END, LOG, ERROR = 0x80, 0x84, 0x85, 0xC0, 0xEE
+
+RESULT_DELIVERED, RESULT_ALREADY, RESULT_SUPERSEDED, RESULT_RELAY_ON = 1, 2, 4, 8
+ERRORS = {1: "unknown command", 2: "bad type", 3: "bad length", 4: "unsupported by role", 5: "busy"}
+
+STATUS_FORMAT = "<BBBIbbbbHHIIII"
+STATUS_FIELDS = ("relay", "rx_online", "implicit", "last_ack_age_ms", "rssi", "snr", "peer_rssi", "peer_snr",
+                 "mv", "peer_mv", "exchanges", "acked", "sent", "superseded")
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, как в прошивке."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_encode(data):
+    out, block = bytearray(), bytearray()
+    for byte in data:
+        if byte == 0:
+            out += bytes([len(block) + 1]) + block
+            block = bytearray()
+        else:
+            block.append(byte)
+            if len(block) == 254:
+                out += b"\xff" + block
+                block = bytearray()
+    return bytes(out + bytes([len(block) + 1]) + block)
+
+
+def cobs_decode(data):
+    out, i = bytearray(), 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            raise ValueError("bad COBS")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def encode_frame(kind, request_id, payload=b""):
+    body = struct.pack("<BH", kind, request_id) + payload
+    return cobs_encode(body + struct.pack("<H", crc16(body))) + b"\x00"
+
+
+def decode_frame(wire):
+    """Кадр без разделителя -> (тип, id, данные) или None, если битый."""
+    try:
+        body = cobs_decode(wire)
+    except ValueError:
+        return None
+    if len(body) < 5 or crc16(body[:-2]) != struct.unpack("<H", body[-2:])[0]:
+        return None
+    kind, request_id = struct.unpack("<BH", body[:3])
+    return kind, request_id, body[3:-2]
+
+
+class HostLink:
+    def __init__(self, port, baud=115200, timeout=10.0, verbose=False):
+        import serial  # pyserial
+        self.serial = serial.Serial(port, baud, timeout=0.1)
+        self.timeout = timeout
+        self.verbose = verbose
+        self.logs = []
+        self.next_id = 1
+        self.buffer = bytearray()
+        self.hello()
+
+    def _send(self, kind, payload=b""):
+        request_id = self.next_id
+        self.next_id = self.next_id % 0xFFFF + 1  # id 0 занят каналом LOG
+        self.serial.write(encode_frame(kind, request_id, payload))
+        return request_id
+
+    def frames(self, timeout=None):
+        """Кадры по мере прихода; LOG уходит в .logs и наружу тоже отдаётся."""
+        deadline = time.monotonic() + (self.timeout if timeout is None else timeout)
+        while time.monotonic() < deadline:
+            self.buffer += self.serial.read(256)
+            while b"\x00" in self.buffer:
+                wire, _, self.buffer = self.buffer.partition(b"\x00")
+                frame = decode_frame(bytes(wire)) if wire else None
+                if frame is None:
+                    continue  # Текст консоли до HELLO или обрывок
+                if frame[0] == LOG:
+                    line = frame[2].decode(errors="replace")
+                    self.logs.append(line)
+                    if self.verbose:
+                        print("LOG", line, file=sys.stderr)
+                yield frame
+        raise TimeoutError("no reply from node")
+
+    def _wait(self, request_id, kinds):
+        for kind, frame_id, data in self.frames():
+            if frame_id != request_id:
+                continue
+            if kind == ERROR:
+                raise RuntimeError(ERRORS.get(data[0], "error %d" % data[0]))
+            if kind in kinds:
+                return kind, data
+
+    def hello(self):
+        self.serial.write(b"\x00")  # Отделить кадр от мусора в линии
+        _, data = self._wait(self._send(HELLO), (HELLO | ACK,))
+        self.version, role, self.node_id, self.frame_max = struct.unpack("<BcBH", data[:5])
+        self.role = role.decode()
+
+    def relay(self, on):
+        """-> (флаги RESULT_*, мс от запроса до итога)."""
+        _, data = self._wait(self._send(RELAY, bytes([1 if on else 0])), (RELAY | ACK,))
+        return struct.unpack("<BI", data[:5])
+
+    def status(self):
+        _, data = self._wait(self._send(STATUS), (STATUS | ACK,))
+        return dict(zip(STATUS_FIELDS, struct.unpack(STATUS_FORMAT, data[:struct.calcsize(STATUS_FORMAT)])))
+
+    def command(self, line):
+        request_id = self._send(COMMAND, line.encode())
+        lines = []
+        for kind, frame_id, data in self.frames():
+            if frame_id != request_id:
+                continue
+            if kind == TEXT:
+                lines.append(data.decode(errors="replace"))
+            elif kind == END:
+                if data[0] != 0:
+                    raise RuntimeError(ERRORS.get(data[0], "error %d" % data[0]))
+                return lines
+            elif kind == ERROR:
+                raise RuntimeError(ERRORS.get(data[0], "error %d" % data[0]))
+
+    def close(self):
+        self._wait(self._send(BYE), (END,))
+        self.serial.close()
+
+
+def main(argv):
+    if len(argv) < 3:
+        print(__doc__)
+        return 2
+    link = HostLink(argv[1], verbose="--verbose" in argv)
+    print("node %s id %d, protocol v%d" % (link.role, link.node_id, link.version))
+    action = argv[2]
+    if action == "status":
+        for key, value in link.status().items():
+            print("%-16s %s" % (key, value))
+    elif action == "relay":
+        flags, ms = link.relay(argv[3] == "on")
+        names = [name for bit, name in ((RESULT_DELIVERED, "delivered"), (RESULT_ALREADY, "already"),
+                                        (RESULT_SUPERSEDED, "superseded"), (RESULT_RELAY_ON, "relay on")) if flags & bit]
+        print("RESULT %s in %d ms" % (", ".join(names) or "not delivered", ms))
+    elif action == "command":
+        print("\n".join(link.command(argv[3])))
+    elif action == "log":
+        try:
+            for kind, _, data in link.frames(timeout=float("inf")):
+                if kind == LOG:
+                    print(data.decode(errors="replace"))
+        except KeyboardInterrupt:
+            pass
+    link.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,8 @@
+#pragma once
+// Минимальная замена Arduino.h для сборки хостовых инструментов с settings.h прошивки.
+// settings.h нужен только ради макросов (LORA_CONFIGURATION, команды, тайминги), поэтому
+// здесь есть лишь то, что он объявляет.
+#include <stdint.h>
+#include <string>
+
+typedef std::string String;
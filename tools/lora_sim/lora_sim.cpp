@@ -0,0 +1,922 @@
+/**
+ * ДИСКРЕТНО-СОБЫТИЙНЫЙ СИМУЛЯТОР КАНАЛА LoRa
+ *
+ * Прогоняет N виртуальных пультов и M приёмников, работающих по протоколу прошивки
+ * (коалесцер команд + sendCommandAndWaitAck на пульте, ответ через TIMEOUT_WAITING_TX на приёмнике),
+ * в общем канале с параметрами LORA_CONFIGURATION из src/settings.h, и считает:
+ * долю доставленных и подтверждённых команд, перцентили задержки и загрузку эфира.
+ *
+ * Модель канала:
+ *  - время в эфире по формуле Semtech (src/lora_airtime.h) для реальной длины кадров;
+ *  - потери на трассе log-distance + логнормальное затенение (фиксированное для пары узлов);
+ *  - шумовой порог -174 + 10lg(BW) + NF, порог демодуляции по SF;
+ *  - PER как логистическая функция запаса по SNR;
+ *  - capture effect: пакет переживает наложение, если он сильнее каждой помехи на capture дБ;
+ *  - полудуплекс: передающий узел не слышит эфир.
+ *
+ * Сборка и запуск (из корня репозитория):
+ *   g++ -O2 -std=c++17 -Isrc -Itools/lora_sim/host tools/lora_sim/lora_sim.cpp -o lora_sim
+ *   ./lora_sim --remotes 1,3 --receivers 1,10,30 --cmd-interval 30 --duration 3600
+ *
+ * Частотная агильность (src/channel_plan.h): --channels N раскладывает узлы на план из N каналов
+ * (все начинают с канала N/2), --jam ch включает на канале ch помеху --jam-dbm у всех узлов с момента
+ * --jam-start. Каждая пара чисел пультов/приёмников прогоняется дважды: "fixed" — все остаются на
+ * домашнем канале, "agile" — пульт сканирует шум и ведёт переходы, приёмник уходит с забитого канала
+ * и ищет пульт обходом, как в прошивке. Сравнивайте deliv% и conf% двух строк:
+ *   ./lora_sim --channels 5 --jam 2 --poll 60 --duration 7200
+ *
+ * Ретрансляция (src/repeater.h): --repeaters N[,N..] ставит пульт, N ретрансляторов и приёмник на одну
+ * линию с шагом --line м (удобно взять шаг чуть меньше дальности одного прыжка — тогда приёмник слышен
+ * только через всю цепочку). Кадры получают байт TTL, пульт ждёт ответ дольше (RadioManager::ackTimeout),
+ * ретрансляторы отсеивают дубли и пересылают через случайную паузу:
+ *   ./lora_sim --repeaters 0,1,2,3 --line 5000 --shadowing 0 --duration 7200
+ *
+ * Слоты TDMA (src/tdma.h): --tdma прогоняет каждую пару чисел дважды — "aloha" (как без TDMA_USED) и "tdma":
+ * первый приёмник шлёт маяки, пульты передают в начале своего слота. Часы узлов в модели идеальные — уход
+ * кварца прошивка компенсирует по маякам. --slots и --assigned заменяют TDMA_SLOTS и TDMA_ASSIGNED_SLOTS.
+ * Сравнивайте conf% и max,ms при росте числа пультов:
+ *   ./lora_sim --tdma --addressed --slots 24 --assigned 21 --remotes 1,5,10,20 --cmd-interval 20 --poll 60 --area 1500
+ *
+ * Флаг --addressed моделирует адресный протокол (отвечает только приёмник-адресат). Без него
+ * моделируется протокол как есть: команду исполняют и подтверждают все приёмники, услышавшие её,
+ * а пульт принимает любой ACK (счётчик false ACK показывает, сколько раз это было чужое подтверждение).
+ */
+#include "settings.h"
+#include "lora_airtime.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef int64_t sim_time; // мкс
+
+static const size_t METRICS_SUFFIX_LEN = 7; // "|-87,9" + запас на трёхзначный RSSI
+#ifdef BATTERY_USED
+static const size_t REPLY_SUFFIX_LEN = METRICS_SUFFIX_LEN + 6; // Ответ приёмника: + ",23150" (напряжение батареи, мВ)
+#else
+static const size_t REPLY_SUFFIX_LEN = METRICS_SUFFIX_LEN;
+#endif
+#ifdef AUTH_USED
+static const size_t FRAME_OVERHEAD = AUTH_OVERHEAD; // id, счётчик и подпись кадра (src/frame_auth.h)
+#else
+static const size_t FRAME_OVERHEAD = 0;
+#endif
+
+// Параметры частотной агильности — из settings.h, если план каналов включён в прошивке
+#ifndef CHANNEL_PLAN_USED
+  #define CMD_CHANNEL "CH_"
+  #define ACK_CHANNEL "CH_OK"
+  #define CHANNEL_SCAN_INTERVAL 300000
+  #define CHANNEL_SWITCH_MARGIN 6
+  #define CHANNEL_LOSS_PENALTY 20
+  #define CHANNEL_JAM_MARGIN 15
+  #define CHANNEL_TX_FAILS 3
+  #define CHANNEL_RX_SAMPLE_INTERVAL 2000
+  #define CHANNEL_RX_JAM_SAMPLES 3
+  #define CHANNEL_RX_LOST 600000
+  #define CHANNEL_RX_DWELL 240000
+#endif
+#ifndef REPEATER_USED
+  #define REPEATER_HOP_LIMIT 3
+  #define REPEATER_CACHE_SIZE 32
+  #define REPEATER_QUEUE_SIZE 4
+  #define REPEATER_JITTER_MIN 10
+  #define REPEATER_JITTER_MAX 200
+#endif
+#ifndef TDMA_USED
+  #define TDMA_SLOTS 8
+  #define TDMA_ASSIGNED_SLOTS 4
+  #define TDMA_SLOT_MS 500
+  #define TDMA_GUARD_MS 20
+  #define TDMA_ASSIGN_TIMEOUT 600000
+  #define TDMA_SYNC_LOST 4
+  #define CMD_BEACON "BCN_"
+#endif
+
+// ######################################## ПАРАМЕТРЫ ########################################
+
+struct SimConfig {
+    int remotes = 1;
+    int receivers = 1;
+    double durationS = 3600;      // Длительность моделирования
+    double cmdIntervalS = 30;     // Средний интервал между нажатиями на одном пульте (пуассоновский поток)
+    double pollIntervalS = 0;     // Фоновая сверка (0 — выключена)
+    double areaM = 3000;          // Узлы случайно раскиданы по квадрату areaM x areaM
+    double pathLossExp = 3.2;     // Показатель затухания log-distance
+    double shadowingDb = 6;       // СКО затенения
+    double noiseFigureDb = 6;     // Коэффициент шума приёмника
+    double captureDb = 6;         // Порог capture effect
+    int retries = 0;              // Повторы после таймаута (прошивка: 0, повтор делает сверка)
+    bool addressed = false;       // Отвечает только приёмник-адресат
+    int channels = 1;             // Каналов в плане (1 — одна частота, как без CHANNEL_PLAN_USED)
+    int jamChannel = -1;          // Канал под помехой (-1 — без помехи)
+    double jamDbm = -80;          // Уровень помехи на этом канале у каждого узла
+    double jamStartS = -1;        // Включение помехи (-1 — на четверти прогона)
+    bool agile = false;           // Частотная агильность: скан, табло и переходы
+    int repeaters = -1;           // Ретрансляторов на линии пульт — приёмник (-1 — без ретрансляции, узлы в квадрате)
+    double lineM = 5000;          // Шаг линии между соседними узлами
+    bool tdma = false;            // Слоты по маяку первого приёмника
+    int slots = TDMA_SLOTS;       // Слотов в суперкадре (слот 0 — маяк)
+    int assigned = TDMA_ASSIGNED_SLOTS; // Из них закрепляемых
+    uint32_t seed = 1;
+};
+
+// ######################################## КАДРЫ И ЭФИР ########################################
+
+enum class FrameType { CMD_ON, CMD_OFF, POLL, CHANNEL, ACK, BEACON };
+
+struct Frame {
+    FrameType type;
+    int src;
+    int dst;            // Адресат (в режиме "как есть" приёмники его игнорируют)
+    uint64_t exchange;  // Номер обмена пульта — чтобы отличать "свой" ACK от чужого
+    size_t length;      // Длина полезной нагрузки, байт
+    int arg;            // CHANNEL: номер канала, на который переходим; BEACON: опоздание маяка, мс
+    int origin = -1;    // Кто создал кадр (src — кто передал его в эфир, может быть ретранслятор)
+    uint64_t seq = 0;   // Номер кадра у создателя (счётчик подписи)
+    int ttl = REPEATER_HOP_LIMIT;
+    std::vector<int> owners = {}; // BEACON: владельцы закреплённых слотов (-1 — свободен)
+};
+
+struct Transmission {
+    Frame frame;
+    int channel;
+    sim_time start;
+    sim_time end;
+};
+
+struct Stats {
+    uint64_t requests = 0, superseded = 0, exchanges = 0, attempts = 0;
+    uint64_t delivered = 0, confirmed = 0, falseAck = 0, failed = 0;
+    uint64_t polls = 0, pollsOk = 0;
+    uint64_t collisions = 0, belowSensitivity = 0, perLoss = 0, deafLoss = 0, offChannel = 0;
+    uint64_t hops = 0; // Переходы пульта на другой канал (согласованные и аварийные)
+    uint64_t forwarded = 0, duplicates = 0; // Ретрансляторы: пересылки и отсеянные дубли
+    sim_time airtimeSum = 0, airtimeBusy = 0;
+    std::vector<double> latencyMs;
+};
+
+class Simulator;
+
+class Node {
+public:
+    Node(Simulator& sim, int id, double x, double y) : sim(sim), id(id), x(x), y(y) {}
+    virtual ~Node() {}
+    virtual void start() {}
+    virtual void onFrame(const Frame& frame) = 0;
+    virtual void onTxDone() {}
+
+    Simulator& sim;
+    int id;
+    double x, y;
+    bool deaf = false;      // Прошивка "не слушает" эфир (например, в delay() перед ответом)
+    int channel = 0;        // Текущий канал плана
+    sim_time txStart = -1;  // Последняя собственная передача
+    sim_time txEnd = -1;
+    uint64_t txSeq = 0;     // Счётчик собственных кадров
+};
+
+class Simulator {
+public:
+    explicit Simulator(const SimConfig& config) : cfg(config), rng(config.seed) {
+        noiseDbm = -174.0 + 10.0 * std::log10(RADIO_BANDWIDTH * 1000.0) + cfg.noiseFigureDb;
+        jamStart = (sim_time)((cfg.jamStartS < 0 ? cfg.durationS / 4 : cfg.jamStartS) * 1e6);
+    }
+
+    int homeChannel() const { return cfg.channels / 2; }
+
+    // Шум эфира на канале сейчас: тепловой + помеха, если она включена на этом канале
+    double noiseAt(int channel) const {
+        if (channel != cfg.jamChannel || now < jamStart) return noiseDbm;
+        return 10.0 * std::log10(std::pow(10.0, noiseDbm / 10.0) + std::pow(10.0, cfg.jamDbm / 10.0));
+    }
+
+    double quietest() const { return noiseDbm; } // Самый тихий канал плана — без помехи
+
+    void schedule(sim_time at, std::function<void()> fn) {
+        queue.push(Event{at, seq++, std::move(fn)});
+    }
+
+    bool repeaterNet() const { return cfg.repeaters >= 0; }
+    sim_time superframe() const { return (sim_time)cfg.slots * TDMA_SLOT_MS * 1000; }
+
+    sim_time airtime(size_t length) const {
+        return lora_time_on_air_us(length + FRAME_OVERHEAD + (repeaterNet() ? 1 : 0), RADIO_SPREAD_FACTOR, RADIO_BANDWIDTH,
+                                   RADIO_CODING_RATE, RADIO_PREAMBLE_LENGTH);
+    }
+
+    // RadioManager::ackTimeout(): с ретрансляцией — запас на пересылки команды и ответа
+    sim_time ackTimeout() const {
+        if (!repeaterNet()) return (sim_time)TIMEOUT_WAITING_RX * 1000;
+        sim_time frameMs = airtime(21) / 1000 + 1;
+        return ((sim_time)TIMEOUT_WAITING_RX + 2 * REPEATER_HOP_LIMIT * (REPEATER_JITTER_MAX + frameMs)) * 1000;
+    }
+
+    // Передача кадра узлом: через время в эфире все остальные узлы решают, приняли ли они его
+    void transmit(Node& node, Frame frame) {
+        if (frame.origin < 0) {
+            frame.origin = node.id; // Новый кадр: свой номер, полный TTL
+            frame.seq = ++node.txSeq;
+            frame.ttl = REPEATER_HOP_LIMIT;
+        }
+        frame.src = node.id;
+        sim_time start = now;
+        sim_time end = now + airtime(frame.length);
+        node.txStart = start;
+        node.txEnd = end;
+
+        stats.airtimeSum += end - start;
+        stats.airtimeBusy += std::max<sim_time>(0, end - std::max(start, busyUntil));
+        busyUntil = std::max(busyUntil, end);
+
+        air.push_back(Transmission{frame, node.channel, start, end});
+        size_t index = air.size() - 1;
+        schedule(end, [this, &node, index]() {
+            Transmission tx = air[index];
+            for (auto& other : nodes) {
+                if (other->id != node.id) deliver(tx, *other);
+            }
+            node.onTxDone();
+        });
+    }
+
+    // Решение о приёме кадра tx узлом rx
+    void deliver(const Transmission& tx, Node& rx) {
+        if (rx.txEnd > tx.start && rx.txStart < tx.end) return; // Сами передавали — полудуплекс
+
+        bool intended = (tx.frame.dst == rx.id);
+        if (rx.channel != tx.channel) {
+            if (intended) stats.offChannel++;
+            return;
+        }
+        double rssi = rxPower(tx.frame.src, rx.id);
+        double snr = rssi - noiseAt(tx.channel);
+        if (snr < lora_snr_floor_db(RADIO_SPREAD_FACTOR)) {
+            if (intended) stats.belowSensitivity++;
+            return;
+        }
+        if (rx.deaf) {
+            if (intended) stats.deafLoss++;
+            return;
+        }
+        for (const auto& other : air) {
+            if (other.frame.src == tx.frame.src) continue; // Сам кадр (узел не передаёт два кадра одновременно)
+            if (other.channel != tx.channel) continue;
+            if (other.end <= tx.start || other.start >= tx.end) continue;
+            if (rssi - rxPower(other.frame.src, rx.id) < cfg.captureDb) {
+                if (intended) stats.collisions++;
+                return;
+            }
+        }
+        double margin = snr - lora_snr_floor_db(RADIO_SPREAD_FACTOR);
+        double per = 1.0 / (1.0 + std::exp(2.0 * margin));
+        if (uniform() < per) {
+            if (intended) stats.perLoss++;
+            return;
+        }
+        rx.onFrame(tx.frame);
+    }
+
+    void run() {
+        for (auto& node : nodes) node->start();
+        sim_time endTime = (sim_time)(cfg.durationS * 1e6);
+        while (!queue.empty() && queue.top().at <= endTime) {
+            Event ev = queue.top();
+            queue.pop();
+            now = ev.at;
+            ev.fn();
+            prune();
+        }
+    }
+
+    double uniform() { return std::uniform_real_distribution<double>(0.0, 1.0)(rng); }
+    double exponential(double mean) { return std::exponential_distribution<double>(1.0 / mean)(rng); }
+
+    SimConfig cfg;
+    std::mt19937 rng;
+    sim_time now = 0;
+    Stats stats;
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::vector<int> receiverIds;
+    uint64_t nextExchange = 1;
+
+private:
+    struct Event {
+        sim_time at;
+        uint64_t seq;
+        std::function<void()> fn;
+        bool operator<(const Event& o) const { return at != o.at ? at > o.at : seq > o.seq; }
+    };
+
+    double rxPower(int from, int to) {
+        const Node& a = *nodes[from];
+        const Node& b = *nodes[to];
+        double d = std::max(1.0, std::hypot(a.x - b.x, a.y - b.y));
+        double fspl1m = 20.0 * std::log10(RADIO_FREQ) - 27.55;
+        return RADIO_OUTPUT_POWER - (fspl1m + 10.0 * cfg.pathLossExp * std::log10(d) + shadowing(from, to));
+    }
+
+    // Затенение фиксировано для пары узлов и симметрично
+    double shadowing(int a, int b) {
+        if (a > b) std::swap(a, b);
+        size_t key = (size_t)a * nodes.size() + b;
+        if (shadow.size() < nodes.size() * nodes.size()) shadow.assign(nodes.size() * nodes.size(), NAN);
+        if (std::isnan(shadow[key])) shadow[key] = std::normal_distribution<double>(0.0, cfg.shadowingDb)(rng);
+        return shadow[key];
+    }
+
+    // Когда эфир пуст, все события окончания передач уже отработали — историю можно забыть
+    void prune() {
+        if (!air.empty() && busyUntil < now) air.clear();
+    }
+
+    std::priority_queue<Event> queue;
+    uint64_t seq = 0;
+    std::vector<Transmission> air;
+    sim_time busyUntil = 0;
+    double noiseDbm;
+    sim_time jamStart;
+    std::vector<double> shadow;
+};
+
+// ######################################## ВИРТУАЛЬНЫЕ ПРОШИВКИ ########################################
+
+/**
+ * Пульт: CommandEngine (цель + коалесцирование) поверх sendCommandAndWaitAck и Reconciler
+ */
+class Remote : public Node {
+public:
+    using Node::Node;
+
+    void start() override {
+        sim.schedule(sim.now + (sim_time)(sim.exponential(sim.cfg.cmdIntervalS) * 1e6), [this]() { userRequest(); });
+        if (sim.cfg.pollIntervalS > 0) {
+            sim.schedule(sim.now + (sim_time)(sim.uniform() * sim.cfg.pollIntervalS * 1e6), [this]() { pollTick(); });
+        }
+        if (sim.cfg.agile) {
+            delivery.assign(sim.cfg.channels, 1.0);
+            sim.schedule(sim.now + (sim_time)CHANNEL_SCAN_INTERVAL * 1000, [this]() { scanTick(); });
+        }
+    }
+
+    void onFrame(const Frame& frame) override {
+        if (frame.type == FrameType::BEACON) {
+            beacon(frame);
+            return;
+        }
+        if (frame.type != FrameType::ACK || !waiting) return;
+        // Прошивка принимает любой ACK с нужным токеном — в том числе чужой
+        bool own = (frame.exchange == exchange);
+        if (!own && sim.cfg.addressed) return;
+        if (!own) sim.stats.falseAck++;
+        finish(true);
+    }
+
+    void onTxDone() override {
+        // send() вернулся, startListening() — ждём ответ TIMEOUT_WAITING_RX
+        waiting = true;
+        uint64_t ex = exchange;
+        int attempt = attempts;
+        sim.schedule(sim.now + sim.ackTimeout(), [this, ex, attempt]() {
+            if (waiting && exchange == ex && attempts == attempt) timeout();
+        });
+    }
+
+private:
+    void userRequest() {
+        Stats& st = sim.stats;
+        st.requests++;
+        bool on = sim.uniform() < 0.5;
+        int target = sim.receiverIds[(size_t)(sim.uniform() * sim.receiverIds.size()) % sim.receiverIds.size()];
+        if (pending && (pendingOn != on || pendingTarget != target)) st.superseded++;
+        if (!pending) requestTime = sim.now;
+        pending = true;
+        pendingOn = on;
+        pendingTarget = target;
+        if (!busy) schedule();
+        sim.schedule(sim.now + (sim_time)(sim.exponential(sim.cfg.cmdIntervalS) * 1e6), [this]() { userRequest(); });
+    }
+
+    void pollTick() {
+        if (!busy && !pending) {
+            sim.stats.polls++;
+            isPoll = true;
+            target = sim.receiverIds[(size_t)(sim.uniform() * sim.receiverIds.size()) % sim.receiverIds.size()];
+            begin(FrameType::POLL, strlen(CMD_GET_STATUS) + METRICS_SUFFIX_LEN);
+        }
+        sim.schedule(sim.now + (sim_time)(sim.cfg.pollIntervalS * 1e6), [this]() { pollTick(); });
+    }
+
+    // ChannelPlan::service(): пересканирование плана раз в CHANNEL_SCAN_INTERVAL
+    void scanTick() {
+        scanDue = true;
+        channelService();
+        sim.schedule(sim.now + (sim_time)CHANNEL_SCAN_INTERVAL * 1000, [this]() { scanTick(); });
+    }
+
+    // Оценка канала как в табло прошивки: шум + штраф за потери обменов на нём
+    double score(int ch) const {
+        return sim.noiseAt(ch) + CHANNEL_LOSS_PENALTY * (1.0 - delivery[ch]);
+    }
+
+    // Переходы — только когда эфир свободен и команда пользователя не ждёт
+    void channelService() {
+        if (!sim.cfg.agile || busy || pending) return;
+        if (escapePending) {
+            escapePending = false;
+            beginChannel((channel + 1) % sim.cfg.channels, true);
+            return;
+        }
+        if (!scanDue) return;
+        scanDue = false;
+        int best = channel;
+        for (int ch = 0; ch < sim.cfg.channels; ch++) {
+            if (score(ch) < score(best)) best = ch;
+        }
+        if (best != channel && score(channel) - score(best) >= CHANNEL_SWITCH_MARGIN) beginChannel(best, false);
+    }
+
+    void beginChannel(int ch, bool escape) {
+        isPoll = false;
+        isChannel = true;
+        escaping = escape;
+        busy = true;
+        exchange = sim.nextExchange++;
+        attempts = 0;
+        frame = Frame{FrameType::CHANNEL, id, target, exchange, strlen(CMD_CHANNEL) + 1, ch};
+        send();
+    }
+
+    // ChannelPlan::recordExchange()
+    void recordExchange(bool ok) {
+        delivery[channel] += 0.2 * ((ok ? 1.0 : 0.0) - delivery[channel]);
+        if (ok) fails = 0;
+        else if (++fails >= CHANNEL_TX_FAILS) {
+            fails = 0;
+            escapePending = true;
+        }
+    }
+
+    // Следующая итерация loop(): MyCommands.service() забирает цель
+    void schedule() {
+        sim.schedule(sim.now + 1000, [this]() {
+            if (busy || !pending) return;
+            pending = false;
+            isPoll = false;
+            target = pendingTarget;
+            exchangeRequestTime = requestTime;
+            sim.stats.exchanges++;
+            begin(pendingOn ? FrameType::CMD_ON : FrameType::CMD_OFF, strlen(pendingOn ? CMD_RELAY_ON : CMD_RELAY_OFF));
+        });
+    }
+
+    void begin(FrameType type, size_t length) {
+        busy = true;
+        exchange = sim.nextExchange++;
+        attempts = 0;
+        frame = Frame{type, id, target, exchange, length, 0};
+        send();
+    }
+
+    void send() {
+        attempts++;
+        if (!isPoll && !isChannel) sim.stats.attempts++;
+        if (!synced()) {
+            sim.transmit(*this, frame);
+            return;
+        }
+        // TdmaMac::waitForSlot(): передача через TDMA_GUARD_MS после начала своего слота
+        slot = ownSlot();
+        waitingSlot = true;
+        uint64_t gen = ++slotWait;
+        sim.schedule(slotStart(slot) + TDMA_GUARD_MS * 1000, [this, gen]() { slotDue(gen); });
+    }
+
+    void slotDue(uint64_t gen) {
+        if (!waitingSlot || gen != slotWait) return; // Ожидание перепланировано маяком
+        waitingSlot = false;
+        sim.transmit(*this, frame);
+    }
+
+    // TdmaMac::onFrame(): часы по началу суперкадра и карта слотов
+    void beacon(const Frame& frame) {
+        frameStart = sim.now - sim.airtime(frame.length) - (sim_time)frame.arg * 1000;
+        owners = frame.owners;
+        hasBeacon = true;
+        if (waitingSlot && slot > sim.cfg.assigned) {
+            slot = ownSlot(); // Общий слот меняем на закреплённый, если он появился
+            uint64_t gen = ++slotWait;
+            sim.schedule(slotStart(slot) + TDMA_GUARD_MS * 1000, [this, gen]() { slotDue(gen); });
+        }
+    }
+
+    bool synced() const {
+        return sim.cfg.tdma && hasBeacon && sim.now - frameStart < TDMA_SYNC_LOST * sim.superframe();
+    }
+
+    int ownSlot() {
+        for (size_t i = 0; i < owners.size(); i++) {
+            if (owners[i] == id) return (int)i + 1;
+        }
+        return 1 + sim.cfg.assigned + (int)(sim.uniform() * (sim.cfg.slots - 1 - sim.cfg.assigned));
+    }
+
+    // Ближайшее начало слота, до передачи в котором ещё не поздно
+    sim_time slotStart(int s) const {
+        sim_time n = (sim.now - frameStart) / sim.superframe();
+        sim_time at = frameStart + n * sim.superframe() + (sim_time)s * TDMA_SLOT_MS * 1000;
+        if (sim.now > at + TDMA_GUARD_MS * 1000) at += sim.superframe();
+        return at;
+    }
+
+    void timeout() {
+        waiting = false;
+        if (attempts <= sim.cfg.retries) send();
+        else finish(false);
+    }
+
+    void finish(bool ok) {
+        waiting = false;
+        busy = false;
+        Stats& st = sim.stats;
+        if (isChannel) {
+            // Согласованный переход — только с ответом, аварийный — в любом случае
+            isChannel = false;
+            if (ok || escaping) {
+                channel = frame.arg;
+                fails = 0;
+                st.hops++;
+            }
+        } else {
+            if (isPoll) {
+                if (ok) st.pollsOk++;
+            } else if (ok) {
+                st.confirmed++;
+                st.latencyMs.push_back((sim.now - exchangeRequestTime) / 1000.0);
+            } else {
+                st.failed++;
+            }
+            if (sim.cfg.agile) recordExchange(ok);
+        }
+        if (pending) schedule();
+        else channelService();
+    }
+
+    bool busy = false, waiting = false, isPoll = false;
+    bool pending = false, pendingOn = false;
+    bool isChannel = false, escaping = false, escapePending = false, scanDue = false;
+    int pendingTarget = 0, target = 0, attempts = 0, fails = 0;
+    std::vector<double> delivery; // Табло: доля подтверждённых обменов по каналам
+    std::vector<int> owners;      // TDMA: карта слотов из последнего маяка
+    sim_time frameStart = 0;
+    bool hasBeacon = false;
+    int slot = 0;
+    bool waitingSlot = false;
+    uint64_t slotWait = 0;        // Номер ожидания слота: отличает актуальное от перепланированного маяком
+    uint64_t exchange = 0;
+    sim_time requestTime = 0, exchangeRequestTime = 0;
+    Frame frame{};
+};
+
+/**
+ * Приёмник: ветка RECEIVER из loop() — исполнить, подождать TIMEOUT_WAITING_TX, ответить
+ */
+class Receiver : public Node {
+public:
+    using Node::Node;
+
+    void start() override {
+        lastHeard = sim.now;
+        if (sim.cfg.agile) sim.schedule(sim.now + (sim_time)CHANNEL_RX_SAMPLE_INTERVAL * 1000, [this]() { sampleTick(); });
+        if (sim.cfg.tdma && id == sim.receiverIds.front()) {
+            owners.assign(sim.cfg.assigned, -1);
+            ownerHeard.assign(sim.cfg.assigned, 0);
+            nextBeacon = sim.now;
+            sim.schedule(nextBeacon, [this]() { beaconTick(); });
+        }
+    }
+
+    void onFrame(const Frame& frame) override {
+        if (frame.type == FrameType::ACK || frame.type == FrameType::BEACON) return;
+        if (sim.cfg.addressed && frame.dst != id) return;
+        // Копия, пришедшая другим путём (напрямую и через ретранслятор), отсеивается по счётчику подписи
+        if (lastSeq.size() < sim.nodes.size()) lastSeq.resize(sim.nodes.size(), 0);
+        if (frame.seq <= lastSeq[frame.origin]) return;
+        lastSeq[frame.origin] = frame.seq;
+        lastHeard = sim.now; // ChannelPlan::recordRx()
+        jamSamples = 0;
+        if (!owners.empty()) assignSlot(frame.origin);
+
+        bool command = (frame.type == FrameType::CMD_ON || frame.type == FrameType::CMD_OFF);
+        if (command && frame.dst == id && frame.exchange != lastDelivered) {
+            lastDelivered = frame.exchange; // Повторы одного обмена считаем одной доставкой
+            sim.stats.delivered++;
+        }
+
+        // readData() + delay(): до конца ответа прошивка эфир не слушает
+        deaf = true;
+        sim_time delayUs = (command ? TIMEOUT_WAITING_TX : 50) * 1000 + (sim_time)(sim.uniform() * 2000);
+        const char* ack = frame.type == FrameType::CMD_ON ? ACK_FROM_RECEIVER_IF_ON
+                        : frame.type == FrameType::CMD_OFF ? ACK_FROM_RECEIVER_IF_OFF
+                        : frame.type == FrameType::CHANNEL ? ACK_CHANNEL
+                        : ACK_RELAY_IS_OFF;
+        if (frame.type == FrameType::CHANNEL) pendingChannel = frame.arg; // Переходим после ответа на старом канале
+        Frame reply{FrameType::ACK, id, frame.origin, frame.exchange, strlen(ack) + REPLY_SUFFIX_LEN, 0};
+        sim.schedule(sim.now + delayUs, [this, reply]() { sim.transmit(*this, reply); });
+    }
+
+    void onTxDone() override {
+        deaf = false; // startListening()
+        if (pendingChannel >= 0) {
+            channel = pendingChannel;
+            pendingChannel = -1;
+        }
+    }
+
+private:
+    // TdmaMac::service() приёмника: маяк в начале суперкадра (занят ответом — чуть позже, с опозданием в маяке)
+    void beaconTick() {
+        if (deaf || txEnd > sim.now) {
+            sim.schedule(sim.now + 5000, [this]() { beaconTick(); });
+            return;
+        }
+        for (size_t i = 0; i < owners.size(); i++) {
+            if (owners[i] >= 0 && sim.now - ownerHeard[i] >= (sim_time)TDMA_ASSIGN_TIMEOUT * 1000) owners[i] = -1;
+        }
+        Frame beacon{FrameType::BEACON, id, -1, 0, strlen(CMD_BEACON) + 6 + 2 * (size_t)sim.cfg.assigned,
+                     (int)((sim.now - nextBeacon) / 1000)};
+        beacon.owners = owners;
+        sim.transmit(*this, beacon);
+        nextBeacon += sim.superframe();
+        sim.schedule(nextBeacon, [this]() { beaconTick(); });
+    }
+
+    // TdmaMac::recordRx(): закрепить слот за услышанным пультом
+    void assignSlot(int remote) {
+        int free = -1;
+        for (size_t i = 0; i < owners.size(); i++) {
+            if (owners[i] == remote) {
+                ownerHeard[i] = sim.now;
+                return;
+            }
+            if (owners[i] < 0 && free < 0) free = (int)i;
+        }
+        if (free < 0) return;
+        owners[free] = remote;
+        ownerHeard[free] = sim.now;
+    }
+
+    // ChannelPlan::service() приёмника: шум своего канала и обход при долгой тишине
+    void sampleTick() {
+        if (!deaf) {
+            if (sim.noiseAt(channel) > sim.quietest() + CHANNEL_JAM_MARGIN) {
+                if (++jamSamples >= CHANNEL_RX_JAM_SAMPLES) hop();
+            } else {
+                jamSamples = 0;
+            }
+        }
+        if (sim.now - lastHeard >= (sim_time)CHANNEL_RX_LOST * 1000) {
+            hop();
+            lastHeard = sim.now - (sim_time)(CHANNEL_RX_LOST - CHANNEL_RX_DWELL) * 1000;
+        }
+        sim.schedule(sim.now + (sim_time)CHANNEL_RX_SAMPLE_INTERVAL * 1000, [this]() { sampleTick(); });
+    }
+
+    void hop() {
+        channel = (channel + 1) % sim.cfg.channels;
+        jamSamples = 0;
+        lastHeard = sim.now;
+    }
+
+    uint64_t lastDelivered = 0;
+    std::vector<uint64_t> lastSeq; // Последний принятый номер кадра по создателям
+    sim_time lastHeard = 0;
+    int jamSamples = 0;
+    int pendingChannel = -1;
+    std::vector<int> owners;          // TDMA (только первый приёмник): владельцы закреплённых слотов
+    std::vector<sim_time> ownerHeard;
+    sim_time nextBeacon = 0;
+};
+
+/**
+ * Ретранслятор: Repeater::service() — отсев дублей по (создатель, номер), TTL, очередь со случайной паузой
+ */
+class Repeater : public Node {
+public:
+    using Node::Node;
+
+    void onFrame(const Frame& frame) override {
+        Stats& st = sim.stats;
+        uint64_t key = ((uint64_t)frame.origin << 48) | frame.seq;
+        if (std::find(cache.begin(), cache.end(), key) != cache.end()) {
+            st.duplicates++;
+            return;
+        }
+        cache.push_back(key);
+        if (cache.size() > REPEATER_CACHE_SIZE) cache.pop_front();
+
+        if (frame.ttl == 0 || queued >= REPEATER_QUEUE_SIZE) return;
+        Frame copy = frame;
+        copy.ttl--;
+        queued++;
+        sim_time jitter = (sim_time)((REPEATER_JITTER_MIN + sim.uniform() * (REPEATER_JITTER_MAX - REPEATER_JITTER_MIN)) * 1000);
+        sim.schedule(sim.now + jitter, [this, copy]() { forward(copy); });
+    }
+
+private:
+    void forward(const Frame& frame) {
+        if (txEnd > sim.now) {
+            // Ещё передаём предыдущий кадр — радио полудуплексное, ждём конца передачи
+            sim.schedule(txEnd, [this, frame]() { forward(frame); });
+            return;
+        }
+        queued--;
+        sim.stats.forwarded++;
+        sim.transmit(*this, frame);
+
+        // План каналов: переход вместе с парой после пересылки ответа на "CH_<n>" (или по тайм-ауту)
+        if (frame.type == FrameType::CHANNEL) {
+            pendingChannel = frame.arg;
+            pendingExchange = frame.exchange;
+            sim.schedule(sim.now + sim.ackTimeout(), [this, ex = frame.exchange]() {
+                if (pendingChannel >= 0 && pendingExchange == ex) switchChannel();
+            });
+        } else if (frame.type == FrameType::ACK && pendingChannel >= 0 && frame.exchange == pendingExchange) {
+            sim.schedule(txEnd, [this]() { switchChannel(); });
+        }
+    }
+
+    void switchChannel() {
+        if (pendingChannel < 0) return;
+        channel = pendingChannel;
+        pendingChannel = -1;
+    }
+
+    std::deque<uint64_t> cache;
+    size_t queued = 0;
+    int pendingChannel = -1;
+    uint64_t pendingExchange = 0;
+};
+
+// ######################################## ЗАПУСК ########################################
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return NAN;
+    std::sort(v.begin(), v.end());
+    size_t i = (size_t)std::min<double>(v.size() - 1, std::floor(p / 100.0 * v.size()));
+    return v[i];
+}
+
+static std::vector<int> parseList(const char* s) {
+    std::vector<int> out;
+    for (const char* p = s; *p;) {
+        out.push_back(atoi(p));
+        const char* comma = strchr(p, ',');
+        if (!comma) break;
+        p = comma + 1;
+    }
+    return out;
+}
+
+static Stats runOnce(SimConfig cfg) {
+    Simulator sim(cfg);
+    int id = 0;
+    if (sim.repeaterNet()) {
+        // Линия: пульты в начале, ретрансляторы через cfg.lineM, приёмники в конце
+        double end = (cfg.repeaters + 1) * cfg.lineM;
+        for (int i = 0; i < cfg.remotes; i++, id++) sim.nodes.emplace_back(new Remote(sim, id, 0, i * 10.0));
+        for (int i = 0; i < cfg.repeaters; i++, id++) sim.nodes.emplace_back(new Repeater(sim, id, (i + 1) * cfg.lineM, 0));
+        for (int i = 0; i < cfg.receivers; i++, id++) {
+            sim.nodes.emplace_back(new Receiver(sim, id, end, i * 10.0));
+            sim.receiverIds.push_back(id);
+        }
+    } else {
+        for (int i = 0; i < cfg.remotes; i++, id++) {
+            sim.nodes.emplace_back(new Remote(sim, id, sim.uniform() * cfg.areaM, sim.uniform() * cfg.areaM));
+        }
+        for (int i = 0; i < cfg.receivers; i++, id++) {
+            sim.nodes.emplace_back(new Receiver(sim, id, sim.uniform() * cfg.areaM, sim.uniform() * cfg.areaM));
+            sim.receiverIds.push_back(id);
+        }
+    }
+    for (auto& node : sim.nodes) node->channel = sim.homeChannel();
+    sim.run();
+    return sim.stats;
+}
+
+static void usage() {
+    printf("usage: lora_sim [--remotes N[,N..]] [--receivers N[,N..]] [--duration s] [--cmd-interval s]\n"
+           "                [--poll s] [--area m] [--ple n] [--shadowing dB] [--capture dB]\n"
+           "                [--retries n] [--addressed] [--seed n]\n"
+           "                [--channels n] [--jam ch] [--jam-dbm dBm] [--jam-start s]\n"
+           "                [--repeaters N[,N..]] [--line m] [--tdma] [--slots n] [--assigned n]\n");
+}
+
+int main(int argc, char** argv) {
+    SimConfig cfg;
+    std::vector<int> remotes{1}, receivers{1}, repeaters{-1};
+    bool tdma = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!strcmp(a, "--addressed")) { cfg.addressed = true; continue; }
+        if (!strcmp(a, "--tdma")) { tdma = true; continue; }
+        if (!v) { usage(); return 1; }
+        if (!strcmp(a, "--remotes")) remotes = parseList(v);
+        else if (!strcmp(a, "--receivers")) receivers = parseList(v);
+        else if (!strcmp(a, "--duration")) cfg.durationS = atof(v);
+        else if (!strcmp(a, "--cmd-interval")) cfg.cmdIntervalS = atof(v);
+        else if (!strcmp(a, "--poll")) cfg.pollIntervalS = atof(v);
+        else if (!strcmp(a, "--area")) cfg.areaM = atof(v);
+        else if (!strcmp(a, "--ple")) cfg.pathLossExp = atof(v);
+        else if (!strcmp(a, "--shadowing")) cfg.shadowingDb = atof(v);
+        else if (!strcmp(a, "--capture")) cfg.captureDb = atof(v);
+        else if (!strcmp(a, "--retries")) cfg.retries = atoi(v);
+        else if (!strcmp(a, "--seed")) cfg.seed = (uint32_t)atoi(v);
+        else if (!strcmp(a, "--channels")) cfg.channels = std::max(1, atoi(v));
+        else if (!strcmp(a, "--jam")) cfg.jamChannel = atoi(v);
+        else if (!strcmp(a, "--jam-dbm")) cfg.jamDbm = atof(v);
+        else if (!strcmp(a, "--jam-start")) cfg.jamStartS = atof(v);
+        else if (!strcmp(a, "--repeaters")) repeaters = parseList(v);
+        else if (!strcmp(a, "--line")) cfg.lineM = atof(v);
+        else if (!strcmp(a, "--slots")) cfg.slots = std::max(3, atoi(v));
+        else if (!strcmp(a, "--assigned")) cfg.assigned = std::max(1, atoi(v));
+        else { usage(); return 1; }
+        i++;
+    }
+
+    printf("LoRa %.3f MHz SF%d BW%.0f CR4/%d preamble %d, %d dBm | RELAY_ON %.1f ms, ACK %.1f ms | %s protocol\n",
+           (double)RADIO_FREQ, RADIO_SPREAD_FACTOR, (double)RADIO_BANDWIDTH, RADIO_CODING_RATE, RADIO_PREAMBLE_LENGTH,
+           RADIO_OUTPUT_POWER,
+           lora_time_on_air_us(strlen(CMD_RELAY_ON) + FRAME_OVERHEAD, RADIO_SPREAD_FACTOR, RADIO_BANDWIDTH, RADIO_CODING_RATE, RADIO_PREAMBLE_LENGTH) / 1000.0,
+           lora_time_on_air_us(strlen(ACK_FROM_RECEIVER_IF_ON) + REPLY_SUFFIX_LEN + FRAME_OVERHEAD, RADIO_SPREAD_FACTOR, RADIO_BANDWIDTH,
+                               RADIO_CODING_RATE, RADIO_PREAMBLE_LENGTH) / 1000.0,
+           cfg.addressed ? "addressed" : "as-is");
+    bool plan = cfg.channels > 1;
+    if (plan) {
+        printf("Channel plan: %d channels, home %d, jammer %s", cfg.channels, cfg.channels / 2,
+               cfg.jamChannel >= 0 ? "on channel " : "none");
+        if (cfg.jamChannel >= 0) {
+            printf("%d at %.0f dBm from %.0f s", cfg.jamChannel, cfg.jamDbm,
+                   cfg.jamStartS < 0 ? cfg.durationS / 4 : cfg.jamStartS);
+        }
+        printf("\n");
+    }
+    bool relay = repeaters.front() >= 0;
+    if (tdma) {
+        cfg.assigned = std::min(cfg.assigned, cfg.slots - 2); // Хотя бы один общий слот, как static_assert в tdma.h
+        printf("TDMA: %d slots x %d ms, %d assigned, guard %d ms, beacon %.1f ms\n", cfg.slots, TDMA_SLOT_MS,
+               cfg.assigned, TDMA_GUARD_MS,
+               lora_time_on_air_us(strlen(CMD_BEACON) + 6 + 2 * cfg.assigned + FRAME_OVERHEAD, RADIO_SPREAD_FACTOR,
+                                   RADIO_BANDWIDTH, RADIO_CODING_RATE, RADIO_PREAMBLE_LENGTH) / 1000.0);
+    }
+    if (relay) {
+        printf("Line topology: %.0f m per hop, hop limit %d, jitter %d..%d ms\n", cfg.lineM, REPEATER_HOP_LIMIT,
+               REPEATER_JITTER_MIN, REPEATER_JITTER_MAX);
+    }
+    printf("%4s %4s %7s %6s %6s %7s %7s %6s %8s %8s %8s %7s %6s %5s", "TX", "RX", "req", "super", "sent",
+           "deliv%", "conf%", "false", "p50,ms", "p95,ms", "p99,ms", "air%", "coll", "poll%");
+    if (plan) printf(" %6s %5s", "mode", "hops");
+    if (relay) printf(" %4s %6s %6s", "rep", "fwd", "dup");
+    if (tdma) printf(" %6s %8s", "mac", "max,ms");
+    printf("\n");
+
+    for (int k : repeaters) {
+        cfg.repeaters = k;
+        for (int r : remotes) {
+            for (int n : receivers) {
+                // С планом каналов — два прогона с одним зерном: все на домашнем канале и с агильностью.
+                // С --tdma — ещё по два: без слотов и со слотами
+                for (int mode = 0; mode < (plan ? 2 : 1) * (tdma ? 2 : 1); mode++) {
+                    cfg.remotes = r;
+                    cfg.receivers = n;
+                    cfg.agile = plan && (tdma ? mode / 2 : mode) == 1;
+                    cfg.tdma = tdma && mode % 2 == 1;
+                    Stats st = runOnce(cfg);
+                    double ex = st.exchanges ? (double)st.exchanges : NAN;
+                    printf("%4d %4d %7llu %6llu %6llu %7.1f %7.1f %6llu %8.0f %8.0f %8.0f %7.2f %6llu %5.0f", r, n,
+                           (unsigned long long)st.requests, (unsigned long long)st.superseded, (unsigned long long)st.attempts,
+                           100.0 * st.delivered / ex, 100.0 * st.confirmed / ex, (unsigned long long)st.falseAck,
+                           percentile(st.latencyMs, 50), percentile(st.latencyMs, 95), percentile(st.latencyMs, 99),
+                           100.0 * st.airtimeBusy / (cfg.durationS * 1e6), (unsigned long long)st.collisions,
+                           st.polls ? 100.0 * st.pollsOk / st.polls : NAN);
+                    if (plan) printf(" %6s %5llu", cfg.agile ? "agile" : "fixed", (unsigned long long)st.hops);
+                    if (relay) printf(" %4d %6llu %6llu", k, (unsigned long long)st.forwarded, (unsigned long long)st.duplicates);
+                    if (tdma) printf(" %6s %8.0f", cfg.tdma ? "tdma" : "aloha", percentile(st.latencyMs, 100));
+                    printf("\n");
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+"""
+Запись эфира со сниффера (роль SNIFFER, см. src/sniffer.h) в pcap и разбор наших кадров.
+
+    python3 tools/sniffer_pcap.py capture /dev/ttyACM0 air.pcap     # запись до Ctrl+C, кадры — в консоль
+    python3 tools/sniffer_pcap.py decode air.pcap                   # разбор готовой записи
+
+pcap с DLT_USER0 (147): каждый пакет — запись CAPTURE целиком (заголовок 26 байт, все числа LE, затем кадр):
+    [мкс, 4][номер, 2][потеряно перед кадром, 2][флаги][SF][CR][BW, 0.1 кГц, 2]
+    [RSSI, 0.1 дБм, 2][SNR, 0.1 дБ, 2][ошибка частоты, Гц, 4][частота, Гц, 4][длина]
+В Wireshark: Edit > Preferences > Protocols > DLT_USER, 147 -> свой диссектор или data.
+Время пакета в pcap — часы ПК в момент первого кадра плюс микросекунды сниффера (уход кварца не учитывается),
+метка — конец кадра в эфире.
+
+Разбор кадров: текст токена, метрики линка после "|", подпись (id отправителя, счётчик, тег) и TTL
+ретрансляции. Есть ли подпись и TTL, берётся из src/settings.h (--auth-tag N / --ttl / --no-ttl — вручную).
+Раз в 10 с запрашивает у сниффера счётчики (команда "sniffer"): это и отчёт о потерях, и знак жизни для
+HOST_LINK_IDLE_MS. Нужен pyserial.
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import host_link  # noqa: E402
+
+CAPTURE = 0xC1
+DLT_USER0 = 147
+RECORD_FORMAT = "<IHHBBBHhhiIB"
+RECORD_HEADER = struct.calcsize(RECORD_FORMAT)  # 26, как SNIFFER_RECORD_HEADER
+FLAG_CRC, FLAG_ERROR = 0x01, 0x02
+SETTINGS = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src", "settings.h")
+
+
+def read_settings(path=SETTINGS):
+    """Включённые #define и строковые токены протокола из settings.h (без разбора условий — как их видит человек)."""
+    defines, tokens = {}, {}
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            m = re.match(r"\s*#define\s+(\w+)(?:\s+(.*?))?\s*(?://.*)?$", line)
+            if not m:
+                continue
+            name, value = m.group(1), (m.group(2) or "").strip()
+            defines[name] = value
+            s = re.match(r'"([^"]*)"', value)
+            if s and (name.startswith("CMD_") or name.startswith("ACK_")):
+                tokens[s.group(1)] = name
+    return defines, tokens
+
+
+class FrameDecoder:
+    def __init__(self, auth_tag=None, ttl=None, settings=SETTINGS):
+        defines, self.tokens = read_settings(settings)
+        if auth_tag is None:
+            auth_tag = int(defines.get("AUTH_TAG_LEN", "4")) if "AUTH_USED" in defines else 0
+        if ttl is None:
+            ttl = "REPEATER_USED" in defines
+        self.auth = 3 + auth_tag if auth_tag else 0
+        self.auth_tag = auth_tag
+        self.ttl = ttl
+
+    def token_name(self, token):
+        if token in self.tokens:
+            return self.tokens[token]
+        prefixes = [(t, n) for t, n in self.tokens.items() if t.endswith("_") and token.startswith(t)]
+        return max(prefixes, key=lambda p: len(p[0]))[1] if prefixes else "?"  # "TMR_OK_" точнее "TMR_"
+
+    def decode(self, frame):
+        """Кадр -> короткое описание: 'RELAY_ON (CMD_RELAY_ON) metrics -80,7 from 0x01 #1234 tag 9f3a0c11 ttl 3'."""
+        parts, end = [], len(frame)
+        ttl = None
+        if self.ttl and end > 0:
+            ttl = frame[end - 1]
+            end -= 1
+        auth = None
+        if self.auth and end >= self.auth:
+            header = end - self.auth
+            auth = (frame[header], frame[header + 1] | (frame[header + 2] << 8), frame[header + 3:end].hex())
+            end = header
+        text = frame[:end].decode("ascii", errors="replace")
+        token, _, metrics = text.partition("|")
+        parts.append("%s (%s)" % (token, self.token_name(token)))
+        if metrics:
+            parts.append("metrics " + metrics)
+        if auth:
+            sender = auth[0]
+            role = "remote" if 0x01 <= sender <= 0x7F else "receiver"
+            parts.append("from 0x%02x %s #%d tag %s" % (sender, role, auth[1], auth[2]))
+        if ttl is not None:
+            parts.append("ttl %d" % ttl)
+        return " ".join(parts)
+
+
+def parse_record(record):
+    fields = struct.unpack(RECORD_FORMAT, record[:RECORD_HEADER])
+    keys = ("us", "seq", "lost", "flags", "sf", "cr", "bw", "rssi", "snr", "freq_error", "frequency", "length")
+    info = dict(zip(keys, fields))
+    info["bw"] /= 10.0
+    info["rssi"] /= 10.0
+    info["snr"] /= 10.0
+    return info, record[RECORD_HEADER:RECORD_HEADER + info["length"]]
+
+
+def describe(info, frame, decoder):
+    flags = ("CRC! " if info["flags"] & FLAG_CRC else "") + ("ERR! " if info["flags"] & FLAG_ERROR else "")
+    lost = " [lost %d before]" % info["lost"] if info["lost"] else ""
+    return "#%-5d %.3f MHz SF%d BW%g %6.1f dBm %5.1f dB %+6d Hz len %3d %s%s%s" % (
+        info["seq"], info["frequency"] / 1e6, info["sf"], info["bw"], info["rssi"], info["snr"],
+        info["freq_error"], info["length"], flags, decoder.decode(frame), lost)
+
+
+class PcapWriter:
+    def __init__(self, path):
+        self.file = open(path, "wb")
+        self.file.write(struct.pack("<IHHiIII", 0xA1B2C3D4, 2, 4, 0, 0, 65535, DLT_USER0))
+        self.base = None  # (время ПК, мкс сниффера) первого кадра
+        self.last_us = None
+        self.wraps = 0
+
+    def write(self, record, us):
+        # Микросекунды сниффера переполняются раз в ~71 мин — разворачиваем
+        if self.last_us is not None and us < self.last_us:
+            self.wraps += 1
+        self.last_us = us
+        us += self.wraps << 32
+        if self.base is None:
+            self.base = (time.time(), us)
+        stamp = self.base[0] + (us - self.base[1]) / 1e6
+        self.file.write(struct.pack("<IIII", int(stamp), int((stamp % 1) * 1e6), len(record), len(record)))
+        self.file.write(record)
+        self.file.flush()
+
+    def close(self):
+        self.file.close()
+
+
+def read_pcap(path):
+    with open(path, "rb") as f:
+        magic, _, _, _, _, _, linktype = struct.unpack("<IHHiIII", f.read(24))
+        if magic != 0xA1B2C3D4 or linktype != DLT_USER0:
+            raise SystemExit("%s: not a sniffer capture" % path)
+        while True:
+            header = f.read(16)
+            if len(header) < 16:
+                return
+            sec, usec, length, _ = struct.unpack("<IIII", header)
+            yield sec + usec / 1e6, f.read(length)
+
+
+def capture(args, decoder):
+    link = host_link.HostLink(args.port, verbose=args.verbose)
+    if link.role != "S":
+        print("warning: node role is %s, not a sniffer" % link.role, file=sys.stderr)
+    writer = PcapWriter(args.output)
+    next_stats = time.monotonic()
+    count = 0
+    try:
+        while True:
+            if time.monotonic() >= next_stats:
+                link._send(host_link.COMMAND, b"sniffer")  # Ответ TEXT придёт между кадрами
+                next_stats = time.monotonic() + 10
+            try:
+                for kind, _, data in link.frames(timeout=1):
+                    if kind == CAPTURE:
+                        info, frame = parse_record(data)
+                        writer.write(data, info["us"])
+                        count += 1
+                        if not args.quiet:
+                            print(describe(info, frame, decoder))
+                    elif kind == host_link.TEXT:
+                        print("  " + data.decode(errors="replace"), file=sys.stderr)
+            except TimeoutError:
+                pass  # Секунда прошла — пора ли за счётчиками
+    except KeyboardInterrupt:
+        pass
+    writer.close()
+    link.close()
+    print("%d frames -> %s" % (count, args.output), file=sys.stderr)
+
+
+def decode(args, decoder):
+    first = None
+    for stamp, record in read_pcap(args.input):
+        info, frame = parse_record(record)
+        first = stamp if first is None else first
+        print("%10.6f %s" % (stamp - first, describe(info, frame, decoder)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--auth-tag", type=int, help="байт подписи в кадре (0 — подписи нет)")
+    parser.add_argument("--ttl", dest="ttl", action="store_true", default=None, help="в конце кадра байт TTL")
+    parser.add_argument("--no-ttl", dest="ttl", action="store_false")
+    sub = parser.add_subparsers(dest="action", required=True)
+    cap = sub.add_parser("capture")
+    cap.add_argument("port")
+    cap.add_argument("output")
+    cap.add_argument("--quiet", action="store_true", help="не печатать кадры")
+    cap.add_argument("--verbose", action="store_true", help="печатать лог сниффера")
+    dec = sub.add_parser("decode")
+    dec.add_argument("input")
+    args = parser.parse_args()
+
+    decoder = FrameDecoder(args.auth_tag, args.ttl)
+    if args.action == "capture":
+        capture(args, decoder)
+    else:
+        decode(args, decoder)
+
+
+if __name__ == "__main__":
+    main()
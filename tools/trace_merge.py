@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""
+Сведение трасс пульта (TX) и приёмника (RX) в разбивку задержек.
+
+Снимите выгрузку командой "trace" с обеих сторон (монитор порта или BLE) в два файла
+и запустите:
+    python3 tools/trace_merge.py tx.log rx.log
+
+Часы узлов не синхронизированы. Смещение RX относительно TX оценивается по каждому обмену
+как среднее двух пар событий, происходящих почти одновременно в эфире:
+    TX:TX_DONE  ~ RX:RX_IRQ   (команда)
+    RX:TX_DONE  ~ TX:RX_IRQ   (подтверждение)
+Усреднение этих пар компенсирует задержку реакции прерывания (она одинакова на обеих сторонах).
+"""
+import statistics
+import sys
+
+
+def parse(path):
+    """Читает лог, возвращает (узел, [(имя пробы, аргумент, время мкс)]) из последней выгрузки."""
+    node, mhz, entries = None, 240, []
+    with open(path, errors="replace") as f:
+        for line in f:
+            # Строки могут идти с префиксами монитора порта — ищем маркер в любом месте
+            for marker in ("TRACE_BEGIN,", "TRACE,", "TRACE_END"):
+                pos = line.find(marker)
+                if pos >= 0:
+                    line = line[pos:].strip()
+                    break
+            else:
+                continue
+            fields = line.split(",")
+            if fields[0] == "TRACE_BEGIN":
+                node, mhz, entries = fields[1], int(fields[2]), []
+            elif fields[0] == "TRACE" and len(fields) == 5:
+                entries.append((fields[1], int(fields[2]), int(fields[3]), int(fields[4])))
+    return node, unwrap(entries, mhz)
+
+
+def unwrap(entries, mhz):
+    """Точное время по счётчику тактов; micros() нужен, только чтобы пережить его переполнение."""
+    out, t, prev = [], None, None
+    for probe, arg, us, cycles in entries:
+        if prev is None:
+            t = float(us)
+        else:
+            d_us = (us - prev[0]) & 0xFFFFFFFF
+            d_cyc = ((cycles - prev[1]) & 0xFFFFFFFF) / mhz
+            # Между метками больше одного оборота счётчика тактов — верим micros()
+            t += d_cyc if d_us < (0xFFFFFFFF / mhz) * 0.9 else d_us
+        prev = (us, cycles)
+        out.append((probe, arg, t))
+    return out
+
+
+def exchanges(tx):
+    """Режет трассу пульта на обмены: от TX_START до ACK_RX (или до следующего TX_START)."""
+    result, cur = [], None
+    for i, (probe, arg, t) in enumerate(tx):
+        if probe == "TX_START":
+            if cur:
+                result.append(cur)
+            cur = {"TX_START": t}
+            # Ближайшее предшествующее нажатие/BLE-команда — начало пользовательской задержки
+            for p, _, tp in reversed(tx[:i]):
+                if p in ("BUTTON_EVENT", "BLE_COMMAND"):
+                    cur["INPUT"] = tp
+                    break
+                if p == "TX_START":
+                    break
+        elif cur is not None and probe not in cur:
+            cur[probe] = t
+    if cur:
+        result.append(cur)
+    return result
+
+
+def match_rx(ex, rx, offset_guess):
+    """Ищет в трассе приёмника события, относящиеся к обмену ex."""
+    target = ex.get("TX_DONE")
+    if target is None:
+        return None
+    best = None
+    for i, (probe, _, t) in enumerate(rx):
+        if probe == "RX_IRQ":
+            err = abs((t - offset_guess) - target)
+            if best is None or err < best[0]:
+                best = (err, i)
+    if best is None or best[0] > 50000:
+        return None
+    ev = {}
+    for probe, _, t in rx[best[1]:]:
+        if probe in ev:
+            if probe == "RX_IRQ":
+                break
+            continue
+        ev[probe] = t
+    return ev
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__)
+        sys.exit(1)
+    tx_node, tx = parse(sys.argv[1])
+    rx_node, rx = parse(sys.argv[2])
+    if not tx or not rx:
+        sys.exit("no TRACE dump found in one of the logs")
+
+    exs = exchanges(tx)
+    # Грубое начальное смещение: первое RX_IRQ приёмника против первого TX_DONE пульта
+    first_rx = next((t for p, _, t in rx if p == "RX_IRQ"), 0.0)
+    first_tx = next((e["TX_DONE"] for e in exs if "TX_DONE" in e), 0.0)
+    offset = first_rx - first_tx
+
+    stages = [
+        ("input -> TX start", "tx", "INPUT", "tx", "TX_START"),
+        ("command airtime", "tx", "TX_START", "tx", "TX_DONE"),
+        ("RX irq -> readData", "rx", "RX_IRQ", "rx", "READ_DATA"),
+        ("readData -> relay GPIO", "rx", "READ_DATA", "rx", "RELAY_WRITE"),
+        ("relay GPIO -> ACK TX", "rx", "RELAY_WRITE", "rx", "ACK_TX"),
+        ("ACK airtime", "rx", "TX_START", "rx", "TX_DONE"),
+        ("ACK irq -> ACK RX", "tx", "RX_IRQ", "tx", "ACK_RX"),
+        ("input -> relay GPIO", "tx", "INPUT", "rx", "RELAY_WRITE"),
+        ("input -> ACK RX", "tx", "INPUT", "tx", "ACK_RX"),
+    ]
+    samples = {name: [] for name, *_ in stages}
+
+    for ex in exs:
+        ev = match_rx(ex, rx, offset)
+        if ev is None:
+            continue
+        # Уточняем смещение по паре "команда" и, если есть, паре "подтверждение"
+        pairs = [ev["RX_IRQ"] - ex["TX_DONE"]]
+        if "TX_DONE" in ev and "RX_IRQ" in ex:
+            pairs.append(ev["TX_DONE"] - ex["RX_IRQ"])
+        ex_offset = sum(pairs) / len(pairs)
+        offset = ex_offset
+        for name, sa, pa, sb, pb in stages:
+            a = (ex if sa == "tx" else ev).get(pa)
+            b = (ex if sb == "tx" else ev).get(pb)
+            if a is None or b is None:
+                continue
+            a -= ex_offset if sa == "rx" else 0
+            b -= ex_offset if sb == "rx" else 0
+            samples[name].append(b - a)
+
+    print(f"{tx_node} vs {rx_node}: {len(exs)} exchanges")
+    print(f"{'stage':28} {'n':>4} {'min,us':>10} {'median,us':>10} {'max,us':>10}")
+    for name, *_ in stages:
+        v = samples[name]
+        if not v:
+            continue
+        print(f"{name:28} {len(v):4} {min(v):10.0f} {statistics.median(v):10.0f} {max(v):10.0f}")
+
+
+if __name__ == "__main__":
+    main()